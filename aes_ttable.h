@@ -0,0 +1,231 @@
+// ============================================================
+// aes_ttable.h — Word-oriented T-table AES-256 engine
+//
+// Alternative backend to tiny_aes.h. The state is four 32-bit
+// columns (row 0 in the low byte) kept in registers; each
+// round is SubBytes + ShiftRows + MixColumns folded into one
+// table lookup per byte:
+//
+//   Te[x] = { 2·S[x], S[x], S[x], 3·S[x] }       (encrypt)
+//   Td[x] = { e·Si[x], 9·Si[x], d·Si[x], b·Si[x] } (decrypt)
+//
+// Only Te and Td are stored (2 × 1 KB, built constexpr at
+// compile time from the S-boxes in tiny_aes.h); the other three
+// column positions are byte rotations, which are free on the
+// Cortex-M33 barrel shifter.
+//
+// Decryption uses the equivalent inverse cipher, so the
+// decryption key schedule is precomputed once alongside the
+// encryption schedule in aesTInit().
+//
+// Usage:
+//   aesTInit(&ctx, key)                 — expand both schedules
+//   aesTCbcEncrypt(&ctx, iv, buf, len)  — in-place, len % 16 == 0
+//   aesTCbcDecrypt(&ctx, iv, buf, len)
+// ============================================================
+#ifndef AES_TTABLE_H
+#define AES_TTABLE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "tiny_aes.h"
+
+#define AES_RK_WORDS (4 * (AES_ROUNDS + 1))   // 60 words for AES-256
+
+// ─── Context: both key schedules as column words ───
+struct AesTCtx {
+  uint32_t ek[AES_RK_WORDS];   // encryption round keys
+  uint32_t dk[AES_RK_WORDS];   // equivalent-inverse-cipher round keys
+};
+
+// ─── Compile-time table generation ───
+struct AesTTables {
+  uint32_t te[256];
+  uint32_t td[256];
+};
+
+constexpr uint8_t _aest_xtime(uint8_t x) {
+  return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+constexpr uint8_t _aest_mul(uint8_t x, uint8_t y) {
+  uint8_t r = 0;
+  while (y) {
+    if (y & 1) r ^= x;
+    x = _aest_xtime(x);
+    y >>= 1;
+  }
+  return r;
+}
+
+constexpr uint32_t _aest_pack(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) {
+  return (uint32_t)b0 | ((uint32_t)b1 << 8) | ((uint32_t)b2 << 16) | ((uint32_t)b3 << 24);
+}
+
+constexpr AesTTables _aestBuild() {
+  AesTTables t = {};
+  for (int i = 0; i < 256; i++) {
+    uint8_t s = _aes_sbox[i];
+    t.te[i] = _aest_pack(_aest_mul(s, 2), s, s, _aest_mul(s, 3));
+    uint8_t si = _aes_rsbox[i];
+    t.td[i] = _aest_pack(_aest_mul(si, 0x0e), _aest_mul(si, 0x09),
+                         _aest_mul(si, 0x0d), _aest_mul(si, 0x0b));
+  }
+  return t;
+}
+
+static constexpr AesTTables _aest = _aestBuild();
+
+// ─── Word helpers ───
+static inline uint32_t _aest_rotl(uint32_t x, unsigned n) { return (x << n) | (x >> (32 - n)); }
+static inline uint8_t _aest_b(uint32_t w, unsigned i) { return (uint8_t)(w >> (8 * i)); }
+
+static inline uint32_t _aest_load(const uint8_t* p) {
+  return _aest_pack(p[0], p[1], p[2], p[3]);
+}
+
+static inline void _aest_store(uint8_t* p, uint32_t w) {
+  p[0] = (uint8_t)w; p[1] = (uint8_t)(w >> 8); p[2] = (uint8_t)(w >> 16); p[3] = (uint8_t)(w >> 24);
+}
+
+// One full round column: Te[a.row0] ^ rot8 Te[b.row1] ^ rot16 Te[c.row2] ^ rot24 Te[d.row3]
+static inline uint32_t _aest_encCol(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  return _aest.te[_aest_b(a, 0)] ^
+         _aest_rotl(_aest.te[_aest_b(b, 1)], 8) ^
+         _aest_rotl(_aest.te[_aest_b(c, 2)], 16) ^
+         _aest_rotl(_aest.te[_aest_b(d, 3)], 24);
+}
+
+static inline uint32_t _aest_decCol(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  return _aest.td[_aest_b(a, 0)] ^
+         _aest_rotl(_aest.td[_aest_b(b, 1)], 8) ^
+         _aest_rotl(_aest.td[_aest_b(c, 2)], 16) ^
+         _aest_rotl(_aest.td[_aest_b(d, 3)], 24);
+}
+
+// InvMixColumns of one word: Td[S[x]] cancels the inverse S-box
+static inline uint32_t _aest_invMixWord(uint32_t w) {
+  return _aest.td[_aes_sbox[_aest_b(w, 0)]] ^
+         _aest_rotl(_aest.td[_aes_sbox[_aest_b(w, 1)]], 8) ^
+         _aest_rotl(_aest.td[_aes_sbox[_aest_b(w, 2)]], 16) ^
+         _aest_rotl(_aest.td[_aes_sbox[_aest_b(w, 3)]], 24);
+}
+
+// ============================================================
+// PUBLIC API
+// ============================================================
+
+// ─── Expand encryption + decryption schedules (once per key) ───
+static inline void aesTInit(AesTCtx* ctx, const uint8_t* key) {
+  // Reuse the byte-wise FIPS-197 expansion, then view it as words
+  AesCtx tmp;
+  _aesKeyExpansion(&tmp, key);
+  for (unsigned i = 0; i < AES_RK_WORDS; i++) {
+    ctx->ek[i] = _aest_load(tmp.roundKey + 4 * i);
+  }
+  memset(&tmp, 0, sizeof(tmp));
+
+  // Equivalent inverse cipher: reverse round order, InvMixColumns
+  // on every round key except the first and last.
+  for (unsigned r = 0; r <= AES_ROUNDS; r++) {
+    for (unsigned j = 0; j < 4; j++) {
+      uint32_t w = ctx->ek[4 * (AES_ROUNDS - r) + j];
+      ctx->dk[4 * r + j] = (r == 0 || r == AES_ROUNDS) ? w : _aest_invMixWord(w);
+    }
+  }
+}
+
+// ─── Encrypt one 16-byte block in place ───
+static inline void aesTEncryptBlock(const AesTCtx* ctx, uint8_t* buf) {
+  const uint32_t* rk = ctx->ek;
+  uint32_t s0 = _aest_load(buf + 0)  ^ rk[0];
+  uint32_t s1 = _aest_load(buf + 4)  ^ rk[1];
+  uint32_t s2 = _aest_load(buf + 8)  ^ rk[2];
+  uint32_t s3 = _aest_load(buf + 12) ^ rk[3];
+
+  for (unsigned r = 1; r < AES_ROUNDS; r++) {
+    rk += 4;
+    uint32_t t0 = _aest_encCol(s0, s1, s2, s3) ^ rk[0];
+    uint32_t t1 = _aest_encCol(s1, s2, s3, s0) ^ rk[1];
+    uint32_t t2 = _aest_encCol(s2, s3, s0, s1) ^ rk[2];
+    uint32_t t3 = _aest_encCol(s3, s0, s1, s2) ^ rk[3];
+    s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+  }
+
+  // Final round: SubBytes + ShiftRows only
+  rk += 4;
+  uint32_t t0 = _aest_pack(_aes_sbox[_aest_b(s0, 0)], _aes_sbox[_aest_b(s1, 1)],
+                           _aes_sbox[_aest_b(s2, 2)], _aes_sbox[_aest_b(s3, 3)]) ^ rk[0];
+  uint32_t t1 = _aest_pack(_aes_sbox[_aest_b(s1, 0)], _aes_sbox[_aest_b(s2, 1)],
+                           _aes_sbox[_aest_b(s3, 2)], _aes_sbox[_aest_b(s0, 3)]) ^ rk[1];
+  uint32_t t2 = _aest_pack(_aes_sbox[_aest_b(s2, 0)], _aes_sbox[_aest_b(s3, 1)],
+                           _aes_sbox[_aest_b(s0, 2)], _aes_sbox[_aest_b(s1, 3)]) ^ rk[2];
+  uint32_t t3 = _aest_pack(_aes_sbox[_aest_b(s3, 0)], _aes_sbox[_aest_b(s0, 1)],
+                           _aes_sbox[_aest_b(s1, 2)], _aes_sbox[_aest_b(s2, 3)]) ^ rk[3];
+
+  _aest_store(buf + 0, t0);
+  _aest_store(buf + 4, t1);
+  _aest_store(buf + 8, t2);
+  _aest_store(buf + 12, t3);
+}
+
+// ─── Decrypt one 16-byte block in place ───
+static inline void aesTDecryptBlock(const AesTCtx* ctx, uint8_t* buf) {
+  const uint32_t* rk = ctx->dk;
+  uint32_t s0 = _aest_load(buf + 0)  ^ rk[0];
+  uint32_t s1 = _aest_load(buf + 4)  ^ rk[1];
+  uint32_t s2 = _aest_load(buf + 8)  ^ rk[2];
+  uint32_t s3 = _aest_load(buf + 12) ^ rk[3];
+
+  for (unsigned r = 1; r < AES_ROUNDS; r++) {
+    rk += 4;
+    uint32_t t0 = _aest_decCol(s0, s3, s2, s1) ^ rk[0];
+    uint32_t t1 = _aest_decCol(s1, s0, s3, s2) ^ rk[1];
+    uint32_t t2 = _aest_decCol(s2, s1, s0, s3) ^ rk[2];
+    uint32_t t3 = _aest_decCol(s3, s2, s1, s0) ^ rk[3];
+    s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+  }
+
+  // Final round: InvSubBytes + InvShiftRows only
+  rk += 4;
+  uint32_t t0 = _aest_pack(_aes_rsbox[_aest_b(s0, 0)], _aes_rsbox[_aest_b(s3, 1)],
+                           _aes_rsbox[_aest_b(s2, 2)], _aes_rsbox[_aest_b(s1, 3)]) ^ rk[0];
+  uint32_t t1 = _aest_pack(_aes_rsbox[_aest_b(s1, 0)], _aes_rsbox[_aest_b(s0, 1)],
+                           _aes_rsbox[_aest_b(s3, 2)], _aes_rsbox[_aest_b(s2, 3)]) ^ rk[1];
+  uint32_t t2 = _aest_pack(_aes_rsbox[_aest_b(s2, 0)], _aes_rsbox[_aest_b(s1, 1)],
+                           _aes_rsbox[_aest_b(s0, 2)], _aes_rsbox[_aest_b(s3, 3)]) ^ rk[2];
+  uint32_t t3 = _aest_pack(_aes_rsbox[_aest_b(s3, 0)], _aes_rsbox[_aest_b(s2, 1)],
+                           _aes_rsbox[_aest_b(s1, 2)], _aes_rsbox[_aest_b(s0, 3)]) ^ rk[3];
+
+  _aest_store(buf + 0, t0);
+  _aest_store(buf + 4, t1);
+  _aest_store(buf + 8, t2);
+  _aest_store(buf + 12, t3);
+}
+
+// ─── CBC encrypt in place. len must be multiple of 16. ───
+static inline void aesTCbcEncrypt(const AesTCtx* ctx, const uint8_t* iv, uint8_t* buf, uint32_t len) {
+  const uint8_t* prev = iv;
+  for (uint32_t i = 0; i < len; i += AES_BLOCKLEN) {
+    _aesXorBlock(buf + i, prev);
+    aesTEncryptBlock(ctx, buf + i);
+    prev = buf + i;
+  }
+}
+
+// ─── CBC decrypt in place. len must be multiple of 16. ───
+static inline void aesTCbcDecrypt(const AesTCtx* ctx, const uint8_t* iv, uint8_t* buf, uint32_t len) {
+  uint8_t prev[AES_BLOCKLEN];
+  uint8_t next[AES_BLOCKLEN];
+  memcpy(prev, iv, AES_BLOCKLEN);
+  for (uint32_t i = 0; i < len; i += AES_BLOCKLEN) {
+    memcpy(next, buf + i, AES_BLOCKLEN);
+    aesTDecryptBlock(ctx, buf + i);
+    _aesXorBlock(buf + i, prev);
+    memcpy(prev, next, AES_BLOCKLEN);
+  }
+  memset(prev, 0, sizeof(prev));
+  memset(next, 0, sizeof(next));
+}
+
+#endif // AES_TTABLE_H
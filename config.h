@@ -17,28 +17,86 @@
 #define DEBOUNCE_MS      50
 
 // ─── Sensor ───
-#define SENSOR_BAUD      115200
-#define SENSOR_INIT_DELAY_MS  200   // let sensor wake after UART start
+#define SENSOR_BAUD      115200   // factory rate; tried first when nothing is saved
+#define SENSOR_INIT_DELAY_MS  200   // sensor wake after UART start (overlaps storage init)
+#define SENSOR_SERVICE_CORE1  1     // 1 = sensor I/O runs on core1, 0 = inline on core0
+#define SENSOR_QUEUE_DEPTH    8     // command/event ring capacity (power of two)
+#define SENSOR_CAPACITY       80    // template IDs on the ID809 (1..80)
+#define SENSOR_TEMPLATE_BYTES 1008  // getTemplate / downLoadTemplate size (63 AES blocks)
+
+// ─── Sensor Link (sensor_link.h) ───
+// Rates the ID809 can be switched to, fastest first. Boot moves the
+// link to the fastest one that passes verification; runtime link
+// errors step it down. The choice is saved in the journal.
+#define SENSOR_BAUD_RATES        { 115200, 57600, 38400, 19200, 9600 }
+#define SENSOR_LINK_VERIFY_PINGS 8     // pings in a row before a new rate is trusted
+#define SENSOR_LINK_MAX_ERRORS   3     // link errors in a row before stepping down
+#define SENSOR_LINK_BENCH_PINGS  20    // pings per rate for !LINKBENCH
+#define SENSOR_LINK_REPROBE_BOOTS 8    // boots below the top rate before it is tried again
 
 // ─── Fingerprint ───
 #define COLLECT_COUNT    3    // captures per enrollment
 #define CAPTURE_TIMEOUT  10   // seconds per capture attempt
 #define MATCH_TIMEOUT    5    // seconds for recognition capture
 #define MAX_CAPTURE_RETRIES 3 // retries per capture step
+#define FINGER_DEBOUNCE_US  5000  // Touch Out edges closer than this are bounces
+
+// ─── Match Strategy (recognition.h; !MATCH switches at run time) ───
+#define RECOG_VERIFY         0   // 1:1 against each indexed finger, last match first
+#define RECOG_SEARCH         1   // 1:N over every template on the sensor
+#define RECOG_VERIFY_SEARCH  2   // 1:1 against the last match, 1:N if that misses
+#define RECOG_STRATEGIES     3
+#define RECOG_STRATEGY       RECOG_VERIFY_SEARCH
 
 // ─── Password ───
 #define PASSWORD_MAX_LEN  32
 #define PASSWORD_TIMEOUT_MS 30000  // 30s to enter password
 #define PASSWORD_MAX_CONFIRM_ATTEMPTS 3
 
-// ─── EEPROM Layout ───
-#define EEPROM_SIZE       64   // bytes to init (only use 36)
-#define EEPROM_ADDR_MAGIC       0x00
-#define EEPROM_ADDR_ACTIVE_SLOT 0x01
-#define EEPROM_ADDR_PWD_LEN     0x02
-#define EEPROM_ADDR_PWD_START   0x03
-#define EEPROM_ADDR_CHECKSUM    0x23  // 0x03 + 32
-#define EEPROM_MAGIC_VALUE      0xAE  // 0xAE = encrypted format (was 0xA5 plaintext)
+// ─── Crypto ───
+#define AES_ENGINE_BYTE    0   // tiny_aes.h — byte-wise reference
+#define AES_ENGINE_TTABLE  1   // aes_ttable.h — 32-bit columns + T-tables
+#define CRYPTO_AES_ENGINE  AES_ENGINE_TTABLE
+
+// ─── Credential Store (cred_store.h) ───
+// Append-only journal in the FS partition — Tools → Flash Size must
+// leave an FS area of at least CRED_STORE_SECTORS × 4 KB.
+#define CRED_STORE_SECTORS     4    // sectors in the journal ring (>= 2)
+#define CRED_STORE_MAX_KEYS    12   // distinct record keys (< 16)
+
+// ─── Template Backup (tpl_backup.h) ───
+// Encrypted copies of enrolled templates, one 4 KB sector each,
+// right after the journal in the FS partition. Boot restores a
+// missing finger from its copy instead of asking for re-enrollment.
+// With an FS area smaller than (CRED_STORE_SECTORS + TPL_BACKUP_SLOTS)
+// × 4 KB the journal still works and backups are skipped.
+#define TPL_BACKUP_SLOTS       8    // templates kept, one sector each
+
+// ─── Credentials (cred_index.h) ───
+// Each credential is one password with any number of fingers. Its
+// password record has two journal keys (A/B banks); the index says
+// which bank is live and which sensor IDs belong to which credential.
+#define CRED_MAX_CREDENTIALS   4
+#define CRED_KEY_RECORD(c, bank) ((uint8_t)(((c) - 1) * 2 + (bank)))  // c = 1.., bank = 0/1
+#define CRED_KEY_INDEX         (CRED_MAX_CREDENTIALS * 2)
+#define CRED_KEY_LEGACY_REG    0    // v2 single registration (older firmware)
+#define CRED_KEY_SENSOR_LINK   (CRED_KEY_INDEX + 1)   // sensor_link.h rate record
+
+// ─── Credential Record ───
+// v3 record (see eeprom_storage.h): header + IV + ciphertext + tag
+#define EEPROM_MAGIC_VALUE      0xAF  // 0xAF = authenticated record (was 0xAE, 0xA5)
+#define EEPROM_RECORD_VERSION   3     // byte 2 = credential number
+#define EEPROM_LEGACY_VERSION   2     // byte 2 = sensor slot (1 or 2)
+#define EEPROM_TAG_LEN          16    // truncated HMAC-SHA256
+
+// ─── Legacy emulated-EEPROM layouts (read once, migrated to the journal) ───
+#define EEPROM_SIZE               128   // bytes to init
+#define EEPROM_LEGACY_ADDR_RECORD 0x00  // 0xAF record as a single EEPROM.put
+#define EEPROM_LEGACY_MAGIC       0xAE
+#define EEPROM_LEGACY_ADDR_SLOT   0x01
+#define EEPROM_LEGACY_ADDR_LEN    0x02
+#define EEPROM_LEGACY_ADDR_PWD    0x03
+#define EEPROM_LEGACY_ADDR_CS     0x23  // XOR of 0x00-0x22
 
 // ─── HID Timing ───
 #define LOCK_DELAY_MS        2000
@@ -49,6 +107,74 @@
 #define POST_TYPE_DELAY_MS   100
 #define POST_ENTER_DELAY_MS  500
 
+// ─── HID Adaptive Timing ───
+// When enabled, each settle delay above becomes an upper bound: after
+// every step a Caps Lock toggle is sent and the step ends as soon as the
+// host echoes it back in a keyboard LED output report.
+#ifndef HID_ADAPTIVE_TIMING      // host/CMakeLists.txt builds sim_adaptive with 1
+#define HID_ADAPTIVE_TIMING  0     // 1 = advance on host LED-report ack
+#endif
+#define HID_ADAPTIVE_MIN_MS  100   // floor per step even if the host acks instantly
+#define HID_CAPS_RESTORE_MS  500   // wait for the echo after tapping Caps Lock back
+
+// ─── HID Report Scheduling (hid_report.h) ───
+// The password is built into reports up front (one per character,
+// Shift held across runs) and sent one per HID_REPORT_INTERVAL_US
+// on alarm deadlines. Going below the endpoint's poll interval only
+// queues reports behind it. 0 types with Keyboard.print() instead.
+#define HID_BATCHED_TYPING     1
+#define HID_POLL_INTERVAL_US   1000   // keyboard endpoint bInterval (full speed: 1 ms minimum)
+#define HID_REPORT_INTERVAL_US 1000   // spacing of typed reports, ≥ HID_POLL_INTERVAL_US
+
+// ─── Keyboard Layouts (hid_layouts.h) ───
+// Each credential types through the layout of its Mac's keyboard,
+// chosen at registration ("2 DE"). New credentials without a choice
+// get this one. HID_LAYOUT_US / _UK / _DE / _FR / _CH.
+#define HID_LAYOUT_DEFAULT     HID_LAYOUT_US
+
+// ─── Cooperative Tasks ───
+#define TASK_MAX_POLLERS      4
+#define TASK_POLL_INTERVAL_MS 5    // max gap between background polls
+#define LOOP_IDLE_MS          10   // main loop wait when polling (!IDLE POLL)
+
+// ─── Idle (idle.h) ───
+// Between flows loop() sleeps (__wfi) until a touch, a switch edge,
+// console data or its next deadline. 0 boots with the fixed
+// LOOP_IDLE_MS wait instead.
+#define IDLE_EVENT_DRIVEN     1
+#define IDLE_MAX_MS           1000 // longest sleep without an event
+
+// ─── Latency Stats (latency_stats.h) ───
+// Per-phase unlock histograms behind !STATS. 0 compiles every
+// timestamp and the histogram storage out.
+#define LATENCY_STATS        1
+
+// ─── Capture Images (img_stream.h, !IMAGE) ───
+// Diagnostic mode: after each recognition capture the sensor's
+// grayscale image is fetched and streamed to the web monitor row by
+// row, delta + run-length coded. The fetch is a sensor UART transfer
+// (25.6 KB ≈ 2.2 s at 115200), made after the unlock.
+#define IMAGE_DIAG           1     // 0 = compiled out (no image buffer)
+#define IMAGE_QUARTER        0     // 1 = 80×80 quarter image (6.4 KB, 4× shorter fetch)
+#define IMAGE_SHIFT_MAX      4     // coarsest quantization !IMAGE ON <shift> accepts
+
+// ─── Console + Control Protocol (ctl_proto.h) ───
+// Text commands and COBS frames share the USB CDC port.
+#define SERIAL_CMD_MAX       32    // longest text command
+#define CTL_MAX_BODY         224   // largest frame body (STATS needs 200)
+#define CTL_FRAME_TIMEOUT_MS 100   // drop a frame that stalls this long
+
+// ─── Deferred Log Ring (log_ring.h) ───
+// LOG() queues { ms, format ID, raw args }; the console poller
+// writes them out while the USB buffer has room.
+#define LOG_RING_SLOTS       64    // records queued (power of two)
+#define LOG_MAX_ARGS         4     // arguments per LOG() call
+#define LOG_MAX_FORMATS      192   // distinct LOG() call sites (≤ 255)
+#define LOG_LINE_MAX         128   // longest rendered text line
+
+// ─── Boot ───
+#define BOOT_LED_MS          2000  // boot flash before the idle LED (touches work meanwhile)
+
 // ─── Cooldown ───
 #define COOLDOWN_MS          5000
 
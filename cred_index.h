@@ -0,0 +1,330 @@
+// ============================================================
+// cred_index.h — Finger → credential index over the 80 sensor IDs
+//
+// A credential is one password (eeprom_storage.h record) plus any
+// number of enrolled fingers. The index is a single authenticated
+// journal record (CRED_KEY_INDEX):
+//
+//   owner[id - 1] → credential number (0 = unassigned)   O(1) lookup
+//   bank[c - 1]   → which of c's two record keys is live (A/B)
+//   layout[c - 1] → keyboard layout of c's Mac (hid_layouts.h)
+//
+// It is held in RAM together with per-credential IdBits, so the
+// match path after search() is one array read and boot checks are
+// word-wide set operations against the sensor's occupancy bitmap.
+//
+// Atomic A/B per credential: a new password is written to the
+// idle bank and a new finger to a free sensor ID first; nothing
+// points at either until the index append that flips the bank and
+// reassigns the fingers. A crash before that append leaves the
+// old pair intact (the staged finger is an orphan that boot
+// validation deletes).
+//
+// Older single-registration devices are migrated on first boot:
+// their slot becomes the only finger of credential 1. A migration
+// that fails to write commits nothing, so the legacy data stays
+// where it was and the next boot tries again; until then boot
+// validation leaves the sensor alone (credLegacyPending). A version 1
+// index (before layouts) is rewritten as version 2 with every
+// credential typing US.
+//
+// Usage:
+//   credIndexInit()                 — after eepromInit()
+//   credLegacyPending()             — legacy slot not migrated yet, 0 = none
+//   credLookup(id)                  — credential for a sensor ID
+//   credReadPassword(c, pwd, len)   — decrypt c's live record
+//   credFreeId()                    — sensor ID for staging
+//   credLayout(c)                   — c's host keyboard layout
+//   credCommitReplace(c, id, pwd, len, layout) / credCommitAddFinger(c, id)
+//   credCommitPrune(ids, credMask)  — boot cleanup
+// ============================================================
+#ifndef CRED_INDEX_H
+#define CRED_INDEX_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "crypto.h"
+#include "cred_store.h"
+#include "eeprom_storage.h"
+#include "sensor_service.h"
+#include "id_bits.h"
+#include "hid_layouts.h"
+#include "log_ring.h"
+
+#define CRED_INDEX_MAGIC    0xC1
+#define CRED_INDEX_VERSION  2   // 2 = layout[] added; 1 is read once and rewritten
+#define CRED_BANK_NONE      0
+#define CRED_BANK_A         1
+#define CRED_BANK_B         2
+
+static_assert(CRED_MAX_CREDENTIALS <= 8, "credential masks are 8 bits");
+static_assert(CRED_KEY_INDEX < CRED_STORE_MAX_KEYS, "not enough journal keys");
+
+struct CredIndexRecord {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t bank[CRED_MAX_CREDENTIALS];   // CRED_BANK_*
+  uint8_t owner[SENSOR_CAPACITY];       // sensor ID - 1 → credential
+  uint8_t layout[CRED_MAX_CREDENTIALS]; // HidLayout of the credential's host
+  uint8_t tag[EEPROM_TAG_LEN];
+};
+static_assert(sizeof(CredIndexRecord) <= CRED_PAYLOAD_MAX, "index must fit one journal page");
+static_assert(HID_LAYOUT_US == 0, "an empty index must type US");
+
+#define CRED_INDEX_MAC_LEN (sizeof(CredIndexRecord) - EEPROM_TAG_LEN)
+#define CRED_INDEX_V1_LEN  offsetof(CredIndexRecord, layout)   // v1: owner[] then tag
+
+// ─── State (RAM copy is authoritative once loaded) ───
+static CredIndexRecord _idx;
+static IdBits _idx_assigned;
+static IdBits _idx_fingers[CRED_MAX_CREDENTIALS];
+static uint8_t _idx_legacySlot = 0;   // found but not migrated (write failed)
+
+// ─── Pure lookup (also used by the benchmark on synthetic indexes) ───
+static inline uint8_t _credLookupIn(const CredIndexRecord &idx, uint8_t id) {
+  if (id < 1 || id > SENSOR_CAPACITY) return 0;
+  uint8_t c = idx.owner[id - 1];
+  return (c <= CRED_MAX_CREDENTIALS) ? c : 0;
+}
+
+static inline void _credEmpty(CredIndexRecord &idx) {
+  memset(&idx, 0, sizeof(idx));
+  idx.magic = CRED_INDEX_MAGIC;
+  idx.version = CRED_INDEX_VERSION;
+}
+
+// ─── Rebuild per-credential bitsets from owner[] ───
+static inline void _credRebuildBits() {
+  idBitsClear(_idx_assigned);
+  for (uint8_t c = 0; c < CRED_MAX_CREDENTIALS; c++) idBitsClear(_idx_fingers[c]);
+  for (uint8_t id = 1; id <= SENSOR_CAPACITY; id++) {
+    uint8_t c = _credLookupIn(_idx, id);
+    if (c == 0) continue;
+    idBitsSet(_idx_assigned, id);
+    idBitsSet(_idx_fingers[c - 1], id);
+  }
+}
+
+static inline bool _credIndexAuthentic(const CredIndexRecord &idx) {
+  if (idx.magic != CRED_INDEX_MAGIC || idx.version != CRED_INDEX_VERSION) return false;
+  return cryptoMacVerify((const uint8_t*)&idx, CRED_INDEX_MAC_LEN, idx.tag, EEPROM_TAG_LEN);
+}
+
+// ─── Version 1 record (read as a v2 buffer, len bytes) → v2 ───
+static inline bool _credIndexFromV1(const CredIndexRecord &raw, uint16_t len, CredIndexRecord &out) {
+  const uint8_t* p = (const uint8_t*)&raw;
+  if (len != CRED_INDEX_V1_LEN + EEPROM_TAG_LEN || raw.magic != CRED_INDEX_MAGIC || raw.version != 1) return false;
+  if (!cryptoMacVerify(p, CRED_INDEX_V1_LEN, p + CRED_INDEX_V1_LEN, EEPROM_TAG_LEN)) return false;
+  _credEmpty(out);
+  memcpy(out.bank, raw.bank, sizeof(out.bank));
+  memcpy(out.owner, raw.owner, sizeof(out.owner));
+  return true;
+}
+
+// ─── Append a new index (the commit point), read back, adopt ───
+static inline bool _credCommit(CredIndexRecord &next) {
+  if (!cryptoMac((const uint8_t*)&next, CRED_INDEX_MAC_LEN, next.tag, EEPROM_TAG_LEN)) return false;
+
+  sensorWaitIdle();
+  bool ok = credStoreWrite(CRED_KEY_INDEX, &next, sizeof(next));
+  cacheBump();
+  if (!ok) return false;
+
+  CredIndexRecord back;
+  ok = credStoreRead(CRED_KEY_INDEX, &back, sizeof(back)) == sizeof(back) &&
+       memcmp(&back, &next, sizeof(next)) == 0;
+  if (!ok) return false;
+
+  _idx = next;
+  _credRebuildBits();
+  return true;
+}
+
+// ─── Older firmware → credential 1 ───
+enum CredMigrate {
+  CRED_MIGRATE_NONE,     // no legacy registration
+  CRED_MIGRATE_DONE,
+  CRED_MIGRATE_FAILED    // found, but a write failed: nothing committed
+};
+
+static inline CredMigrate _credMigrateLegacy() {
+  uint8_t slot = 0, len = 0;
+  char pwd[PASSWORD_MAX_LEN + 1];
+  if (!eepromTakeLegacy(slot, pwd, len)) return CRED_MIGRATE_NONE;
+
+  // Bank B: the legacy v2 record may still sit in bank A's key
+  bool ok = eepromWriteRecord(CRED_KEY_RECORD(1, 1), 1, pwd, len);
+  memset(pwd, 0, sizeof(pwd));
+
+  CredIndexRecord next;
+  _credEmpty(next);
+  next.bank[0] = CRED_BANK_B;
+  next.owner[slot - 1] = 1;
+  if (!ok || !_credCommit(next)) {
+    _idx_legacySlot = slot;
+    LOG("[ERROR] Migrating registration (slot %u) failed — retried next boot", slot);
+    return CRED_MIGRATE_FAILED;
+  }
+
+  eepromEraseRecord(CRED_KEY_LEGACY_REG);
+  eepromWipeLegacy();
+  LOG("[CRED] Migrated registration (slot %u) to credential 1", slot);
+  return CRED_MIGRATE_DONE;
+}
+
+// ============================================================
+// PUBLIC API
+// ============================================================
+
+// ─── Load the index; create or migrate on first boot ───
+// Returns false if a stored index failed its tag (treated as empty —
+// boot validation then sees every template as an orphan).
+inline bool credIndexInit() {
+  _credEmpty(_idx);
+  _credRebuildBits();
+  _idx_legacySlot = 0;
+  if (!credStoreMounted()) return false;
+
+  if (credStoreHas(CRED_KEY_INDEX)) {
+    CredIndexRecord rec, next;
+    uint16_t len = credStoreRead(CRED_KEY_INDEX, &rec, sizeof(rec));
+    if (len == sizeof(rec) && _credIndexAuthentic(rec)) {
+      _idx = rec;
+      _credRebuildBits();
+      return true;
+    }
+    if (_credIndexFromV1(rec, len, next)) {
+      if (!_credCommit(next)) {   // keep going on the upgraded copy; retried next boot
+        _idx = next;
+        _credRebuildBits();
+      }
+      LOG("[CRED] Index v1 → v2 (layouts: US)");
+      return true;
+    }
+    LOG("[CRED] Index failed integrity check");
+    return false;
+  }
+
+  // Never written: older firmware, or a virgin device. An index is
+  // committed only once there is nothing left to migrate — with one
+  // in place the migration would never run again.
+  if (_credMigrateLegacy() == CRED_MIGRATE_NONE) {
+    CredIndexRecord next;
+    _credEmpty(next);
+    _credCommit(next);
+  }
+  return true;
+}
+
+inline uint8_t credLegacyPending()                { return _idx_legacySlot; }
+
+inline uint8_t credLookup(uint8_t id)             { return _credLookupIn(_idx, id); }
+inline bool credInUse(uint8_t c)                  { return c >= 1 && c <= CRED_MAX_CREDENTIALS && _idx.bank[c - 1] != CRED_BANK_NONE; }
+inline const IdBits& credFingers(uint8_t c)       { return _idx_fingers[c - 1]; }
+inline const IdBits& credAssigned()               { return _idx_assigned; }
+inline uint8_t credFingerCount(uint8_t c)         { return idBitsCount(_idx_fingers[c - 1]); }
+inline uint8_t credLayout(uint8_t c)              { return _idx.layout[c - 1] < HID_LAYOUTS ? _idx.layout[c - 1] : (uint8_t)HID_LAYOUT_US; }
+
+// ─── Journal key of c's live password record ───
+inline uint8_t credActiveKey(uint8_t c) {
+  return CRED_KEY_RECORD(c, _idx.bank[c - 1] == CRED_BANK_B ? 1 : 0);
+}
+
+// ─── Live record authentic? (cached, no decrypt) ───
+inline bool credRecordValid(uint8_t c) {
+  return credInUse(c) && eepromRecordValid(credActiveKey(c), c);
+}
+
+inline bool credReadPassword(uint8_t c, char* password, uint8_t &length) {
+  if (!credInUse(c)) return false;
+  return eepromReadRecord(credActiveKey(c), c, password, length);
+}
+
+// ─── Lowest sensor ID neither indexed nor holding a template ───
+// 0 if the sensor is full. Falls back to index-only when the
+// sensor's ID list is unavailable.
+inline uint8_t credFreeId() {
+  IdBits used = _idx_assigned;
+  if (sensorOccupancyKnown()) {
+    const IdBits &occ = sensorOccupancy();
+    for (uint8_t i = 0; i < ID_BITS_WORDS; i++) used.w[i] |= occ.w[i];
+  }
+  for (uint8_t i = 0; i < ID_BITS_WORDS; i++) used.w[i] = ~used.w[i];
+  return idBitsFirst(used);
+}
+
+// ─── Replace c's password + fingers with (id, password) ───
+// Writes the idle bank, then flips bank + fingers + layout in one
+// index append. The old fingers are still on the sensor afterwards —
+// the caller deletes them (credFingers(c) before the call).
+inline bool credCommitReplace(uint8_t c, uint8_t id, const char* password, uint8_t length, uint8_t layout) {
+  if (c < 1 || c > CRED_MAX_CREDENTIALS || id < 1 || id > SENSOR_CAPACITY || layout >= HID_LAYOUTS) return false;
+  uint8_t bank = (_idx.bank[c - 1] == CRED_BANK_A) ? CRED_BANK_B : CRED_BANK_A;
+  if (!eepromWriteRecord(CRED_KEY_RECORD(c, bank - 1), c, password, length)) return false;
+
+  CredIndexRecord next = _idx;
+  for (uint8_t i = 0; i < SENSOR_CAPACITY; i++) {
+    if (next.owner[i] == c) next.owner[i] = 0;
+  }
+  next.owner[id - 1] = c;
+  next.bank[c - 1] = bank;
+  next.layout[c - 1] = layout;
+  return _credCommit(next);
+}
+
+// ─── Add a finger to an existing credential (password unchanged) ───
+inline bool credCommitAddFinger(uint8_t c, uint8_t id) {
+  if (!credInUse(c) || id < 1 || id > SENSOR_CAPACITY) return false;
+  CredIndexRecord next = _idx;
+  next.owner[id - 1] = c;
+  return _credCommit(next);
+}
+
+// ─── Unassign ids and drop whole credentials (bit c-1 of credMask) ───
+// Dropped credentials' records are erased after the index commit.
+inline bool credCommitPrune(const IdBits &ids, uint8_t credMask) {
+  CredIndexRecord next = _idx;
+  for (uint8_t id = idBitsFirst(ids); id; id = idBitsNext(ids, id)) next.owner[id - 1] = 0;
+  for (uint8_t c = 1; c <= CRED_MAX_CREDENTIALS; c++) {
+    if (!(credMask & (1u << (c - 1)))) continue;
+    next.bank[c - 1] = CRED_BANK_NONE;
+    next.layout[c - 1] = HID_LAYOUT_US;
+    for (uint8_t i = 0; i < SENSOR_CAPACITY; i++) {
+      if (next.owner[i] == c) next.owner[i] = 0;
+    }
+  }
+  if (!_credCommit(next)) return false;
+
+  for (uint8_t c = 1; c <= CRED_MAX_CREDENTIALS; c++) {
+    if (!(credMask & (1u << (c - 1)))) continue;
+    eepromEraseRecord(CRED_KEY_RECORD(c, 0));
+    eepromEraseRecord(CRED_KEY_RECORD(c, 1));
+  }
+  return true;
+}
+
+// ─── Console: one line per credential ───
+inline void credPrintIndex() {
+  logFlush();
+  for (uint8_t c = 1; c <= CRED_MAX_CREDENTIALS; c++) {
+    Serial.print("[CRED] #");
+    Serial.print(c);
+    if (!credInUse(c)) {
+      Serial.println(": empty");
+      continue;
+    }
+    Serial.print(credRecordValid(c) ? ": valid, bank " : ": INVALID, bank ");
+    Serial.print(_idx.bank[c - 1] == CRED_BANK_A ? 'A' : 'B');
+    Serial.print(", layout ");
+    Serial.print(hidLayoutName(credLayout(c)));
+    Serial.print(", fingers");
+    const IdBits &f = credFingers(c);
+    for (uint8_t id = idBitsFirst(f); id; id = idBitsNext(f, id)) {
+      Serial.print(' ');
+      Serial.print(id);
+    }
+    Serial.println();
+  }
+}
+
+#endif // CRED_INDEX_H
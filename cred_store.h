@@ -0,0 +1,326 @@
+// ============================================================
+// cred_store.h — Log-structured, wear-leveled credential journal
+//
+// Replaces the fixed EEPROM layout. Every write appends one
+// 256-byte page to a ring of CRED_STORE_SECTORS flash sectors:
+//
+//   [ magic | seq | key | flags | len | crc32 | payload ... ]
+//
+// The newest valid page (highest seq) for a key wins. Deletes
+// append a tombstone. Nothing is erased on the write path
+// except when the head sector fills:
+//
+//   sector:   S0        S1        S2        S3
+//             [full]    [head→ ]  [blank]   [old]
+//
+// The sector after the head is always kept blank. Moving the
+// head into it reclaims the sector after that: pages still
+// current for their key are copied forward, then it is erased.
+// A copy that doesn't take is retried once at the next head
+// page; if that fails too the reclaim stops with the sector
+// left as it is (it may hold the only good copy) and is retried
+// by the next append. The head never moves into a sector that
+// still holds a current page.
+// Sectors are erased round-robin, so wear is spread evenly and a
+// re-registration costs one page program instead of a sector
+// erase + rewrite.
+//
+// Mount scans every page once, keeps a per-key index in RAM
+// (O(1) reads) and resumes after the highest valid seq. Torn
+// pages fail the CRC and are skipped; an interrupted reclaim is
+// finished on the next mount.
+//
+// Usage:
+//   credStoreMount()                 — once at boot
+//   credStoreWrite(key, data, len)   — append a new version
+//   credStoreRead(key, buf, cap)     — bytes read, 0 = absent
+//   credStoreErase(key)              — append a tombstone
+//   credStoreStats()                 — appends / erases / latency
+// ============================================================
+#ifndef CRED_STORE_H
+#define CRED_STORE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "flash_region.h"
+
+#define CRED_PAGE_MAGIC       0x4A524E4CUL   // "LNRJ"
+#define CRED_FLAG_TOMBSTONE   0x01
+#define CRED_PAGES_PER_SECTOR (FLASH_REGION_SECTOR / FLASH_REGION_PAGE)
+
+struct CredPageHdr {
+  uint32_t magic;
+  uint32_t seq;      // 1.. ; 0 and 0xFFFFFFFF never written
+  uint8_t  key;
+  uint8_t  flags;
+  uint16_t len;      // payload bytes
+  uint32_t crc;      // CRC-32 of header (crc = 0) + payload
+};
+
+#define CRED_PAYLOAD_MAX (FLASH_REGION_PAGE - sizeof(CredPageHdr))
+
+static_assert(sizeof(CredPageHdr) == 16, "CredPageHdr must be packed");
+static_assert(CRED_STORE_SECTORS >= 2, "journal needs at least two sectors");
+// A reclaim must always fit in the fresh head sector
+static_assert(CRED_STORE_MAX_KEYS < CRED_PAGES_PER_SECTOR, "too many keys per sector");
+
+// ─── Per-key index (RAM) ───
+struct CredKeyRef {
+  uint32_t seq;      // 0 = never written
+  uint16_t page;     // global page index
+  uint16_t len;
+  bool live;         // false = tombstone
+};
+
+struct CredStoreStats {
+  uint32_t appends;
+  uint32_t relocations;                       // pages copied forward by reclaim
+  uint32_t erases;
+  uint32_t sectorErases[CRED_STORE_SECTORS];  // since boot
+  uint32_t lastCommitUs;
+  uint32_t maxCommitUs;
+};
+
+// ─── State ───
+static CredKeyRef _cred_keys[CRED_STORE_MAX_KEYS];
+static CredStoreStats _cred_stats;
+static uint32_t _cred_seq = 0;       // last seq written
+static uint8_t _cred_sector = 0;     // head sector
+static uint8_t _cred_page = 0;       // next free page in head sector (== PAGES when full)
+static bool _cred_mounted = false;
+
+// ─── CRC-32 (IEEE, nibble table) ───
+static inline uint32_t _credCrc(uint32_t crc, const uint8_t* p, size_t len) {
+  static const uint32_t t[16] = {
+    0x00000000,0x1DB71064,0x3B6E20C8,0x26D930AC,0x76DC4190,0x6B6B51F4,0x4DB26158,0x5005713C,
+    0xEDB88320,0xF00F9344,0xD6D6A3E8,0xCB61B38C,0x9B64C2B0,0x86D3D2D4,0xA00AE278,0xBDBDF21C
+  };
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    crc = (crc >> 4) ^ t[crc & 15];
+    crc = (crc >> 4) ^ t[crc & 15];
+  }
+  return ~crc;
+}
+
+static inline uint32_t _credPageCrc(const uint8_t* page) {
+  CredPageHdr h;
+  memcpy(&h, page, sizeof(h));
+  h.crc = 0;
+  uint32_t crc = _credCrc(0, (const uint8_t*)&h, sizeof(h));
+  return _credCrc(crc, page + sizeof(h), h.len);
+}
+
+static inline uint32_t _credPageOff(uint16_t page) {
+  return (uint32_t)page * FLASH_REGION_PAGE;
+}
+
+// ─── Read + validate one page. hdr is filled only when valid. ───
+static inline bool _credLoadPage(uint16_t page, uint8_t* buf, CredPageHdr &hdr) {
+  flashRegionRead(_credPageOff(page), buf, FLASH_REGION_PAGE);
+  memcpy(&hdr, buf, sizeof(hdr));
+  if (hdr.magic != CRED_PAGE_MAGIC || hdr.seq == 0 || hdr.seq == 0xFFFFFFFFUL) return false;
+  if (hdr.len > CRED_PAYLOAD_MAX) return false;
+  return hdr.crc == _credPageCrc(buf);
+}
+
+static inline bool _credBlank(const uint8_t* buf, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+// ─── Are pages [first, end of sector) all erased? ───
+static inline bool _credSectorBlankFrom(uint8_t sector, uint8_t first) {
+  uint8_t buf[FLASH_REGION_PAGE];
+  for (uint8_t p = first; p < CRED_PAGES_PER_SECTOR; p++) {
+    flashRegionRead(_credPageOff(sector * CRED_PAGES_PER_SECTOR + p), buf, sizeof(buf));
+    if (!_credBlank(buf, sizeof(buf))) return false;
+  }
+  return true;
+}
+
+static inline void _credEraseSector(uint8_t sector) {
+  flashRegionErase((uint32_t)sector * FLASH_REGION_SECTOR);
+  _cred_stats.erases++;
+  _cred_stats.sectorErases[sector]++;
+}
+
+// ─── Does any key's current version live in this sector? ───
+static inline bool _credSectorHoldsLive(uint8_t sector) {
+  for (uint8_t k = 0; k < CRED_STORE_MAX_KEYS; k++) {
+    const CredKeyRef &ref = _cred_keys[k];
+    if (ref.seq && ref.live && ref.page / CRED_PAGES_PER_SECTOR == sector) return true;
+  }
+  return false;
+}
+
+// ─── Program one page at the head (no sector change; false when full) ───
+static inline bool _credProgram(uint8_t key, uint8_t flags, const void* data, uint16_t len) {
+  if (_cred_page >= CRED_PAGES_PER_SECTOR) return false;
+  uint8_t buf[FLASH_REGION_PAGE];
+  memset(buf, 0xFF, sizeof(buf));
+
+  CredPageHdr hdr = { CRED_PAGE_MAGIC, _cred_seq + 1, key, flags, len, 0 };
+  memcpy(buf, &hdr, sizeof(hdr));
+  if (len) memcpy(buf + sizeof(hdr), data, len);
+  hdr.crc = _credPageCrc(buf);
+  memcpy(buf, &hdr, sizeof(hdr));
+
+  uint16_t page = _cred_sector * CRED_PAGES_PER_SECTOR + _cred_page;
+  flashRegionProgram(_credPageOff(page), buf);
+  _cred_page++;
+
+  // Read back — a page that didn't take is simply skipped
+  CredPageHdr back;
+  uint8_t chk[FLASH_REGION_PAGE];
+  if (!_credLoadPage(page, chk, back) || memcmp(chk, buf, sizeof(buf)) != 0) return false;
+
+  _cred_seq = hdr.seq;
+  CredKeyRef &ref = _cred_keys[key];
+  ref.seq = hdr.seq;
+  ref.page = page;
+  ref.len = len;
+  ref.live = !(flags & CRED_FLAG_TOMBSTONE);
+  return true;
+}
+
+// ─── Copy the still-current pages of a sector to the head, then erase it ───
+// False (sector not erased) when a page could not be copied.
+static inline bool _credReclaim(uint8_t sector) {
+  uint8_t buf[FLASH_REGION_PAGE];
+  bool moved = true;
+  for (uint8_t p = 0; p < CRED_PAGES_PER_SECTOR && moved; p++) {
+    uint16_t page = sector * CRED_PAGES_PER_SECTOR + p;
+    CredPageHdr hdr;
+    if (!_credLoadPage(page, buf, hdr) || hdr.key >= CRED_STORE_MAX_KEYS) continue;
+    const CredKeyRef &ref = _cred_keys[hdr.key];
+    // Tombstones are dropped: every older version is in an older sector
+    if (ref.page != page || !ref.live) continue;
+    const uint8_t* data = buf + sizeof(hdr);
+    moved = _credProgram(hdr.key, hdr.flags, data, hdr.len) ||
+            _credProgram(hdr.key, hdr.flags, data, hdr.len);   // once more, next page
+    if (moved) _cred_stats.relocations++;
+  }
+  memset(buf, 0, sizeof(buf));
+  if (!moved) return false;
+  if (!_credSectorBlankFrom(sector, 0)) _credEraseSector(sector);
+  return true;
+}
+
+// ─── Move the head into the (blank) next sector and reclaim the one after ───
+// False when the next sector's reclaim never finished: nowhere to go.
+static inline bool _credAdvance() {
+  uint8_t next = (_cred_sector + 1) % CRED_STORE_SECTORS;
+  if (_credSectorHoldsLive(next)) return false;
+  if (!_credSectorBlankFrom(next, 0)) _credEraseSector(next);  // only garbage can be here
+  _cred_sector = next;
+  _cred_page = 0;
+  _credReclaim((next + 1) % CRED_STORE_SECTORS);   // on failure retried by the next append
+  return true;
+}
+
+// ─── Append with head management ───
+static inline bool _credAppend(uint8_t key, uint8_t flags, const void* data, uint16_t len) {
+  if (!_cred_mounted || key >= CRED_STORE_MAX_KEYS || len > CRED_PAYLOAD_MAX) return false;
+
+  uint32_t t0 = flashRegionMicros();
+  bool ok = false;
+  // A reclaim that stopped early gets another go while the head has room
+  uint8_t after = (_cred_sector + 1) % CRED_STORE_SECTORS;
+  if (_cred_page < CRED_PAGES_PER_SECTOR && _credSectorHoldsLive(after)) _credReclaim(after);
+
+  for (uint8_t attempt = 0; attempt < 3 && !ok; attempt++) {
+    if (_cred_page >= CRED_PAGES_PER_SECTOR && !_credAdvance()) break;
+    ok = _credProgram(key, flags, data, len);
+  }
+  uint32_t dt = flashRegionMicros() - t0;
+
+  _cred_stats.appends++;
+  _cred_stats.lastCommitUs = dt;
+  if (dt > _cred_stats.maxCommitUs) _cred_stats.maxCommitUs = dt;
+  return ok;
+}
+
+// ============================================================
+// PUBLIC API
+// ============================================================
+
+// ─── Scan the ring, rebuild the index, restore the blank-next invariant ───
+inline bool credStoreMount() {
+  _cred_mounted = false;
+  memset(_cred_keys, 0, sizeof(_cred_keys));
+  memset(&_cred_stats, 0, sizeof(_cred_stats));
+  if (flashRegionSize() < FLASH_REGION_JOURNAL) return false;
+
+  uint8_t buf[FLASH_REGION_PAGE];
+  int32_t last = -1;
+  _cred_seq = 0;
+  for (uint16_t page = 0; page < CRED_STORE_SECTORS * CRED_PAGES_PER_SECTOR; page++) {
+    CredPageHdr hdr;
+    if (!_credLoadPage(page, buf, hdr)) continue;
+    if (hdr.key < CRED_STORE_MAX_KEYS && hdr.seq > _cred_keys[hdr.key].seq) {
+      _cred_keys[hdr.key] = { hdr.seq, page, hdr.len, !(hdr.flags & CRED_FLAG_TOMBSTONE) };
+    }
+    if (hdr.seq > _cred_seq) {
+      _cred_seq = hdr.seq;
+      last = page;
+    }
+  }
+  memset(buf, 0, sizeof(buf));
+
+  // Resume after the newest page; a torn or dirty tail closes the sector
+  uint16_t head = (last < 0) ? 0 : (uint16_t)(last + 1);
+  _cred_sector = (last < 0) ? 0 : (uint8_t)(last / CRED_PAGES_PER_SECTOR);
+  _cred_page = (uint8_t)(head - _cred_sector * CRED_PAGES_PER_SECTOR);
+  if (_cred_page < CRED_PAGES_PER_SECTOR && !_credSectorBlankFrom(_cred_sector, _cred_page)) {
+    _cred_page = CRED_PAGES_PER_SECTOR;
+  }
+
+  _cred_mounted = true;
+  if (_cred_page >= CRED_PAGES_PER_SECTOR) {
+    _credAdvance();
+  } else {
+    _credReclaim((_cred_sector + 1) % CRED_STORE_SECTORS);  // no-op when already blank
+  }
+  return true;
+}
+
+inline bool credStoreMounted() {
+  return _cred_mounted;
+}
+
+inline bool credStoreWrite(uint8_t key, const void* data, uint16_t len) {
+  return _credAppend(key, 0, data, len);
+}
+
+inline bool credStoreErase(uint8_t key) {
+  if (key >= CRED_STORE_MAX_KEYS || !_cred_keys[key].live) return true;  // nothing to delete
+  return _credAppend(key, CRED_FLAG_TOMBSTONE, nullptr, 0);
+}
+
+inline bool credStoreHas(uint8_t key) {
+  return _cred_mounted && key < CRED_STORE_MAX_KEYS && _cred_keys[key].live;
+}
+
+// ─── Copy the current version into buf. Returns bytes read (0 = absent). ───
+inline uint16_t credStoreRead(uint8_t key, void* buf, uint16_t cap) {
+  if (!credStoreHas(key)) return 0;
+  const CredKeyRef &ref = _cred_keys[key];
+  uint16_t n = ref.len < cap ? ref.len : cap;
+  flashRegionRead(_credPageOff(ref.page) + sizeof(CredPageHdr), buf, n);
+  return n;
+}
+
+inline const CredStoreStats& credStoreStats() {
+  return _cred_stats;
+}
+
+inline uint32_t credStoreSequence() {
+  return _cred_seq;
+}
+
+#endif // CRED_STORE_H
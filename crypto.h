@@ -3,16 +3,33 @@
 //
 // Key derivation:
 //   1. Read RP2350's 8-byte unique board ID from OTP
-//   2. SHA-256 hash it → 32-byte AES key
+//   2. SHA-256 hash it → 32-byte AES key      (0xAE record format)
 //   3. SHA-256 hash (unique_id + salt) → first 16 bytes = IV
+//   4. HKDF-SHA256(unique_id) → independent encryption + MAC
+//      subkeys for the authenticated 0xAF record (random IV per
+//      write, encrypt-then-MAC, see cryptoSeal)
 //
 // The encryption key is DEVICE-SPECIFIC. An EEPROM dump from
 // one board is useless on another (or without the board).
 //
+// AES backend is chosen at compile time (CRYPTO_AES_ENGINE):
+//   AES_ENGINE_BYTE   — tiny_aes.h, byte-wise reference
+//   AES_ENGINE_TTABLE — aes_ttable.h, 32-bit T-table engine
+// Either way both key schedules are expanded once in cryptoInit()
+// and reused for every seal/open.
+//
 // Usage:
 //   cryptoInit()                           — call once at boot
-//   cryptoEncryptPassword(plain, cipher)   — encrypt 32 bytes
-//   cryptoDecryptPassword(cipher, plain)   — decrypt 32 bytes
+//   cryptoRandom(buf, len)                 — hardware RNG (IVs)
+//   cryptoSeal(aad, ..., tag, tagLen)      — encrypt-then-MAC, one pass
+//   cryptoOpen(aad, ..., tag, tagLen)      — verify tag, then decrypt
+//   cryptoVerifyTag(aad, ..., tag, tagLen) — tag check only
+//   cryptoMac(data, len, tag, tagLen)      — HMAC tag over plaintext
+//   cryptoMacVerify(data, len, tag, tagLen)
+//   cryptoDecryptLegacy(cipher, plain)     — 0xAE records (migration)
+//   cryptoWipe(buf, len)                   — zero secrets (never elided)
+//   cryptoSelfTest()                       — FIPS-197 KAT, both engines
+//   cryptoBenchmark(blocks)                — cycles/block, both engines
 // ============================================================
 #ifndef CRYPTO_H
 #define CRYPTO_H
@@ -21,83 +38,16 @@
 #include <string.h>
 #include <Arduino.h>
 #include <pico/unique_id.h>
+#include <pico/rand.h>
+#include "config.h"
 #include "tiny_aes.h"
+#include "aes_ttable.h"
+#include "sha256.h"
+#include "log_ring.h"
 
-// ─── Minimal software SHA-256 (RFC 6234) ───
-// Used for key derivation only. ~100 lines.
-
-static const uint32_t _sha256_k[64] = {
-  0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
-  0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
-  0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
-  0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
-  0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
-  0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
-  0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
-  0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
-};
-
-static inline uint32_t _sha_rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32 - n)); }
-static inline uint32_t _sha_ch(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (~x & z); }
-static inline uint32_t _sha_maj(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (x & z) ^ (y & z); }
-static inline uint32_t _sha_ep0(uint32_t x) { return _sha_rotr(x,2) ^ _sha_rotr(x,13) ^ _sha_rotr(x,22); }
-static inline uint32_t _sha_ep1(uint32_t x) { return _sha_rotr(x,6) ^ _sha_rotr(x,11) ^ _sha_rotr(x,25); }
-static inline uint32_t _sha_sig0(uint32_t x) { return _sha_rotr(x,7) ^ _sha_rotr(x,18) ^ (x >> 3); }
-static inline uint32_t _sha_sig1(uint32_t x) { return _sha_rotr(x,17) ^ _sha_rotr(x,19) ^ (x >> 10); }
-
-// SHA-256: hash arbitrary data into 32-byte digest
-// Simple single-call implementation for short inputs (< 55 bytes)
-static inline void _sha256(const uint8_t* data, size_t len, uint8_t digest[32]) {
-  uint32_t h[8] = {
-    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
-  };
-
-  // Pad message: data + 0x80 + zeros + 64-bit length
-  // For inputs <= 55 bytes, fits in single 64-byte block
-  uint8_t block[64];
-  memset(block, 0, 64);
-  memcpy(block, data, len);
-  block[len] = 0x80;
-
-  // Length in bits (big-endian) at end of block
-  uint64_t bitlen = len * 8;
-  block[63] = (uint8_t)(bitlen);
-  block[62] = (uint8_t)(bitlen >> 8);
-  block[61] = (uint8_t)(bitlen >> 16);
-  block[60] = (uint8_t)(bitlen >> 24);
-  block[59] = (uint8_t)(bitlen >> 32);
-  block[58] = (uint8_t)(bitlen >> 40);
-  block[57] = (uint8_t)(bitlen >> 48);
-  block[56] = (uint8_t)(bitlen >> 56);
-
-  // Parse block into 16 big-endian words
-  uint32_t w[64];
-  for (int i = 0; i < 16; i++) {
-    w[i] = ((uint32_t)block[i*4] << 24) | ((uint32_t)block[i*4+1] << 16) |
-            ((uint32_t)block[i*4+2] << 8) | ((uint32_t)block[i*4+3]);
-  }
-  for (int i = 16; i < 64; i++) {
-    w[i] = _sha_sig1(w[i-2]) + w[i-7] + _sha_sig0(w[i-15]) + w[i-16];
-  }
-
-  // Compress
-  uint32_t a=h[0], b=h[1], c=h[2], d=h[3], e=h[4], f=h[5], g=h[6], hh=h[7];
-  for (int i = 0; i < 64; i++) {
-    uint32_t t1 = hh + _sha_ep1(e) + _sha_ch(e,f,g) + _sha256_k[i] + w[i];
-    uint32_t t2 = _sha_ep0(a) + _sha_maj(a,b,c);
-    hh=g; g=f; f=e; e=d+t1; d=c; c=b; b=a; a=t1+t2;
-  }
-  h[0]+=a; h[1]+=b; h[2]+=c; h[3]+=d; h[4]+=e; h[5]+=f; h[6]+=g; h[7]+=hh;
-
-  // Output digest (big-endian)
-  for (int i = 0; i < 8; i++) {
-    digest[i*4+0] = (uint8_t)(h[i] >> 24);
-    digest[i*4+1] = (uint8_t)(h[i] >> 16);
-    digest[i*4+2] = (uint8_t)(h[i] >> 8);
-    digest[i*4+3] = (uint8_t)(h[i]);
-  }
-}
+#ifndef F_CPU
+#define F_CPU 150000000UL   // RP2350 default clock
+#endif
 
 // ============================================================
 // Device key material — derived once at boot, held in RAM
@@ -107,6 +57,188 @@ static uint8_t _crypto_key[32];  // AES-256 key (SHA-256 of unique ID)
 static uint8_t _crypto_iv[16];   // CBC IV (from salted hash of unique ID)
 static bool _crypto_ready = false;
 
+// ─── HKDF subkeys (separate keys for encryption and integrity) ───
+static const char _crypto_hkdfSalt[]    = "fp-unlocker/v1";
+static const char _crypto_hkdfInfoEnc[] = "enc:aes-256";
+static const char _crypto_hkdfInfoMac[] = "mac:hmac-sha256";
+static uint8_t _crypto_encKey[32];
+static uint8_t _crypto_macKey[32];
+
+// ─── Engine-neutral block helpers ───
+#if CRYPTO_AES_ENGINE == AES_ENGINE_TTABLE
+typedef AesTCtx CryptoAes;
+static inline void _cryptoAesInit(CryptoAes* c, const uint8_t* key) { aesTInit(c, key); }
+static inline void _cryptoAesEnc(CryptoAes* c, uint8_t* b)          { aesTEncryptBlock(c, b); }
+static inline void _cryptoAesDec(CryptoAes* c, uint8_t* b)          { aesTDecryptBlock(c, b); }
+#else
+typedef AesCtx CryptoAes;                // only roundKey is used; CBC chaining is ours
+static inline void _cryptoAesInit(CryptoAes* c, const uint8_t* key) { aesInitCtx(c, key, key); }
+static inline void _cryptoAesEnc(CryptoAes* c, uint8_t* b)          { _aesEncryptBlock(c, b); }
+static inline void _cryptoAesDec(CryptoAes* c, uint8_t* b)          { _aesDecryptBlock(c, b); }
+#endif
+
+// ─── Expanded key schedules (cached at init) ───
+static CryptoAes _crypto_aes;      // legacy _crypto_key (0xAE records)
+static CryptoAes _crypto_aesEnc;   // HKDF encryption subkey (v2 records)
+
+// ─── CBC decrypt in place with an explicit IV ───
+static inline void _cryptoCbcDecrypt(CryptoAes* c, const uint8_t* iv, uint8_t* buf, size_t len) {
+  uint8_t chain[AES_BLOCKLEN], next[AES_BLOCKLEN];
+  memcpy(chain, iv, AES_BLOCKLEN);
+  for (size_t off = 0; off < len; off += AES_BLOCKLEN) {
+    memcpy(next, buf + off, AES_BLOCKLEN);
+    _cryptoAesDec(c, buf + off);
+    for (uint8_t i = 0; i < AES_BLOCKLEN; i++) buf[off + i] ^= chain[i];
+    memcpy(chain, next, AES_BLOCKLEN);
+  }
+  memset(next, 0, sizeof(next));
+}
+
+// ============================================================
+// Self-test + benchmark (both engines, independent of config)
+// ============================================================
+
+// ─── FIPS-197 Appendix C.3 (AES-256) ───
+static const uint8_t _crypto_katKey[32] = {
+  0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f,
+  0x10,0x11,0x12,0x13,0x14,0x15,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x1e,0x1f
+};
+static const uint8_t _crypto_katPlain[16] = {
+  0x00,0x11,0x22,0x33,0x44,0x55,0x66,0x77,0x88,0x99,0xaa,0xbb,0xcc,0xdd,0xee,0xff
+};
+static const uint8_t _crypto_katCipher[16] = {
+  0x8e,0xa2,0xb7,0xca,0x51,0x67,0x45,0xbf,0xea,0xfc,0x49,0x90,0x4b,0x49,0x60,0x89
+};
+
+// ─── SHA-256 / HMAC / HKDF vectors ───
+// FIPS 180-4 "abc", RFC 4231 test case 2, RFC 5869 test case 3 (first 32 bytes)
+static const uint8_t _crypto_katShaAbc[32] = {
+  0xba,0x78,0x16,0xbf,0x8f,0x01,0xcf,0xea,0x41,0x41,0x40,0xde,0x5d,0xae,0x22,0x23,
+  0xb0,0x03,0x61,0xa3,0x96,0x17,0x7a,0x9c,0xb4,0x10,0xff,0x61,0xf2,0x00,0x15,0xad
+};
+static const uint8_t _crypto_katHmac[32] = {
+  0x5b,0xdc,0xc1,0x46,0xbf,0x60,0x75,0x4e,0x6a,0x04,0x24,0x26,0x08,0x95,0x75,0xc7,
+  0x5a,0x00,0x3f,0x08,0x9d,0x27,0x39,0x83,0x9d,0xec,0x58,0xb9,0x64,0xec,0x38,0x43
+};
+static const uint8_t _crypto_katHkdf[32] = {
+  0x8d,0xa4,0xe7,0x75,0xa5,0x63,0xc1,0x8f,0x71,0x5f,0x80,0x2a,0x06,0x3c,0x5a,0x31,
+  0xb8,0xa1,0x1f,0x5c,0x5e,0xe1,0x87,0x9e,0xc3,0x45,0x4e,0x5f,0x3c,0x73,0x8d,0x2d
+};
+
+static inline bool _cryptoSelfTestSha() {
+  uint8_t out[32];
+  bool ok = true;
+
+  sha256((const uint8_t*)"abc", 3, out);
+  ok &= (memcmp(out, _crypto_katShaAbc, 32) == 0);
+
+  // Same input fed one byte at a time through the streaming API
+  Sha256Ctx ctx;
+  sha256Init(&ctx);
+  sha256Update(&ctx, (const uint8_t*)"a", 1);
+  sha256Update(&ctx, (const uint8_t*)"b", 1);
+  sha256Update(&ctx, (const uint8_t*)"c", 1);
+  sha256Final(&ctx, out);
+  ok &= (memcmp(out, _crypto_katShaAbc, 32) == 0);
+
+  static const char msg[] = "what do ya want for nothing?";
+  hmacSha256((const uint8_t*)"Jefe", 4, (const uint8_t*)msg, sizeof(msg) - 1, out);
+  ok &= (memcmp(out, _crypto_katHmac, 32) == 0);
+
+  uint8_t ikm[22];
+  memset(ikm, 0x0b, sizeof(ikm));
+  hkdfSha256(nullptr, 0, ikm, sizeof(ikm), nullptr, 0, out, 32);
+  ok &= (memcmp(out, _crypto_katHkdf, 32) == 0);
+
+  memset(out, 0, sizeof(out));
+  return ok;
+}
+
+// ─── Known-answer test: both engines must match FIPS-197 and each other ───
+inline bool cryptoSelfTest() {
+  uint8_t a[16], b[16];
+  bool ok = _cryptoSelfTestSha();
+
+  AesCtx bctx;
+  aesInitCtx(&bctx, _crypto_katKey, _crypto_katPlain);
+  memcpy(a, _crypto_katPlain, 16);
+  _aesEncryptBlock(&bctx, a);
+  ok &= (memcmp(a, _crypto_katCipher, 16) == 0);
+  _aesDecryptBlock(&bctx, a);
+  ok &= (memcmp(a, _crypto_katPlain, 16) == 0);
+
+  AesTCtx tctx;
+  aesTInit(&tctx, _crypto_katKey);
+  memcpy(b, _crypto_katPlain, 16);
+  aesTEncryptBlock(&tctx, b);
+  ok &= (memcmp(b, _crypto_katCipher, 16) == 0);
+  aesTDecryptBlock(&tctx, b);
+  ok &= (memcmp(b, _crypto_katPlain, 16) == 0);
+
+  // CBC cross-check over two blocks (the password buffer size)
+  uint8_t x[32], y[32];
+  for (uint8_t i = 0; i < 32; i++) x[i] = y[i] = (uint8_t)(i * 37 + 11);
+  aesInitCtx(&bctx, _crypto_katKey, _crypto_katPlain);
+  aesCbcEncrypt(&bctx, x, 32);
+  aesTCbcEncrypt(&tctx, _crypto_katPlain, y, 32);
+  ok &= (memcmp(x, y, 32) == 0);
+
+  memset(&bctx, 0, sizeof(bctx));
+  memset(&tctx, 0, sizeof(tctx));
+  return ok;
+}
+
+// ─── Cycles per block for each engine (encrypt + decrypt) ───
+// Cycle counts are derived from micros() at F_CPU.
+inline void cryptoBenchmark(uint16_t blocks) {
+  uint8_t buf[16];
+  memcpy(buf, _crypto_katPlain, 16);
+
+  AesCtx bctx;
+  aesInitCtx(&bctx, _crypto_katKey, _crypto_katPlain);
+  unsigned long t0 = micros();
+  for (uint16_t i = 0; i < blocks; i++) _aesEncryptBlock(&bctx, buf);
+  unsigned long t1 = micros();
+  for (uint16_t i = 0; i < blocks; i++) _aesDecryptBlock(&bctx, buf);
+  unsigned long t2 = micros();
+
+  AesTCtx tctx;
+  aesTInit(&tctx, _crypto_katKey);
+  unsigned long t3 = micros();
+  for (uint16_t i = 0; i < blocks; i++) aesTEncryptBlock(&tctx, buf);
+  unsigned long t4 = micros();
+  for (uint16_t i = 0; i < blocks; i++) aesTDecryptBlock(&tctx, buf);
+  unsigned long t5 = micros();
+
+  const unsigned long cpu = F_CPU / 1000000UL;
+  Serial.print("[CRYPTO] byte   enc ");
+  Serial.print((t1 - t0) * cpu / blocks);
+  Serial.print(" / dec ");
+  Serial.print((t2 - t1) * cpu / blocks);
+  Serial.println(" cycles/block");
+  Serial.print("[CRYPTO] ttable enc ");
+  Serial.print((t4 - t3) * cpu / blocks);
+  Serial.print(" / dec ");
+  Serial.print((t5 - t4) * cpu / blocks);
+  Serial.println(" cycles/block");
+
+  memset(&bctx, 0, sizeof(bctx));
+  memset(&tctx, 0, sizeof(tctx));
+
+  // SHA-256 throughput over a 1 KB buffer
+  uint8_t data[1024];
+  for (uint16_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)i;
+  uint8_t digest[32];
+  uint16_t passes = blocks / 16 + 1;
+  unsigned long t6 = micros();
+  for (uint16_t i = 0; i < passes; i++) sha256(data, sizeof(data), digest);
+  unsigned long t7 = micros();
+
+  Serial.print("[CRYPTO] sha256 ");
+  Serial.print((t7 - t6) * cpu * 100 / ((unsigned long)passes * sizeof(data)));
+  Serial.println(" cycles/100 bytes");
+}
+
 // ─── Init: derive device-specific key + IV from unique board ID ───
 inline void cryptoInit() {
   // 1. Read unique board ID (8 bytes from OTP)
@@ -114,7 +246,7 @@ inline void cryptoInit() {
   pico_get_unique_board_id(&board_id);
 
   // 2. Derive AES key: SHA-256(unique_id)
-  _sha256(board_id.id, PICO_UNIQUE_BOARD_ID_SIZE_BYTES, _crypto_key);
+  sha256(board_id.id, PICO_UNIQUE_BOARD_ID_SIZE_BYTES, _crypto_key);
 
   // 3. Derive IV: SHA-256(unique_id + salt) → take first 16 bytes
   //    Salt ensures IV differs from key even though same source
@@ -126,57 +258,158 @@ inline void cryptoInit() {
   salted[PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 3] = 0xEF;
 
   uint8_t ivHash[32];
-  _sha256(salted, sizeof(salted), ivHash);
+  sha256(salted, sizeof(salted), ivHash);
   memcpy(_crypto_iv, ivHash, 16);
 
+  // 4. HKDF subkeys: one PRK from the board ID, expanded per purpose
+  uint8_t prk[SHA256_DIGEST_SIZE];
+  hkdfSha256Extract((const uint8_t*)_crypto_hkdfSalt, sizeof(_crypto_hkdfSalt) - 1,
+                    board_id.id, PICO_UNIQUE_BOARD_ID_SIZE_BYTES, prk);
+  hkdfSha256Expand(prk, (const uint8_t*)_crypto_hkdfInfoEnc, sizeof(_crypto_hkdfInfoEnc) - 1,
+                   _crypto_encKey, sizeof(_crypto_encKey));
+  hkdfSha256Expand(prk, (const uint8_t*)_crypto_hkdfInfoMac, sizeof(_crypto_hkdfInfoMac) - 1,
+                   _crypto_macKey, sizeof(_crypto_macKey));
+  memset(prk, 0, sizeof(prk));
+
   // Clear intermediates
   memset(&board_id, 0, sizeof(board_id));
   memset(salted, 0, sizeof(salted));
   memset(ivHash, 0, sizeof(ivHash));
 
+  // 5. Known-answer test before trusting any primitive with real data
+  if (!cryptoSelfTest()) {
+    LOG("[ERROR] Crypto self-test FAILED — encryption disabled");
+    return;
+  }
+
+  // 6. Expand both key schedules once — reused by every seal/open
+  _cryptoAesInit(&_crypto_aes, _crypto_key);
+  _cryptoAesInit(&_crypto_aesEnc, _crypto_encKey);
+
   _crypto_ready = true;
 
-  Serial.println("[BOOT] Crypto OK (AES-256-CBC, device-bound key)");
+  LOG("[BOOT] Crypto OK (AES-256-CBC + HMAC-SHA256, device-bound keys)");
 }
 
-// ─── Encrypt 32-byte password buffer ───
-// plaintext: input (32 bytes, null-padded)
-// ciphertext: output (32 bytes)
-// Both can be the same buffer (in-place).
-inline bool cryptoEncryptPassword(const uint8_t* plaintext, uint8_t* ciphertext) {
-  if (!_crypto_ready) return false;
+// ─── Zero a buffer that held a secret ───
+// Volatile stores: a memset right before the buffer dies is a dead
+// store the compiler may drop.
+inline void cryptoWipe(void* buf, size_t len) {
+  volatile uint8_t* p = (volatile uint8_t*)buf;
+  while (len--) *p++ = 0;
+}
 
-  // Copy plaintext to output (CBC encrypts in-place)
-  if (plaintext != ciphertext) {
-    memcpy(ciphertext, plaintext, 32);
+// ─── Fill buf with hardware random bytes (per-record IVs) ───
+inline void cryptoRandom(uint8_t* buf, size_t len) {
+  while (len) {
+    uint32_t r = get_rand_32();
+    size_t n = len < 4 ? len : 4;
+    memcpy(buf, &r, n);
+    buf += n;
+    len -= n;
   }
+}
+
+// ─── Encrypt-then-MAC in one pass ───
+// CBC-encrypts len bytes (multiple of 16) under the encryption
+// subkey and feeds each ciphertext block into HMAC-SHA256 (MAC
+// subkey) as soon as it is produced. The tag covers
+// aad || iv || ciphertext and is truncated to tagLen bytes.
+// plain and cipher can be the same buffer (in-place).
+inline bool cryptoSeal(const uint8_t* aad, size_t aadLen, const uint8_t* iv,
+                       const uint8_t* plain, uint8_t* cipher, size_t len,
+                       uint8_t* tag, size_t tagLen) {
+  if (!_crypto_ready || (len % AES_BLOCKLEN) != 0 || tagLen > SHA256_DIGEST_SIZE) return false;
 
-  // Fresh context each time (IV must be reset for deterministic encryption)
-  AesCtx ctx;
-  aesInitCtx(&ctx, _crypto_key, _crypto_iv);
-  aesCbcEncrypt(&ctx, ciphertext, 32);
+  HmacSha256Ctx mac;
+  hmacSha256Init(&mac, _crypto_macKey, sizeof(_crypto_macKey));
+  hmacSha256Update(&mac, aad, aadLen);
+  hmacSha256Update(&mac, iv, AES_BLOCKLEN);
 
-  // Clear context from stack
-  memset(&ctx, 0, sizeof(ctx));
+  const uint8_t* chain = iv;
+  for (size_t off = 0; off < len; off += AES_BLOCKLEN) {
+    for (uint8_t i = 0; i < AES_BLOCKLEN; i++) cipher[off + i] = plain[off + i] ^ chain[i];
+    _cryptoAesEnc(&_crypto_aesEnc, cipher + off);
+    hmacSha256Update(&mac, cipher + off, AES_BLOCKLEN);
+    chain = cipher + off;
+  }
+
+  uint8_t full[SHA256_DIGEST_SIZE];
+  hmacSha256Final(&mac, full);
+  memcpy(tag, full, tagLen);
+  memset(full, 0, sizeof(full));
+  memset(&mac, 0, sizeof(mac));
+  return true;
+}
+
+// ─── Constant-time compare of the first n tag bytes ───
+static inline bool _cryptoTagEqual(const uint8_t* a, const uint8_t* b, size_t n) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < n; i++) diff |= (uint8_t)(a[i] ^ b[i]);
+  return diff == 0;
+}
+
+// ─── Check a tag without decrypting (constant-time compare) ───
+inline bool cryptoVerifyTag(const uint8_t* aad, size_t aadLen, const uint8_t* iv,
+                            const uint8_t* cipher, size_t len,
+                            const uint8_t* tag, size_t tagLen) {
+  if (!_crypto_ready || tagLen > SHA256_DIGEST_SIZE) return false;
+
+  HmacSha256Ctx mac;
+  hmacSha256Init(&mac, _crypto_macKey, sizeof(_crypto_macKey));
+  hmacSha256Update(&mac, aad, aadLen);
+  hmacSha256Update(&mac, iv, AES_BLOCKLEN);
+  hmacSha256Update(&mac, cipher, len);
+
+  uint8_t full[SHA256_DIGEST_SIZE];
+  hmacSha256Final(&mac, full);
+  bool ok = _cryptoTagEqual(full, tag, tagLen);
+  memset(full, 0, sizeof(full));
+  memset(&mac, 0, sizeof(mac));
+  return ok;
+}
+
+// ─── Tag over a plaintext structure (integrity only, MAC subkey) ───
+inline bool cryptoMac(const uint8_t* data, size_t len, uint8_t* tag, size_t tagLen) {
+  if (!_crypto_ready || tagLen > SHA256_DIGEST_SIZE) return false;
+  uint8_t full[SHA256_DIGEST_SIZE];
+  hmacSha256(_crypto_macKey, sizeof(_crypto_macKey), data, len, full);
+  memcpy(tag, full, tagLen);
+  memset(full, 0, sizeof(full));
   return true;
 }
 
-// ─── Decrypt 32-byte password buffer ───
-// ciphertext: input (32 bytes)
-// plaintext: output (32 bytes)
+inline bool cryptoMacVerify(const uint8_t* data, size_t len, const uint8_t* tag, size_t tagLen) {
+  if (!_crypto_ready || tagLen > SHA256_DIGEST_SIZE) return false;
+  uint8_t full[SHA256_DIGEST_SIZE];
+  hmacSha256(_crypto_macKey, sizeof(_crypto_macKey), data, len, full);
+  bool ok = _cryptoTagEqual(full, tag, tagLen);
+  memset(full, 0, sizeof(full));
+  return ok;
+}
+
+// ─── Verify, then decrypt (nothing is decrypted on a bad tag) ───
+// cipher and plain can be the same buffer (in-place).
+inline bool cryptoOpen(const uint8_t* aad, size_t aadLen, const uint8_t* iv,
+                       const uint8_t* cipher, uint8_t* plain, size_t len,
+                       const uint8_t* tag, size_t tagLen) {
+  if ((len % AES_BLOCKLEN) != 0) return false;
+  if (!cryptoVerifyTag(aad, aadLen, iv, cipher, len, tag, tagLen)) return false;
+  if (cipher != plain) memcpy(plain, cipher, len);
+  _cryptoCbcDecrypt(&_crypto_aesEnc, iv, plain, len);
+  return true;
+}
+
+// ─── Decrypt a legacy 0xAE password buffer (migration only) ───
+// Fixed device IV, legacy key, no authentication.
 // Both can be the same buffer (in-place).
-inline bool cryptoDecryptPassword(const uint8_t* ciphertext, uint8_t* plaintext) {
+inline bool cryptoDecryptLegacy(const uint8_t* ciphertext, uint8_t* plaintext) {
   if (!_crypto_ready) return false;
 
   if (ciphertext != plaintext) {
     memcpy(plaintext, ciphertext, 32);
   }
-
-  AesCtx ctx;
-  aesInitCtx(&ctx, _crypto_key, _crypto_iv);
-  aesCbcDecrypt(&ctx, plaintext, 32);
-
-  memset(&ctx, 0, sizeof(ctx));
+  _cryptoCbcDecrypt(&_crypto_aes, _crypto_iv, plaintext, 32);
   return true;
 }
 
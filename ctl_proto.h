@@ -0,0 +1,348 @@
+// ============================================================
+// ctl_proto.h — Framed binary control protocol on the USB console
+//
+// Shares the CDC port with the text console. On the wire a frame is
+//
+//   0x00  COBS( type | seq | body… | crc16 )  0x00
+//
+// COBS removes every zero from the payload, and console text never
+// contains one, so the first 0x00 switches the receiver into frame
+// mode and the next ends the frame. Two zeros in a row are taken as
+// a fresh start, which resynchronises after a lost delimiter; a
+// frame that stalls for CTL_FRAME_TIMEOUT_MS is dropped. crc16 is
+// CRC-16/CCITT-FALSE over type..body, big-endian, so the CRC over
+// the whole payload comes out 0.
+//
+// Requests (host → device) are answered with type | CTL_RSP and the
+// same seq, or with CTL_RSP_NAK. Events (device → host, seq 0) are
+// only sent after the host's CTL_REQ_HELLO, so a plain serial
+// monitor never sees binary.
+//
+// The receiver decodes COBS and runs the CRC as bytes arrive, into
+// one fixed buffer — no allocation, no second pass.
+//
+// Usage:
+//   ctlFeed(c)                — CTL_RX_TEXT / CTL_RX_BUSY / CTL_RX_FRAME
+//   ctlFrame()                — the frame ctlFeed just completed
+//   ctlOnRequest(fn)          — handler for requests (the sketch's)
+//   ctlDispatch()             — PING answered here, the rest → handler
+//   ctlReply(f, body, len) / ctlNak(f, err)
+//   ctlEventMode / ctlEventReg / ctlEventAuth
+//   ctlEncode(...) / ctlDecode(...) — wire frames for host tools, tests
+// ============================================================
+#ifndef CTL_PROTO_H
+#define CTL_PROTO_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define CTL_PROTO_VERSION  1
+#define CTL_MAX_PAYLOAD    (CTL_MAX_BODY + 4)                        // type + seq + body + crc
+#define CTL_MAX_WIRE       (CTL_MAX_PAYLOAD + CTL_MAX_PAYLOAD / 254 + 3)  // + COBS codes + 2 delimiters
+
+// ─── Message types ───
+enum CtlType : uint8_t {
+  CTL_REQ_HELLO       = 0x01,  // → status body; enables events
+  CTL_REQ_PING        = 0x02,  // → same body back
+  CTL_REQ_STATUS      = 0x03,  // → status body
+  CTL_REQ_STATS       = 0x04,  // → per phase: n, p50, p95, p99, max (u32 each)
+  CTL_REQ_STATS_RESET = 0x05,  // → empty
+  CTL_REQ_CONFIG      = 0x06,  // → config body
+  CTL_REQ_REG_INPUT   = 0x07,  // answer the current registration prompt (body = line)
+  CTL_REQ_RESET       = 0x08,  // → empty, then reboot
+  CTL_REQ_LOG_MODE    = 0x09,  // [0] 1 = CTL_EVT_LOG frames, 0 = text → empty
+  CTL_REQ_LOG_FMT     = 0x0A,  // [0] format ID → ID, format string
+  CTL_REQ_PROVISION   = 0x0B,  // [0] credential, [1..] password → empty; registration starts
+  CTL_REQ_IMAGE       = 0x0C,  // [0] 1 = stream captures, [1] shift (opt.) → on, shift, w, h
+
+  CTL_EVT_MODE        = 0x40,  // mode, bootState
+  CTL_EVT_REG         = 0x41,  // CtlRegStep, a, b
+  CTL_EVT_AUTH        = 0x42,  // CtlAuthResult, sensor ID, credential
+  CTL_EVT_LOG         = 0x43,  // deferred log record (log_ring.h)
+  CTL_EVT_IMAGE       = 0x44,  // frame, w, h, shift — rows follow (img_stream.h)
+  CTL_EVT_IMAGE_ROW   = 0x45,  // frame, row, coded row
+
+  CTL_RSP             = 0x80,  // OR-ed into the request type
+  CTL_RSP_NAK         = 0xFF   // request type, CtlError
+};
+
+enum CtlError : uint8_t {
+  CTL_ERR_UNKNOWN  = 1,   // no such request
+  CTL_ERR_BAD_ARG  = 2,   // body length or content
+  CTL_ERR_STATE    = 3,   // not now (e.g. REG_INPUT without a prompt)
+  CTL_ERR_DISABLED = 4    // compiled out (config.h)
+};
+
+// ─── Status body (HELLO / STATUS) ───
+//   [0] CTL_PROTO_VERSION  [1] mode  [2] bootState  [3] sensorOK
+//   [4] enrolled templates [5] credentials in use  [6..9] uptime ms
+//   [10..] FW_VERSION (no terminator)
+//   [4] is CTL_STATUS_UNKNOWN while a flow holds the sensor and the count is stale
+#define CTL_STATUS_UNKNOWN 0xFF
+
+// ─── Config body ───
+//   [0..3] COOLDOWN_MS  [4..7] PASSWORD_TIMEOUT_MS  [8..11] LOCK_DELAY_MS
+//   [12..15] WAKE_SETTLE_MS  [16] PASSWORD_MAX_LEN  [17] CRED_MAX_CREDENTIALS
+//   [18] COLLECT_COUNT  [19] SENSOR_CAPACITY
+
+// ─── Registration steps (CTL_EVT_REG) ───
+enum CtlRegStep : uint8_t {
+  CTL_REG_CHOOSE = 1,    // a = credentials available
+  CTL_REG_PLACE,         // a = capture, b = of
+  CTL_REG_REMOVE,
+  CTL_REG_CAPTURE_FAIL,  // a = attempt, b = of
+  CTL_REG_PASSWORD,
+  CTL_REG_CONFIRM,
+  CTL_REG_EMPTY,
+  CTL_REG_MISMATCH,      // a = attempt, b = of
+  CTL_REG_TIMEOUT,
+  CTL_REG_DONE,          // a = credential, b = sensor ID
+  CTL_REG_FAILED
+};
+
+// ─── Recognition results (CTL_EVT_AUTH) ───
+enum CtlAuthResult : uint8_t {
+  CTL_AUTH_MATCH = 1,
+  CTL_AUTH_UNLOCKED,
+  CTL_AUTH_NO_MATCH,
+  CTL_AUTH_CAPTURE_FAIL,
+  CTL_AUTH_COOLDOWN,
+  CTL_AUTH_NO_REGISTRATION,
+  CTL_AUTH_ORPHAN,
+  CTL_AUTH_RECORD_FAIL
+};
+
+// ─── Receiver results ───
+enum CtlRx : uint8_t {
+  CTL_RX_TEXT,    // not ours — a console byte
+  CTL_RX_BUSY,    // consumed by the framer
+  CTL_RX_FRAME    // a valid frame is waiting in ctlFrame()
+};
+
+struct CtlFrame {
+  uint8_t type;
+  uint8_t seq;
+  uint8_t len;
+  const uint8_t* body;
+};
+
+// ─── State ───
+static uint8_t _ctl_rx[CTL_MAX_PAYLOAD];
+static uint16_t _ctl_rxLen = 0;
+static uint8_t _ctl_code = 0;        // current COBS code, 0 = none yet
+static uint8_t _ctl_left = 0;        // data bytes left in this code block
+static uint16_t _ctl_crc = 0xFFFF;   // running CRC of the decoded payload
+static bool _ctl_inFrame = false;
+static bool _ctl_overflow = false;
+static uint32_t _ctl_lastMs = 0;
+static bool _ctl_session = false;    // host said HELLO — events on
+static CtlFrame _ctl_frame = {0, 0, 0, _ctl_rx};
+static void (*_ctl_handler)(const CtlFrame &f) = nullptr;
+static uint8_t _ctl_tx[CTL_MAX_WIRE];
+
+// ─── Counters (host tests) ───
+static uint32_t _ctl_frames = 0;
+static uint32_t _ctl_dropped = 0;    // CRC, COBS, size or timeout
+
+// ─── CRC-16/CCITT-FALSE, one nibble per table step ───
+static inline uint16_t ctlCrc16(const uint8_t* p, size_t n, uint16_t crc = 0xFFFF) {
+  static const uint16_t nib[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+  };
+  while (n--) {
+    crc ^= (uint16_t)(*p++) << 8;
+    crc = (uint16_t)((crc << 4) ^ nib[crc >> 12]);
+    crc = (uint16_t)((crc << 4) ^ nib[crc >> 12]);
+  }
+  return crc;
+}
+
+static inline void ctlPut32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t ctlGet32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ─── Build a complete wire frame into out[CTL_MAX_WIRE] ───
+// Returns the wire length, 0 if the body is too long.
+static inline size_t ctlEncode(uint8_t type, uint8_t seq, const uint8_t* body, size_t len, uint8_t* out) {
+  if (len > CTL_MAX_BODY) return 0;
+  uint8_t head[2] = { type, seq };
+  uint16_t crc = ctlCrc16(body, len, ctlCrc16(head, 2));
+  uint8_t tail[2] = { (uint8_t)(crc >> 8), (uint8_t)crc };
+
+  size_t o = 0;
+  out[o++] = 0;
+  size_t codeAt = o++;
+  uint8_t code = 1;
+  const uint8_t* parts[3] = { head, body, tail };
+  const size_t sizes[3] = { 2, len, 2 };
+  for (uint8_t s = 0; s < 3; s++) {
+    for (size_t i = 0; i < sizes[s]; i++) {
+      uint8_t b = parts[s][i];
+      if (b != 0) {
+        out[o++] = b;
+        code++;
+      }
+      if (b == 0 || code == 0xFF) {
+        out[codeAt] = code;
+        codeAt = o++;
+        code = 1;
+      }
+    }
+  }
+  out[codeAt] = code;
+  out[o++] = 0;
+  return o;
+}
+
+// ─── Check and unpack one frame (delimiters stripped) ───
+// in[] holds the COBS bytes between two zeros; out[] receives
+// type | seq | body. Returns type + seq + body length, 0 if the
+// COBS or CRC is bad.
+static inline size_t ctlDecode(const uint8_t* in, size_t n, uint8_t* out, size_t cap) {
+  size_t o = 0, i = 0;
+  while (i < n) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > n) return 0;
+    for (uint8_t k = 1; k < code; k++) {
+      if (o >= cap) return 0;
+      out[o++] = in[i++];
+    }
+    if (code != 0xFF && i < n) {
+      if (o >= cap) return 0;
+      out[o++] = 0;
+    }
+  }
+  if (o < 4 || ctlCrc16(out, o) != 0) return 0;
+  return o - 2;
+}
+
+// ─── Receiver ───
+static inline void _ctlRxStart() {
+  _ctl_inFrame = true;
+  _ctl_overflow = false;
+  _ctl_rxLen = 0;
+  _ctl_code = 0;
+  _ctl_left = 0;
+  _ctl_crc = 0xFFFF;
+}
+
+static inline void _ctlRxPut(uint8_t b) {
+  if (_ctl_rxLen < CTL_MAX_PAYLOAD) {
+    _ctl_rx[_ctl_rxLen++] = b;
+    _ctl_crc = ctlCrc16(&b, 1, _ctl_crc);
+  } else {
+    _ctl_overflow = true;
+  }
+}
+
+// Closing delimiter: check COBS + CRC residue, publish the frame.
+static inline bool _ctlRxEnd() {
+  bool ok = !_ctl_overflow && _ctl_left == 0 && _ctl_rxLen >= 4 && _ctl_crc == 0;
+  if (!ok) {
+    _ctl_dropped++;
+    return false;
+  }
+  _ctl_frame.type = _ctl_rx[0];
+  _ctl_frame.seq = _ctl_rx[1];
+  _ctl_frame.len = (uint8_t)(_ctl_rxLen - 4);
+  _ctl_frame.body = _ctl_rx + 2;
+  _ctl_frames++;
+  return true;
+}
+
+inline CtlRx ctlFeed(uint8_t c) {
+  if (_ctl_inFrame) {
+    uint32_t now = millis();
+    if ((now - _ctl_lastMs) > CTL_FRAME_TIMEOUT_MS) {
+      // Stalled mid-frame (delimiter lost) — give the byte back to text
+      _ctl_inFrame = false;
+      if (_ctl_code) _ctl_dropped++;
+    }
+    _ctl_lastMs = now;
+  }
+
+  if (!_ctl_inFrame) {
+    if (c != 0) return CTL_RX_TEXT;   // console text: no clock read
+    _ctlRxStart();
+    _ctl_lastMs = millis();
+    return CTL_RX_BUSY;
+  }
+
+  if (c == 0) {
+    if (_ctl_code == 0) {  // "00 00" — treat the second as a fresh start
+      _ctlRxStart();
+      return CTL_RX_BUSY;
+    }
+    _ctl_inFrame = false;
+    return _ctlRxEnd() ? CTL_RX_FRAME : CTL_RX_BUSY;
+  }
+
+  if (_ctl_left == 0) {  // code byte: implied zero after a short block
+    if (_ctl_code != 0 && _ctl_code != 0xFF) _ctlRxPut(0);
+    _ctl_code = c;
+    _ctl_left = (uint8_t)(c - 1);
+  } else {
+    _ctlRxPut(c);
+    _ctl_left--;
+  }
+  return CTL_RX_BUSY;
+}
+
+inline const CtlFrame& ctlFrame() { return _ctl_frame; }
+inline bool ctlSessionActive()    { return _ctl_session; }
+
+// ─── Transmit ───
+static inline void _ctlSend(uint8_t type, uint8_t seq, const uint8_t* body, size_t len) {
+  size_t n = ctlEncode(type, seq, body, len, _ctl_tx);
+  if (n) Serial.write(_ctl_tx, n);
+}
+
+inline void ctlReply(const CtlFrame &f, const uint8_t* body, size_t len) {
+  _ctlSend((uint8_t)(f.type | CTL_RSP), f.seq, body, len);
+}
+
+inline void ctlNak(const CtlFrame &f, CtlError err) {
+  uint8_t body[2] = { f.type, (uint8_t)err };
+  _ctlSend(CTL_RSP_NAK, f.seq, body, 2);
+}
+
+inline void ctlEvent(uint8_t type, const uint8_t* body, size_t len) {
+  if (_ctl_session) _ctlSend(type, 0, body, len);
+}
+
+inline void ctlEventMode(uint8_t mode, uint8_t bootState) {
+  uint8_t body[2] = { mode, bootState };
+  ctlEvent(CTL_EVT_MODE, body, 2);
+}
+
+inline void ctlEventReg(CtlRegStep step, uint8_t a = 0, uint8_t b = 0) {
+  uint8_t body[3] = { (uint8_t)step, a, b };
+  ctlEvent(CTL_EVT_REG, body, 3);
+}
+
+inline void ctlEventAuth(CtlAuthResult result, uint8_t id = 0, uint8_t cred = 0) {
+  uint8_t body[3] = { (uint8_t)result, id, cred };
+  ctlEvent(CTL_EVT_AUTH, body, 3);
+}
+
+// ─── Dispatch ───
+inline void ctlOnRequest(void (*fn)(const CtlFrame &f)) { _ctl_handler = fn; }
+
+inline void ctlDispatch() {
+  const CtlFrame &f = _ctl_frame;
+  if (f.type & CTL_RSP) return;  // not a request — ignore
+  if (f.type == CTL_REQ_HELLO) _ctl_session = true;
+  if (f.type == CTL_REQ_PING) {
+    ctlReply(f, f.body, f.len);
+    return;
+  }
+  if (_ctl_handler) _ctl_handler(f);
+  else ctlNak(f, CTL_ERR_UNKNOWN);
+}
+
+#endif // CTL_PROTO_H
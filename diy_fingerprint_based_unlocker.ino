@@ -2,15 +2,24 @@
 #include <hardware/watchdog.h>
 
 #include "config.h"
+#include "tasks.h"
+#include "idle.h"
 #include "switch_control.h"
+#include "sensor_service.h"
+#include "sensor_link.h"
 #include "led_feedback.h"
 #include "eeprom_storage.h"
+#include "cred_index.h"
 #include "crypto.h"
 #include "irq_finger.h"
 #include "registration.h"
 #include "hid_unlock.h"
 #include "recognition.h"
 #include "validation.h"
+#include "latency_stats.h"
+#include "ctl_proto.h"
+#include "log_ring.h"
+#include "img_stream.h"
 
 // ─── Globals ───
 DFRobot_ID809 fingerprint;
@@ -18,14 +27,25 @@ bool sensorOK = false;
 DeviceMode currentMode = MODE_RECOGNIZE;
 BootState bootState = BOOT_VIRGIN;
 
-// ─── Serial command buffer ───
-static String _serialCmdBuf = "";
+// ─── Boot ───
+static uint32_t _sensorWakeAt = 0;   // millis() the sensor answers from
+static uint32_t _modeLedAt = 0;      // idle LED after the boot flash, 0 = done
+static bool _regRunning = false;     // a registration flow is on (PROVISION waits for the next)
+
+// ─── Serial command buffer (text console) ───
+static char _serialCmdBuf[SERIAL_CMD_MAX + 1];
+static uint8_t _serialCmdLen = 0;
 
 // ─── Forward declarations ───
 void bootSequence();
+void startSensorUart();
 bool initSensor();
+void showModeLed();
 void handleSerialCommands();
+void handleControlFrame(const CtlFrame &f);
+void rebootDevice();
 void handleModeSwitch();
+uint32_t loopDeadline();
 void handleRegisterMode();
 void handleRecognizeMode();
 
@@ -40,13 +60,27 @@ void setup() {
 // LOOP
 // ============================================================
 void loop() {
+  // Sleep until a touch, switch edge, console data or loopDeadline();
+  // a wakeup with none of them goes straight back to sleep
+  if (!idleWait(loopDeadline())) return;
+  taskPassStart();
+
   // 1. Check for serial commands (e.g. !RESET from Web Serial UI)
   handleSerialCommands();
 
   // 2. Check for mode switch change
   handleModeSwitch();
 
-  // 3. Mode-specific behavior
+  // 3. Idle LED once the boot flash has played (a touch or flip takes over earlier)
+  if (_modeLedAt && (int32_t)(millis() - _modeLedAt) >= 0) {
+    _modeLedAt = 0;
+    showModeLed();
+  }
+
+  // 4. A runtime fallback on core1 changed the sensor rate — journal it
+  sensorLinkSave();
+
+  // 5. Mode-specific behavior
   if (sensorOK) {
     if (currentMode == MODE_REGISTER) {
       handleRegisterMode();
@@ -54,49 +88,249 @@ void loop() {
       handleRecognizeMode();
     }
   }
+}
 
-  delay(100);  // IRQ-driven — no need for fast polling
+// ─── Next time loop() has work without an interrupt, 0 = none ───
+uint32_t loopDeadline() {
+  uint32_t at = _modeLedAt;
+  uint32_t settle;
+  if (irqFingerSettling(&settle) && (!at || (int32_t)(settle - at) < 0)) at = settle;
+  return at;
+}
+
+// ============================================================
+// CORE1 — sensor service (owns Serial1 + fingerprint)
+// ============================================================
+void setup1() {
+}
+
+void loop1() {
+  sensorServiceRun();
 }
 
 // ============================================================
 // SERIAL COMMAND HANDLER
 // ============================================================
 void handleSerialCommands() {
+  // A flow reading the password owns the console — leave its bytes alone
+  if (taskConsoleOwned()) return;
+
   while (Serial.available()) {
     char c = Serial.read();
+
+    // Control frames are multiplexed on the same port (ctl_proto.h)
+    CtlRx rx = ctlFeed((uint8_t)c);
+    if (rx == CTL_RX_FRAME) ctlDispatch();
+    if (rx != CTL_RX_TEXT) continue;
+
     if (c == '\n' || c == '\r') {
-      _serialCmdBuf.trim();
-      if (_serialCmdBuf == "!RESET") {
-        Serial.println("[CMD] Rebooting...");
-        Serial.flush();
-        delay(100);  // let the response reach the host
-        watchdog_reboot(0, 0, 0);  // immediate hardware reset
-        while (true) { tight_loop_contents(); }  // wait for watchdog
+      // Trim surrounding blanks in place
+      char* cmd = _serialCmdBuf;
+      char* end = _serialCmdBuf + _serialCmdLen;
+      while (cmd < end && (*cmd == ' ' || *cmd == '\t')) cmd++;
+      while (end > cmd && (end[-1] == ' ' || end[-1] == '\t')) end--;
+      *end = '\0';
+
+      // Reports below print directly — queued log records go first
+      if (*cmd == '!') logFlush();
+
+      if (strcmp(cmd, "!RESET") == 0) {
+        rebootDevice();
+      }
+      else if (strcmp(cmd, "!CACHE") == 0) {
+        cachePrintStats();
+      }
+      else if (strcmp(cmd, "!CRYPTOBENCH") == 0) {
+        cryptoBenchmark(1000);
+      }
+      else if (strcmp(cmd, "!STORE") == 0) {
+        eepromPrintStoreStats();
+      }
+      else if (strcmp(cmd, "!CREDS") == 0) {
+        credPrintIndex();
+      }
+      else if (strcmp(cmd, "!CREDBENCH") == 0) {
+        valBenchmark();
+      }
+      else if (strcmp(cmd, "!STATS") == 0) {
+        statPrint();
+        taskPrintStats();
+      }
+      else if (strcmp(cmd, "!STATS RESET") == 0) {
+        statReset();
+        taskResetStats();
+        Serial.println("[STATS] Reset");
+      }
+      else if (strcmp(cmd, "!LOGBENCH") == 0) {
+        logBenchmark(LOG_RING_SLOTS / 2);
+      }
+      else if (strcmp(cmd, "!MATCH") == 0) {
+        recPrintMatchStats();
+      }
+      else if (strcmp(cmd, "!MATCH VERIFY") == 0 || strcmp(cmd, "!MATCH SEARCH") == 0 ||
+               strcmp(cmd, "!MATCH BOTH") == 0) {
+        recSetStrategy(cmd[7] == 'V' ? RECOG_VERIFY : cmd[7] == 'S' ? RECOG_SEARCH : RECOG_VERIFY_SEARCH);
+        Serial.print("[MATCH] Strategy ");
+        Serial.println(recStrategyName(recStrategy()));
+      }
+      else if (strcmp(cmd, "!MATCH RESET") == 0) {
+        recResetMatchStats();
+        Serial.println("[MATCH] Reset");
+      }
+      else if (strcmp(cmd, "!IDLE") == 0) {
+        idlePrintStats();
+      }
+      else if (strcmp(cmd, "!IDLE POLL") == 0 || strcmp(cmd, "!IDLE EVENT") == 0) {
+        idleSetPolling(cmd[6] == 'P');
+        Serial.println(idlePolling() ? "[IDLE] Polling" : "[IDLE] Event-driven");
+      }
+      else if (strcmp(cmd, "!IDLE RESET") == 0) {
+        idleResetStats();
+        Serial.println("[IDLE] Reset");
+      }
+      else if (strcmp(cmd, "!IMAGE") == 0) {
+        imgPrintStatus();
+      }
+      else if (strcmp(cmd, "!IMAGE OFF") == 0 ||
+               (strncmp(cmd, "!IMAGE ON", 9) == 0 && (cmd[9] == '\0' || cmd[9] == ' '))) {
+        bool on = cmd[8] == 'N';
+        int shift = on && cmd[9] == ' ' ? atoi(cmd + 10) : 0;
+        if (shift >= 0 && imgStreamSet(on, (uint8_t)shift)) imgPrintStatus();
+        else Serial.println("[IMAGE] Usage: !IMAGE ON [shift] | !IMAGE OFF");
+      }
+      else if (strcmp(cmd, "!LINKBENCH") == 0) {
+        if (sensorOK) sensorLinkBenchmark();
+        else Serial.println("[LINK] No sensor");
       }
       // Future commands can be added here with else-if
-      _serialCmdBuf = "";
+      _serialCmdLen = 0;
     } else {
-      if (_serialCmdBuf.length() < 32) {  // prevent runaway buffer
-        _serialCmdBuf += c;
+      if (_serialCmdLen < SERIAL_CMD_MAX) {  // prevent runaway buffer
+        _serialCmdBuf[_serialCmdLen++] = c;
       }
     }
   }
 }
 
+// ============================================================
+// CONTROL FRAME HANDLER — typed requests (ctl_proto.h)
+// ============================================================
+// PING is answered by ctl_proto.h itself. REG_INPUT is taken by the
+// registration prompt while one is open; reaching here means none is.
+void handleControlFrame(const CtlFrame &f) {
+  uint8_t body[CTL_MAX_BODY];
+
+  switch (f.type) {
+    case CTL_REQ_HELLO:
+    case CTL_REQ_STATUS: {
+      if (f.type == CTL_REQ_HELLO) logSetBinary(false);  // new session starts in text
+      uint8_t creds = 0;
+      for (uint8_t c = 1; c <= CRED_MAX_CREDENTIALS; c++) creds += credInUse(c);
+      body[0] = CTL_PROTO_VERSION;
+      body[1] = (uint8_t)currentMode;
+      body[2] = (uint8_t)bootState;
+      body[3] = sensorOK;
+      body[4] = sensorOK ? sensorPeekEnrollCount() : 0;   // may run inside a flow's sensor wait
+      body[5] = creds;
+      ctlPut32(body + 6, millis());
+      size_t fw = strlen(FW_VERSION);
+      memcpy(body + 10, FW_VERSION, fw);
+      ctlReply(f, body, 10 + fw);
+      break;
+    }
+
+    case CTL_REQ_STATS:
+#if LATENCY_STATS
+      static_assert(STAT_PHASES * 20 <= CTL_MAX_BODY, "STATS body exceeds CTL_MAX_BODY");
+      for (uint8_t p = 0; p < STAT_PHASES; p++) {
+        uint8_t* row = body + p * 20;
+        ctlPut32(row, statCount((StatPhase)p));
+        ctlPut32(row + 4, statPercentile((StatPhase)p, 500));
+        ctlPut32(row + 8, statPercentile((StatPhase)p, 950));
+        ctlPut32(row + 12, statPercentile((StatPhase)p, 990));
+        ctlPut32(row + 16, statMax((StatPhase)p));
+      }
+      ctlReply(f, body, STAT_PHASES * 20);
+#else
+      ctlNak(f, CTL_ERR_DISABLED);
+#endif
+      break;
+
+    case CTL_REQ_STATS_RESET:
+      statReset();
+      taskResetStats();
+      ctlReply(f, nullptr, 0);
+      break;
+
+    case CTL_REQ_CONFIG:
+      ctlPut32(body, COOLDOWN_MS);
+      ctlPut32(body + 4, PASSWORD_TIMEOUT_MS);
+      ctlPut32(body + 8, LOCK_DELAY_MS);
+      ctlPut32(body + 12, WAKE_SETTLE_MS);
+      body[16] = PASSWORD_MAX_LEN;
+      body[17] = CRED_MAX_CREDENTIALS;
+      body[18] = COLLECT_COUNT;
+      body[19] = SENSOR_CAPACITY;
+      ctlReply(f, body, 20);
+      break;
+
+    case CTL_REQ_REG_INPUT:
+      ctlNak(f, CTL_ERR_STATE);
+      break;
+
+    case CTL_REQ_PROVISION: {
+      // Taken by the next registration, which loop() starts right away
+      uint8_t err = CTL_ERR_STATE;
+      if (currentMode == MODE_REGISTER && sensorOK && !_regRunning) err = regProvision(f.body, f.len);
+      if (err) ctlNak(f, (CtlError)err);
+      else ctlReply(f, nullptr, 0);
+      break;
+    }
+
+    case CTL_REQ_RESET:
+      ctlReply(f, nullptr, 0);
+      rebootDevice();
+      break;
+
+    case CTL_REQ_LOG_MODE:
+    case CTL_REQ_LOG_FMT:
+      logHandleFrame(f);
+      break;
+
+    case CTL_REQ_IMAGE:
+      imgHandleFrame(f);
+      break;
+
+    default:
+      ctlNak(f, CTL_ERR_UNKNOWN);
+      break;
+  }
+}
+
+// ─── Reboot (text !RESET and CTL_REQ_RESET) ───
+void rebootDevice() {
+  logFlush();
+  Serial.println("[CMD] Rebooting...");
+  Serial.flush();
+  delay(100);  // let the response reach the host
+  watchdog_reboot(0, 0, 0);  // immediate hardware reset
+  while (true) { tight_loop_contents(); }  // wait for watchdog
+}
+
 // ============================================================
 // MODE SWITCH HANDLER
 // ============================================================
 void handleModeSwitch() {
-  switchRead();
-
   if (switchChanged()) {
     switchAckChange();
     currentMode = switchRead();
-    Serial.print("[SWITCH] ");
-    Serial.println(modeName(currentMode));
+    LOG("[SWITCH] %s", modeName(currentMode));
+    ctlEventMode(currentMode, bootState);
+    _modeLedAt = 0;
 
-    // Clear any pending IRQ trigger from before the switch
+    // Clear any pending IRQ trigger or provision from before the switch
     irqFingerClear();
+    regProvisionClear();
 
     // Reset recognition state (cooldown, etc.)
     recReset();
@@ -107,11 +341,11 @@ void handleModeSwitch() {
         ledRegisterIdle();
       } else {
         // Check registration when entering recognize mode
-        if (recCheckRegistration(fingerprint)) {
+        if (recCheckRegistration()) {
           ledRecognizeReady();
         } else {
           ledNoRegistration();
-          Serial.println("[AUTH] No registration — flip to REGISTER first");
+          LOG("[AUTH] No registration — flip to REGISTER first");
         }
       }
     }
@@ -119,31 +353,38 @@ void handleModeSwitch() {
 }
 
 // ============================================================
-// REGISTER MODE — wait for IRQ touch to start registration
+// REGISTER MODE — IRQ touch or a PROVISION frame starts registration
 // ============================================================
 void handleRegisterMode() {
-  if (irqFingerDetected()) {
-    Serial.println("[SENSOR] Finger detected (IRQ) — starting registration");
+  bool provisioned = regProvisionPending();
+  if (provisioned || irqFingerDetected()) {
+    if (provisioned) LOG("[REG] Provisioning — starting registration");
+    else LOG("[SENSOR] Finger detected (IRQ) — starting registration");
+    _modeLedAt = 0;
 
     // Run the full registration flow (blocks until complete or failed)
-    bool success = runRegistration(fingerprint);
+    _regRunning = true;
+    bool success = runRegistration();
+    _regRunning = false;
+    regProvisionClear();  // a run that ended before the password step
 
     if (success) {
-      Serial.println("[REG] Success — flip switch to RECOGNIZE to use");
+      LOG("[REG] Success — flip switch to RECOGNIZE to use");
       // Update boot state now that we have a valid registration
       bootState = BOOT_VALID;
+      ctlEventMode(currentMode, bootState);
     } else {
-      Serial.println("[REG] Registration did not complete");
+      LOG("[REG] Registration did not complete");
+      ctlEventReg(CTL_REG_FAILED);
       // Check if switch changed during registration
-      switchRead();
       if (switchChanged()) {
         switchAckChange();
         currentMode = switchRead();
-        Serial.print("[SWITCH] ");
-        Serial.println(modeName(currentMode));
+        LOG("[SWITCH] %s", modeName(currentMode));
+        ctlEventMode(currentMode, bootState);
         if (currentMode == MODE_RECOGNIZE) {
           recReset();
-          if (recCheckRegistration(fingerprint)) {
+          if (recCheckRegistration()) {
             ledRecognizeReady();
           } else {
             ledNoRegistration();
@@ -158,7 +399,7 @@ void handleRegisterMode() {
     ledRegisterIdle();
 
     // Wait for finger removal before allowing another IRQ trigger
-    while (fingerprint.detectFinger()) delay(100);
+    irqFingerAwaitLift(0);
     irqFingerClear();  // discard any IRQ that fired during removal wait
     return;
   }
@@ -169,10 +410,13 @@ void handleRegisterMode() {
 // ============================================================
 void handleRecognizeMode() {
   if (irqFingerDetected()) {
-    Serial.println("[SENSOR] Finger detected (IRQ)");
+    STAT_FLOW_START(irqFingerTouchUs());
+    STAT_FLOW(STAT_IRQ_PICKUP);
+    LOG("[SENSOR] Finger detected (IRQ)");
+    _modeLedAt = 0;
 
     // Run recognition (capture → match → HID unlock)
-    bool unlocked = runRecognition(fingerprint);
+    bool unlocked = runRecognition();
 
     if (unlocked) {
       // After cooldown LED phase, return to ready
@@ -180,8 +424,11 @@ void handleRecognizeMode() {
     }
     // If not unlocked (no match, capture fail, etc.), LED already reset in runRecognition
 
+    // Diagnostic image of that capture (!IMAGE ON), after the unlock
+    if (recCaptured()) imgStreamCapture();
+
     // Wait for finger removal
-    while (fingerprint.detectFinger()) delay(100);
+    irqFingerAwaitLift(0);
     irqFingerClear();  // discard any IRQ that fired during removal wait
   }
 }
@@ -189,71 +436,80 @@ void handleRecognizeMode() {
 // ============================================================
 // BOOT SEQUENCE
 // ============================================================
+// Nothing waits for the USB host: boot lines stay in the log ring
+// until a terminal opens the port. The sensor's wake-up time after
+// UART start is spent on crypto + flash, and the boot LED flash plays
+// while the device already takes touches (loop() sets the idle LED
+// when it ends). A touch during the integrity check is latched by
+// the IRQ and served on the first loop pass.
 void bootSequence() {
-  // 1. Serial init (wait up to 5s for USB CDC)
+  // 1. Serial init (no wait for USB CDC)
   Serial.begin(115200);
-  while (!Serial && millis() < 5000) { delay(10); }
-  delay(500);
 
-  Serial.println();
-  Serial.println("========================================");
-  Serial.print("[BOOT] Fingerprint Unlocker v");
-  Serial.println(FW_VERSION);
-  Serial.println("========================================");
-  Serial.println("[BOOT] Serial OK");
+  LOG("");
+  LOG("========================================");
+  LOG("[BOOT] Fingerprint Unlocker v%s", FW_VERSION);
+  LOG("========================================");
+  LOG("[BOOT] Serial OK");
 
   // 2. Switch init (debounced)
   switchInit();
   currentMode = switchRead();
-  Serial.print("[BOOT] Switch: ");
-  Serial.println(modeName(currentMode));
+  LOG("[BOOT] Switch: %s", modeName(currentMode));
 
-  // 3. Sensor init
-  sensorOK = initSensor();
+  // Background pollers — serviced during every blocking wait from here on
+  taskAddPoller(handleSerialCommands);
+  ctlOnRequest(handleControlFrame);
+  taskAddPoller(logDrain);
 
-  if (sensorOK) {
-    // Init LED wrappers
-    ledInit(&fingerprint);
+  // 3. Sensor UART up — the sensor wakes while core0 does 4-6
+  startSensorUart();
+
+  // 4. Crypto init (derive device-bound AES key from unique ID)
+  uint32_t t = millis();
+  cryptoInit();
+
+  // 5. Credential journal + finger index (migrates older registrations)
+  eepromInit();
+  credIndexInit();
 
-    // 4. Crypto init (derive device-bound AES key from unique ID)
-    cryptoInit();
+  // 6. HID keyboard init
+  hidInit();
+  LOG("[BOOT] HID Keyboard OK");
+  uint32_t storeMs = millis() - t;
 
-    // 5. EEPROM init
-    eepromInit();
+  // 7. Sensor handshake (waits out whatever is left of its wake time)
+  t = millis();
+  sensorOK = initSensor();
+  uint32_t sensorMs = millis() - t;
 
-    // 6. HID keyboard init
-    hidInit();
-    Serial.println("[BOOT] HID Keyboard OK");
-    Serial.flush();
+  if (sensorOK) {
+    // Init LED wrappers (routed through the sensor service)
+    ledInit();
 
-    // 7. IRQ finger detection init
+    // 8. IRQ finger detection — touches are latched from here on
     irqFingerInit();
-    Serial.flush();
 
-    // 8. Boot integrity validation
-    bootState = runBootValidation(fingerprint);
-    Serial.flush();
+    // 9. Boot integrity validation
+    t = millis();
+    bootState = runBootValidation();
+    uint32_t checkMs = millis() - t;
 
-    // Boot OK flash
-    ledBootOK();
-    delay(2000);
+    // Boot OK flash (a corrupt state shows its own); idle LED follows from loop()
+    if (bootState != BOOT_CORRUPT) ledBootOK();
+    _modeLedAt = millis() + BOOT_LED_MS;
 
-    // 9. Decide initial mode based on validation result
+    // 10. Decide initial mode based on validation result
     switch (bootState) {
       case BOOT_VALID:
         // Normal operation — use switch position
         if (currentMode == MODE_REGISTER) {
-          ledRegisterIdle();
-          Serial.println("[MODE] REGISTER");
+          LOG("[MODE] REGISTER");
+        } else if (recCheckRegistration()) {
+          LOG("[MODE] RECOGNIZE");
         } else {
-          if (recCheckRegistration(fingerprint)) {
-            ledRecognizeReady();
-            Serial.println("[MODE] RECOGNIZE");
-          } else {
-            // Shouldn't happen if BOOT_VALID, but be safe
-            ledNoRegistration();
-            Serial.println("[MODE] RECOGNIZE (registration check failed)");
-          }
+          // Shouldn't happen if BOOT_VALID, but be safe
+          LOG("[MODE] RECOGNIZE (registration check failed)");
         }
         break;
 
@@ -261,48 +517,68 @@ void bootSequence() {
       case BOOT_CORRUPT:
         // Force REGISTER mode regardless of switch
         currentMode = MODE_REGISTER;
-        ledRegisterIdle();
         if (bootState == BOOT_VIRGIN) {
-          Serial.println("[MODE] REGISTER (forced — virgin device)");
+          LOG("[MODE] REGISTER (forced — virgin device)");
         } else {
-          Serial.println("[MODE] REGISTER (forced — state was corrupt, cleaned up)");
+          LOG("[MODE] REGISTER (forced — state was corrupt, cleaned up)");
         }
-        Serial.println("[BOOT] Touch sensor to begin registration");
+        LOG("[BOOT] Touch sensor to begin registration");
         break;
     }
+
+    LOG("[BOOT] Phases: storage %u ms, sensor %u ms, check %u ms", storeMs, sensorMs, checkMs);
   }
 
-  Serial.println("[BOOT] Ready");
-  Serial.println("----------------------------------------");
+  LOG("[BOOT] Ready at %u ms", millis());
+  LOG("----------------------------------------");
+  logDrain();  // boot log out now, not at the first loop pass
+}
+
+// ─── Idle LED for the current mode (after the boot flash) ───
+void showModeLed() {
+  if (currentMode == MODE_REGISTER) {
+    ledRegisterIdle();
+  } else if (recCheckRegistration()) {
+    ledRecognizeReady();
+  } else {
+    ledNoRegistration();
+  }
 }
 
 // ============================================================
 // SENSOR INIT
 // ============================================================
-bool initSensor() {
-  Serial.println("[BOOT] Starting UART1...");
+void startSensorUart() {
+  LOG("[BOOT] Starting UART1...");
   Serial1.begin(SENSOR_BAUD);
-  delay(SENSOR_INIT_DELAY_MS);
-  Serial.println("[BOOT] UART1 OK");
+  _sensorWakeAt = millis() + SENSOR_INIT_DELAY_MS;
+  LOG("[BOOT] UART1 OK");
+}
 
-  Serial.print("[BOOT] Sensor init... ");
-  Serial.flush();
+bool initSensor() {
+  int32_t wake = (int32_t)(_sensorWakeAt - millis());
+  if (wake > 0) taskDelay((unsigned long)wake);
 
-  bool ok = fingerprint.begin(Serial1);
+  // Finds the rate the sensor is at and moves it to the fastest that holds
+  bool ok = sensorLinkOpen(fingerprint);
 
   if (!ok) {
-    Serial.println("FAILED");
-    Serial.println("[ERROR] Sensor init failed — halting");
+    LOG("[BOOT] Sensor init... FAILED");
+    LOG("[ERROR] Sensor init failed — halting");
+    logFlush();
     fingerprint.ctrlLED(fingerprint.eKeepsOn, fingerprint.eLEDRed, 0);
     while (true) { delay(1000); }
     return false;
   }
 
-  Serial.println("OK");
+  LOG("[BOOT] Sensor init... OK (%u bps)", (unsigned)sensorLinkBaud());
+  sensorLinkSave();   // negotiated rate → journal (no-op if unchanged)
 
-  Serial.print("[BOOT] Enrolled fingerprints: ");
-  Serial.println(fingerprint.getEnrollCount());
-  Serial.flush();
+  // Hand the sensor to core1 — from here on core0 only uses sensor*()
+  sensorServiceInit(&fingerprint);
+  sensorServiceStart();
+
+  LOG("[BOOT] Enrolled fingerprints: %u", sensorCachedEnrollCount());
 
   return true;
 }
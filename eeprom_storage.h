@@ -1,16 +1,34 @@
 // ============================================================
-// eeprom_storage.h — Encrypted EEPROM storage for password + slot
+// eeprom_storage.h — Encrypted password records in the journal
 //
-// Layout (36 bytes):
-//   0x00: Magic (0xAE = encrypted format)
-//   0x01: Active slot (1 or 2)
-//   0x02: Password length (1-32, stored in plaintext)
-//   0x03-0x22: ENCRYPTED password (32 bytes AES-256-CBC)
-//   0x23: Checksum (XOR of bytes 0x00-0x22, over encrypted data)
+// Record v3 (68 bytes, struct EepromRecord), one per journal
+// key — cred_index.h decides which key holds which credential:
+//   0x00: Magic (0xAF = authenticated format)
+//   0x01: Version (3)
+//   0x02: Credential number (1..CRED_MAX_CREDENTIALS)
+//   0x03: Password length (1-32, plaintext)
+//   0x04-0x13: IV (16 bytes, fresh random per write)
+//   0x14-0x33: ENCRYPTED password (32 bytes AES-256-CBC)
+//   0x34-0x43: Tag (HMAC-SHA256 over 0x00-0x33, first 16 bytes)
 //
 // The password is encrypted with a device-specific AES-256 key
-// derived from the RP2350's unique board ID. An EEPROM dump
-// from one board cannot be decrypted on another.
+// derived from the RP2350's unique board ID. A flash dump
+// from one board cannot be decrypted on another, and any bit
+// flip in header, IV or ciphertext fails the tag. The
+// credential number is authenticated, so a record copied to
+// another credential's key is rejected.
+//
+// The record is sealed in RAM (encryption and MAC in one pass)
+// and appended to the journal as one page program — no sector
+// erase on the write path. Write verification and validity
+// checks are tag checks; nothing is decrypted except by
+// eepromReadRecord().
+//
+// Validity per key is cached in RAM (see state_cache.h).
+//
+// Single-registration records from older firmware (v2 in the
+// journal, 0xAF / 0xAE in the emulated EEPROM) are handed to
+// cred_index.h once by eepromTakeLegacy() for migration.
 // ============================================================
 #ifndef EEPROM_STORAGE_H
 #define EEPROM_STORAGE_H
@@ -19,145 +37,255 @@
 #include <EEPROM.h>
 #include "config.h"
 #include "crypto.h"
+#include "cred_store.h"
+#include "sensor_service.h"
+#include "state_cache.h"
+#include "log_ring.h"
+
+// ─── Record v3 ───
+struct EepromRecord {
+  uint8_t magic;                     // EEPROM_MAGIC_VALUE
+  uint8_t version;                   // EEPROM_RECORD_VERSION (v2: legacy)
+  uint8_t credential;                // v3: credential number; v2: sensor slot
+  uint8_t pwdLen;                    // 1..PASSWORD_MAX_LEN
+  uint8_t iv[16];
+  uint8_t cipher[PASSWORD_MAX_LEN];
+  uint8_t tag[EEPROM_TAG_LEN];
+};
+static_assert(sizeof(EepromRecord) == 68, "EepromRecord must be packed");
+static_assert(sizeof(EepromRecord) <= CRED_PAYLOAD_MAX, "record must fit one journal page");
+static_assert(EEPROM_LEGACY_ADDR_RECORD + sizeof(EepromRecord) <= EEPROM_SIZE, "EEPROM_SIZE too small");
+
+#define EEPROM_RECORD_AAD_LEN 4     // magic, version, credential, length
+
+// ─── Validity cache (one entry per journal key) ───
+struct EepromValidCache {
+  uint32_t gen;        // cache generation this was filled at
+  bool valid;
+  uint8_t credential;
+};
+
+static EepromValidCache _eeprom_valid[CRED_STORE_MAX_KEYS];
 
 // ─── Init ───
+// Mounts the journal; the emulated EEPROM is only opened so
+// records from older firmware can be migrated.
 inline void eepromInit() {
   EEPROM.begin(EEPROM_SIZE);
-}
-
-// ─── Checksum ───
-static inline uint8_t _eepromCalcChecksum() {
-  uint8_t cs = 0;
-  for (uint16_t i = EEPROM_ADDR_MAGIC; i < EEPROM_ADDR_CHECKSUM; i++) {
-    cs ^= EEPROM.read(i);
+  if (credStoreMount()) {
+    LOG("[BOOT] Credential store OK (seq %u)", credStoreSequence());
+  } else {
+    LOG("[ERROR] Credential store unavailable — select a Flash Size with FS >= 16KB");
   }
-  return cs;
 }
 
-// ─── Read registration ───
-// Returns true if valid registration exists.
-// Fills activeSlot, password buffer (decrypted), and length.
-inline bool eepromReadRegistration(uint8_t &activeSlot, char* password, uint8_t &length) {
-  // Check magic
-  if (EEPROM.read(EEPROM_ADDR_MAGIC) != EEPROM_MAGIC_VALUE) return false;
+// ─── Plaintext header sanity (magic, version, ranges) ───
+static inline bool _eepromHeaderSane(const EepromRecord &rec, uint8_t version) {
+  if (rec.magic != EEPROM_MAGIC_VALUE || rec.version != version) return false;
+  if (rec.credential == 0) return false;
+  return rec.pwdLen != 0 && rec.pwdLen <= PASSWORD_MAX_LEN;
+}
 
-  // Read active slot
-  activeSlot = EEPROM.read(EEPROM_ADDR_ACTIVE_SLOT);
-  if (activeSlot != 1 && activeSlot != 2) return false;
+// ─── Header + tag check (no decrypt) ───
+static inline bool _eepromRecordAuthentic(const EepromRecord &rec, uint8_t version = EEPROM_RECORD_VERSION) {
+  if (!_eepromHeaderSane(rec, version)) return false;
+  return cryptoVerifyTag(&rec.magic, EEPROM_RECORD_AAD_LEN, rec.iv,
+                         rec.cipher, PASSWORD_MAX_LEN, rec.tag, EEPROM_TAG_LEN);
+}
 
-  // Read password length (stored in plaintext)
-  length = EEPROM.read(EEPROM_ADDR_PWD_LEN);
-  if (length == 0 || length > PASSWORD_MAX_LEN) return false;
+// ─── Seal a record in RAM (random IV, encrypt + MAC in one pass) ───
+static inline bool _eepromSealRecord(EepromRecord &rec, uint8_t credential,
+                                     const uint8_t* plaintext, uint8_t length) {
+  rec.magic = EEPROM_MAGIC_VALUE;
+  rec.version = EEPROM_RECORD_VERSION;
+  rec.credential = credential;
+  rec.pwdLen = length;
+  cryptoRandom(rec.iv, sizeof(rec.iv));
+  return cryptoSeal(&rec.magic, EEPROM_RECORD_AAD_LEN, rec.iv,
+                    plaintext, rec.cipher, PASSWORD_MAX_LEN, rec.tag, EEPROM_TAG_LEN);
+}
 
-  // Verify checksum BEFORE decryption (checksum covers encrypted data)
-  uint8_t stored = EEPROM.read(EEPROM_ADDR_CHECKSUM);
-  uint8_t calc = _eepromCalcChecksum();
-  if (stored != calc) return false;
+static inline bool _eepromLoadRecord(uint8_t key, EepromRecord &rec) {
+  return credStoreRead(key, &rec, sizeof(rec)) == sizeof(rec);
+}
 
-  // Read encrypted password bytes
-  uint8_t encrypted[PASSWORD_MAX_LEN];
-  for (uint8_t i = 0; i < PASSWORD_MAX_LEN; i++) {
-    encrypted[i] = EEPROM.read(EEPROM_ADDR_PWD_START + i);
+// ─── Decrypt an authenticated record into password (NUL-terminated) ───
+static inline bool _eepromOpenRecord(const EepromRecord &rec, char* password) {
+  uint8_t decrypted[PASSWORD_MAX_LEN];
+  bool ok = cryptoOpen(&rec.magic, EEPROM_RECORD_AAD_LEN, rec.iv,
+                       rec.cipher, decrypted, PASSWORD_MAX_LEN, rec.tag, EEPROM_TAG_LEN);
+  if (ok) {
+    memcpy(password, decrypted, rec.pwdLen);
+    password[rec.pwdLen] = '\0';
   }
+  cryptoWipe(decrypted, sizeof(decrypted));
+  return ok;
+}
 
-  // Decrypt
-  uint8_t decrypted[PASSWORD_MAX_LEN];
-  if (!cryptoDecryptPassword(encrypted, decrypted)) return false;
+// ============================================================
+// PUBLIC API
+// ============================================================
+
+// ─── Is key holding an authentic record for credential? (cached, no decrypt) ───
+inline bool eepromRecordValid(uint8_t key, uint8_t credential) {
+  if (key >= CRED_STORE_MAX_KEYS) return false;
+  EepromValidCache &c = _eeprom_valid[key];
+  if (cacheFresh(c.gen)) {
+    cacheHit(CACHE_REG);
+  } else {
+    cacheMiss(CACHE_REG);
+    EepromRecord rec;
+    c.valid = _eepromLoadRecord(key, rec) && _eepromRecordAuthentic(rec);
+    c.credential = c.valid ? rec.credential : 0;
+    c.gen = cacheGeneration();
+    memset(&rec, 0, sizeof(rec));
+  }
+  return c.valid && c.credential == credential;
+}
 
-  // Copy to output
-  memcpy(password, decrypted, length);
-  password[length] = '\0';
+// ─── Read + decrypt ───
+// Returns true if key holds an authentic record for credential.
+inline bool eepromReadRecord(uint8_t key, uint8_t credential, char* password, uint8_t &length) {
+  EepromRecord rec;
+  if (!_eepromLoadRecord(key, rec)) return false;
 
-  // Clear temp buffers
-  memset(encrypted, 0, sizeof(encrypted));
-  memset(decrypted, 0, sizeof(decrypted));
+  // Tag is checked inside cryptoOpen: no decrypt of unauthenticated bytes
+  bool ok = _eepromHeaderSane(rec, EEPROM_RECORD_VERSION) &&
+            rec.credential == credential && _eepromOpenRecord(rec, password);
+  if (ok) length = rec.pwdLen;
 
-  return true;
+  memset(&rec, 0, sizeof(rec));
+  return ok;
 }
 
-// ─── Write registration ───
-// Encrypts password, writes to EEPROM, commits. Returns true if verify passes.
-inline bool eepromWriteRegistration(uint8_t activeSlot, const char* password, uint8_t length) {
-  // Validate inputs
-  if ((activeSlot != 1 && activeSlot != 2) || length == 0 || length > PASSWORD_MAX_LEN) {
-    return false;
-  }
+// ─── Seal + append ───
+// Returns true if the read-back tag check passes.
+inline bool eepromWriteRecord(uint8_t key, uint8_t credential, const char* password, uint8_t length) {
+  if (credential == 0 || length == 0 || length > PASSWORD_MAX_LEN) return false;
 
   // Prepare plaintext buffer (null-padded to 32 bytes)
   uint8_t plaintext[PASSWORD_MAX_LEN];
   memset(plaintext, 0, PASSWORD_MAX_LEN);
   memcpy(plaintext, password, length);
 
-  // Encrypt
-  uint8_t ciphertext[PASSWORD_MAX_LEN];
-  if (!cryptoEncryptPassword(plaintext, ciphertext)) {
-    memset(plaintext, 0, sizeof(plaintext));
-    return false;
-  }
-  memset(plaintext, 0, sizeof(plaintext));
+  EepromRecord rec;
+  bool ok = _eepromSealRecord(rec, credential, plaintext, length);
+  cryptoWipe(plaintext, sizeof(plaintext));
 
-  // Write magic
-  EEPROM.write(EEPROM_ADDR_MAGIC, EEPROM_MAGIC_VALUE);
+  if (ok) {
+    // Flash program parks core1 — let it finish its UART op first
+    sensorWaitIdle();
+    ok = credStoreWrite(key, &rec, sizeof(rec));
+    cacheBump();
+  }
 
-  // Write active slot
-  EEPROM.write(EEPROM_ADDR_ACTIVE_SLOT, activeSlot);
+  if (ok) {
+    EepromRecord back;
+    ok = _eepromLoadRecord(key, back) && memcmp(&back, &rec, sizeof(rec)) == 0 &&
+         _eepromRecordAuthentic(back);
+    memset(&back, 0, sizeof(back));
+  }
 
-  // Write password length (plaintext — needed for decryption output sizing)
-  EEPROM.write(EEPROM_ADDR_PWD_LEN, length);
+  // Clear sensitive data
+  memset(&rec, 0, sizeof(rec));
+  return ok;
+}
 
-  // Write encrypted password bytes
-  for (uint8_t i = 0; i < PASSWORD_MAX_LEN; i++) {
-    EEPROM.write(EEPROM_ADDR_PWD_START + i, ciphertext[i]);
-  }
+// ─── Drop a record (tombstone, one page program) ───
+inline void eepromEraseRecord(uint8_t key) {
+  sensorWaitIdle();
+  credStoreErase(key);
+  cacheBump();
+}
 
-  // Calculate and write checksum (over encrypted data)
-  uint8_t cs = _eepromCalcChecksum();
-  EEPROM.write(EEPROM_ADDR_CHECKSUM, cs);
+// ============================================================
+// LEGACY — single-registration records from older firmware
+// ============================================================
 
-  // Commit to flash
-  EEPROM.commit();
+// ─── 0xAE (XOR checksum, fixed IV, legacy key) ───
+static inline bool _eepromTakeLegacyAE(uint8_t &slot, char* password, uint8_t &length) {
+  slot = EEPROM.read(EEPROM_LEGACY_ADDR_SLOT);
+  length = EEPROM.read(EEPROM_LEGACY_ADDR_LEN);
+  if ((slot != 1 && slot != 2) || length == 0 || length > PASSWORD_MAX_LEN) return false;
 
-  // Verify by re-reading (which decrypts)
-  uint8_t slotBack;
-  char pwdBack[PASSWORD_MAX_LEN + 1];
-  uint8_t lenBack;
-  if (!eepromReadRegistration(slotBack, pwdBack, lenBack)) return false;
-  if (slotBack != activeSlot || lenBack != length) return false;
-  if (memcmp(pwdBack, password, length) != 0) return false;
+  uint8_t cs = 0;
+  for (uint16_t i = 0; i < EEPROM_LEGACY_ADDR_CS; i++) cs ^= EEPROM.read(i);
+  if (cs != EEPROM.read(EEPROM_LEGACY_ADDR_CS)) return false;
 
-  // Clear sensitive data
-  memset(ciphertext, 0, sizeof(ciphertext));
-  memset(pwdBack, 0, sizeof(pwdBack));
+  uint8_t plaintext[PASSWORD_MAX_LEN];
+  for (uint8_t i = 0; i < PASSWORD_MAX_LEN; i++) {
+    plaintext[i] = EEPROM.read(EEPROM_LEGACY_ADDR_PWD + i);
+  }
+  bool ok = cryptoDecryptLegacy(plaintext, plaintext);
+  if (ok) {
+    memcpy(password, plaintext, length);
+    password[length] = '\0';
+  }
+  cryptoWipe(plaintext, sizeof(plaintext));
+  return ok;
+}
 
+// ─── v2 record (journal key or EEPROM.put) ───
+static inline bool _eepromTakeLegacyV2(const EepromRecord &rec, uint8_t &slot, char* password, uint8_t &length) {
+  if (!_eepromRecordAuthentic(rec, EEPROM_LEGACY_VERSION)) return false;
+  if (rec.credential != 1 && rec.credential != 2) return false;
+  if (!_eepromOpenRecord(rec, password)) return false;
+  slot = rec.credential;
+  length = rec.pwdLen;
   return true;
 }
 
-// ─── Clear registration ───
-inline void eepromClearRegistration() {
-  EEPROM.write(EEPROM_ADDR_MAGIC, 0x00);
-  EEPROM.commit();
-}
+// ─── Find + decrypt an old registration ───
+// Fills the sensor slot its fingerprint is in and the password.
+// Journal first (newest firmware), then the emulated EEPROM.
+inline bool eepromTakeLegacy(uint8_t &slot, char* password, uint8_t &length) {
+  EepromRecord rec;
+  bool ok = _eepromLoadRecord(CRED_KEY_LEGACY_REG, rec) &&
+            _eepromTakeLegacyV2(rec, slot, password, length);
 
-// ─── Convenience: get active slot (0 = none/virgin) ───
-inline uint8_t eepromGetActiveSlot() {
-  uint8_t slot;
-  char pwd[PASSWORD_MAX_LEN + 1];
-  uint8_t len;
-  if (eepromReadRegistration(slot, pwd, len)) return slot;
-  return 0;
+  if (!ok) {
+    uint8_t magic = EEPROM.read(EEPROM_LEGACY_ADDR_RECORD);
+    if (magic == EEPROM_MAGIC_VALUE) {
+      EEPROM.get(EEPROM_LEGACY_ADDR_RECORD, rec);
+      ok = _eepromTakeLegacyV2(rec, slot, password, length);
+    } else if (magic == EEPROM_LEGACY_MAGIC) {
+      ok = _eepromTakeLegacyAE(slot, password, length);
+    }
+  }
+  memset(&rec, 0, sizeof(rec));
+  return ok;
 }
 
-// ─── Convenience: get staging slot ───
-inline uint8_t eepromGetStagingSlot() {
-  uint8_t active = eepromGetActiveSlot();
-  if (active == 1) return 2;
-  if (active == 2) return 1;
-  return 1;  // virgin: first registration goes to slot 1
+// ─── Wipe the EEPROM copy once migrated (one last sector commit) ───
+inline void eepromWipeLegacy() {
+  if (EEPROM.read(EEPROM_LEGACY_ADDR_RECORD) == 0x00) return;
+  EEPROM.write(EEPROM_LEGACY_ADDR_RECORD, 0x00);
+  sensorWaitIdle();
+  EEPROM.commit();
 }
 
-// ─── Convenience: check if valid registration exists ───
-inline bool eepromHasRegistration() {
-  return (eepromGetActiveSlot() != 0);
+// ─── Journal wear + latency (console: !STORE) ───
+inline void eepromPrintStoreStats() {
+  const CredStoreStats &st = credStoreStats();
+  Serial.print("[STORE] seq ");
+  Serial.print(credStoreSequence());
+  Serial.print(", appends ");
+  Serial.print(st.appends);
+  Serial.print(", relocations ");
+  Serial.print(st.relocations);
+  Serial.print(", erases ");
+  Serial.println(st.erases);
+  Serial.print("[STORE] commit last ");
+  Serial.print(st.lastCommitUs);
+  Serial.print(" us, max ");
+  Serial.print(st.maxCommitUs);
+  Serial.println(" us");
+  Serial.print("[STORE] erases per sector:");
+  for (uint8_t i = 0; i < CRED_STORE_SECTORS; i++) {
+    Serial.print(' ');
+    Serial.print(st.sectorErases[i]);
+  }
+  Serial.println();
 }
 
 #endif // EEPROM_STORAGE_H
@@ -0,0 +1,85 @@
+// ============================================================
+// finger_edges.h — Debounced touch / lift state from raw pin edges
+//
+// Touch Out is tracked on both edges. The ISR feeds every raw
+// edge with the pin level after it; the record keeps a debounced
+// "finger present" and the time of the last accepted touch and
+// lift.
+//
+//   - The first edge that changes the state is taken at once, so
+//     a touch costs no debounce latency.
+//   - Edges within FINGER_DEBOUNCE_US of an accepted one are
+//     bounces: counted, not taken.
+//   - A change a bounce window swallowed (a tap shorter than the
+//     window, a lift that bounced) is taken once the pin has held
+//     the new level for FINGER_DEBOUNCE_US. The next edge does that,
+//     or fingerEdgeSettle() from the main loop. Its timestamp is
+//     the raw edge, not when it was noticed.
+//
+// No Arduino calls in here: host tests feed synthetic sequences.
+//
+// Usage:
+//   FingerEdges e; fingerEdgeInit(e, level, nowUs)
+//   fingerEdgeFeed(e, level, nowUs)   — ISR, level after the edge
+//   fingerEdgeSettle(e, nowUs)        — outside the ISR, before reading
+// ============================================================
+#ifndef FINGER_EDGES_H
+#define FINGER_EDGES_H
+
+#include <stdint.h>
+#include "config.h"
+
+struct FingerEdges {
+  bool present;        // debounced: finger on the glass
+  bool touched;        // touch not yet taken by the main loop
+  bool rawLevel;       // pin level after the last raw edge
+  uint32_t rawUs;      // … and when that edge came
+  uint32_t edgeUs;     // last accepted change
+  uint32_t touchUs;    // last accepted touch
+  uint32_t liftUs;     // last accepted lift
+  uint16_t touches;
+  uint16_t lifts;
+  uint16_t bounces;
+};
+
+// ─── Start from the pin as it is (finger already on = no touch event) ───
+static inline void fingerEdgeInit(FingerEdges &e, bool level, uint32_t nowUs) {
+  e = FingerEdges();
+  e.present = e.rawLevel = level;
+  e.rawUs = e.edgeUs = nowUs - FINGER_DEBOUNCE_US;   // first edge is taken at once
+}
+
+static inline void _fingerEdgeAccept(FingerEdges &e, bool level, uint32_t atUs) {
+  e.present = level;
+  e.edgeUs = atUs;
+  if (level) {
+    e.touched = true;
+    e.touchUs = atUs;
+    e.touches++;
+  } else {
+    e.liftUs = atUs;
+    e.lifts++;
+  }
+}
+
+// ─── Take a change the bounce window swallowed once the pin held it ───
+static inline void fingerEdgeSettle(FingerEdges &e, uint32_t nowUs) {
+  if (e.rawLevel != e.present && nowUs - e.rawUs >= FINGER_DEBOUNCE_US) {
+    _fingerEdgeAccept(e, e.rawLevel, e.rawUs);
+  }
+}
+
+// ─── One raw edge; level = pin after it ───
+static inline void fingerEdgeFeed(FingerEdges &e, bool level, uint32_t nowUs) {
+  fingerEdgeSettle(e, nowUs);
+  e.rawLevel = level;
+  e.rawUs = nowUs;
+  if (level == e.present) return;   // coalesced pair, or back after a bounce
+  if (nowUs - e.edgeUs < FINGER_DEBOUNCE_US) {
+    e.bounces++;
+    return;
+  }
+  _fingerEdgeAccept(e, level, nowUs);
+}
+
+#endif // FINGER_EDGES_H
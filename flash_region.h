@@ -0,0 +1,93 @@
+// ============================================================
+// flash_region.h — Raw flash access for the journal + template backups
+//
+// The start of the arduino-pico filesystem partition (_FS_start):
+//
+//   [ journal: CRED_STORE_SECTORS ][ backups: TPL_BACKUP_SLOTS ]
+//
+// The journal (cred_store.h) needs its sectors; the template
+// backups (tpl_backup.h) are used only when the FS area holds
+// them too (e.g. "4MB (Sketch: 4032KB, FS: 64KB)").
+//
+// Offsets are relative to the start of the region. Erase works
+// on whole sectors, program on whole 256-byte pages, and — like
+// real NOR flash — programming can only clear bits.
+//
+// On target the other core is parked and interrupts are off for
+// each erase/program (XIP is unavailable while flash is busy).
+// With HOST_BUILD the functions are provided by host/flash_sim.cpp.
+//
+// Usage:
+//   flashRegionSize()             — usable bytes (0 = no region)
+//   flashRegionRead(off, buf, n)  — memory-mapped read
+//   flashRegionErase(off)         — erase one sector
+//   flashRegionProgram(off, page) — program one page
+//   flashRegionMicros()           — clock for latency stats
+// ============================================================
+#ifndef FLASH_REGION_H
+#define FLASH_REGION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#define FLASH_REGION_SECTOR  4096
+#define FLASH_REGION_PAGE    256
+#define FLASH_REGION_JOURNAL ((uint32_t)CRED_STORE_SECTORS * FLASH_REGION_SECTOR)
+#define FLASH_REGION_BYTES   ((uint32_t)(CRED_STORE_SECTORS + TPL_BACKUP_SLOTS) * FLASH_REGION_SECTOR)
+
+#ifdef HOST_BUILD
+
+uint32_t flashRegionSize();
+void flashRegionRead(uint32_t off, void* buf, size_t len);
+void flashRegionErase(uint32_t off);
+void flashRegionProgram(uint32_t off, const uint8_t* page);
+uint32_t flashRegionMicros();
+
+#else
+
+#include <Arduino.h>
+#include <hardware/flash.h>
+
+extern uint8_t _FS_start;
+extern uint8_t _FS_end;
+
+// ─── Whole sectors up to FLASH_REGION_BYTES; 0 if not even the journal fits ───
+inline uint32_t flashRegionSize() {
+  uint32_t avail = (uint32_t)(&_FS_end - &_FS_start) & ~(uint32_t)(FLASH_REGION_SECTOR - 1);
+  if (avail < FLASH_REGION_JOURNAL) return 0;
+  return avail < FLASH_REGION_BYTES ? avail : FLASH_REGION_BYTES;
+}
+
+inline void flashRegionRead(uint32_t off, void* buf, size_t len) {
+  memcpy(buf, &_FS_start + off, len);
+}
+
+// ─── Offset from the start of flash (what the SDK calls expect) ───
+static inline uint32_t _flashRegionAbs(uint32_t off) {
+  return (uint32_t)((uintptr_t)(&_FS_start + off) - XIP_BASE);
+}
+
+inline void flashRegionErase(uint32_t off) {
+  rp2040.idleOtherCore();
+  noInterrupts();
+  flash_range_erase(_flashRegionAbs(off), FLASH_REGION_SECTOR);
+  interrupts();
+  rp2040.resumeOtherCore();
+}
+
+inline void flashRegionProgram(uint32_t off, const uint8_t* page) {
+  rp2040.idleOtherCore();
+  noInterrupts();
+  flash_range_program(_flashRegionAbs(off), page, FLASH_REGION_PAGE);
+  interrupts();
+  rp2040.resumeOtherCore();
+}
+
+inline uint32_t flashRegionMicros() {
+  return micros();
+}
+
+#endif // HOST_BUILD
+
+#endif // FLASH_REGION_H
@@ -0,0 +1,233 @@
+// ============================================================
+// hid_layouts.h — Keyboard layouts as compile-time lookup tables
+//
+// The host turns key positions into characters through its own
+// layout, so the same report types "z" on a US Mac and "y" on a
+// German one. Each layout is written down as what its keys type
+// (plain, Shift, Option, Shift+Option); hidLayoutBuild() inverts
+// that at compile time into a 95-entry table
+//
+//   printable ASCII 0x20..0x7E → (usage, modifiers)
+//
+// picking the fewest modifiers when a character sits on several
+// keys. static_asserts refuse a layout that misses a character or
+// types two with the same keys. Nothing is parsed at run time: a
+// lookup is one index into a table in flash.
+//
+// The layouts are macOS's. Option is Alt in the report. Characters
+// that are dead keys there (^ ` ~ on the European layouts) are
+// flagged HID_KEY_DEAD: the dead key, then Space, types them alone.
+// macOS swaps usages 0x35 and 0x64 on keyboards it was told are
+// ISO (Keyboard Setup Assistant); UK, DE, FR and CH assume ISO,
+// US assumes ANSI.
+//
+// Layout numbers are stored with each credential (cred_index.h) —
+// append new layouts, never renumber.
+//
+// Usage:
+//   hidKeyFor(layout, c)     — { usage | HID_KEY_DEAD, mods }, usage 0 = none
+//   hidLayoutName(layout)    — "US", "UK", "DE", "FR", "CH"
+//   hidLayoutFind(name)      — layout for a name, HID_LAYOUTS if none
+// ============================================================
+#ifndef HID_LAYOUTS_H
+#define HID_LAYOUTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ─── Boot report modifier bits ───
+#define HID_MOD_LCTRL   0x01
+#define HID_MOD_LSHIFT  0x02
+#define HID_MOD_LALT    0x04   // Option on a Mac
+#define HID_MOD_LGUI    0x08   // Command
+#define HID_MOD_RSHIFT  0x20
+
+#define HID_KEY_DEAD    0x80   // usage flag: dead key, follow with Space
+#define HID_USAGE_SPACE 0x2C
+#define HID_USAGE_A     0x04   // first letter key; 26 in a row
+
+enum HidLayout : uint8_t {
+  HID_LAYOUT_US,
+  HID_LAYOUT_UK,
+  HID_LAYOUT_DE,
+  HID_LAYOUT_FR,
+  HID_LAYOUT_CH,
+  HID_LAYOUTS
+};
+
+struct HidKey {
+  uint8_t usage;   // | HID_KEY_DEAD; 0 = the layout can't type it
+  uint8_t mods;
+};
+
+// ─── One key: what it types per modifier state, 0 = nothing ASCII ───
+struct HidKeyDef {
+  uint8_t usage;
+  char plain = 0, shift = 0, option = 0, shiftOption = 0;
+};
+
+struct HidLayoutDef {
+  const char* name;
+  const char* letters;   // 26: what the letter keys A..Z type, ' ' = not a letter (see keys)
+  const HidKeyDef* keys; // everything else; a usage may appear again for more levels
+  uint8_t count;
+  const char* dead;      // characters this layout only has as dead keys
+};
+
+struct HidLayoutTable {
+  HidKey key[95];
+};
+
+// ─── Compile-time construction ───
+constexpr bool _hidHas(const char* s, char c) {
+  for (; *s; s++) {
+    if (*s == c) return true;
+  }
+  return false;
+}
+
+constexpr void _hidPut(HidLayoutTable &t, const HidLayoutDef &d, char c, uint8_t usage, uint8_t mods) {
+  if (c < 0x20 || c > 0x7E || t.key[c - 0x20].usage) return;   // fewer modifiers already won
+  t.key[c - 0x20] = HidKey { (uint8_t)(usage | (_hidHas(d.dead, c) ? HID_KEY_DEAD : 0)), mods };
+}
+
+constexpr HidLayoutTable hidLayoutBuild(const HidLayoutDef &d) {
+  HidLayoutTable t {};
+  const uint8_t mods[4] = { 0, HID_MOD_LSHIFT, HID_MOD_LALT, HID_MOD_LSHIFT | HID_MOD_LALT };
+  for (uint8_t level = 0; level < 4; level++) {
+    for (uint8_t i = 0; i < 26 && level < 2; i++) {
+      char c = d.letters[i];
+      if (c < 'a' || c > 'z') continue;
+      _hidPut(t, d, level ? (char)(c - 'a' + 'A') : c, (uint8_t)(HID_USAGE_A + i), mods[level]);
+    }
+    for (uint8_t i = 0; i < d.count; i++) {
+      const HidKeyDef &k = d.keys[i];
+      char c = level == 0 ? k.plain : level == 1 ? k.shift : level == 2 ? k.option : k.shiftOption;
+      _hidPut(t, d, c, k.usage, mods[level]);
+    }
+  }
+  return t;
+}
+
+// Every printable character has keys, and no two share them
+constexpr bool hidLayoutSound(const HidLayoutTable &t) {
+  for (uint8_t i = 0; i < 95; i++) {
+    if (!t.key[i].usage) return false;
+    for (uint8_t j = 0; j < i; j++) {
+      if (t.key[j].usage == t.key[i].usage && t.key[j].mods == t.key[i].mods) return false;
+    }
+  }
+  return true;
+}
+
+// ============================================================
+// LAYOUTS
+// ============================================================
+
+// ─── US (ANSI) ───
+static constexpr HidKeyDef _hidKeysUS[] = {
+  { 0x1E, '1', '!' }, { 0x1F, '2', '@' }, { 0x20, '3', '#' }, { 0x21, '4', '$' }, { 0x22, '5', '%' },
+  { 0x23, '6', '^' }, { 0x24, '7', '&' }, { 0x25, '8', '*' }, { 0x26, '9', '(' }, { 0x27, '0', ')' },
+  { 0x2C, ' ' },
+  { 0x2D, '-', '_' }, { 0x2E, '=', '+' }, { 0x2F, '[', '{' }, { 0x30, ']', '}' }, { 0x31, '\\', '|' },
+  { 0x33, ';', ':' }, { 0x34, '\'', '"' }, { 0x35, '`', '~' },
+  { 0x36, ',', '<' }, { 0x37, '.', '>' }, { 0x38, '/', '?' },
+};
+
+// ─── British: £ on Shift+3, # on Option+3 ───
+static constexpr HidKeyDef _hidKeysUK[] = {
+  { 0x1E, '1', '!' }, { 0x1F, '2', '@' }, { 0x20, '3', 0, '#' }, { 0x21, '4', '$' }, { 0x22, '5', '%' },
+  { 0x23, '6', '^' }, { 0x24, '7', '&' }, { 0x25, '8', '*' }, { 0x26, '9', '(' }, { 0x27, '0', ')' },
+  { 0x2C, ' ' },
+  { 0x2D, '-', '_' }, { 0x2E, '=', '+' }, { 0x2F, '[', '{' }, { 0x30, ']', '}' }, { 0x31, '\\', '|' },
+  { 0x33, ';', ':' }, { 0x34, '\'', '"' }, { 0x35, '`', '~' },   // 0x35: beside left Shift (ISO)
+  { 0x36, ',', '<' }, { 0x37, '.', '>' }, { 0x38, '/', '?' },
+};
+
+// ─── German: QWERTZ, @ on Option+L, brackets on Option+5..9 ───
+static constexpr HidKeyDef _hidKeysDE[] = {
+  { 0x1E, '1', '!' }, { 0x1F, '2', '"' }, { 0x20, '3', 0 }, { 0x21, '4', '$' },
+  { 0x22, '5', '%', '[' }, { 0x23, '6', '&', ']' }, { 0x24, '7', '/', '|', '\\' },
+  { 0x25, '8', '(', '{' }, { 0x26, '9', ')', '}' }, { 0x27, '0', '=' },
+  { 0x2C, ' ' },
+  { 0x2D, 0, '?' }, { 0x2E, 0, '`' }, { 0x30, '+', '*' }, { 0x31, '#', '\'' },   // ß, ´ (dead)
+  { 0x35, '<', '>' }, { 0x36, ',', ';' }, { 0x37, '.', ':' }, { 0x38, '-', '_' },
+  { 0x64, '^' },                                                                    // left of 1 (ISO)
+  { 0x0F, 0, 0, '@' }, { 0x11, 0, 0, '~' },                                         // Option+L, Option+N
+};
+
+// ─── French: AZERTY, digits on Shift, @ # left of 1 ───
+static constexpr HidKeyDef _hidKeysFR[] = {
+  { 0x1E, '&', '1' }, { 0x1F, 0, '2' }, { 0x20, '"', '3' }, { 0x21, '\'', '4' },
+  { 0x22, '(', '5', '{', '[' }, { 0x23, 0, '6' }, { 0x24, 0, '7' }, { 0x25, '!', '8' },
+  { 0x26, 0, '9' }, { 0x27, 0, '0' },
+  { 0x2C, ' ' },
+  { 0x2D, ')', 0, '}', ']' }, { 0x2E, '-', '_' }, { 0x2F, '^' }, { 0x30, '$', '*' }, { 0x31, '`' },
+  { 0x33, 'm', 'M' }, { 0x34, 0, '%' },
+  { 0x35, '<', '>' }, { 0x10, ',', '?' }, { 0x36, ';', '.' }, { 0x37, ':', '/', 0, '\\' },
+  { 0x38, '=', '+' }, { 0x64, '@', '#' },
+  { 0x0F, 0, 0, 0, '|' }, { 0x11, 0, 0, '~' },                                      // Option+Shift+L, Option+N
+};
+
+// ─── Swiss German: QWERTZ, @ on Option+G, # on Option+3 ───
+static constexpr HidKeyDef _hidKeysCH[] = {
+  { 0x1E, '1', '+' }, { 0x1F, '2', '"' }, { 0x20, '3', '*', '#' }, { 0x21, '4', 0 },
+  { 0x22, '5', '%', '[' }, { 0x23, '6', '&', ']' }, { 0x24, '7', '/', '|', '\\' },
+  { 0x25, '8', '(', '{' }, { 0x26, '9', ')', '}' }, { 0x27, '0', '=' },
+  { 0x2C, ' ' },
+  { 0x2D, '\'', '?' }, { 0x2E, '^', '`' }, { 0x30, 0, '!' }, { 0x31, '$' },
+  { 0x35, '<', '>' }, { 0x36, ',', ';' }, { 0x37, '.', ':' }, { 0x38, '-', '_' },
+  { 0x0A, 0, 0, '@' }, { 0x11, 0, 0, '~' },                                         // Option+G, Option+N
+};
+
+#define _HID_LAYOUT(name, letters, keys, dead) \
+  HidLayoutDef { name, letters, keys, (uint8_t)(sizeof(keys) / sizeof(keys[0])), dead }
+
+static constexpr HidLayoutDef _hidLayoutDefs[HID_LAYOUTS] = {
+  _HID_LAYOUT("US", "abcdefghijklmnopqrstuvwxyz", _hidKeysUS, ""),
+  _HID_LAYOUT("UK", "abcdefghijklmnopqrstuvwxyz", _hidKeysUK, ""),
+  _HID_LAYOUT("DE", "abcdefghijklmnopqrstuvwxzy", _hidKeysDE, "^`~"),
+  _HID_LAYOUT("FR", "qbcdefghijkl noparstuvzxyw", _hidKeysFR, "^`~"),
+  _HID_LAYOUT("CH", "abcdefghijklmnopqrstuvwxzy", _hidKeysCH, "^`~"),
+};
+
+static constexpr HidLayoutTable _hidLayoutTables[HID_LAYOUTS] = {
+  hidLayoutBuild(_hidLayoutDefs[HID_LAYOUT_US]),
+  hidLayoutBuild(_hidLayoutDefs[HID_LAYOUT_UK]),
+  hidLayoutBuild(_hidLayoutDefs[HID_LAYOUT_DE]),
+  hidLayoutBuild(_hidLayoutDefs[HID_LAYOUT_FR]),
+  hidLayoutBuild(_hidLayoutDefs[HID_LAYOUT_CH]),
+};
+
+static_assert(hidLayoutSound(_hidLayoutTables[HID_LAYOUT_US]), "US layout incomplete or ambiguous");
+static_assert(hidLayoutSound(_hidLayoutTables[HID_LAYOUT_UK]), "UK layout incomplete or ambiguous");
+static_assert(hidLayoutSound(_hidLayoutTables[HID_LAYOUT_DE]), "DE layout incomplete or ambiguous");
+static_assert(hidLayoutSound(_hidLayoutTables[HID_LAYOUT_FR]), "FR layout incomplete or ambiguous");
+static_assert(hidLayoutSound(_hidLayoutTables[HID_LAYOUT_CH]), "CH layout incomplete or ambiguous");
+
+// ============================================================
+// LOOKUP
+// ============================================================
+
+static inline HidKey hidKeyFor(uint8_t layout, char c) {
+  uint8_t u = (uint8_t)c;
+  if (layout >= HID_LAYOUTS || u < 0x20 || u > 0x7E) return HidKey { 0, 0 };
+  return _hidLayoutTables[layout].key[u - 0x20];
+}
+
+static inline const char* hidLayoutName(uint8_t layout) {
+  return layout < HID_LAYOUTS ? _hidLayoutDefs[layout].name : "?";
+}
+
+// ─── "de", "DE" → HID_LAYOUT_DE; HID_LAYOUTS if unknown ───
+static inline uint8_t hidLayoutFind(const char* name) {
+  for (uint8_t l = 0; l < HID_LAYOUTS; l++) {
+    const char* n = _hidLayoutDefs[l].name;
+    const char* s = name;
+    while (*n && (*s & ~0x20) == *n) { s++; n++; }
+    if (!*n && !*s) return l;
+  }
+  return HID_LAYOUTS;
+}
+
+#endif // HID_LAYOUTS_H
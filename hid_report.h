@@ -0,0 +1,74 @@
+// ============================================================
+// hid_report.h — Text → boot-keyboard reports, built ahead of time
+//
+// Keyboard.print() sends two reports per character (press with its
+// modifiers, then an all-up report). The host only needs to see a
+// key go down while the right modifier is held, so a string can be
+// typed with one report per character:
+//
+//   "aB1"  →  {a}  {Shift B}  {1}  {}
+//
+//   - the next key replaces the previous one in the same report
+//     (its release rides along) unless it is the same key, which
+//     must be seen going up first:  "oo" → {o} {} {o}
+//   - Shift (and Option) are bits in the report's modifier byte;
+//     they change together with the key that needs them and stay
+//     down across a run, never toggled on their own
+//   - a dead key is followed by Space: "^" on a German host is
+//     {^} {Space}
+//   - one all-up report at the end
+//
+// Reports carry a single key: two keys going down in one report
+// have no order, so different characters never share one.
+//
+// Keys come from the host's layout (hid_layouts.h). Pure and static
+// inline (no Arduino, no state), so the host sim and tests can build
+// reports with the same tables.
+//
+// Usage:
+//   hidReportBuild(text, out, layout)  — reports for text, returns count
+//   HID_REPORTS_MAX(chars)             — buffer size for chars characters
+// ============================================================
+#ifndef HID_REPORT_H
+#define HID_REPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "hid_layouts.h"
+
+// Worst case two per character: the same key again (release, press)
+// or a dead key (key, Space). A dead key only needs a release after
+// a character on its own key, which took one report.
+#define HID_REPORTS_MAX(chars) (2 * (chars) + 1)
+
+struct HidReport {
+  uint8_t mods;   // modifier byte
+  uint8_t key;    // usage in the first key slot, 0 = none down
+};
+
+static inline void _hidStroke(HidReport* out, size_t &n, uint8_t &prevKey, uint8_t &held,
+                              uint8_t mods, uint8_t key) {
+  if (key == prevKey) out[n++] = HidReport { held, 0 };   // up before it goes down again
+  out[n++] = HidReport { mods, key };
+  prevKey = key;
+  held = mods;
+}
+
+// ─── Reports for text; out holds HID_REPORTS_MAX(strlen(text)) ───
+// Characters without a key are skipped, as Keyboard.print() does.
+// Returns the report count, 0 if nothing is typed.
+static inline size_t hidReportBuild(const char* text, HidReport* out, uint8_t layout = HID_LAYOUT_US) {
+  size_t n = 0;
+  uint8_t prevKey = 0, held = 0;
+  for (; *text; text++) {
+    HidKey k = hidKeyFor(layout, *text);
+    if (!k.usage) continue;
+    _hidStroke(out, n, prevKey, held, k.mods, k.usage & ~HID_KEY_DEAD);
+    if (k.usage & HID_KEY_DEAD) _hidStroke(out, n, prevKey, held, 0, HID_USAGE_SPACE);   // the accent alone
+  }
+  if (n) out[n++] = HidReport { 0, 0 };
+  return n;
+}
+
+#endif // HID_REPORT_H
@@ -7,17 +7,80 @@
 //   3. Cmd+A (select-all — clears stale text in pwd field)
 //   4. Type password (first char replaces selection from step 3)
 //   5. Enter (submit)
+//
+// Adaptive timing (HID_ADAPTIVE_TIMING):
+//   After each step a Caps Lock tap is sent as a readiness probe.
+//   The host answers with a keyboard LED output report; the step
+//   ends as soon as that arrives (Caps Lock is then toggled back).
+//   The fixed *_DELAY_MS values stay as upper bounds — if the host
+//   ever fails to answer, the rest of the sequence falls back to
+//   fixed delays. Per-step timing is recorded either way. An echo
+//   that came late or not at all can leave Caps Lock flipped, so
+//   it is checked against its state at the start and tapped back
+//   before the password is typed.
+//
+// Batched typing (HID_BATCHED_TYPING):
+//   The password is built into reports before the first one goes
+//   out (hid_report.h: one per character, Shift held across runs)
+//   and sent through the keyboard's own sendReport(), one per
+//   HID_REPORT_INTERVAL_US. A repeating alarm marks the deadlines,
+//   rescheduled from the last deadline rather than from "now", so
+//   the spacing doesn't drift with the time each report takes;
+//   core0 sleeps (__wfi) in between. With no free alarm the
+//   password is typed with Keyboard.print() as before.
+//
+// Keyboard layouts:
+//   Each credential records the layout of the Mac it unlocks
+//   (hid_layouts.h). Keyboard.print() only knows US keys, so other
+//   layouts always type as a report train (paced with
+//   delayMicroseconds() if no alarm is free), and the Cmd
+//   shortcuts press the key the host's layout has Q and A on.
 // ============================================================
 #ifndef HID_UNLOCK_H
 #define HID_UNLOCK_H
 
 #include <Arduino.h>
 #include <Keyboard.h>
+#include <pico/time.h>
 #include "config.h"
+#include "tasks.h"
+#include "crypto.h"
+#include "hid_report.h"
+#include "latency_stats.h"
+#include "log_ring.h"
+
+// ─── Per-step timing ───
+#define HID_MAX_STEPS 8
+
+struct HidStepTiming {
+  const char* name;
+  uint16_t budgetMs;   // fixed delay (upper bound)
+  uint16_t tookMs;     // actual settle time
+  bool acked;          // host answered the LED probe
+};
+
+static HidStepTiming _hid_steps[HID_MAX_STEPS];
+static uint8_t _hid_stepCount = 0;
+
+// ─── Host LED report tracking (written from USB callback) ───
+static volatile uint32_t _hid_ledReports = 0;
+static volatile bool _hid_hostCaps = false;
+static bool _hid_adaptive = false;   // probe still trusted for this sequence
+
+#if HID_ADAPTIVE_TIMING
+static void _hidOnLED(bool numlock, bool capslock, bool scrolllock, bool compose, bool kana, void* cbData) {
+  (void)numlock; (void)scrolllock; (void)compose; (void)kana; (void)cbData;
+  _hid_hostCaps = capslock;
+  _hid_ledReports++;
+}
+#endif
 
 // ─── Init ───
 inline void hidInit() {
   Keyboard.begin();
+#if HID_ADAPTIVE_TIMING
+  Keyboard.onLED(_hidOnLED);
+#endif
 }
 
 // ─── End ───
@@ -25,53 +88,251 @@ inline void hidEnd() {
   Keyboard.end();
 }
 
+// ─── Tap a single key ───
+static inline void _hidTap(uint8_t key) {
+  Keyboard.press(key);
+  taskDelay(50);
+  Keyboard.release(key);
+}
+
+// ─── Report train (batched typing) ───
+static_assert(HID_REPORT_INTERVAL_US >= HID_POLL_INTERVAL_US, "reports closer than the endpoint is polled");
+
+struct HidTypeStats {
+  uint16_t chars;
+  uint16_t reports;
+  uint32_t tookUs;      // first report → last report
+  uint32_t maxLateUs;   // worst report behind its deadline
+};
+
+static HidReport _hid_train[HID_REPORTS_MAX(PASSWORD_MAX_LEN)];
+static volatile uint32_t _hid_ticks = 0;   // deadlines passed, written from the alarm
+static HidTypeStats _hid_typeStats;
+
+static int64_t _hidOnTick(alarm_id_t, void*) {
+  _hid_ticks++;
+  return -(int64_t)HID_REPORT_INTERVAL_US;   // next deadline counted from this one
+}
+
+// HID_Keyboard keeps sendReport() protected; a member pointer named
+// from a derived class reaches it and dispatches to the USB
+// keyboard's own (report ID, USB lock), as press() would.
+struct _HidRawKeyboard : HID_Keyboard {
+  static void send(HID_Keyboard &kb, KeyReport* r) {
+    void (HID_Keyboard::*fn)(KeyReport*) = &_HidRawKeyboard::sendReport;
+    (kb.*fn)(r);
+  }
+};
+
+static inline void _hidSendReport(const HidReport &r) {
+  KeyReport k;
+  memset(&k, 0, sizeof(k));
+  k.modifiers = r.mods;
+  k.keys[0] = r.key;
+  _HidRawKeyboard::send(Keyboard, &k);
+}
+
+// ─── Sleep until the alarm passes another deadline ───
+static inline uint32_t _hidAwaitTick(uint32_t seen) {
+  while (_hid_ticks == seen) {
+    noInterrupts();
+    if (_hid_ticks == seen) __wfi();
+    interrupts();
+  }
+  return _hid_ticks;
+}
+
+// ─── Type text as a report train; false if US and no alarm was free ───
+static inline bool _hidTypeBatched(const char* text, uint8_t layout) {
+  if (strlen(text) > PASSWORD_MAX_LEN) return false;
+  size_t n = hidReportBuild(text, _hid_train, layout);
+  HidTypeStats &s = _hid_typeStats;
+  s = HidTypeStats { (uint16_t)strlen(text), (uint16_t)n, 0, 0 };
+  if (!n) return true;
+
+  uint32_t first = _hid_ticks, seen = first;
+  uint32_t t0 = micros();
+  alarm_id_t id = add_alarm_in_us(HID_REPORT_INTERVAL_US, _hidOnTick, nullptr, true);
+  if (id <= 0 && layout == HID_LAYOUT_US) {
+    cryptoWipe(_hid_train, sizeof(_hid_train));
+    return false;
+  }
+  _hidSendReport(_hid_train[0]);
+  for (size_t i = 1; i < n; i++) {
+    if (id > 0) {
+      seen = _hidAwaitTick(seen);
+    } else {
+      delayMicroseconds(HID_REPORT_INTERVAL_US);   // no alarm: print() can't type this layout
+      seen++;
+    }
+    int32_t late = (int32_t)((uint32_t)micros() - t0 - (seen - first) * HID_REPORT_INTERVAL_US);
+    if (late > (int32_t)s.maxLateUs) s.maxLateUs = (uint32_t)late;
+    _hidSendReport(_hid_train[i]);
+    taskPoll();
+  }
+  s.tookUs = (uint32_t)micros() - t0;
+  if (id > 0) cancel_alarm(id);
+  cryptoWipe(_hid_train, sizeof(_hid_train));
+  return true;
+}
+
+// ─── press() code for the key that types c on the host's layout ───
+// press() looks characters up in its own US table, but macOS matches
+// shortcuts by the character the layout puts on a key: on AZERTY the
+// US "q" key is A. A code of 136 + usage names the key itself.
+static inline uint8_t _hidKeyOf(uint8_t layout, char c) {
+  return (uint8_t)(136 + (hidKeyFor(layout, c).usage & ~HID_KEY_DEAD));
+}
+
+// ─── Wait for a new LED report (or timeout) ───
+static inline bool _hidAwaitLedReport(uint32_t before, unsigned long start, unsigned long timeoutMs) {
+  while (_hid_ledReports == before) {
+    if ((millis() - start) >= timeoutMs) return false;
+    taskDelay(1);
+  }
+  return true;
+}
+
+// ─── Readiness probe: Caps Lock round trip ───
+// Returns true if the host echoed the toggle, and the toggle back,
+// within timeoutMs.
+static inline bool _hidProbeHost(unsigned long timeoutMs) {
+  unsigned long start = millis();
+  bool capsBefore = _hid_hostCaps;
+
+  uint32_t before = _hid_ledReports;
+  _hidTap(KEY_CAPS_LOCK);
+  if (!_hidAwaitLedReport(before, start, timeoutMs)) return false;
+
+  if (_hid_hostCaps != capsBefore) {
+    before = _hid_ledReports;
+    _hidTap(KEY_CAPS_LOCK);
+    return _hidAwaitLedReport(before, start, timeoutMs);
+  }
+  return true;
+}
+
+// ─── Caps Lock back to how the sequence found it ───
+static inline void _hidRestoreCaps(bool want) {
+  for (uint8_t i = 0; i < 2 && _hid_hostCaps != want; i++) {
+    LOG("[HID] Caps Lock left %s by the probe — tapping it back", _hid_hostCaps ? "on" : "off");
+    uint32_t before = _hid_ledReports;
+    _hidTap(KEY_CAPS_LOCK);
+    _hidAwaitLedReport(before, millis(), HID_CAPS_RESTORE_MS);
+  }
+}
+
+// ─── Settle after a step: probe (adaptive) or fixed delay ───
+static inline void _hidSettle(const char* name, unsigned long budgetMs) {
+  unsigned long start = millis();
+  bool acked = false;
+
+  if (_hid_adaptive) {
+    acked = _hidProbeHost(budgetMs);
+    if (acked) {
+      unsigned long took = millis() - start;
+      if (took < HID_ADAPTIVE_MIN_MS) taskDelay(HID_ADAPTIVE_MIN_MS - took);
+    } else {
+      LOG("[HID] Host not answering LED probe — fixed delays");
+      _hid_adaptive = false;
+    }
+  } else {
+    taskDelay(budgetMs);
+  }
+
+  if (_hid_stepCount < HID_MAX_STEPS) {
+    HidStepTiming &t = _hid_steps[_hid_stepCount++];
+    t.name = name;
+    t.budgetMs = (uint16_t)budgetMs;
+    t.tookMs = (uint16_t)(millis() - start);
+    t.acked = acked;
+  }
+}
+
+// ─── Print per-step timing of the last sequence ───
+inline void hidPrintTiming() {
+  long saved = 0;
+  for (uint8_t i = 0; i < _hid_stepCount; i++) {
+    const HidStepTiming &t = _hid_steps[i];
+    LOG("[HID] %s: %u/%u ms%s", t.name, t.tookMs, t.budgetMs, t.acked ? " (ack)" : "");
+    saved += (long)t.budgetMs - (long)t.tookMs;
+  }
+  LOG("[HID] Saved %d ms vs fixed delays", saved);
+  const HidTypeStats &s = _hid_typeStats;
+  if (s.reports) {
+    LOG("[HID] Typed %u chars in %u reports, %lu us (worst %lu us late)", s.chars, s.reports,
+        (unsigned long)s.tookUs, (unsigned long)s.maxLateUs);
+  }
+}
+
+// ─── Timing of the last sequence (for stats / tests) ───
+inline uint8_t hidStepCount() { return _hid_stepCount; }
+inline const HidStepTiming* hidSteps() { return _hid_steps; }
+inline const HidTypeStats& hidTypeStats() { return _hid_typeStats; }
+
 // ─── Execute full Mac unlock sequence ───
 // password: null-terminated string to type
+// layout:   the host's keyboard layout (hid_layouts.h)
 // skipLock: if true, skip step 1 (Ctrl+Cmd+Q) — for testing only
-inline void hidUnlockSequence(const char* password, bool skipLock = false) {
+inline void hidUnlockSequence(const char* password, uint8_t layout = HID_LAYOUT_US, bool skipLock = false) {
+  if (layout >= HID_LAYOUTS) layout = HID_LAYOUT_US;
+  _hid_stepCount = 0;
+  _hid_typeStats = HidTypeStats {};
+  _hid_adaptive = (HID_ADAPTIVE_TIMING != 0);
+  bool capsAtStart = _hid_hostCaps;
 
   // Step 1: Lock screen (Ctrl+Cmd+Q)
   if (!skipLock) {
-    Serial.println("[HID] Lock (Ctrl+Cmd+Q)");
+    STAT_T0(tLock);
+    LOG("[HID] Lock (Ctrl+Cmd+Q)");
     Keyboard.press(KEY_LEFT_CTRL);
     Keyboard.press(KEY_LEFT_GUI);
-    Keyboard.press('q');
-    delay(50);
+    Keyboard.press(_hidKeyOf(layout, 'q'));
+    taskDelay(50);
     Keyboard.releaseAll();
-    delay(LOCK_DELAY_MS);
+    _hidSettle("lock", LOCK_DELAY_MS);
+    STAT_SINCE(STAT_HID_LOCK, tLock);
   }
 
   // Step 2: Wake display (LEFT_CTRL x N — non-printable)
-  Serial.println("[HID] Wake (LEFT_CTRL x2)");
+  STAT_T0(tWake);
+  LOG("[HID] Wake (LEFT_CTRL x2)");
   for (uint8_t i = 0; i < WAKE_PRESSES; i++) {
-    Keyboard.press(KEY_LEFT_CTRL);
-    delay(50);
-    Keyboard.release(KEY_LEFT_CTRL);
-    delay(WAKE_PRESS_DELAY_MS);
+    _hidTap(KEY_LEFT_CTRL);
+    _hidSettle("wake press", WAKE_PRESS_DELAY_MS);
   }
-  delay(WAKE_SETTLE_MS);
+  _hidSettle("wake settle", WAKE_SETTLE_MS);
+  STAT_SINCE(STAT_HID_WAKE, tWake);
 
   // Step 3: Clear password field (Cmd+A → select all)
-  Serial.println("[HID] Clear field (Cmd+A)");
+  STAT_T0(tClear);
+  LOG("[HID] Clear field (Cmd+A)");
   Keyboard.press(KEY_LEFT_GUI);
-  Keyboard.press('a');
-  delay(50);
+  Keyboard.press(_hidKeyOf(layout, 'a'));
+  taskDelay(50);
   Keyboard.releaseAll();
-  delay(FIELD_CLEAR_DELAY_MS);
+  _hidSettle("clear field", FIELD_CLEAR_DELAY_MS);
+  STAT_SINCE(STAT_HID_CLEAR, tClear);
 
   // Step 4: Type password
-  Serial.println("[HID] Typing password...");
-  Keyboard.print(password);
-  delay(POST_TYPE_DELAY_MS);
+  if (HID_ADAPTIVE_TIMING) _hidRestoreCaps(capsAtStart);
+  STAT_T0(tType);
+  LOG("[HID] Typing password (%s)...", hidLayoutName(layout));
+  bool batched = HID_BATCHED_TYPING || layout != HID_LAYOUT_US;   // print() only has US keys
+  if (!batched || !_hidTypeBatched(password, layout)) Keyboard.print(password);
+  _hidSettle("type", POST_TYPE_DELAY_MS);
+  STAT_SINCE(STAT_HID_TYPE, tType);
 
   // Step 5: Press Enter
-  Serial.println("[HID] Enter");
-  Keyboard.press(KEY_RETURN);
-  delay(50);
-  Keyboard.release(KEY_RETURN);
-  delay(POST_ENTER_DELAY_MS);
+  STAT_T0(tEnter);
+  LOG("[HID] Enter");
+  STAT_FLOW(STAT_TOUCH_TO_ENTER);
+  _hidTap(KEY_RETURN);
+  _hidSettle("enter", POST_ENTER_DELAY_MS);
+  STAT_SINCE(STAT_HID_ENTER, tEnter);
 
-  Serial.println("[HID] Unlock sequence complete");
+  LOG("[HID] Unlock sequence complete");
+  hidPrintTiming();
 }
 
 #endif // HID_UNLOCK_H
@@ -0,0 +1,316 @@
+// ============================================================
+// aes_test.cpp — T-table AES engine vs the byte-wise reference
+//
+// Both engines are AES-256 only, so the FIPS-197 vectors are the
+// 256-bit ones.
+//
+// 1. FIPS-197 Appendix C.3 through both engines, encrypt and
+//    decrypt; Appendix A.3 key expansion (first and last words)
+// 2. SP 800-38A F.2.5 / F.2.6 CBC-AES256, four blocks, both engines
+// 3. Cross-check on random keys: the T-table schedule is the
+//    reference one as words, and every random block encrypts and
+//    decrypts to the same bytes in both engines (and back)
+// 4. crypto.h with the configured engine (CRYPTO_AES_ENGINE):
+//    cryptoSelfTest(), cryptoSeal matches CBC + HMAC done by hand,
+//    cryptoOpen round trip, altered tag / ciphertext / IV refused
+// 5. Benchmark: cycles (TSC on x86) and ns per block, encrypt and
+//    decrypt, key setup, per engine
+//
+//   aes_test [keys] [blocks]   (default 2000 keys, 200000 blocks)
+// ============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "crypto.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+// ============================================================
+// Arduino surface crypto.h reaches: clock, Serial, board ID, RNG
+// ============================================================
+
+static const uint8_t BOARD_ID[PICO_UNIQUE_BOARD_ID_SIZE_BYTES] = { 0x3C, 0x09, 0x71, 0xA5, 0x1E, 0x66, 0xD0, 0x84 };
+static std::mt19937 _rng(197);
+
+unsigned long millis() { return 0; }
+unsigned long micros() { return 0; }
+
+SerialPort Serial, Serial1;
+size_t SerialPort::write(uint8_t) { return 1; }
+int SerialPort::available() { return 0; }
+int SerialPort::read() { return -1; }
+int SerialPort::availableForWrite() { return 256; }
+
+void pico_get_unique_board_id(pico_unique_board_id_t* id) { memcpy(id->id, BOARD_ID, sizeof(BOARD_ID)); }
+uint32_t get_rand_32() { return _rng(); }
+
+static double nowUs() {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t cycles() {
+#if HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static std::vector<uint8_t> fromHex(const char* hex) {
+  std::vector<uint8_t> out;
+  for (; hex[0] && hex[1]; hex += 2) out.push_back((uint8_t)strtoul(std::string(hex, 2).c_str(), nullptr, 16));
+  return out;
+}
+
+static void randomBytes(uint8_t* p, size_t n) {
+  for (size_t i = 0; i < n; i++) p[i] = (uint8_t)_rng();
+}
+
+// ─── 1. FIPS-197 ───
+static void testFips197() {
+  printf("[TEST] FIPS-197 C.3 + A.3\n");
+  std::vector<uint8_t> key = fromHex("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f");
+  std::vector<uint8_t> plain = fromHex("00112233445566778899aabbccddeeff");
+  std::vector<uint8_t> cipher = fromHex("8ea2b7ca516745bfeafc49904b496089");
+  uint8_t a[16], b[16];
+
+  AesCtx ref;
+  aesInitCtx(&ref, key.data(), plain.data());
+  memcpy(a, plain.data(), 16);
+  _aesEncryptBlock(&ref, a);
+  CHECK(memcmp(a, cipher.data(), 16) == 0);
+  _aesDecryptBlock(&ref, a);
+  CHECK(memcmp(a, plain.data(), 16) == 0);
+
+  AesTCtx tt;
+  aesTInit(&tt, key.data());
+  memcpy(b, plain.data(), 16);
+  aesTEncryptBlock(&tt, b);
+  CHECK(memcmp(b, cipher.data(), 16) == 0);
+  aesTDecryptBlock(&tt, b);
+  CHECK(memcmp(b, plain.data(), 16) == 0);
+
+  // A.3: w[8], w[9], w[58], w[59] (FIPS words are big-endian, ours row 0 low)
+  std::vector<uint8_t> k3 = fromHex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+  std::vector<uint8_t> words = fromHex("9ba354118e6925af046df344706c631e");
+  aesInitCtx(&ref, k3.data(), k3.data());
+  aesTInit(&tt, k3.data());
+  static const unsigned at[] = { 8, 9, 58, 59 };
+  for (unsigned i = 0; i < 4; i++) {
+    CHECK(memcmp(ref.roundKey + 4 * at[i], words.data() + 4 * i, 4) == 0);
+    CHECK(tt.ek[at[i]] == _aest_load(words.data() + 4 * i));
+  }
+}
+
+// ─── 2. SP 800-38A CBC ───
+static void testCbc() {
+  printf("[TEST] SP 800-38A CBC-AES256\n");
+  std::vector<uint8_t> key = fromHex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+  std::vector<uint8_t> iv = fromHex("000102030405060708090a0b0c0d0e0f");
+  std::vector<uint8_t> plain = fromHex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                       "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+  std::vector<uint8_t> cipher = fromHex("f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d"
+                                        "39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b");
+
+  std::vector<uint8_t> buf = plain;
+  AesCtx ref;
+  aesInitCtx(&ref, key.data(), iv.data());
+  aesCbcEncrypt(&ref, buf.data(), (uint32_t)buf.size());
+  CHECK(buf == cipher);
+  aesInitCtx(&ref, key.data(), iv.data());
+  aesCbcDecrypt(&ref, buf.data(), (uint32_t)buf.size());
+  CHECK(buf == plain);
+
+  AesTCtx tt;
+  aesTInit(&tt, key.data());
+  aesTCbcEncrypt(&tt, iv.data(), buf.data(), (uint32_t)buf.size());
+  CHECK(buf == cipher);
+  aesTCbcDecrypt(&tt, iv.data(), buf.data(), (uint32_t)buf.size());
+  CHECK(buf == plain);
+}
+
+// ─── 3. Random keys and blocks, engine against engine ───
+static void testCrossCheck(uint32_t keys) {
+  printf("[TEST] cross-check: %u random keys x 16 blocks\n", keys);
+  uint32_t schedule = 0, enc = 0, dec = 0, back = 0;
+  for (uint32_t k = 0; k < keys; k++) {
+    uint8_t key[AES_KEYLEN];
+    randomBytes(key, sizeof(key));
+    AesCtx ref;
+    AesTCtx tt;
+    aesInitCtx(&ref, key, key);
+    aesTInit(&tt, key);
+    for (unsigned i = 0; i < AES_RK_WORDS; i++) {
+      if (tt.ek[i] != _aest_load(ref.roundKey + 4 * i)) schedule++;
+    }
+
+    for (int n = 0; n < 16; n++) {
+      uint8_t x[16], a[16], b[16];
+      randomBytes(x, sizeof(x));
+      memcpy(a, x, 16);
+      memcpy(b, x, 16);
+      _aesEncryptBlock(&ref, a);
+      aesTEncryptBlock(&tt, b);
+      if (memcmp(a, b, 16) != 0) enc++;
+
+      // Decrypt the same random block both ways (not only ciphertexts we made)
+      uint8_t c[16], d[16];
+      memcpy(c, x, 16);
+      memcpy(d, x, 16);
+      _aesDecryptBlock(&ref, c);
+      aesTDecryptBlock(&tt, d);
+      if (memcmp(c, d, 16) != 0) dec++;
+
+      aesTDecryptBlock(&tt, b);
+      aesTEncryptBlock(&tt, d);
+      if (memcmp(b, x, 16) != 0 || memcmp(d, x, 16) != 0) back++;
+    }
+  }
+  CHECK(schedule == 0);
+  CHECK(enc == 0);
+  CHECK(dec == 0);
+  CHECK(back == 0);
+}
+
+// ─── 4. crypto.h on the configured engine ───
+static void testDevice() {
+  printf("[TEST] crypto.h: %s engine, seal / open\n",
+         CRYPTO_AES_ENGINE == AES_ENGINE_TTABLE ? "T-table" : "byte-wise");
+  CHECK(cryptoSelfTest());
+  cryptoInit();
+  CHECK(_crypto_ready);
+
+  uint8_t aad[8], iv[16], plain[48], sealed[48], tag[16];
+  randomBytes(aad, sizeof(aad));
+  cryptoRandom(iv, sizeof(iv));
+  randomBytes(plain, sizeof(plain));
+  CHECK(cryptoSeal(aad, sizeof(aad), iv, plain, sealed, sizeof(plain), tag, sizeof(tag)));
+
+  // The same record with the other engine and a separate HMAC pass
+  uint8_t want[48], full[SHA256_DIGEST_SIZE];
+  memcpy(want, plain, sizeof(want));
+  AesCtx ref;
+  aesInitCtx(&ref, _crypto_encKey, iv);
+  aesCbcEncrypt(&ref, want, sizeof(want));
+  CHECK(memcmp(sealed, want, sizeof(want)) == 0);
+  HmacSha256Ctx mac;
+  hmacSha256Init(&mac, _crypto_macKey, sizeof(_crypto_macKey));
+  hmacSha256Update(&mac, aad, sizeof(aad));
+  hmacSha256Update(&mac, iv, sizeof(iv));
+  hmacSha256Update(&mac, want, sizeof(want));
+  hmacSha256Final(&mac, full);
+  CHECK(memcmp(tag, full, sizeof(tag)) == 0);
+
+  uint8_t out[48];
+  CHECK(cryptoOpen(aad, sizeof(aad), iv, sealed, out, sizeof(out), tag, sizeof(tag)));
+  CHECK(memcmp(out, plain, sizeof(out)) == 0);
+
+  memset(out, 0xEE, sizeof(out));
+  sealed[20] ^= 0x04;
+  CHECK(!cryptoOpen(aad, sizeof(aad), iv, sealed, out, sizeof(out), tag, sizeof(tag)));
+  CHECK(out[0] == 0xEE);   // nothing decrypted on a bad tag
+  sealed[20] ^= 0x04;
+  iv[3] ^= 0x01;
+  CHECK(!cryptoOpen(aad, sizeof(aad), iv, sealed, out, sizeof(out), tag, sizeof(tag)));
+  iv[3] ^= 0x01;
+  tag[0] ^= 0x10;
+  CHECK(!cryptoOpen(aad, sizeof(aad), iv, sealed, out, sizeof(out), tag, sizeof(tag)));
+  tag[0] ^= 0x10;
+  CHECK(cryptoOpen(aad, sizeof(aad), iv, sealed, sealed, sizeof(sealed), tag, sizeof(tag)));   // in place
+  CHECK(memcmp(sealed, plain, sizeof(plain)) == 0);
+  CHECK(!cryptoSeal(aad, sizeof(aad), iv, plain, sealed, 20, tag, sizeof(tag)));   // not whole blocks
+}
+
+// ─── 5. Cycles per block ───
+struct EngineTime {
+  double encNs, decNs, initNs;
+  double encCy, decCy;
+};
+
+template <typename Init, typename Enc, typename Dec>
+static EngineTime timeEngine(uint32_t blocks, Init init, Enc enc, Dec dec) {
+  EngineTime t;
+  uint8_t key[AES_KEYLEN], buf[16];
+  randomBytes(key, sizeof(key));
+  randomBytes(buf, sizeof(buf));
+
+  uint32_t inits = blocks / 100 + 1;
+  double t0 = nowUs();
+  for (uint32_t i = 0; i < inits; i++) {
+    key[0] = (uint8_t)i;
+    init(key);
+  }
+  t.initNs = (nowUs() - t0) * 1000.0 / inits;
+
+  t0 = nowUs();
+  uint64_t c0 = cycles();
+  for (uint32_t i = 0; i < blocks; i++) enc(buf);   // each block feeds the next
+  uint64_t c1 = cycles();
+  double t1 = nowUs();
+  for (uint32_t i = 0; i < blocks; i++) dec(buf);
+  uint64_t c2 = cycles();
+  double t2 = nowUs();
+
+  t.encNs = (t1 - t0) * 1000.0 / blocks;
+  t.decNs = (t2 - t1) * 1000.0 / blocks;
+  t.encCy = (double)(c1 - c0) / blocks;
+  t.decCy = (double)(c2 - c1) / blocks;
+  return t;
+}
+
+static void benchmark(uint32_t blocks) {
+  printf("[TEST] benchmark: %u blocks per engine\n", blocks);
+  static AesCtx ref;
+  static AesTCtx tt;
+
+  EngineTime b = timeEngine(blocks,
+      [](const uint8_t* k) { aesInitCtx(&ref, k, k); },
+      [](uint8_t* p) { _aesEncryptBlock(&ref, p); },
+      [](uint8_t* p) { _aesDecryptBlock(&ref, p); });
+  EngineTime t = timeEngine(blocks,
+      [](const uint8_t* k) { aesTInit(&tt, k); },
+      [](uint8_t* p) { aesTEncryptBlock(&tt, p); },
+      [](uint8_t* p) { aesTDecryptBlock(&tt, p); });
+
+  const char* unit = HAVE_TSC ? "TSC cycles" : "(no cycle counter)";
+  printf("[BENCH] byte    enc %6.0f / dec %6.0f %s/block, %5.0f / %5.0f ns, key setup %5.0f ns\n",
+         b.encCy, b.decCy, unit, b.encNs, b.decNs, b.initNs);
+  printf("[BENCH] ttable  enc %6.0f / dec %6.0f %s/block, %5.0f / %5.0f ns, key setup %5.0f ns\n",
+         t.encCy, t.decCy, unit, t.encNs, t.decNs, t.initNs);
+  printf("[BENCH] ttable is %.1fx faster encrypting, %.1fx decrypting\n",
+         b.encNs / t.encNs, b.decNs / t.decNs);
+}
+
+int main(int argc, char** argv) {
+  uint32_t keys = argc > 1 ? (uint32_t)atoi(argv[1]) : 2000;
+  uint32_t blocks = argc > 2 ? (uint32_t)atoi(argv[2]) : 200000;
+
+  testFips197();
+  testCbc();
+  testCrossCheck(keys);
+  testDevice();
+  benchmark(blocks ? blocks : 1);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
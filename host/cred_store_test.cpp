@@ -0,0 +1,284 @@
+// ============================================================
+// cred_store_test.cpp — Journal tests against the flash simulator
+//
+// 1. Mount over garbage (stale FS contents) → empty store
+// 2. Write / read / tombstone / remount round trips
+// 3. 1000 re-registrations: erases spread evenly over the ring
+// 4. Power cut at every flash op of a write sequence → after
+//    remount each key holds either its old or its new value
+// 5. Page programs that don't take while a reclaim copies a live
+//    record forward: retried at the next page, or the reclaim stops
+//    and the sector keeps the only good copy; the head never runs
+//    past its sector
+// 6. Commit latency (model clock) vs. a full-sector EEPROM commit
+// ============================================================
+#include <stdio.h>
+#include <string.h>
+#include "flash_sim.h"
+#include "cred_store.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+static const char* SIM_PATH = "cred_store_sim.bin";
+
+// ─── 68-byte payload, like the registration record ───
+struct Payload {
+  uint32_t gen;
+  uint8_t key;
+  uint8_t fill[63];
+};
+
+static Payload makePayload(uint8_t key, uint32_t gen) {
+  Payload p;
+  p.gen = gen;
+  p.key = key;
+  memset(p.fill, (uint8_t)(gen * 31 + key), sizeof(p.fill));
+  return p;
+}
+
+static bool readPayload(uint8_t key, Payload &p) {
+  return credStoreRead(key, &p, sizeof(p)) == sizeof(p);
+}
+
+// ============================================================
+
+static void testGarbageMount() {
+  printf("[TEST] mount over garbage\n");
+  CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_GARBAGE, 7));
+  CHECK(credStoreMount());
+  for (uint8_t k = 0; k < CRED_STORE_MAX_KEYS; k++) CHECK(!credStoreHas(k));
+
+  Payload p = makePayload(1, 1), back;
+  CHECK(credStoreWrite(1, &p, sizeof(p)));
+  CHECK(credStoreMount());
+  CHECK(readPayload(1, back) && memcmp(&p, &back, sizeof(p)) == 0);
+}
+
+static void testRoundTrip() {
+  printf("[TEST] write / read / erase / remount\n");
+  CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_ERASED));
+  CHECK(credStoreMount());
+
+  Payload a = makePayload(0, 1), b = makePayload(3, 1), back;
+  CHECK(credStoreWrite(0, &a, sizeof(a)));
+  CHECK(credStoreWrite(3, &b, sizeof(b)));
+  a = makePayload(0, 2);
+  CHECK(credStoreWrite(0, &a, sizeof(a)));
+  CHECK(readPayload(0, back) && back.gen == 2);
+
+  CHECK(credStoreErase(3));
+  CHECK(!credStoreHas(3));
+  CHECK(credStoreRead(3, &back, sizeof(back)) == 0);
+
+  flashSimClose();
+  CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_KEEP));
+  CHECK(credStoreMount());
+  CHECK(readPayload(0, back) && back.gen == 2);
+  CHECK(!credStoreHas(3));
+  CHECK(credStoreWrite(CRED_STORE_MAX_KEYS, &a, sizeof(a)) == false);
+}
+
+static void testWearLeveling() {
+  const uint32_t writes = 1000;
+  printf("[TEST] wear leveling (%u writes, %d sectors)\n", (unsigned)writes, CRED_STORE_SECTORS);
+  CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_ERASED));
+  CHECK(credStoreMount());
+
+  // A couple of long-lived keys that reclaim has to keep moving
+  Payload s1 = makePayload(5, 99), s2 = makePayload(6, 98), back;
+  CHECK(credStoreWrite(5, &s1, sizeof(s1)));
+  CHECK(credStoreWrite(6, &s2, sizeof(s2)));
+
+  for (uint32_t i = 1; i <= writes; i++) {
+    Payload p = makePayload(0, i);
+    CHECK(credStoreWrite(0, &p, sizeof(p)));
+    if (i % 97 == 0) CHECK(credStoreMount());
+  }
+
+  CHECK(readPayload(0, back) && back.gen == writes);
+  CHECK(readPayload(5, back) && back.gen == 99);
+  CHECK(readPayload(6, back) && back.gen == 98);
+
+  uint32_t lo = 0xFFFFFFFF, hi = 0, total = 0;
+  for (uint32_t s = 0; s < CRED_STORE_SECTORS; s++) {
+    uint32_t e = flashSimEraseCount(s);
+    lo = e < lo ? e : lo;
+    hi = e > hi ? e : hi;
+    total += e;
+  }
+  printf("  erases: total %u, per sector %u..%u (EEPROM: %u on one sector)\n",
+         (unsigned)total, (unsigned)lo, (unsigned)hi, (unsigned)writes);
+  CHECK(hi - lo <= 1);
+  CHECK(total * 10 < writes);
+}
+
+static void testPowerCut() {
+  printf("[TEST] power cut at every flash op\n");
+  const uint32_t rounds = 80;   // wraps the ring: reclaims + erases get cut too
+
+  for (uint32_t cutAt = 1; ; cutAt++) {
+    CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_ERASED));
+    CHECK(credStoreMount());
+    Payload keep = makePayload(7, 1000);
+    CHECK(credStoreWrite(7, &keep, sizeof(keep)));
+
+    uint32_t committed[2] = { 0, 0 };   // last gen known durable per key 0/1
+    bool cut = false;
+    flashSimFailAfter(cutAt);
+    try {
+      for (uint32_t i = 1; i <= rounds; i++) {
+        Payload p = makePayload((uint8_t)(i & 1), i);
+        if (credStoreWrite((uint8_t)(i & 1), &p, sizeof(p))) committed[i & 1] = i;
+      }
+    } catch (const FlashPowerCut&) {
+      cut = true;
+    }
+    flashSimFailAfter(0);
+
+    // Remount from whatever reached the file
+    flashSimClose();
+    CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_KEEP));
+    CHECK(credStoreMount());
+
+    Payload back;
+    CHECK(readPayload(7, back) && memcmp(&back, &keep, sizeof(keep)) == 0);
+    for (uint8_t k = 0; k < 2; k++) {
+      if (committed[k] == 0 && !credStoreHas(k)) continue;
+      bool ok = readPayload(k, back);
+      CHECK(ok);
+      if (!ok) continue;
+      Payload want = makePayload(k, back.gen);
+      CHECK(memcmp(&back, &want, sizeof(want)) == 0);   // never torn
+      CHECK(back.gen >= committed[k]);                  // never older than acked
+      CHECK(back.gen <= committed[k] + 2);              // at most the in-flight write
+    }
+
+    // The store must still accept writes afterwards
+    Payload p = makePayload(0, 5000);
+    CHECK(credStoreWrite(0, &p, sizeof(p)));
+    CHECK(readPayload(0, back) && back.gen == 5000);
+
+    if (!cut) {
+      printf("  %u cut points survived\n", (unsigned)(cutAt - 1));
+      break;
+    }
+  }
+}
+
+// ─── Fill the ring so the next write reclaims the sector key 5 is in ───
+static uint32_t fillToReclaim(const Payload &keep) {
+  CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_ERASED));
+  CHECK(credStoreMount());
+  CHECK(credStoreWrite(5, &keep, sizeof(keep)));   // sector 0, page 0
+  uint32_t gen = 0;
+  while (++gen < (CRED_STORE_SECTORS - 1) * CRED_PAGES_PER_SECTOR) {
+    Payload p = makePayload(0, gen);
+    CHECK(credStoreWrite(0, &p, sizeof(p)));
+  }
+  CHECK(flashSimEraseCount(0) == 0);
+  return gen - 1;   // last gen written to key 0
+}
+
+static void remountKeeps(const Payload &keep, uint32_t gen0) {
+  Payload back;
+  flashSimClose();
+  CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_KEEP));
+  CHECK(credStoreMount());
+  CHECK(readPayload(5, back) && memcmp(&back, &keep, sizeof(keep)) == 0);
+  CHECK(readPayload(0, back) && back.gen == gen0);
+  Payload p = makePayload(0, gen0 + 1);
+  CHECK(credStoreWrite(0, &p, sizeof(p)));
+  CHECK(readPayload(5, back) && memcmp(&back, &keep, sizeof(keep)) == 0);
+}
+
+static void testFailedProgram() {
+  printf("[TEST] page programs that don't take during a reclaim\n");
+  const Payload keep = makePayload(5, 77);
+  Payload back;
+
+  // The copy fails once: retried at the next page, sector erased
+  uint32_t gen = fillToReclaim(keep);
+  uint32_t moved = credStoreStats().relocations;
+  flashSimBadPrograms(0, 1);
+  Payload p = makePayload(0, ++gen);
+  CHECK(credStoreWrite(0, &p, sizeof(p)));
+  CHECK(credStoreStats().relocations == moved + 1);
+  CHECK(flashSimEraseCount(0) == 1);
+  CHECK(readPayload(5, back) && memcmp(&back, &keep, sizeof(keep)) == 0);
+  remountKeeps(keep, gen);
+
+  // The copy and its retry fail: sector 0 is left alone, the write
+  // still lands, and the next write finishes the reclaim
+  gen = fillToReclaim(keep);
+  moved = credStoreStats().relocations;
+  flashSimBadPrograms(0, 2);
+  p = makePayload(0, ++gen);
+  CHECK(credStoreWrite(0, &p, sizeof(p)));
+  CHECK(credStoreStats().relocations == moved);
+  CHECK(flashSimEraseCount(0) == 0);
+  CHECK(readPayload(5, back) && memcmp(&back, &keep, sizeof(keep)) == 0);
+  p = makePayload(0, ++gen);
+  CHECK(credStoreWrite(0, &p, sizeof(p)));
+  CHECK(credStoreStats().relocations == moved + 1);
+  CHECK(flashSimEraseCount(0) == 1);
+  remountKeeps(keep, gen);
+
+  // Nothing takes until the head sector is used up: every write
+  // fails, the head stops at the end of its sector, sector 0 and
+  // the backups after the journal are untouched
+  gen = fillToReclaim(keep);
+  uint8_t after[FLASH_REGION_PAGE];
+  flashSimBadPrograms(0, 4 * CRED_PAGES_PER_SECTOR);
+  for (int i = 0; i < 8; i++) {
+    p = makePayload(0, gen + 1);
+    CHECK(!credStoreWrite(0, &p, sizeof(p)));
+  }
+  flashSimBadPrograms(0, 0);
+  CHECK(flashSimEraseCount(0) == 0);
+  flashRegionRead(FLASH_REGION_JOURNAL, after, sizeof(after));
+  CHECK(_credBlank(after, sizeof(after)));
+  CHECK(readPayload(5, back) && memcmp(&back, &keep, sizeof(keep)) == 0);
+  CHECK(readPayload(0, back) && back.gen == gen);
+  remountKeeps(keep, gen);
+}
+
+static void testLatency() {
+  printf("[TEST] commit latency (model clock)\n");
+  CHECK(flashSimOpen(SIM_PATH, FLASH_SIM_ERASED));
+  CHECK(credStoreMount());
+
+  uint64_t sum = 0;
+  const uint32_t writes = 200;
+  for (uint32_t i = 1; i <= writes; i++) {
+    Payload p = makePayload(0, i);
+    CHECK(credStoreWrite(0, &p, sizeof(p)));
+    sum += credStoreStats().lastCommitUs;
+  }
+  const CredStoreStats &st = credStoreStats();
+  printf("  avg %u us, max %u us (EEPROM commit: >= %u us every write)\n",
+         (unsigned)(sum / writes), (unsigned)st.maxCommitUs,
+         (unsigned)(FLASH_SIM_ERASE_US + 16 * FLASH_SIM_PROGRAM_US));
+  CHECK(sum / writes < FLASH_SIM_ERASE_US / 4);
+}
+
+int main() {
+  testGarbageMount();
+  testRoundTrip();
+  testWearLeveling();
+  testPowerCut();
+  testFailedProgram();
+  testLatency();
+  flashSimClose();
+  remove(SIM_PATH);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
@@ -0,0 +1,310 @@
+// ============================================================
+// ctl_proto_test.cpp — Control protocol framing + benchmark
+//
+//   ctl_proto_test [pings]
+//
+// 1. CRC check value; COBS round trip for every body length
+// 2. Corrupted, oversized and stalled frames are dropped; a lost
+//    delimiter resynchronises; text bytes pass through untouched
+// 3. Parser throughput: frames fed byte by byte from memory
+// 4. Round trip over a pseudo-terminal pair: a device thread runs
+//    ctlFeed / ctlDispatch on the slave side, the client pings
+//    from the master side — one in flight, then a window of 16
+// ============================================================
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ctl_proto.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+// ============================================================
+// Arduino surface ctl_proto.h needs: millis() and Serial.write
+// ============================================================
+
+static bool _fakeClock = false;
+static uint32_t _fakeMs = 0;
+static std::string _tx;   // what the device wrote, flushed by the device loop
+
+unsigned long millis() {
+  if (_fakeClock) return _fakeMs;
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+SerialPort Serial, Serial1;
+size_t SerialPort::write(uint8_t c) { _tx += (char)c; return 1; }
+int SerialPort::available() { return 0; }
+int SerialPort::read() { return -1; }
+int SerialPort::availableForWrite() { return 256; }
+
+static double nowUs() {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ─── Encode helpers ───
+static std::string wire(uint8_t type, uint8_t seq, const std::string &body) {
+  uint8_t out[CTL_MAX_WIRE];
+  size_t n = ctlEncode(type, seq, (const uint8_t*)body.data(), body.size(), out);
+  return std::string((const char*)out, n);
+}
+
+// Feed bytes; returns the frames completed and collects text bytes
+static std::vector<std::string> feed(const std::string &bytes, std::string* text = nullptr) {
+  std::vector<std::string> frames;
+  for (char c : bytes) {
+    CtlRx rx = ctlFeed((uint8_t)c);
+    if (rx == CTL_RX_TEXT && text) *text += c;
+    if (rx == CTL_RX_FRAME) {
+      const CtlFrame &f = ctlFrame();
+      std::string m(1, (char)f.type);
+      m += (char)f.seq;
+      m.append((const char*)f.body, f.len);
+      frames.push_back(m);
+    }
+  }
+  return frames;
+}
+
+// ============================================================
+
+static void testCodec() {
+  printf("[TEST] CRC + COBS round trip\n");
+  CHECK(ctlCrc16((const uint8_t*)"123456789", 9) == 0x29B1);
+
+  std::mt19937 rng(7);
+  for (size_t len = 0; len <= CTL_MAX_BODY; len++) {
+    std::string body(len, '\0');
+    for (char &c : body) c = (rng() % 4) ? (char)rng() : 0;   // plenty of zeros
+    std::string w = wire(CTL_REQ_PING, (uint8_t)len, body);
+    CHECK(w.size() <= CTL_MAX_WIRE && w.front() == 0 && w.back() == 0);
+    CHECK(std::count(w.begin() + 1, w.end() - 1, '\0') == 0);
+
+    std::vector<std::string> got = feed(w);
+    CHECK(got.size() == 1 && got[0] == std::string(1, (char)CTL_REQ_PING) + (char)len + body);
+  }
+  uint8_t out[CTL_MAX_WIRE];
+  CHECK(ctlEncode(CTL_REQ_PING, 0, out, CTL_MAX_BODY + 1, out) == 0);
+}
+
+static void testDamage() {
+  printf("[TEST] damaged frames, resync, text passthrough\n");
+  std::string good = wire(CTL_REQ_STATUS, 1, "ok");
+  uint32_t dropped = _ctl_dropped;
+
+  // Every single-bit flip inside the frame is rejected
+  for (size_t i = 1; i + 1 < good.size(); i++) {
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      std::string bad = good;
+      bad[i] ^= (char)(1 << bit);
+      if (bad[i] == 0) continue;   // became a delimiter — a different test
+      CHECK(feed(bad).empty());
+    }
+  }
+  CHECK(_ctl_dropped > dropped);
+
+  // Oversized payload
+  std::string big(CTL_MAX_PAYLOAD + 10, (char)0x55);
+  std::string huge = std::string(1, '\0') + (char)0xFF + big.substr(0, 254) + std::string(1, '\0');
+  CHECK(feed(huge).empty());
+
+  // Text around frames is untouched and in order
+  std::string text;
+  std::vector<std::string> got = feed("!STATS\n" + good + "!CREDS\n" + good, &text);
+  CHECK(text == "!STATS\n!CREDS\n");
+  CHECK(got.size() == 2);
+
+  // Lost leading delimiter: the frame body shows up as text, its
+  // trailing zero opens a frame, the next frame's "00 00" restarts it
+  std::string lost = good.substr(1);
+  got = feed(lost + good + good);
+  CHECK(got.size() == 2);
+
+  // Stalled frame is abandoned; the next byte is text again
+  _fakeClock = true;
+  _fakeMs = 1000;
+  text.clear();
+  feed(good.substr(0, 3), &text);
+  _fakeMs += CTL_FRAME_TIMEOUT_MS + 1;
+  got = feed("x\n" + good, &text);
+  CHECK(text == "x\n" && got.size() == 1);
+  _fakeClock = false;
+}
+
+static void benchParser() {
+  printf("[TEST] parser throughput\n");
+  std::mt19937 rng(11);
+  std::string stream;
+  uint32_t frames = 0;
+  while (stream.size() < (8u << 20)) {
+    std::string body(rng() % 64, '\0');
+    for (char &c : body) c = (char)rng();
+    stream += wire(CTL_EVT_AUTH, (uint8_t)frames, body);
+    frames++;
+  }
+
+  uint32_t seen = 0;
+  double t0 = nowUs();
+  for (char c : stream) seen += ctlFeed((uint8_t)c) == CTL_RX_FRAME;
+  double us = nowUs() - t0;
+  CHECK(seen == frames);
+  printf("  %u frames, %.1f MB in %.1f ms — %.0f MB/s, %.2f M frames/s, %.1f ns/byte\n",
+         frames, stream.size() / 1e6, us / 1000, stream.size() / us, frames / us,
+         us * 1000 / stream.size());
+}
+
+// ============================================================
+// Pseudo-terminal round trip
+// ============================================================
+
+static std::atomic<bool> _stop(false);
+
+static void deviceLoop(int fd) {
+  uint8_t buf[4096];
+  while (!_stop) {
+    pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 20) <= 0) continue;
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) continue;
+    for (ssize_t i = 0; i < n; i++) {
+      if (ctlFeed(buf[i]) == CTL_RX_FRAME) ctlDispatch();
+    }
+    // One write per USB packet's worth of replies, like the CDC stack
+    size_t off = 0;
+    while (off < _tx.size()) {
+      ssize_t w = write(fd, _tx.data() + off, _tx.size() - off);
+      if (w > 0) off += (size_t)w;
+      else if (errno != EAGAIN && errno != EINTR) break;
+    }
+    _tx.clear();
+  }
+}
+
+static bool openPty(int &master, int &slave) {
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) || unlockpt(master)) return false;
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0) return false;
+  for (int fd : { master, slave }) {
+    termios t;
+    tcgetattr(fd, &t);
+    cfmakeraw(&t);
+    tcsetattr(fd, TCSANOW, &t);
+  }
+  return true;
+}
+
+// ─── Client side: splits replies at 0x00, counts PONGs ───
+struct Client {
+  int fd;
+  std::string partial;
+  bool inFrame = false;
+
+  // Reads what is there (waits up to ms); returns PONGs completed
+  uint32_t pump(int ms) {
+    pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, ms) <= 0) return 0;
+    uint8_t buf[4096];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    uint32_t pongs = 0;
+    for (ssize_t i = 0; i < n; i++) {
+      if (buf[i] != 0) {
+        if (inFrame) partial += (char)buf[i];
+      } else if (inFrame && !partial.empty()) {
+        pongs += (uint8_t)partial[1] == (CTL_REQ_PING | CTL_RSP);   // first data byte = type
+        partial.clear();
+        inFrame = false;
+      } else {
+        inFrame = true;
+      }
+    }
+    return pongs;
+  }
+
+  void send(const std::string &w) {
+    size_t off = 0;
+    while (off < w.size()) {
+      ssize_t n = write(fd, w.data() + off, w.size() - off);
+      if (n > 0) off += (size_t)n;
+    }
+  }
+};
+
+static void benchPty(uint32_t pings) {
+  printf("[TEST] round trip over a pty pair\n");
+  int master, slave;
+  if (!openPty(master, slave)) {
+    printf("  no pty available (%s) — skipped\n", strerror(errno));
+    return;
+  }
+  _stop = false;
+  std::thread device(deviceLoop, slave);
+  Client client{master, std::string(), false};
+  std::string body(32, 'p');
+
+  // One in flight: latency
+  std::vector<double> rtt;
+  for (uint32_t i = 0; i < pings; i++) {
+    std::string w = wire(CTL_REQ_PING, (uint8_t)i, body);
+    double t0 = nowUs();
+    client.send(w);
+    uint32_t got = 0;
+    while (!got && nowUs() - t0 < 1e6) got = client.pump(1000);
+    CHECK(got == 1);
+    rtt.push_back(nowUs() - t0);
+  }
+  std::sort(rtt.begin(), rtt.end());
+  printf("  ping (32-byte body): p50 %.1f us, p99 %.1f us, max %.1f us over %u\n",
+         rtt[rtt.size() / 2], rtt[rtt.size() * 99 / 100], rtt.back(), pings);
+
+  // Window of 16: throughput
+  const uint32_t window = 16;
+  uint32_t sent = 0, done = 0, total = pings * 4;
+  double t0 = nowUs();
+  while (done < total && nowUs() - t0 < 10e6) {
+    while (sent < total && sent - done < window) client.send(wire(CTL_REQ_PING, (uint8_t)sent++, body));
+    done += client.pump(100);
+  }
+  double us = nowUs() - t0;
+  CHECK(done == total);
+  printf("  pipelined: %u round trips in %.1f ms — %.0f frames/s each way\n", done, us / 1000, done / us * 1e6);
+
+  _stop = true;
+  device.join();
+  close(slave);
+  close(master);
+}
+
+int main(int argc, char** argv) {
+  uint32_t pings = argc > 1 ? (uint32_t)atoi(argv[1]) : 2000;
+
+  testCodec();
+  testDamage();
+  benchParser();
+  benchPty(pings);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
@@ -0,0 +1,128 @@
+// ============================================================
+// Arduino.h — Host stand-in for the arduino-pico core
+//
+// Just the surface the firmware uses. Time, pins, interrupts and
+// Serial are implemented by the simulator (host/sim.cpp): the
+// clock is virtual, so delay() returns immediately after moving
+// simulated time forward.
+// ============================================================
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define LOW            0
+#define HIGH           1
+#define INPUT          0
+#define OUTPUT         1
+#define INPUT_PULLUP   2
+#define INPUT_PULLDOWN 3
+#define FALLING        2
+#define RISING         3
+#define CHANGE         4
+
+// ─── Time (virtual) ───
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// ─── Pins / interrupts ───
+void pinMode(int pin, int mode);
+int digitalRead(int pin);
+inline int digitalPinToInterrupt(int pin) { return pin; }
+void attachInterrupt(int irq, void (*isr)(), int mode);
+void detachInterrupt(int irq);
+void noInterrupts();
+void interrupts();
+
+// ─── Cortex-M hints (sim: core1 is a coroutine, see sim.cpp) ───
+void tight_loop_contents();
+void __wfe();
+void __wfi();   // sim: sleeps until the next simulated interrupt
+void __sev();
+
+// ─── String (subset) ───
+class String {
+ public:
+  String(const char* c = "") : s(c) {}
+  String(const std::string &x) : s(x) {}
+  String(char c) : s(1, c) {}
+  String(int v) : s(std::to_string(v)) {}
+  String(unsigned v) : s(std::to_string(v)) {}
+  String(long v) : s(std::to_string(v)) {}
+  String(unsigned long v) : s(std::to_string(v)) {}
+
+  const char* c_str() const { return s.c_str(); }
+  unsigned length() const { return (unsigned)s.size(); }
+  void trim() {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    size_t e = s.find_last_not_of(" \t\r\n");
+    s = (b == std::string::npos) ? std::string() : s.substr(b, e - b + 1);
+  }
+  bool operator==(const char* o) const { return s == o; }
+  String& operator+=(char c) { s += c; return *this; }
+  friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+  friend String operator+(const char* a, const String &b) { return String(std::string(a) + b.s); }
+
+ private:
+  std::string s;
+};
+
+// ─── Print / Stream ───
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n) {
+    for (size_t i = 0; i < n; i++) write(buf[i]);
+    return n;
+  }
+  size_t print(const char* s)          { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const String &s)        { return print(s.c_str()); }
+  size_t print(char c)                 { return write((uint8_t)c); }
+  size_t print(unsigned char v)        { return print(String((unsigned)v)); }
+  size_t print(int v)                  { return print(String(v)); }
+  size_t print(unsigned v)             { return print(String(v)); }
+  size_t print(long v)                 { return print(String(v)); }
+  size_t print(unsigned long v)        { return print(String(v)); }
+  size_t println()                     { return print("\r\n"); }
+  template <class T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int availableForWrite() { return 256; }
+  virtual void flush() {}
+};
+
+// ─── USB CDC / UART — backed by the simulator's console ───
+class SerialPort : public Stream {
+ public:
+  unsigned long baud = 0;   // last begin() rate (sim: sensor link model)
+  void begin(unsigned long b) { baud = b; }
+  void end() {}
+  operator bool() const { return true; }
+  size_t write(uint8_t c) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int availableForWrite() override;
+};
+
+extern SerialPort Serial;
+extern SerialPort Serial1;
+
+// ─── Multicore control ───
+struct RP2040Class {
+  void idleOtherCore() {}
+  void resumeOtherCore() {}
+};
+extern RP2040Class rp2040;
@@ -0,0 +1,39 @@
+// ============================================================
+// DFRobot_ID809.h — Host stand-in for the SEN0348 library
+//
+// Same class, enums and return conventions; every call is
+// answered by the scriptable sensor in host/sim.cpp.
+// ============================================================
+#pragma once
+
+#include <Arduino.h>
+
+#define ERR_ID809            0xFF
+#define FINGERPRINT_CAPACITY 80
+
+class DFRobot_ID809 {
+ public:
+  typedef enum { eBreathing = 1, eFastBlink, eKeepsOn, eNormalClose, eFadeIn, eFadeOut, eSlowBlink } eLEDMode_t;
+  typedef enum { eLEDGreen = 1, eLEDRed, eLEDYellow, eLEDBlue, eLEDCyan, eLEDMagenta, eLEDWhite } eLEDColor_t;
+  typedef enum { e9600bps = 1, e19200bps, e38400bps, e57600bps, e115200bps } eDeviceBaudrate_t;
+
+  bool begin(Stream &s);
+  bool isConnected();
+  uint8_t setBaudrate(eDeviceBaudrate_t baud);
+  uint8_t ctrlLED(eLEDMode_t mode, eLEDColor_t color, uint8_t blinkCount);
+  uint8_t detectFinger();
+  uint8_t getEmptyID();
+  uint8_t getStatusID(uint8_t id);
+  uint8_t getEnrollCount();
+  uint8_t getEnrolledIDList(uint8_t* list);
+  uint8_t collectionFingerprint(uint16_t timeout, int ramNumber = -1);
+  uint8_t storeFingerprint(uint8_t id);
+  uint8_t delFingerprint(uint8_t id);
+  uint8_t search();
+  uint8_t verify(uint8_t id);
+  uint8_t getTemplate(uint16_t id, uint8_t* temp);        // SENSOR_TEMPLATE_BYTES out
+  uint8_t downLoadTemplate(uint16_t id, uint8_t* temp);   // … and back into an ID
+  uint8_t getFingerImage(uint8_t* image);                  // last capture, 160×160
+  uint8_t getQuarterFingerImage(uint8_t* image);           // … 80×80
+  String getErrorDescription();
+};
@@ -0,0 +1,28 @@
+// ============================================================
+// EEPROM.h — Host stand-in for arduino-pico's emulated EEPROM
+//
+// RAM buffer; begin() loads and commit() saves the simulator's
+// persistent copy, so contents survive a simulated power cycle.
+// ============================================================
+#pragma once
+
+#include <Arduino.h>
+
+#define SIM_EEPROM_BYTES 4096
+
+class EEPROMClass {
+ public:
+  void begin(size_t size);
+  bool commit();
+  uint8_t read(int addr) const         { return _data[addr]; }
+  void write(int addr, uint8_t value)  { _data[addr] = value; }
+  template <class T> T& get(int addr, T &t) const { memcpy(&t, _data + addr, sizeof(T)); return t; }
+  template <class T> const T& put(int addr, const T &t) { memcpy(_data + addr, &t, sizeof(T)); return t; }
+  uint8_t* getDataPtr() { return _data; }
+
+ private:
+  uint8_t _data[SIM_EEPROM_BYTES];
+  size_t _size = 0;
+};
+
+extern EEPROMClass EEPROM;
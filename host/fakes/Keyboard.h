@@ -0,0 +1,45 @@
+// ============================================================
+// Keyboard.h — Host stand-in for the arduino-pico USB keyboard
+//
+// Key events are recorded with their virtual timestamp by
+// host/sim.cpp; a modelled host answers Caps Lock with an LED
+// report so adaptive HID timing can be exercised. Raw reports
+// (sendReport, protected as in the library) go to a recording
+// sink that decodes them the way a host would.
+// ============================================================
+#pragma once
+
+#include <Arduino.h>
+
+#define KEY_LEFT_CTRL   0x80
+#define KEY_LEFT_SHIFT  0x81
+#define KEY_LEFT_ALT    0x82
+#define KEY_LEFT_GUI    0x83
+#define KEY_RIGHT_ALT   0x86
+#define KEY_RETURN      0xB0
+#define KEY_CAPS_LOCK   0xC1
+
+typedef struct {
+  uint8_t modifiers;
+  uint8_t reserved;
+  uint8_t keys[6];
+} KeyReport;
+
+typedef void (*LedCallbackFcn)(bool numlock, bool capslock, bool scrolllock, bool compose, bool kana, void* cbData);
+
+class HID_Keyboard : public Print {
+ public:
+  void begin() {}
+  void end() {}
+  size_t write(uint8_t c) override;
+  using Print::write;
+  size_t press(uint8_t key);
+  size_t release(uint8_t key);
+  void releaseAll();
+  void onLED(LedCallbackFcn fn, void* cbData = nullptr);
+
+ protected:
+  virtual void sendReport(KeyReport* keys);
+};
+
+extern HID_Keyboard Keyboard;
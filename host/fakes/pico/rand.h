@@ -0,0 +1,5 @@
+// Host stand-in — seeded per simulated boot, deterministic
+#pragma once
+#include <stdint.h>
+
+uint32_t get_rand_32();
@@ -0,0 +1,152 @@
+// ============================================================
+// finger_edges_test.cpp — Touch Out edge record on synthetic edges
+//
+//   finger_edges_test [presses]
+//
+// 1. Clean touch + lift: one event each, exact timestamps
+// 2. Bouncy touch and bouncy lift: bounces counted, not taken
+// 3. A tap shorter than the bounce window: taken by settle (or the
+//    next edge) with the raw edge's timestamp
+// 4. Finger already on at init, coalesced edges, micros() wrap
+// 5. Random presses with bounce bursts: touches, lifts and the
+//    final state always agree with the presses made
+// ============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+
+#include "finger_edges.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+#define W FINGER_DEBOUNCE_US
+
+static void testClean() {
+  printf("[TEST] clean touch + lift\n");
+  FingerEdges e;
+  fingerEdgeInit(e, false, 1000);
+  CHECK(!e.present && !e.touched);
+
+  fingerEdgeFeed(e, true, 1000);   // right after init: no debounce wait
+  CHECK(e.present && e.touched && e.touchUs == 1000 && e.touches == 1);
+
+  fingerEdgeFeed(e, false, 400000);
+  CHECK(!e.present && e.liftUs == 400000 && e.lifts == 1 && e.bounces == 0);
+  CHECK(e.touched);   // still waiting for the main loop
+}
+
+static void testBounce() {
+  printf("[TEST] bouncy touch + bouncy lift\n");
+  FingerEdges e;
+  fingerEdgeInit(e, false, 0);
+  uint32_t t = 50000;
+  fingerEdgeFeed(e, true, t);
+  fingerEdgeFeed(e, false, t + 300);
+  fingerEdgeFeed(e, true, t + 700);
+  fingerEdgeFeed(e, false, t + 900);
+  fingerEdgeFeed(e, true, t + 1500);
+  fingerEdgeSettle(e, t + 100000);
+  CHECK(e.present && e.touches == 1 && e.touchUs == t && e.bounces == 2);
+
+  t = 500000;
+  fingerEdgeFeed(e, false, t);
+  fingerEdgeFeed(e, true, t + 400);
+  fingerEdgeFeed(e, false, t + 800);
+  fingerEdgeSettle(e, t + 100000);
+  CHECK(!e.present && e.lifts == 1 && e.liftUs == t && e.touches == 1 && e.bounces == 3);
+}
+
+static void testShortTap() {
+  printf("[TEST] tap shorter than the bounce window\n");
+  FingerEdges e;
+  fingerEdgeInit(e, false, 0);
+  uint32_t t = 80000;
+  fingerEdgeFeed(e, true, t);
+  fingerEdgeFeed(e, false, t + W / 2);   // inside the window: not taken yet
+  CHECK(e.present);
+
+  fingerEdgeSettle(e, t + W / 2 + W - 1);   // low not held long enough
+  CHECK(e.present);
+  fingerEdgeSettle(e, t + W / 2 + W);
+  CHECK(!e.present && e.lifts == 1 && e.liftUs == t + W / 2);
+
+  // Same tap, no settle in between: the next touch settles it first
+  fingerEdgeFeed(e, true, t + 200000);
+  fingerEdgeFeed(e, false, t + 200000 + W / 4);
+  fingerEdgeFeed(e, true, t + 400000);
+  CHECK(e.present && e.touches == 3 && e.lifts == 2 && e.liftUs == t + 200000 + W / 4);
+  CHECK(e.touchUs == t + 400000);
+}
+
+static void testEdgeCases() {
+  printf("[TEST] finger on at init, coalesced edges, micros() wrap\n");
+  FingerEdges e;
+  fingerEdgeInit(e, true, 5000);
+  CHECK(e.present && !e.touched && e.touches == 0);
+  fingerEdgeFeed(e, false, 9000);
+  CHECK(!e.present && e.lifts == 1);
+
+  fingerEdgeFeed(e, false, 20000);   // two edges, one interrupt: level unchanged
+  CHECK(!e.present && e.lifts == 1 && e.bounces == 0);
+
+  uint32_t t = 0xFFFFFFFFu - W / 2;
+  fingerEdgeFeed(e, true, t);
+  fingerEdgeFeed(e, false, t + 100);            // bounce across the wrap
+  fingerEdgeFeed(e, true, t + 200);
+  fingerEdgeFeed(e, false, t + 10 * W);         // wrapped: still a real lift
+  CHECK(!e.present && e.touches == 1 && e.lifts == 2 && e.bounces == 1);
+  CHECK(e.liftUs == t + 10 * W);
+}
+
+// ─── Presses with bounce bursts shorter than the window ───
+static void testRandom(uint32_t presses) {
+  printf("[TEST] %u random presses with bounce bursts\n", presses);
+  std::mt19937 rng(20240611);
+  FingerEdges e;
+  uint32_t t = rng();
+  fingerEdgeInit(e, false, t);
+  uint32_t wrongTimes = 0;
+
+  for (uint32_t p = 0; p < presses; p++) {
+    for (int level = 1; level >= 0; level--) {
+      t += W + rng() % 500000;   // a real change, steady for a while first
+      uint32_t edge = t;
+      fingerEdgeFeed(e, level, edge);
+      uint32_t pairs = rng() % 4;
+      for (uint32_t b = 0; b < pairs; b++) {
+        t += 1 + rng() % (W / 8);
+        fingerEdgeFeed(e, !level, t);
+        t += 1 + rng() % (W / 8);
+        fingerEdgeFeed(e, level, t);
+      }
+      if ((level ? e.touchUs : e.liftUs) != edge) wrongTimes++;
+    }
+  }
+  fingerEdgeSettle(e, t + W);
+  CHECK(e.touches == (uint16_t)presses);
+  CHECK(e.lifts == (uint16_t)presses);
+  CHECK(!e.present);
+  CHECK(wrongTimes == 0);
+  printf("[TEST] %u bounces ignored\n", e.bounces);
+}
+
+int main(int argc, char** argv) {
+  uint32_t presses = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+
+  testClean();
+  testBounce();
+  testShortTap();
+  testEdgeCases();
+  testRandom(presses);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
@@ -0,0 +1,133 @@
+// ============================================================
+// flash_sim.cpp — File-backed NOR flash simulator (host builds)
+// ============================================================
+#include "flash_sim.h"
+#include "flash_region.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define FLASH_SIM_BYTES FLASH_REGION_BYTES
+
+static FILE* _sim_file = nullptr;
+static std::vector<uint8_t> _sim_mem;
+static uint32_t _sim_erases[FLASH_SIM_BYTES / FLASH_REGION_SECTOR];
+static uint32_t _sim_programs = 0;
+static uint32_t _sim_failAfter = 0;
+static uint32_t _sim_badSkip = 0;     // good programs before the bad ones
+static uint32_t _sim_badCount = 0;    // programs that won't take
+static uint64_t _sim_clockUs = 0;
+static void (*_sim_onBusy)(uint32_t us) = nullptr;
+
+static void _simTick(uint32_t us) {
+  _sim_clockUs += us;
+  if (_sim_onBusy) _sim_onBusy(us);
+}
+
+static void _simFlush(uint32_t off, uint32_t len) {
+  fseek(_sim_file, off, SEEK_SET);
+  fwrite(&_sim_mem[off], 1, len, _sim_file);
+  fflush(_sim_file);
+}
+
+// ─── Power-cut bookkeeping: true when this op is the one that dies ───
+static bool _simCut() {
+  if (_sim_failAfter == 0) return false;
+  return --_sim_failAfter == 0;
+}
+
+bool flashSimOpen(const char* path, FlashSimFill fill, uint32_t seed) {
+  flashSimClose();
+  _sim_mem.assign(FLASH_SIM_BYTES, 0xFF);
+
+  if (fill == FLASH_SIM_KEEP) {
+    _sim_file = fopen(path, "r+b");
+    if (_sim_file) {
+      size_t n = fread(_sim_mem.data(), 1, FLASH_SIM_BYTES, _sim_file);
+      (void)n;
+    }
+  }
+  if (!_sim_file) {
+    _sim_file = fopen(path, "w+b");
+    if (!_sim_file) return false;
+    if (fill == FLASH_SIM_GARBAGE) {
+      srand(seed);
+      for (auto &b : _sim_mem) b = (uint8_t)rand();
+    }
+  }
+  _simFlush(0, FLASH_SIM_BYTES);
+  flashSimResetCounters();
+  return true;
+}
+
+void flashSimClose() {
+  if (_sim_file) fclose(_sim_file);
+  _sim_file = nullptr;
+  _sim_failAfter = 0;
+  _sim_badCount = 0;
+}
+
+void flashSimFailAfter(uint32_t ops)        { _sim_failAfter = ops; }
+void flashSimBadPrograms(uint32_t skip, uint32_t count) { _sim_badSkip = skip; _sim_badCount = count; }
+uint32_t flashSimEraseCount(uint32_t sector) { return _sim_erases[sector]; }
+uint32_t flashSimProgramCount()             { return _sim_programs; }
+
+void flashSimOnBusy(void (*fn)(uint32_t us)) { _sim_onBusy = fn; }
+
+void flashSimResetCounters() {
+  memset(_sim_erases, 0, sizeof(_sim_erases));
+  _sim_programs = 0;
+}
+
+// ============================================================
+// flash_region.h implementation
+// ============================================================
+
+uint32_t flashRegionSize() {
+  return _sim_file ? FLASH_SIM_BYTES : 0;
+}
+
+void flashRegionRead(uint32_t off, void* buf, size_t len) {
+  memcpy(buf, &_sim_mem[off], len);
+  _simTick(FLASH_SIM_READ_US_PER_PAGE * ((len + FLASH_REGION_PAGE - 1) / FLASH_REGION_PAGE));
+}
+
+void flashRegionErase(uint32_t off) {
+  uint32_t sector = off / FLASH_REGION_SECTOR;
+  if (_simCut()) {
+    // Interrupted erase: first half cleared, the rest left as it was
+    memset(&_sim_mem[off], 0xFF, FLASH_REGION_SECTOR / 2);
+    _simFlush(off, FLASH_REGION_SECTOR);
+    throw FlashPowerCut();
+  }
+  memset(&_sim_mem[off], 0xFF, FLASH_REGION_SECTOR);
+  _simFlush(off, FLASH_REGION_SECTOR);
+  _sim_erases[sector]++;
+  _simTick(FLASH_SIM_ERASE_US);
+}
+
+void flashRegionProgram(uint32_t off, const uint8_t* page) {
+  uint32_t n = FLASH_REGION_PAGE;
+  bool cut = _simCut();
+  bool bad = false;
+  if (!cut && _sim_badCount) {
+    if (_sim_badSkip) {
+      _sim_badSkip--;
+    } else {
+      _sim_badCount--;
+      bad = true;
+    }
+  }
+  if (cut) n = FLASH_REGION_PAGE / 3;   // torn page
+  for (uint32_t i = bad ? 4 : 0; i < n; i++) _sim_mem[off + i] &= page[i];   // bad: first word stays erased
+  _simFlush(off, FLASH_REGION_PAGE);
+  if (cut) throw FlashPowerCut();
+  _sim_programs++;
+  _simTick(FLASH_SIM_PROGRAM_US);
+}
+
+uint32_t flashRegionMicros() {
+  return (uint32_t)_sim_clockUs;
+}
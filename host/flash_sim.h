@@ -0,0 +1,55 @@
+// ============================================================
+// flash_sim.h — File-backed NOR flash simulator (host builds)
+//
+// Implements flash_region.h for HOST_BUILD. The region is a
+// plain file so contents survive between runs, and it behaves
+// like the real part:
+//   - erase sets a 4 KB sector to 0xFF
+//   - program ANDs a 256-byte page into place (bits only clear)
+//   - latency comes from a model clock (typical QSPI NOR timing)
+//
+// A power cut can be armed to fire after N flash operations;
+// the interrupted operation is left half done and FlashPowerCut
+// is thrown so a test can remount from what is on "disk".
+// Page programs can also be made not to take (a worn or
+// disturbed page): all but its first word is written, no power
+// cut.
+//
+// Usage:
+//   flashSimOpen(path, fill)    — create / open the backing file
+//   flashSimFailAfter(n)        — cut power on the nth op (0 = off)
+//   flashSimBadPrograms(skip, n) — after skip good programs, the
+//                                 next n don't take (n = 0: off)
+//   flashSimEraseCount(sector)  — lifetime erases of a sector
+//   flashSimOnBusy(fn)          — report each op's model time
+//                                 (drives the device sim's clock)
+//   flashSimClose()
+// ============================================================
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLASH_SIM_ERASE_US    45000   // 4 KB sector erase (typ.)
+#define FLASH_SIM_PROGRAM_US  700     // 256 B page program (typ.)
+#define FLASH_SIM_READ_US_PER_PAGE 3  // XIP read, 256 B
+
+struct FlashPowerCut {};
+
+enum FlashSimFill : uint8_t {
+  FLASH_SIM_KEEP,       // reuse an existing file as-is
+  FLASH_SIM_ERASED,     // all 0xFF
+  FLASH_SIM_GARBAGE     // random bytes (e.g. a stale filesystem)
+};
+
+bool flashSimOpen(const char* path, FlashSimFill fill, uint32_t seed = 1);
+void flashSimClose();
+void flashSimFailAfter(uint32_t ops);
+void flashSimBadPrograms(uint32_t skip, uint32_t count);
+uint32_t flashSimEraseCount(uint32_t sector);
+uint32_t flashSimProgramCount();
+void flashSimResetCounters();
+void flashSimOnBusy(void (*fn)(uint32_t us));
+
+#endif // FLASH_SIM_H
@@ -0,0 +1,221 @@
+// ============================================================
+// fp_console.cpp — Terminal for the unlocker's USB console
+//
+//   fp_console /dev/ttyACM0 [--text]
+//
+// Says HELLO and switches the device to binary log records
+// (CTL_REQ_LOG_MODE), then prints every record rendered on this
+// side, stamped with the device's millis(). A format is fetched
+// once per ID (CTL_REQ_LOG_FMT); records wait, in order, until
+// theirs has arrived. Console text (reports, prompts) is passed
+// through and lines typed on stdin go to the device, so !STATS,
+// !CREDS etc. work as in a serial monitor.
+//
+// --text leaves the device logging text. On exit (Ctrl+C or end
+// of stdin) the device is put back into text logging.
+// ============================================================
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <deque>
+#include <set>
+#include <string>
+
+#include "ctl_proto.h"
+#include "log_decode.h"
+
+static volatile sig_atomic_t _quit = 0;
+static int _fd = -1;
+static uint8_t _seq = 0;
+static LogDecoder _dec;
+// Output behind a record whose format has not arrived yet — console
+// text queues too, so nothing overtakes the record
+struct Held {
+  bool record;
+  std::string bytes;
+};
+static std::deque<Held> _held;
+static std::set<uint8_t> _asked;
+
+static void onSignal(int) { _quit = 1; }
+
+static bool writeAll(const void* p, size_t n) {
+  const uint8_t* b = (const uint8_t*)p;
+  while (n) {
+    ssize_t w = write(_fd, b, n);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) return false;
+    b += w;
+    n -= (size_t)w;
+  }
+  return true;
+}
+
+static void sendFrame(uint8_t type, const uint8_t* body, size_t len) {
+  uint8_t out[CTL_MAX_WIRE];
+  if (++_seq == 0) _seq = 1;
+  size_t n = ctlEncode(type, _seq, body, len, out);
+  if (n) writeAll(out, n);
+}
+
+static void sendLogMode(bool binary) {
+  uint8_t mode = binary ? 1 : 0;
+  sendFrame(CTL_REQ_LOG_MODE, &mode, 1);
+}
+
+// ─── Print held output until a record needs a format we lack ───
+static void releaseHeld() {
+  while (!_held.empty()) {
+    if (!_held.front().record) {
+      fputs(_held.front().bytes.c_str(), stdout);
+      _held.pop_front();
+      continue;
+    }
+    const std::string &b = _held.front().bytes;
+    uint8_t id = LogDecoder::idOf((const uint8_t*)b.data(), b.size());
+    if (!_dec.known(id)) {
+      if (_asked.insert(id).second) sendFrame(CTL_REQ_LOG_FMT, &id, 1);
+      return;
+    }
+    uint32_t ms;
+    std::string text;
+    if (_dec.decode((const uint8_t*)b.data(), b.size(), ms, text)) {
+      printf("%10.3f  %s\n", ms / 1000.0, text.c_str());
+    }
+    _held.pop_front();
+  }
+}
+
+static void onFrame(const std::string &cobs) {
+  uint8_t msg[CTL_MAX_PAYLOAD];
+  size_t len = ctlDecode((const uint8_t*)cobs.data(), cobs.size(), msg, sizeof(msg));
+  if (len < 2) {
+    fprintf(stderr, "[console] damaged frame dropped\n");
+    return;
+  }
+  uint8_t type = msg[0];
+  const uint8_t* body = msg + 2;
+  size_t n = len - 2;
+
+  switch (type) {
+    case CTL_EVT_LOG:
+      _held.push_back({ true, std::string((const char*)body, n) });
+      releaseHeld();
+      break;
+    case CTL_REQ_LOG_FMT | CTL_RSP:
+      _dec.learn(body, n);
+      releaseHeld();
+      break;
+    case CTL_REQ_HELLO | CTL_RSP:
+      if (n >= 10) printf("[console] firmware %.*s, protocol v%u\n", (int)(n - 10), (const char*)body + 10, body[0]);
+      break;
+    case CTL_RSP_NAK:
+      if (n >= 2) printf("[console] request 0x%02X refused (error %u)\n", body[0], body[1]);
+      break;
+    case CTL_EVT_MODE:
+    case CTL_EVT_REG:
+    case CTL_EVT_AUTH:
+      printf("[event 0x%02X]", type);
+      for (size_t i = 0; i < n; i++) printf(" %u", body[i]);
+      printf("\n");
+      break;
+    default:
+      break;   // other replies carry nothing to show
+  }
+}
+
+// ─── Split device output: 0x00 opens a frame, the next closes it ───
+struct Demux {
+  bool inFrame = false;
+  std::string frame;
+
+  void feed(const uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      uint8_t c = p[i];
+      if (c == 0) {
+        if (inFrame && !frame.empty()) {
+          onFrame(frame);
+          frame.clear();
+          inFrame = false;
+        } else {
+          inFrame = true;   // "00 00" restarts
+          frame.clear();
+        }
+      } else if (inFrame) {
+        frame += (char)c;
+      } else if (c != '\r') {
+        if (_held.empty()) putchar(c);
+        else if (_held.back().record) _held.push_back({ false, std::string(1, (char)c) });
+        else _held.back().bytes += (char)c;
+      }
+    }
+    fflush(stdout);
+  }
+};
+
+static bool openTty(const char* path) {
+  _fd = open(path, O_RDWR | O_NOCTTY);
+  if (_fd < 0) return false;
+  termios t;
+  if (tcgetattr(_fd, &t) == 0) {
+    cfmakeraw(&t);
+    cfsetspeed(&t, B115200);   // ignored by USB CDC, needed by adapters
+    tcsetattr(_fd, TCSANOW, &t);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <tty> [--text]\n", argv[0]);
+    return 2;
+  }
+  bool binary = !(argc > 2 && strcmp(argv[2], "--text") == 0);
+  if (!openTty(argv[1])) {
+    fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+    return 1;
+  }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  sendFrame(CTL_REQ_HELLO, nullptr, 0);
+  if (binary) sendLogMode(true);
+
+  Demux demux;
+  bool stdinOpen = true;
+  while (!_quit) {
+    pollfd p[2] = { { _fd, POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } };
+    if (poll(p, stdinOpen ? 2 : 1, 200) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (p[0].revents & (POLLERR | POLLHUP)) {
+      fprintf(stderr, "[console] device gone\n");
+      break;
+    }
+    if (p[0].revents & POLLIN) {
+      uint8_t buf[4096];
+      ssize_t n = read(_fd, buf, sizeof(buf));
+      if (n > 0) demux.feed(buf, (size_t)n);
+    }
+    if (stdinOpen && (p[1].revents & (POLLIN | POLLHUP))) {
+      char buf[256];
+      ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+      if (n <= 0) {
+        stdinOpen = false;
+        _quit = 1;
+      } else {
+        writeAll(buf, (size_t)n);   // text commands, newline included
+      }
+    }
+  }
+
+  if (binary) sendLogMode(false);
+  close(_fd);
+  return 0;
+}
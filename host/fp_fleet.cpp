@@ -0,0 +1,348 @@
+// ============================================================
+// fp_fleet.cpp — Provision a batch of units over their USB consoles
+//
+//   fp_fleet [--cred N] [--timeout S] tty... < passwords
+//   fp_fleet --status tty...
+//
+// Opens every port and serves all of them from one epoll loop. Each
+// device is greeted with HELLO (status, events on) and then sent one
+// CTL_REQ_PROVISION frame: the credential plus the password from
+// stdin, one line per port in argument order (an empty line adds a
+// finger to the credential). The device starts registration at
+// once, so the operator only walks along the bench presenting a
+// finger wherever one is asked for, in any order. CTL_EVT_REG
+// events are printed per port; DONE is confirmed with a STATUS
+// request before the unit counts as provisioned.
+//
+// A unit fails on a NAK (wrong mode, bad password), a FAILED event,
+// a vanished port or no progress for --timeout seconds (default
+// 120). The run ends when every unit is done or failed and prints
+// units provisioned per minute. Exit status 0 only if all passed.
+//
+// --status only asks each device for its status and prints it.
+// ============================================================
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ctl_proto.h"
+
+enum UnitState { U_HELLO, U_PROVISION, U_ENROLL, U_VERIFY, U_DONE, U_FAILED };
+
+struct Unit {
+  std::string path;
+  int fd = -1;
+  std::string password;
+  UnitState state = U_HELLO;
+  uint8_t seq = 0;
+  uint8_t cred = 0, sensorId = 0;   // from CTL_REG_DONE
+  double startS = 0, lastS = 0, doneS = 0;
+  std::string why;                  // failure reason
+  bool inFrame = false;
+  std::string frame;                // COBS bytes of the frame being received
+  std::string tx;                   // not yet written
+};
+
+static volatile sig_atomic_t _quit = 0;
+static int _ep = -1;
+static uint8_t _cred = 1;
+static double _timeoutS = 120;
+static bool _statusOnly = false;
+
+static void onSignal(int) { _quit = 1; }
+
+static double nowS() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static const char* shortName(const Unit &u) {
+  size_t slash = u.path.rfind('/');
+  return u.path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+// ─── Output: queued, written as the port takes it ───
+static void watch(Unit &u) {
+  epoll_event ev = {};
+  ev.events = u.tx.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+  ev.data.ptr = &u;
+  epoll_ctl(_ep, EPOLL_CTL_MOD, u.fd, &ev);
+}
+
+static void flush(Unit &u) {
+  while (!u.tx.empty()) {
+    ssize_t w = write(u.fd, u.tx.data(), u.tx.size());
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) break;   // EAGAIN: EPOLLOUT brings us back
+    u.tx.erase(0, (size_t)w);
+  }
+  watch(u);
+}
+
+static void send(Unit &u, uint8_t type, const uint8_t* body = nullptr, size_t len = 0) {
+  uint8_t out[CTL_MAX_WIRE];
+  if (++u.seq == 0) u.seq = 1;
+  size_t n = ctlEncode(type, u.seq, body, len, out);
+  u.tx.append((const char*)out, n);
+  flush(u);
+}
+
+static void finish(Unit &u, UnitState state, const std::string &why = std::string()) {
+  if (u.state == U_DONE || u.state == U_FAILED) return;
+  u.state = state;
+  u.why = why;
+  u.doneS = nowS();
+  if (state == U_FAILED) printf("[%s] FAILED: %s\n", shortName(u), why.c_str());
+}
+
+static const char* errName(uint8_t err) {
+  switch (err) {
+    case CTL_ERR_UNKNOWN:  return "request unknown (old firmware?)";
+    case CTL_ERR_BAD_ARG:  return "refused: bad credential or password";
+    case CTL_ERR_STATE:    return "refused: not in REGISTER mode or busy";
+    case CTL_ERR_DISABLED: return "refused: compiled out";
+    default:               return "refused";
+  }
+}
+
+static void printStatus(const Unit &u, const uint8_t* b, size_t n) {
+  char tpl[16];
+  if (b[4] == CTL_STATUS_UNKNOWN) snprintf(tpl, sizeof(tpl), "?");   // sensor busy, count stale
+  else snprintf(tpl, sizeof(tpl), "%u", b[4]);
+  printf("[%s] firmware %.*s, %s, boot state %u, sensor %s, %s template(s), %u credential(s), up %.1f s\n",
+         shortName(u), (int)(n - 10), (const char*)b + 10, b[1] == 0 ? "REGISTER" : "RECOGNIZE", b[2],
+         b[3] ? "OK" : "FAIL", tpl, b[5], ctlGet32(b + 6) / 1000.0);
+}
+
+// ─── One frame from a device ───
+static void onFrame(Unit &u) {
+  uint8_t msg[CTL_MAX_PAYLOAD];
+  size_t len = ctlDecode((const uint8_t*)u.frame.data(), u.frame.size(), msg, sizeof(msg));
+  if (len < 2) return;   // damaged: the device will resend nothing, the timeout decides
+  uint8_t type = msg[0], seq = msg[1];
+  const uint8_t* b = msg + 2;
+  size_t n = len - 2;
+  u.lastS = nowS();
+
+  if (type == CTL_RSP_NAK && seq == u.seq && n >= 2) {
+    finish(u, U_FAILED, errName(b[1]));
+    return;
+  }
+
+  switch (u.state) {
+    case U_HELLO:
+      if (type != (CTL_REQ_HELLO | CTL_RSP) || seq != u.seq || n < 10) return;
+      if (_statusOnly) {
+        printStatus(u, b, n);
+        finish(u, U_DONE);
+      } else if (b[0] != CTL_PROTO_VERSION) {
+        finish(u, U_FAILED, "protocol version " + std::to_string(b[0]));
+      } else if (b[1] != 0) {
+        finish(u, U_FAILED, "in RECOGNIZE mode — flip the switch to REGISTER");
+      } else if (!b[3]) {
+        finish(u, U_FAILED, "sensor not responding");
+      } else {
+        std::string body = std::string(1, (char)_cred) + u.password;
+        send(u, CTL_REQ_PROVISION, (const uint8_t*)body.data(), body.size());
+        u.state = U_PROVISION;
+      }
+      break;
+
+    case U_PROVISION:
+      if (type == (CTL_REQ_PROVISION | CTL_RSP) && seq == u.seq) {
+        u.password.assign(u.password.size(), '\0');   // the device has it now
+        u.state = U_ENROLL;
+        printf("[%s] registration started\n", shortName(u));
+      }
+      break;
+
+    case U_ENROLL:
+      if (type != CTL_EVT_REG || n < 3) return;
+      switch (b[0]) {
+        case CTL_REG_PLACE:        printf("[%s] place finger (%u/%u)\n", shortName(u), b[1], b[2]); break;
+        case CTL_REG_REMOVE:       printf("[%s] remove finger\n", shortName(u)); break;
+        case CTL_REG_CAPTURE_FAIL: printf("[%s] capture failed (%u/%u)\n", shortName(u), b[1], b[2]); break;
+        case CTL_REG_FAILED:       finish(u, U_FAILED, "registration did not complete"); break;
+        case CTL_REG_DONE:
+          u.cred = b[1];
+          u.sensorId = b[2];
+          send(u, CTL_REQ_STATUS);
+          u.state = U_VERIFY;
+          break;
+      }
+      break;
+
+    case U_VERIFY:
+      if (type != (CTL_REQ_STATUS | CTL_RSP) || seq != u.seq || n < 10) return;
+      if (b[5] == 0) {
+        finish(u, U_FAILED, "no credential after DONE");
+      } else {
+        finish(u, U_DONE);
+        printf("[%s] provisioned: credential %u → ID %u in %.1f s\n", shortName(u), u.cred, u.sensorId,
+               u.doneS - u.startS);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+// ─── Split device output: 0x00 opens a frame, the next closes it ───
+static void onBytes(Unit &u, const uint8_t* p, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (p[i] == 0) {
+      if (u.inFrame && !u.frame.empty()) {
+        onFrame(u);
+        u.inFrame = false;
+      } else {
+        u.inFrame = true;   // "00 00" restarts
+      }
+      u.frame.clear();
+    } else if (u.inFrame) {
+      u.frame += (char)p[i];
+    }   // console text is not ours
+  }
+}
+
+static bool openTty(Unit &u) {
+  u.fd = open(u.path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (u.fd < 0) return false;
+  termios t;
+  if (tcgetattr(u.fd, &t) == 0) {
+    cfmakeraw(&t);
+    cfsetspeed(&t, B115200);   // ignored by USB CDC, needed by adapters
+    tcsetattr(u.fd, TCSANOW, &t);
+  }
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.ptr = &u;
+  return epoll_ctl(_ep, EPOLL_CTL_ADD, u.fd, &ev) == 0;
+}
+
+static void usage(const char* me) {
+  fprintf(stderr, "usage: %s [--cred N] [--timeout S] tty... < passwords\n"
+                  "       %s --status tty...\n", me, me);
+}
+
+int main(int argc, char** argv) {
+  std::vector<Unit> units;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--status") == 0) _statusOnly = true;
+    else if (strcmp(argv[i], "--cred") == 0 && i + 1 < argc) _cred = (uint8_t)atoi(argv[++i]);
+    else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) _timeoutS = atof(argv[++i]);
+    else if (argv[i][0] == '-') { usage(argv[0]); return 2; }
+    else { units.emplace_back(); units.back().path = argv[i]; }
+  }
+  if (units.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // One password line per port, read before any port is touched
+  if (!_statusOnly) {
+    for (Unit &u : units) {
+      if (!std::getline(std::cin, u.password)) {
+        fprintf(stderr, "%s: %zu port(s) but fewer password lines on stdin\n", argv[0], units.size());
+        return 2;
+      }
+      if (!u.password.empty() && u.password.back() == '\r') u.password.pop_back();
+      if (u.password.size() > PASSWORD_MAX_LEN) {
+        fprintf(stderr, "%s: password for %s longer than %d\n", argv[0], u.path.c_str(), PASSWORD_MAX_LEN);
+        return 2;
+      }
+    }
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+  _ep = epoll_create1(0);
+
+  double t0 = nowS();
+  for (Unit &u : units) {
+    u.startS = u.lastS = t0;
+    if (!openTty(u)) {
+      finish(u, U_FAILED, strerror(errno));
+      continue;
+    }
+    send(u, CTL_REQ_HELLO);
+  }
+
+  size_t busy = 0;
+  for (const Unit &u : units) busy += u.state != U_DONE && u.state != U_FAILED;
+  while (busy && !_quit) {
+    // Sleep until a port has data or the next unit runs out of time
+    double next = 1e300;
+    for (const Unit &u : units) {
+      if (u.state != U_DONE && u.state != U_FAILED && u.lastS + _timeoutS < next) next = u.lastS + _timeoutS;
+    }
+    int waitMs = (int)((next - nowS()) * 1000) + 1;
+    epoll_event evs[64];
+    int k = epoll_wait(_ep, evs, 64, waitMs < 0 ? 0 : waitMs);
+    if (k < 0 && errno != EINTR) break;
+
+    for (int i = 0; i < k; i++) {
+      Unit &u = *(Unit*)evs[i].data.ptr;
+      if (evs[i].events & EPOLLOUT) flush(u);
+      // A hung-up pty or ACM port reports EPOLLIN too, and read() then
+      // gives 0 or EIO: drain what is left, then drop the port
+      bool closed = evs[i].events & (EPOLLERR | EPOLLHUP);
+      if (evs[i].events & EPOLLIN) {
+        uint8_t buf[4096];
+        ssize_t r;
+        while ((r = read(u.fd, buf, sizeof(buf))) > 0) onBytes(u, buf, (size_t)r);
+        if (r == 0 || (errno != EAGAIN && errno != EINTR)) closed = true;
+      }
+      if (closed) {
+        finish(u, U_FAILED, "port closed");
+        u.tx.clear();   // nothing more can be written
+      }
+    }
+
+    double now = nowS();
+    busy = 0;
+    for (Unit &u : units) {
+      if (u.state == U_DONE || u.state == U_FAILED) {
+        if (u.fd >= 0 && u.tx.empty()) {
+          epoll_ctl(_ep, EPOLL_CTL_DEL, u.fd, nullptr);
+          close(u.fd);
+          u.fd = -1;
+        }
+        continue;
+      }
+      if (now - u.lastS >= _timeoutS) {
+        finish(u, U_FAILED, u.state == U_HELLO ? "no answer to HELLO" : "no progress (timeout)");
+      } else {
+        busy++;
+      }
+    }
+  }
+
+  double spanS = nowS() - t0;
+  uint32_t done = 0;
+  for (Unit &u : units) {
+    if (u.state != U_DONE && u.state != U_FAILED) finish(u, U_FAILED, "interrupted");
+    done += u.state == U_DONE;
+    if (u.fd >= 0) close(u.fd);
+    u.password.assign(u.password.size(), '\0');
+  }
+  if (_statusOnly) {
+    printf("[fleet] %u/%zu answered\n", done, units.size());
+  } else {
+    printf("[fleet] %u/%zu provisioned in %.1f s — %.1f units/min\n", done, units.size(), spanS,
+           spanS > 0 ? done * 60.0 / spanS : 0.0);
+  }
+  close(_ep);
+  return done == units.size() ? 0 : 1;
+}
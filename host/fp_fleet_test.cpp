@@ -0,0 +1,377 @@
+// ============================================================
+// fp_fleet_test.cpp — fp_fleet against pseudo-terminal devices
+//
+//   fp_fleet_test <fp_fleet> [units]
+//
+// Every device is the master side of a pty pair; one thread serves
+// them all. A device answers HELLO / STATUS, takes PROVISION and
+// plays the registration a real unit would report with a scripted
+// operator: PLACE + REMOVE per capture, console text in between,
+// then DONE. fp_fleet is run on the slave paths.
+//
+// 1. A batch of healthy units: all provisioned, each with its own
+//    password, in about the time of the slowest unit — not the sum
+// 2. Failures: a unit in RECOGNIZE, an enrollment that fails, one
+//    that never answers — each reported, the rest still done, exit 1
+// 3. --status: one line per unit, nothing provisioned
+// 4. A device unplugged mid-registration: that unit fails at once
+//    as "port closed", well before --timeout, the rest carry on
+// ============================================================
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ctl_proto.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+static double nowS() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ============================================================
+// Devices
+// ============================================================
+
+enum DevKind { DEV_OK, DEV_RECOGNIZE, DEV_FAILS, DEV_SILENT, DEV_UNPLUGS };
+
+struct Dev {
+  int master = -1;
+  std::string slave;
+  DevKind kind = DEV_OK;
+  double stepS = 0;               // operator time per prompt
+  bool inFrame = false;
+  std::string frame;
+  std::multimap<double, std::string> out;   // due time → bytes; empty: unplug
+  std::string password;
+  uint32_t provisions = 0;
+  uint8_t creds = 0;
+  double enrollS = 0;             // scripted length of the registration
+};
+
+static std::atomic<bool> _stop(false);
+
+static std::string frameBytes(uint8_t type, uint8_t seq, const std::string &body) {
+  uint8_t wire[CTL_MAX_WIRE];
+  size_t n = ctlEncode(type, seq, (const uint8_t*)body.data(), body.size(), wire);
+  return std::string((const char*)wire, n);
+}
+
+static std::string regEvent(CtlRegStep step, uint8_t a = 0, uint8_t b = 0) {
+  return frameBytes(CTL_EVT_REG, 0, std::string{ (char)step, (char)a, (char)b });
+}
+
+static std::string statusBody(const Dev &d) {
+  std::string b(10, '\0');
+  b[0] = CTL_PROTO_VERSION;
+  b[1] = d.kind == DEV_RECOGNIZE ? 1 : 0;
+  b[2] = d.creds ? 0 : 1;   // VALID / VIRGIN
+  b[3] = 1;
+  b[4] = d.creds;
+  b[5] = d.creds;
+  return b + "1.0.0";
+}
+
+static void onRequest(Dev &d, uint8_t type, uint8_t seq, const std::string &body) {
+  double now = nowS();
+  switch (type) {
+    case CTL_REQ_HELLO:
+    case CTL_REQ_STATUS:
+      d.out.emplace(now, frameBytes(type | CTL_RSP, seq, statusBody(d)));
+      break;
+
+    case CTL_REQ_PROVISION: {
+      d.provisions++;
+      if (d.kind == DEV_RECOGNIZE || body.empty()) {
+        d.out.emplace(now, frameBytes(CTL_RSP_NAK, seq, std::string{ (char)type, (char)CTL_ERR_STATE }));
+        break;
+      }
+      d.password = body.substr(1);
+      d.out.emplace(now, frameBytes(type | CTL_RSP, seq, ""));
+      double t = now;
+      for (uint8_t c = 1; c <= COLLECT_COUNT; c++) {
+        d.out.emplace(t, "[REG] Place finger...\r\n" + regEvent(CTL_REG_PLACE, c, COLLECT_COUNT));
+        t += d.stepS;
+        if (d.kind == DEV_UNPLUGS) {
+          d.out.emplace(t, std::string());
+          break;
+        }
+        if (d.kind == DEV_FAILS) {
+          d.out.emplace(t, regEvent(CTL_REG_CAPTURE_FAIL, 1, 1) + regEvent(CTL_REG_FAILED));
+          break;
+        }
+        d.out.emplace(t, "[REG] Remove finger...\r\n" + regEvent(CTL_REG_REMOVE));
+        t += d.stepS;
+      }
+      if (d.kind == DEV_OK) {
+        d.out.emplace(t, regEvent(CTL_REG_DONE, (uint8_t)body[0], 1));
+        d.creds = 1;
+      }
+      d.enrollS = t - now;
+      break;
+    }
+
+    default:
+      d.out.emplace(now, frameBytes(CTL_RSP_NAK, seq, std::string{ (char)type, (char)CTL_ERR_UNKNOWN }));
+      break;
+  }
+}
+
+static void onBytes(Dev &d, const uint8_t* p, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (p[i] == 0) {
+      if (d.inFrame && !d.frame.empty()) {
+        uint8_t msg[CTL_MAX_PAYLOAD];
+        size_t len = ctlDecode((const uint8_t*)d.frame.data(), d.frame.size(), msg, sizeof(msg));
+        if (len >= 2) onRequest(d, msg[0], msg[1], std::string((const char*)msg + 2, len - 2));
+        d.inFrame = false;
+      } else {
+        d.inFrame = true;
+      }
+      d.frame.clear();
+    } else if (d.inFrame) {
+      d.frame += (char)p[i];
+    }
+  }
+}
+
+static void serve(std::vector<Dev>* devs) {
+  std::vector<pollfd> fds;
+  for (const Dev &d : *devs) fds.push_back({ d.master, POLLIN, 0 });
+  while (!_stop) {
+    poll(fds.data(), fds.size(), 2);
+    for (size_t i = 0; i < devs->size(); i++) {
+      Dev &d = (*devs)[i];
+      if (d.master < 0) continue;
+      if (fds[i].revents & POLLIN) {
+        uint8_t buf[512];
+        ssize_t n = read(d.master, buf, sizeof(buf));
+        if (n > 0 && d.kind != DEV_SILENT) onBytes(d, buf, (size_t)n);
+      }
+      double now = nowS();
+      while (!d.out.empty() && d.out.begin()->first <= now) {
+        const std::string &b = d.out.begin()->second;
+        if (b.empty()) {
+          close(d.master);   // the slave side now reads as hung up
+          d.master = fds[i].fd = -1;
+          d.out.clear();
+          break;
+        }
+        if (write(d.master, b.data(), b.size()) < 0 && errno == EAGAIN) break;
+        d.out.erase(d.out.begin());
+      }
+    }
+  }
+}
+
+static bool openDevs(std::vector<Dev> &devs, uint32_t n, std::mt19937 &rng) {
+  devs.resize(n);
+  for (Dev &d : devs) {
+    d.master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (d.master < 0 || grantpt(d.master) || unlockpt(d.master)) return false;
+    termios t;
+    tcgetattr(d.master, &t);
+    cfmakeraw(&t);
+    tcsetattr(d.master, TCSANOW, &t);
+    d.slave = ptsname(d.master);
+    d.stepS = (20 + rng() % 41) / 1000.0;
+  }
+  return true;
+}
+
+static void closeDevs(std::vector<Dev> &devs) {
+  for (Dev &d : devs) {
+    if (d.master >= 0) close(d.master);
+  }
+}
+
+// ─── Run fp_fleet on the devices; stdout lines + exit status ───
+static int runFleet(const char* fleet, const std::string &args, std::vector<Dev> &devs,
+                    const std::vector<std::string> &passwords, std::vector<std::string> &lines, double &wallS) {
+  char out[] = "/tmp/fp_fleet_out_XXXXXX";
+  close(mkstemp(out));
+  std::string cmd = std::string("exec ") + fleet + " " + args;
+  for (const Dev &d : devs) cmd += " " + d.slave;
+  cmd += std::string(" > ") + out;
+
+  _stop = false;
+  std::thread device(serve, &devs);
+  double t0 = nowS();
+  FILE* in = popen(cmd.c_str(), "w");
+  for (const std::string &p : passwords) fprintf(in, "%s\n", p.c_str());
+  int status = pclose(in);
+  wallS = nowS() - t0;
+  _stop = true;
+  device.join();
+
+  lines.clear();
+  FILE* f = fopen(out, "r");
+  char line[512];
+  while (f && fgets(line, sizeof(line), f)) lines.push_back(line);
+  if (f) fclose(f);
+  unlink(out);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static uint32_t countLines(const std::vector<std::string> &lines, const char* text) {
+  uint32_t n = 0;
+  for (const std::string &l : lines) n += l.find(text) != std::string::npos;
+  return n;
+}
+
+static std::string unitName(const Dev &d) {
+  return "[" + d.slave.substr(d.slave.rfind('/') + 1) + "] ";
+}
+
+// ============================================================
+// Tests
+// ============================================================
+
+static void testBatch(const char* fleet, uint32_t units) {
+  printf("[TEST] %u units provisioned in parallel\n", units);
+  std::mt19937 rng(42);
+  std::vector<Dev> devs;
+  if (!openDevs(devs, units, rng)) {
+    printf("  no pty available (%s) — skipped\n", strerror(errno));
+    closeDevs(devs);
+    return;
+  }
+  std::vector<std::string> passwords;
+  for (uint32_t i = 0; i < units; i++) passwords.push_back("unit-" + std::to_string(i) + " pw");
+
+  std::vector<std::string> lines;
+  double wallS;
+  int rc = runFleet(fleet, "--timeout 5", devs, passwords, lines, wallS);
+  closeDevs(devs);
+
+  double sumS = 0, maxS = 0;
+  uint32_t got = 0;
+  for (uint32_t i = 0; i < units; i++) {
+    got += devs[i].password == passwords[i] && devs[i].provisions == 1;
+    sumS += devs[i].enrollS;
+    if (devs[i].enrollS > maxS) maxS = devs[i].enrollS;
+    CHECK(countLines(lines, (unitName(devs[i]) + "provisioned").c_str()) == 1);
+  }
+  CHECK(rc == 0);
+  CHECK(got == units);
+  CHECK(countLines(lines, "place finger (") == units * COLLECT_COUNT);
+  CHECK(countLines(lines, (std::to_string(units) + "/" + std::to_string(units) + " provisioned").c_str()) == 1);
+  // Served side by side: the batch takes the slowest unit, not the sum
+  CHECK(wallS < maxS + 1.0 && wallS < sumS / 2);
+  printf("[TEST] wall %.2f s, slowest unit %.2f s, all units back to back %.2f s\n", wallS, maxS, sumS);
+  if (!lines.empty()) printf("[TEST] %s", lines.back().c_str());
+}
+
+static void testFailures(const char* fleet) {
+  printf("[TEST] failing units are reported, the rest still provisioned\n");
+  std::mt19937 rng(7);
+  std::vector<Dev> devs;
+  if (!openDevs(devs, 5, rng)) {
+    printf("  no pty available (%s) — skipped\n", strerror(errno));
+    closeDevs(devs);
+    return;
+  }
+  devs[1].kind = DEV_RECOGNIZE;
+  devs[2].kind = DEV_FAILS;
+  devs[3].kind = DEV_SILENT;
+  std::vector<std::string> lines;
+  double wallS;
+  int rc = runFleet(fleet, "--timeout 1 --cred 2", devs, { "a", "b", "c", "d", "" }, lines, wallS);
+  closeDevs(devs);
+
+  CHECK(rc == 1);
+  CHECK(countLines(lines, (unitName(devs[0]) + "provisioned: credential 2").c_str()) == 1);
+  CHECK(countLines(lines, (unitName(devs[1]) + "FAILED: in RECOGNIZE mode").c_str()) == 1);
+  CHECK(countLines(lines, (unitName(devs[2]) + "FAILED: registration did not complete").c_str()) == 1);
+  CHECK(countLines(lines, (unitName(devs[3]) + "FAILED: no answer to HELLO").c_str()) == 1);
+  CHECK(countLines(lines, (unitName(devs[4]) + "provisioned").c_str()) == 1);   // empty line: add a finger
+  CHECK(devs[1].provisions == 0 && devs[3].provisions == 0);
+  CHECK(devs[4].password.empty() && devs[4].provisions == 1);
+  CHECK(countLines(lines, "2/5 provisioned") == 1);
+  CHECK(wallS < 3);
+}
+
+static void testStatus(const char* fleet) {
+  printf("[TEST] --status\n");
+  std::mt19937 rng(9);
+  std::vector<Dev> devs;
+  if (!openDevs(devs, 3, rng)) {
+    printf("  no pty available (%s) — skipped\n", strerror(errno));
+    closeDevs(devs);
+    return;
+  }
+  devs[2].kind = DEV_RECOGNIZE;
+  std::vector<std::string> lines;
+  double wallS;
+  int rc = runFleet(fleet, "--status", devs, {}, lines, wallS);
+  closeDevs(devs);
+
+  CHECK(rc == 0);
+  CHECK(countLines(lines, "firmware 1.0.0, REGISTER") == 2);
+  CHECK(countLines(lines, "firmware 1.0.0, RECOGNIZE") == 1);
+  CHECK(countLines(lines, "3/3 answered") == 1);
+  for (const Dev &d : devs) CHECK(d.provisions == 0);
+}
+
+static void testUnplug(const char* fleet) {
+  printf("[TEST] a port that goes away fails its unit at once\n");
+  std::mt19937 rng(11);
+  std::vector<Dev> devs;
+  if (!openDevs(devs, 3, rng)) {
+    printf("  no pty available (%s) — skipped\n", strerror(errno));
+    closeDevs(devs);
+    return;
+  }
+  devs[1].kind = DEV_UNPLUGS;
+  std::vector<std::string> lines;
+  double wallS;
+  int rc = runFleet(fleet, "--timeout 10", devs, { "a", "b", "c" }, lines, wallS);
+  closeDevs(devs);
+
+  CHECK(rc == 1);
+  CHECK(countLines(lines, (unitName(devs[1]) + "FAILED: port closed").c_str()) == 1);
+  CHECK(countLines(lines, (unitName(devs[0]) + "provisioned").c_str()) == 1);
+  CHECK(countLines(lines, (unitName(devs[2]) + "provisioned").c_str()) == 1);
+  CHECK(countLines(lines, "2/3 provisioned") == 1);
+  // Not left spinning on the hangup until --timeout
+  CHECK(wallS < 3);
+  printf("[TEST] wall %.2f s with --timeout 10\n", wallS);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("usage: %s <fp_fleet> [units]\n", argv[0]);
+    return 2;
+  }
+  uint32_t units = argc > 2 ? (uint32_t)atoi(argv[2]) : 32;
+
+  testBatch(argv[1], units);
+  testFailures(argv[1]);
+  testStatus(argv[1]);
+  testUnplug(argv[1]);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
@@ -0,0 +1,67 @@
+// ============================================================
+// fp_image.h — Synthetic fingerprint images (host builds)
+//
+// Stand-in for captures from the ID809: a ridge pattern (whorl,
+// loop or arch, picked by the finger identity) inside an elliptic
+// contact area, ridge contrast fading towards its edge, a bright
+// background and uniform sensor noise of ±noise levels. The same
+// finger always gives the same image, so the sim sensor can hand
+// out "the last capture" and a test can compare what a decoder
+// rebuilt against it.
+//
+// Usage:
+//   fpImageSynth(finger, img, w, h, noise)   — w × h, row-major
+// ============================================================
+#ifndef FP_IMAGE_H
+#define FP_IMAGE_H
+
+#include <stdint.h>
+#include <math.h>
+
+#define FP_IMAGE_BACKGROUND 236
+
+static inline void fpImageSynth(uint8_t finger, uint8_t* img, uint16_t w, uint16_t h, uint8_t noise) {
+  uint32_t rnd = 0x2545F491u ^ ((uint32_t)finger * 2654435761u);
+  auto next = [&rnd] {
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd;
+  };
+
+  const double scale = w / 160.0;
+  const double cx = w * (0.42 + (next() % 17) / 100.0);
+  const double cy = h * (0.40 + (next() % 21) / 100.0);
+  const double ax = w * (0.40 + (next() % 9) / 100.0);   // contact ellipse
+  const double ay = h * (0.46 + (next() % 7) / 100.0);
+  const double period = scale * (7.5 + (next() % 30) / 10.0);
+  const double warp = 2.0 + (next() % 20) / 10.0;
+  const double twist = (next() % 628) / 100.0;
+  const uint8_t pattern = finger % 3;
+
+  for (uint16_t y = 0; y < h; y++) {
+    for (uint16_t x = 0; x < w; x++) {
+      double dx = x - cx, dy = y - cy;
+      double e = (dx * dx) / (ax * ax) + (dy * dy) / (ay * ay);
+      double v = FP_IMAGE_BACKGROUND;
+      if (e < 1.0) {
+        double phase;
+        if (pattern == 0) {          // whorl: rings around the core
+          phase = sqrt(dx * dx * 1.3 + dy * dy) / period;
+        } else if (pattern == 1) {   // loop: rings opening downwards
+          double r = sqrt(dx * dx + dy * dy);
+          phase = (dy > 0 ? dy + 0.35 * fabs(dx) : r) / period;
+        } else {                     // arch: waves bent over the core
+          phase = (dy + 14.0 * scale * exp(-(dx * dx) / (2 * 30.0 * 30.0 * scale * scale))) / period;
+        }
+        phase += warp * 0.1 * sin(dx / (19.0 * scale) + twist) + 0.15 * sin(dy / (23.0 * scale));
+        double contrast = 95.0 * (1.0 - e * e);   // pressure fades at the edge
+        v = 140.0 + contrast * cos(2 * M_PI * phase);
+      }
+      if (noise) v += (int)(next() % (2u * noise + 1)) - (int)noise;
+      img[(uint32_t)y * w + x] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+  }
+}
+
+#endif // FP_IMAGE_H
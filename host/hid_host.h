@@ -0,0 +1,79 @@
+// ============================================================
+// hid_host.h — What a Mac types for a keyboard report stream (host builds)
+//
+// Reads reports the way the host does: a key that is down now and
+// wasn't in the last report types the character its layout puts
+// under the report's Shift/Option state (hid_layouts.h, read
+// backwards). A dead key types nothing until the next key: Space
+// gives the accent alone, anything else gives the accent and then
+// that key's character. Keys with Control or Command held are
+// shortcuts and type nothing; Return types nothing; a key the
+// layout has no ASCII for types '?'.
+//
+// Usage:
+//   HidHost host(layout);
+//   host.report(mods, keys, typed)   — keys[6] as in the boot report
+// ============================================================
+#ifndef HID_HOST_H
+#define HID_HOST_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "hid_layouts.h"
+
+#define HID_USAGE_RETURN 0x28
+
+// ─── Reverse lookup: the character for usage + Shift/Option, 0 = none ───
+static inline char hidHostChar(uint8_t layout, uint8_t mods, uint8_t usage, bool* dead = nullptr) {
+  uint8_t want = ((mods & (HID_MOD_LSHIFT | HID_MOD_RSHIFT)) ? HID_MOD_LSHIFT : 0) | (mods & HID_MOD_LALT);
+  if (!usage || layout >= HID_LAYOUTS) return 0;
+  for (uint8_t i = 0; i < 95; i++) {
+    HidKey k = _hidLayoutTables[layout].key[i];
+    if ((k.usage & ~HID_KEY_DEAD) == usage && k.mods == want) {
+      if (dead) *dead = k.usage & HID_KEY_DEAD;
+      return (char)(0x20 + i);
+    }
+  }
+  return 0;
+}
+
+struct HidHost {
+  uint8_t layout;
+  uint8_t down[6] = {};
+  char pending = 0;   // dead key waiting for the next one
+
+  explicit HidHost(uint8_t l = HID_LAYOUT_US) : layout(l) {}
+
+  void report(uint8_t mods, const uint8_t keys[6], std::string &typed) {
+    for (uint8_t i = 0; i < 6; i++) {
+      uint8_t k = keys[i];
+      if (!k || memchr(down, k, sizeof(down))) continue;
+      press(mods, k, typed);
+    }
+    memcpy(down, keys, sizeof(down));
+  }
+
+private:
+  void press(uint8_t mods, uint8_t usage, std::string &typed) {
+    if (mods & (HID_MOD_LCTRL | HID_MOD_LGUI)) return;
+    char accent = pending;
+    pending = 0;
+    if (usage == HID_USAGE_RETURN) {
+      if (accent) typed += accent;
+      return;
+    }
+    bool dead = false;
+    char c = hidHostChar(layout, mods, usage, &dead);
+    if (accent) {
+      typed += accent;
+      if (usage == HID_USAGE_SPACE && !(mods & HID_MOD_LALT)) return;   // Space: the accent alone
+    }
+    if (!c) typed += '?';
+    else if (dead) pending = c;
+    else typed += c;
+  }
+};
+
+#endif // HID_HOST_H
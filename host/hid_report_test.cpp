@@ -0,0 +1,293 @@
+// ============================================================
+// hid_report_test.cpp — Report builder, keyboard layouts + benchmark
+//
+// 1. Every printable character, alone and between neighbours,
+//    comes out of a modelled Mac (hid_host.h) exactly as written,
+//    through every layout
+// 2. Layout spot checks: QWERTZ / AZERTY letters, Option and dead
+//    keys, names
+// 3. Repeated keys are released in between, Shift changes only
+//    with a key that needs it, the train ends all-up, the count
+//    stays within HID_REPORTS_MAX
+// 4. Random passwords up to PASSWORD_MAX_LEN round-trip per layout
+// 5. 32-character passwords: reports and wire time of the report
+//    train against Keyboard.print() (press + all-up report per
+//    character), build time per password; per-character lookup
+//    cost of the compiled tables against scanning the layout's key
+//    definitions at run time
+// ============================================================
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "hid_report.h"
+#include "hid_host.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+static double nowUs() {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ─── What a Mac with this layout types for the reports ───
+static std::string hostReads(const std::vector<HidReport> &reports, uint8_t layout = HID_LAYOUT_US) {
+  HidHost host(layout);
+  std::string typed;
+  for (const HidReport &r : reports) {
+    uint8_t keys[6] = { r.key };
+    host.report(r.mods, keys, typed);
+  }
+  return typed;
+}
+
+static std::vector<HidReport> build(const std::string &text, uint8_t layout = HID_LAYOUT_US) {
+  std::vector<HidReport> out(HID_REPORTS_MAX(text.size()));
+  out.resize(hidReportBuild(text.c_str(), out.data(), layout));
+  return out;
+}
+
+// ─── What Keyboard.print() sends: press (mods + key), then all up ───
+// Its table is the US one.
+static std::vector<HidReport> buildPrint(const std::string &text) {
+  std::vector<HidReport> out;
+  for (char c : text) {
+    HidKey k = hidKeyFor(HID_LAYOUT_US, c);
+    if (!k.usage) continue;
+    out.push_back(HidReport { k.mods, k.usage });
+    out.push_back(HidReport { 0, 0 });
+  }
+  return out;
+}
+
+// ============================================================
+// 1. Every printable character, every layout
+// ============================================================
+static void testCharacters() {
+  for (uint8_t l = 0; l < HID_LAYOUTS; l++) {
+    printf("[TEST] every printable character, %s\n", hidLayoutName(l));
+    for (int c = 0x20; c <= 0x7E; c++) {
+      std::string one(1, (char)c);
+      HidKey k = hidKeyFor(l, (char)c);
+      bool dead = false;
+      CHECK(k.usage != 0);
+      CHECK(hidHostChar(l, k.mods, k.usage & ~HID_KEY_DEAD, &dead) == (char)c);
+      CHECK(dead == ((k.usage & HID_KEY_DEAD) != 0));
+      CHECK(hostReads(build(one, l), l) == one);
+      if (l == HID_LAYOUT_US) CHECK(hostReads(buildPrint(one)) == one);
+      bool ok = true;
+      for (int d = 0x20; d <= 0x7E; d++) {
+        std::string two = one + (char)d + one;
+        ok &= hostReads(build(two, l), l) == two;
+      }
+      CHECK(ok);
+    }
+    CHECK(hidKeyFor(l, '\n').usage == 0 && hidKeyFor(l, '\x7F').usage == 0 && hidKeyFor(l, (char)0xE9).usage == 0);
+    CHECK(build("", l).empty());
+    CHECK(hostReads(build("a\tb\x01" "c", l), l) == "abc");   // no key: skipped like print()
+  }
+  CHECK(hidKeyFor(HID_LAYOUTS, 'a').usage == 0);
+}
+
+// ============================================================
+// 2. Layout spot checks
+// ============================================================
+static bool is(uint8_t layout, char c, uint8_t usage, uint8_t mods) {
+  HidKey k = hidKeyFor(layout, c);
+  return k.usage == usage && k.mods == mods;
+}
+
+static void testLayouts() {
+  printf("[TEST] layout spot checks\n");
+  const uint8_t S = HID_MOD_LSHIFT, O = HID_MOD_LALT, D = HID_KEY_DEAD;
+  CHECK(is(HID_LAYOUT_US, 'z', 0x1D, 0) && is(HID_LAYOUT_US, '#', 0x20, S) && is(HID_LAYOUT_US, '~', 0x35, S));
+  CHECK(is(HID_LAYOUT_UK, '#', 0x20, O) && is(HID_LAYOUT_UK, '"', 0x34, S) && is(HID_LAYOUT_UK, '@', 0x1F, S));
+  CHECK(is(HID_LAYOUT_DE, 'z', 0x1C, 0) && is(HID_LAYOUT_DE, 'Y', 0x1D, S) && is(HID_LAYOUT_DE, '@', 0x0F, O));
+  CHECK(is(HID_LAYOUT_DE, '\\', 0x24, S | O) && is(HID_LAYOUT_DE, '^', 0x64 | D, 0) && is(HID_LAYOUT_DE, '~', 0x11 | D, O));
+  CHECK(is(HID_LAYOUT_FR, 'a', 0x14, 0) && is(HID_LAYOUT_FR, 'm', 0x33, 0) && is(HID_LAYOUT_FR, '1', 0x1E, S));
+  CHECK(is(HID_LAYOUT_FR, ',', 0x10, 0) && is(HID_LAYOUT_FR, '@', 0x64, 0) && is(HID_LAYOUT_FR, '[', 0x22, S | O));
+  CHECK(is(HID_LAYOUT_CH, '@', 0x0A, O) && is(HID_LAYOUT_CH, '+', 0x1E, S) && is(HID_LAYOUT_CH, '`', 0x2E | D, S));
+
+  // Dead key, then Space for the accent alone
+  std::vector<HidReport> r = build("^", HID_LAYOUT_DE);
+  CHECK(r.size() == 3 && r[0].key == 0x64 && r[1].key == HID_USAGE_SPACE && r[1].mods == 0 && r[2].key == 0);
+  r = build("n~", HID_LAYOUT_DE);   // same key: released before Option+N
+  CHECK(r.size() == 5 && r[1].key == 0 && r[2].key == 0x11 && r[2].mods == HID_MOD_LALT);
+  CHECK(hostReads(build("^^ ~", HID_LAYOUT_FR), HID_LAYOUT_FR) == "^^ ~");
+
+  // The same reports mean something else on another layout
+  CHECK(hostReads(build("yz"), HID_LAYOUT_DE) == "zy");
+  CHECK(hostReads(build("qa"), HID_LAYOUT_FR) == "aq");
+
+  CHECK(hidLayoutFind("de") == HID_LAYOUT_DE && hidLayoutFind("CH") == HID_LAYOUT_CH && hidLayoutFind("Fr") == HID_LAYOUT_FR);
+  CHECK(hidLayoutFind("XX") == HID_LAYOUTS && hidLayoutFind("D") == HID_LAYOUTS && hidLayoutFind("DEU") == HID_LAYOUTS);
+  CHECK(strcmp(hidLayoutName(HID_LAYOUT_UK), "UK") == 0 && strcmp(hidLayoutName(HID_LAYOUTS), "?") == 0);
+}
+
+// ============================================================
+// 3. Shape of the train
+// ============================================================
+static void testShape() {
+  printf("[TEST] report shape\n");
+  std::vector<HidReport> r = build("oo");
+  CHECK(r.size() == 4 && r[1].key == 0);   // {o} {} {o} {}
+
+  r = build("ABC");   // Shift held across the run, no report of its own
+  CHECK(r.size() == 4);
+  for (size_t i = 0; i < 3; i++) CHECK(r[i].mods == HID_MOD_LSHIFT && r[i].key);
+
+  r = build("aBc");
+  CHECK(r.size() == 4 && r[0].mods == 0 && r[1].mods == HID_MOD_LSHIFT && r[2].mods == 0);
+
+  r = build("AA");    // same key again: released with Shift still down
+  CHECK(r.size() == 4 && r[1].key == 0 && r[1].mods == HID_MOD_LSHIFT);
+
+  std::mt19937 rng(11);
+  for (uint8_t l = 0; l < HID_LAYOUTS; l++) {
+    for (int i = 0; i < 20000; i++) {
+      std::string pw;
+      for (int n = 1 + rng() % PASSWORD_MAX_LEN; n > 0; n--) pw += (char)(0x20 + rng() % 95);
+      r = build(pw, l);
+      CHECK(r.size() <= HID_REPORTS_MAX(pw.size()));
+      CHECK(r.back().key == 0 && r.back().mods == 0);
+      for (size_t k = 1; k + 1 < r.size(); k++) {
+        CHECK(r[k].key != 0 || r[k - 1].key == r[k + 1].key);   // releases only between equal keys
+        CHECK(r[k].mods == r[k - 1].mods || r[k].key != 0);     // modifiers never change alone
+      }
+    }
+  }
+  std::string worst;   // a dead key on the key just used: release, key, Space
+  while (worst.size() < PASSWORD_MAX_LEN) worst += "n~";
+  CHECK(build(worst, HID_LAYOUT_DE).size() == HID_REPORTS_MAX(PASSWORD_MAX_LEN));
+}
+
+// ============================================================
+// 4. Random passwords
+// ============================================================
+static void testRandom() {
+  printf("[TEST] random passwords round trip, every layout\n");
+  std::mt19937 rng(5);
+  for (uint8_t l = 0; l < HID_LAYOUTS; l++) {
+    bool ok = true;
+    for (int i = 0; i < 20000; i++) {
+      std::string pw;
+      for (int n = 1 + rng() % PASSWORD_MAX_LEN; n > 0; n--) pw += (char)(0x20 + rng() % 95);
+      ok &= hostReads(build(pw, l), l) == pw;
+    }
+    CHECK(ok);
+  }
+}
+
+// ============================================================
+// 5. Benchmark
+// ============================================================
+
+// ─── What a run-time table would do: walk the key definitions ───
+static HidKey scanDefs(const HidLayoutDef &d, char c) {
+  for (uint8_t i = 0; i < 26; i++) {
+    if (d.letters[i] < 'a' || d.letters[i] > 'z') continue;
+    if (d.letters[i] == c) return HidKey { (uint8_t)(HID_USAGE_A + i), 0 };
+    if (d.letters[i] - 'a' + 'A' == c) return HidKey { (uint8_t)(HID_USAGE_A + i), HID_MOD_LSHIFT };
+  }
+  const uint8_t mods[4] = { 0, HID_MOD_LSHIFT, HID_MOD_LALT, HID_MOD_LSHIFT | HID_MOD_LALT };
+  for (uint8_t level = 0; level < 4; level++) {
+    for (uint8_t i = 0; i < d.count; i++) {
+      const HidKeyDef &k = d.keys[i];
+      char e = level == 0 ? k.plain : level == 1 ? k.shift : level == 2 ? k.option : k.shiftOption;
+      if (e == c) return HidKey { k.usage, mods[level] };
+    }
+  }
+  return HidKey { 0, 0 };
+}
+
+static void benchLookup() {
+  printf("[BENCH] per-character lookup, 95 printable characters\n");
+  printf("[BENCH] layout   table ns   scan ns\n");
+  for (uint8_t l = 0; l < HID_LAYOUTS; l++) {
+    const HidLayoutDef &def = _hidLayoutDefs[l];
+    for (int c = 0x20; c <= 0x7E; c++) {   // the scan finds the same keys (dead flag aside)
+      HidKey a = hidKeyFor(l, (char)c), b = scanDefs(def, (char)c);
+      CHECK((a.usage & ~HID_KEY_DEAD) == b.usage && a.mods == b.mods);
+    }
+
+    volatile uint8_t sink = 0;
+    double took[2] = { 0, 0 };
+    uint32_t reps[2] = { 0, 0 };
+    for (int way = 0; way < 2; way++) {
+      double t0 = nowUs();
+      while ((took[way] = nowUs() - t0) < 20000) {
+        for (int i = 0; i < 100; i++) {
+          for (int c = 0x20; c <= 0x7E; c++) {
+            HidKey k = way ? scanDefs(def, (char)c) : hidKeyFor(l, (char)c);
+            sink = sink + k.usage;
+          }
+        }
+        reps[way] += 100 * 95;
+      }
+    }
+    printf("[BENCH] %-6s  %9.2f  %8.2f\n", def.name, took[0] * 1000.0 / reps[0], took[1] * 1000.0 / reps[1]);
+  }
+}
+static void bench() {
+  printf("[BENCH] 32 characters; one report per %u us poll (sendReport waits for the endpoint)\n",
+         HID_POLL_INTERVAL_US);
+  printf("[BENCH] password             print: reports   ms    train: reports   ms   build ns\n");
+
+  std::mt19937 rng(3);
+  std::string random;
+  for (int i = 0; i < 32; i++) random += (char)(0x20 + rng() % 95);
+  struct { const char* name; std::string pw; } sets[] = {
+    { "lowercase",       "correcthorsebatterystaplezebrafx" },
+    { "words + caps",    "Correct-Horse-Battery-Staple-42!" },
+    { "alternating case", "aBcDeFgHiJkLmNoPqRsTuVwXyZaBcDeF" },
+    { "all caps",        "CORRECTHORSEBATTERYSTAPLEZEBRAFX" },
+    { "doubled letters", "aabbccddeeffgghhiijjkkllmmnnoopp" },
+    { "one key",         "11111111111111111111111111111111" },
+    { "random printable", random },
+  };
+
+  for (auto &set : sets) {
+    CHECK(set.pw.size() == 32);
+    std::vector<HidReport> printed = buildPrint(set.pw), train = build(set.pw);
+    CHECK(hostReads(printed) == set.pw && hostReads(train) == set.pw);
+
+    HidReport out[HID_REPORTS_MAX(PASSWORD_MAX_LEN)];
+    volatile size_t sink = 0;
+    uint32_t reps = 0;
+    double t0 = nowUs(), took = 0;
+    while ((took = nowUs() - t0) < 20000) {
+      for (int i = 0; i < 100; i++) sink = sink + hidReportBuild(set.pw.c_str(), out);
+      reps += 100;
+    }
+
+    // Wire time: print() waits a poll per report; the train sends one per
+    // HID_REPORT_INTERVAL_US
+    printf("[BENCH] %-18s  %13zu  %5.1f  %13zu  %5.1f  %8.1f\n", set.name, printed.size(),
+           printed.size() * HID_POLL_INTERVAL_US / 1000.0, train.size(),
+           train.size() * HID_REPORT_INTERVAL_US / 1000.0, took * 1000.0 / reps);
+  }
+}
+
+int main() {
+  testCharacters();
+  testLayouts();
+  testShape();
+  testRandom();
+  bench();
+  benchLookup();
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
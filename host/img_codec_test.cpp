@@ -0,0 +1,264 @@
+// ============================================================
+// img_codec_test.cpp — Image row code + benchmark
+//
+//   img_codec_test [image.pgm ...]
+//
+// 1. Round trip of synthetic fingerprints (fp_image.h) at 160×160
+//    and 80×80 for every shift up to IMAGE_SHIFT_MAX: exact at
+//    shift 0, the same quantization step otherwise
+// 2. Noise, flat, gradient and mixed rows at widths 1..255 never
+//    code beyond IMG_ROW_MAX(w) and come back unchanged
+// 3. Truncated, overlong and empty input is refused
+// 4. Per image and shift: coded size, ratio, encode / decode time
+//    per frame, and wire bytes of the whole stream (COBS frames,
+//    ctl_proto.h) against the same rows sent uncoded. Binary PGM
+//    files on the command line (captures saved from the monitor)
+//    are measured the same way instead of the synthetic set.
+// ============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "ctl_proto.h"
+#include "img_codec.h"
+#include "fp_image.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+static double nowUs() {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Image {
+  std::string name;
+  uint16_t w, h;
+  std::vector<uint8_t> px;
+};
+
+static Image synth(uint8_t finger, uint16_t side) {
+  std::string dims = std::to_string(side) + "x" + std::to_string(side);
+  Image img { "synth " + std::to_string(finger) + " " + dims, side, side, {} };
+  img.px.resize((size_t)side * side);
+  fpImageSynth(finger, img.px.data(), side, side, 3);
+  return img;
+}
+
+// ─── Binary PGM (P5, maxval ≤ 255), up to 255 × 255 (one-byte w, h, row) ───
+static bool loadPgm(const char* path, Image &img) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  unsigned w = 0, h = 0, maxval = 0;
+  bool ok = fscanf(f, "P5 %u %u %u", &w, &h, &maxval) == 3 && fgetc(f) != EOF &&
+            w >= 1 && w <= 255 && h >= 1 && h <= 255 && maxval <= 255;
+  if (ok) {
+    img = Image { path, (uint16_t)w, (uint16_t)h, std::vector<uint8_t>((size_t)w * h) };
+    ok = fread(img.px.data(), 1, img.px.size(), f) == img.px.size();
+  }
+  fclose(f);
+  return ok;
+}
+
+// Decoded pixel must fall in the original's quantization step
+static bool sameStep(const uint8_t* a, const uint8_t* b, uint16_t w, uint8_t shift) {
+  for (uint16_t x = 0; x < w; x++) {
+    if ((a[x] >> shift) != (b[x] >> shift)) return false;
+  }
+  return true;
+}
+
+static bool roundTrip(const uint8_t* px, uint16_t w, uint8_t shift, size_t* coded = nullptr) {
+  uint8_t out[IMG_ROW_MAX(255)];
+  uint8_t back[255];
+  size_t n = imgEncodeRow(px, w, shift, out);
+  if (coded) *coded = n;
+  return n <= (size_t)IMG_ROW_MAX(w) && imgDecodeRow(out, n, w, shift, back) && sameStep(px, back, w, shift);
+}
+
+// ============================================================
+// 1. Synthetic fingerprints
+// ============================================================
+static void testImages() {
+  printf("[TEST] round trip, synthetic images\n");
+  for (uint16_t side : { 160, 80 }) {
+    for (uint8_t finger = 1; finger <= 9; finger++) {
+      Image img = synth(finger, side);
+      for (uint8_t shift = 0; shift <= IMAGE_SHIFT_MAX; shift++) {
+        bool ok = true;
+        for (uint16_t y = 0; y < img.h; y++) ok &= roundTrip(&img.px[(size_t)y * img.w], img.w, shift);
+        CHECK(ok);
+      }
+    }
+  }
+
+  // Shift 0 is lossless, byte for byte
+  Image img = synth(4, 160);
+  uint8_t out[IMG_ROW_MAX(160)], back[160];
+  size_t n = imgEncodeRow(&img.px[80 * 160], 160, 0, out);
+  CHECK(imgDecodeRow(out, n, 160, 0, back));
+  CHECK(memcmp(back, &img.px[80 * 160], 160) == 0);
+}
+
+// ============================================================
+// 2. Worst cases and odd widths
+// ============================================================
+static void testRows() {
+  printf("[TEST] round trip + size bound, widths 1..255\n");
+  std::mt19937 rng(7);
+  uint8_t px[255];
+  size_t worst = 0;
+  uint16_t worstW = 0;
+
+  for (uint16_t w = 1; w <= 255; w++) {
+    for (int kind = 0; kind < 5; kind++) {
+      for (int rep = 0; rep < 20; rep++) {
+        uint8_t v = (uint8_t)rng();
+        for (uint16_t x = 0; x < w; x++) {
+          switch (kind) {
+            case 0: px[x] = (uint8_t)rng(); break;                 // noise
+            case 1: px[x] = 200; break;                            // flat
+            case 2: px[x] = (uint8_t)(x * 3 + rep); break;         // gradient
+            case 3: {                                              // zero / small / big mix
+              uint32_t r = rng() % 3;
+              v = (uint8_t)(v + (r == 0 ? 0 : r == 1 ? (int)(rng() % 16) - 8 : 64 + rng() % 128));
+              px[x] = v;
+              break;
+            }
+            default: {                                             // short runs that barely pay
+              uint32_t r = (x / (1 + rng() % 4)) % 3;
+              v = (uint8_t)(v + (r == 0 ? 0 : r == 1 ? 5 : 100));
+              px[x] = v;
+              break;
+            }
+          }
+        }
+        for (uint8_t shift = 0; shift <= IMAGE_SHIFT_MAX; shift++) {
+          size_t n = 0;
+          bool ok = roundTrip(px, w, shift, &n);
+          if (!ok) printf("  width %u kind %d shift %u: %zu bytes\n", w, kind, shift, n);
+          CHECK(ok);
+          if (n > w && n - w > worst) { worst = n - w; worstW = w; }
+        }
+      }
+    }
+  }
+  printf("  largest row: width + %zu bytes (width %u), bound width + ceil(width / 64)\n", worst, worstW);
+}
+
+// ============================================================
+// 3. Malformed input
+// ============================================================
+static void testMalformed() {
+  printf("[TEST] malformed rows\n");
+  Image img = synth(2, 160);
+  const uint8_t* row = &img.px[70 * 160];
+  uint8_t out[IMG_ROW_MAX(160)], back[160];
+  size_t n = imgEncodeRow(row, 160, 0, out);
+
+  for (size_t cut = 0; cut < n; cut++) CHECK(!imgDecodeRow(out, cut, 160, 0, back));
+  CHECK(!imgDecodeRow(out, n, 159, 0, back));   // more pixels than the row holds
+  CHECK(!imgDecodeRow(out, n, 161, 0, back));   // fewer
+
+  const uint8_t literal[] = { 0x03, 1, 2 };     // 4 bytes announced, 2 present
+  CHECK(!imgDecodeRow(literal, sizeof(literal), 4, 0, back));
+  const uint8_t small[] = { 0x83 };             // 4 nibbles announced, none present
+  CHECK(!imgDecodeRow(small, sizeof(small), 4, 0, back));
+  const uint8_t zeros[] = { 0x7F };             // 64 zeros into a 10-pixel row
+  CHECK(!imgDecodeRow(zeros, sizeof(zeros), 10, 0, back));
+}
+
+// ============================================================
+// 4. Ratio, time and wire bytes per frame
+// ============================================================
+static size_t wireBytes(uint8_t type, const uint8_t* body, size_t len) {
+  uint8_t out[CTL_MAX_WIRE];
+  return ctlEncode(type, 0, body, len, out);
+}
+
+static void bench(const std::vector<Image> &images) {
+  printf("[BENCH] per frame: coded rows vs raw pixels; wire = COBS frames incl. headers\n");
+  printf("[BENCH] image            shift   raw B  coded B  ratio   wire B  raw wire B  "
+         "115200 ms (raw)  enc us  dec us\n");
+
+  for (const Image &img : images) {
+    for (uint8_t shift = 0; shift <= IMAGE_SHIFT_MAX; shift++) {
+      const uint8_t head[4] = { 1, (uint8_t)img.w, (uint8_t)img.h, shift };
+      uint8_t body[2 + IMG_ROW_MAX(255)];
+      uint8_t back[255];
+      size_t coded = 0;
+      size_t wire = wireBytes(CTL_EVT_IMAGE, head, sizeof(head));
+      size_t rawWire = wire;
+
+      for (uint16_t y = 0; y < img.h; y++) {
+        const uint8_t* row = &img.px[(size_t)y * img.w];
+        body[0] = 1;
+        body[1] = (uint8_t)y;
+        size_t n = imgEncodeRow(row, img.w, shift, body + 2);
+        coded += n;
+        wire += wireBytes(CTL_EVT_IMAGE_ROW, body, 2 + n);
+        memcpy(body + 2, row, img.w);
+        rawWire += wireBytes(CTL_EVT_IMAGE_ROW, body, 2 + img.w);
+      }
+
+      // Timing: repeat the frame until a few ms have passed
+      uint8_t out[IMG_ROW_MAX(255)];
+      uint32_t reps = 0;
+      double encUs = 0, decUs = 0;
+      volatile size_t sink = 0;
+      while (encUs < 20000) {
+        double t0 = nowUs();
+        for (uint16_t y = 0; y < img.h; y++) sink = sink + imgEncodeRow(&img.px[(size_t)y * img.w], img.w, shift, out);
+        double t1 = nowUs();
+        bool ok = true;
+        for (uint16_t y = 0; y < img.h; y++) {
+          size_t n = imgEncodeRow(&img.px[(size_t)y * img.w], img.w, shift, out);
+          double d0 = nowUs();
+          ok &= imgDecodeRow(out, n, img.w, shift, back);
+          decUs += nowUs() - d0;
+        }
+        CHECK(ok);
+        encUs += t1 - t0;
+        reps++;
+      }
+
+      size_t raw = (size_t)img.w * img.h;
+      printf("[BENCH] %-16s %5u  %6zu  %7zu  %4.1f%%  %7zu  %10zu  %6.0f (%6.0f)  %6.1f  %6.1f\n",
+             img.name.c_str(), shift, raw, coded, 100.0 * coded / raw, wire, rawWire,
+             wire * 10 * 1000.0 / 115200, rawWire * 10 * 1000.0 / 115200, encUs / reps, decUs / reps);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  testImages();
+  testRows();
+  testMalformed();
+
+  std::vector<Image> images;
+  for (int i = 1; i < argc; i++) {
+    Image img;
+    if (loadPgm(argv[i], img)) images.push_back(img);
+    else printf("[BENCH] %s: not a binary PGM up to 255 × 255, skipped\n", argv[i]);
+  }
+  if (argc <= 1) {
+    for (uint8_t finger : { 1, 2, 3 }) images.push_back(synth(finger, 160));
+    images.push_back(synth(1, 80));
+  }
+  bench(images);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
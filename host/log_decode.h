@@ -0,0 +1,62 @@
+// ============================================================
+// log_decode.h — CTL_EVT_LOG records → text on the host
+//
+// The device sends a format ID and raw arguments (log_ring.h). The
+// formats come from CTL_REQ_LOG_FMT replies and are cached here.
+// Rendering goes through the device's own logFormat(), so a record
+// decodes to exactly the line text mode would have printed.
+//
+// Usage:
+//   LogDecoder d;
+//   d.learn(body, len)               — CTL_REQ_LOG_FMT reply body
+//   d.known(id) / LogDecoder::idOf(body, len)
+//   d.decode(body, len, ms, text)    — CTL_EVT_LOG body
+// ============================================================
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "log_ring.h"
+
+struct LogDecoder {
+  std::map<uint8_t, std::string> formats;
+
+  bool known(uint8_t id) const { return formats.count(id) != 0; }
+
+  void learn(const uint8_t* body, size_t len) {
+    if (len >= 1) formats[body[0]] = std::string((const char*)body + 1, len - 1);
+  }
+
+  // Format ID of a record, 0 if the body is too short
+  static uint8_t idOf(const uint8_t* body, size_t len) { return len >= 5 ? body[4] : 0; }
+
+  // False if the body is short or its format is not known yet
+  bool decode(const uint8_t* body, size_t len, uint32_t &ms, std::string &text) const {
+    if (len < 5) return false;
+    auto it = formats.find(body[4]);
+    if (it == formats.end()) return false;
+
+    ms = ctlGet32(body);
+    size_t o = 5;
+    char line[LOG_LINE_MAX + 1];
+    size_t n = logFormat(line, sizeof(line), it->second.c_str(), [&](char conv, LogArg &a) {
+      if (conv == 's') {
+        if (o >= len || o + 1 + body[o] > len) return false;
+        a.n = body[o++];
+        a.s = (const char*)body + o;
+        o += a.n;
+      } else if (conv == 'c') {
+        if (o >= len) return false;
+        a.v = body[o++];
+      } else {
+        if (o + 4 > len) return false;
+        a.v = ctlGet32(body + o);
+        o += 4;
+      }
+      return true;
+    });
+    text.assign(line, n);
+    return true;
+  }
+};
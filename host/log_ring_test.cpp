@@ -0,0 +1,417 @@
+// ============================================================
+// log_ring_test.cpp — Deferred log ring + host decoder + benchmark
+//
+//   log_ring_test [fp_console path] [calls]
+//
+// 1. logFormat() against snprintf for every supported conversion
+// 2. Ring order, drop counting and the drop marker
+// 3. The drain never splits a line: it writes whole records while
+//    Serial.availableForWrite() has room, and stops otherwise
+// 4. Binary records (CTL_EVT_LOG) decode to the same text
+// 5. fp_console end to end over a pty pair: HELLO, LOG_MODE, format
+//    fetches, decoded lines, text mode restored on exit
+// 6. Cost per call: LOG() vs the Serial.print sequence it replaces,
+//    and the drain's cost per record in both encodings
+// ============================================================
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log_ring.h"
+#include "log_decode.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+// ============================================================
+// Arduino surface: a settable clock and a Serial with a TX budget
+// ============================================================
+
+static uint32_t _fakeMs = 0;
+static std::string _tx;        // everything the device wrote
+static int _txRoom = 1 << 20;  // availableForWrite()
+
+unsigned long millis() { return _fakeMs; }
+unsigned long micros() { return _fakeMs * 1000UL; }
+
+SerialPort Serial, Serial1;
+size_t SerialPort::write(uint8_t c) { _tx += (char)c; if (_txRoom > 0) _txRoom--; return 1; }
+int SerialPort::available() { return 0; }
+int SerialPort::read() { return -1; }
+int SerialPort::availableForWrite() { return _txRoom; }
+
+static double nowUs() {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void resetRing() {
+  _log_head = _log_tail = 0;
+  _log_gap = 0;
+  _log_dropped = 0;
+  _log_binary = false;
+  _ctl_session = false;
+  _tx.clear();
+  _txRoom = 1 << 20;
+}
+
+// Text the drain produced, split into lines
+static std::vector<std::string> txLines() {
+  std::vector<std::string> lines;
+  size_t at = 0, nl;
+  while ((nl = _tx.find("\r\n", at)) != std::string::npos) {
+    lines.push_back(_tx.substr(at, nl - at));
+    at = nl + 2;
+  }
+  return lines;
+}
+
+// ============================================================
+
+static void testFormat() {
+  printf("[TEST] logFormat vs snprintf\n");
+  static const char* const ints[] = {
+    "%u", "%d", "%i", "%x", "%X", "%5u", "%-5d|", "%08X", "%05d", "%3d", "%lu", "%-3x|"
+  };
+  static const uint32_t edges[] = { 0u, 1u, 0x7FFFFFFFu, 0xFFFFFFFFu };
+  std::mt19937 rng(3);
+  for (const char* f : ints) {
+    for (int i = 0; i < 2000; i++) {
+      uint32_t v = i < 4 ? edges[i] : (uint32_t)rng() >> (rng() % 32);
+      if (rng() & 1) v = (uint32_t)-(int32_t)v;
+      char want[64], got[64];
+      bool isSigned = strpbrk(f, "di") != nullptr;
+      if (f[1] == 'l') snprintf(want, sizeof(want), f, (unsigned long)v);
+      else if (isSigned) snprintf(want, sizeof(want), f, (int)(int32_t)v);
+      else snprintf(want, sizeof(want), f, (unsigned)v);
+      logFormat(got, sizeof(got), f, [&](char, LogArg &a) { a.v = v; return true; });
+      if (strcmp(want, got) != 0) {
+        printf("  %s with 0x%08X: want \"%s\" got \"%s\"\n", f, v, want, got);
+        _failures++;
+        break;
+      }
+    }
+  }
+
+  char got[64], want[64];
+  const char* s = "RECOGNIZE";
+  for (const char* f : { "%s", "[%12s]", "[%-12s]", "[%3s]" }) {
+    snprintf(want, sizeof(want), f, s);
+    logFormat(got, sizeof(got), f, [&](char, LogArg &a) { a.s = s; a.n = (uint16_t)strlen(s); return true; });
+    CHECK(strcmp(want, got) == 0);
+  }
+  logFormat(got, sizeof(got), "%c%c 100%%", [](char, LogArg &a) { a.v = 'o'; return true; });
+  CHECK(strcmp(got, "oo 100%") == 0);
+  logFormat(got, sizeof(got), "a %u b %u", [](char, LogArg &) { return false; });
+  CHECK(strcmp(got, "a ? b ?") == 0);
+  logFormat(got, 8, "0123456789", [](char, LogArg &) { return false; });
+  CHECK(strcmp(got, "0123456") == 0);
+}
+
+static void testRing() {
+  printf("[TEST] ring order, drops, marker\n");
+  resetRing();
+  for (uint32_t i = 0; i < LOG_RING_SLOTS + 10; i++) {
+    _fakeMs = i;
+    LOG("[T] record %u", i);
+  }
+  CHECK(logPending() == LOG_RING_SLOTS);
+  CHECK(_log_dropped == 10);
+
+  logDrain();
+  LOG("[T] after the gap");
+  logDrain();
+  std::vector<std::string> lines = txLines();
+  CHECK(lines.size() == LOG_RING_SLOTS + 2);
+  CHECK(lines.front() == "[T] record 0");
+  CHECK(lines[LOG_RING_SLOTS - 1] == "[T] record " + std::to_string(LOG_RING_SLOTS - 1));
+  CHECK(lines[LOG_RING_SLOTS] == "[LOG] 10 record(s) dropped");
+  CHECK(lines.back() == "[T] after the gap");
+  CHECK(logPending() == 0);
+
+  // A gap with no later LOG() still gets its marker from logFlush
+  resetRing();
+  for (uint32_t i = 0; i < LOG_RING_SLOTS + 1; i++) LOG("[T] x");
+  logFlush();
+  CHECK(txLines().back() == "[LOG] 1 record(s) dropped");
+
+  // Mixed argument kinds
+  resetRing();
+  int8_t neg = -7;
+  bool on = true;
+  LOG("[T] %d %u %c %s", neg, on, 'Z', "str");
+  logFlush();
+  CHECK(txLines().size() == 1 && txLines()[0] == "[T] -7 1 Z str");
+}
+
+static void testBudget() {
+  printf("[TEST] drain stops at availableForWrite\n");
+  resetRing();
+  for (int i = 0; i < 5; i++) LOG("[T] twelve %u", i);   // 12 chars + CRLF each
+  _txRoom = 40;
+  logDrain();
+  CHECK(_tx == "[T] twelve 0\r\n[T] twelve 1\r\n");
+  CHECK(logPending() == 3);
+  _txRoom = 0;
+  logDrain();
+  CHECK(logPending() == 3);
+  _txRoom = 1 << 20;
+  logDrain();
+  CHECK(logPending() == 0 && txLines().size() == 5);
+}
+
+// Split _tx into CTL frames, return the decoded payloads
+static std::vector<std::string> txFrames() {
+  std::vector<std::string> out;
+  size_t at = 0;
+  while ((at = _tx.find('\0', at)) != std::string::npos) {
+    size_t end = _tx.find('\0', at + 1);
+    if (end == std::string::npos) break;
+    uint8_t msg[CTL_MAX_PAYLOAD];
+    size_t n = ctlDecode((const uint8_t*)_tx.data() + at + 1, end - at - 1, msg, sizeof(msg));
+    if (n) out.push_back(std::string((const char*)msg, n));
+    at = end + 1;
+  }
+  return out;
+}
+
+static void testBinary() {
+  printf("[TEST] binary records decode to the text lines\n");
+  resetRing();
+  _ctl_session = true;
+
+  auto emit = []() {
+    for (uint32_t i = 0; i < 20; i++) {
+      _fakeMs = 1000 + i;
+      LOG("[AUTH] Match — ID #%u → credential %u", i, i % 4 + 1);
+      LOG("[HID] %s: %u/%u ms%s", i & 1 ? "wake press" : "lock", 90 + i, 120, i & 2 ? " (ack)" : "");
+      LOG("[T] %d %c %05X %%", -(int)i, (char)('a' + i), i * 4097);
+    }
+  };
+  emit();
+  logFlush();
+  std::vector<std::string> text = txLines();
+
+  resetRing();
+  _ctl_session = true;
+  logSetBinary(true);
+  emit();
+  logFlush();
+  std::vector<std::string> frames = txFrames();
+  CHECK(frames.size() == text.size());
+
+  LogDecoder dec;
+  for (size_t i = 0; i < frames.size() && i < text.size(); i++) {
+    const std::string &f = frames[i];
+    CHECK((uint8_t)f[0] == CTL_EVT_LOG && f[1] == 0);
+    const uint8_t* body = (const uint8_t*)f.data() + 2;
+    size_t len = f.size() - 2;
+    uint8_t id = LogDecoder::idOf(body, len);
+    if (!dec.known(id)) {
+      // What the device answers to CTL_REQ_LOG_FMT
+      _tx.clear();
+      CtlFrame req = { CTL_REQ_LOG_FMT, 9, 1, &id };
+      CHECK(logHandleFrame(req));
+      std::vector<std::string> rsp = txFrames();
+      CHECK(rsp.size() == 1 && (uint8_t)rsp[0][0] == (CTL_REQ_LOG_FMT | CTL_RSP));
+      if (rsp.size() == 1) dec.learn((const uint8_t*)rsp[0].data() + 2, rsp[0].size() - 2);
+    }
+    uint32_t ms = 0;
+    std::string line;
+    CHECK(dec.decode(body, len, ms, line));
+    CHECK(line == text[i]);
+    CHECK(ms == 1000 + i / 3);
+  }
+
+  // Unknown ID and a bad mode are refused
+  _tx.clear();
+  uint8_t bad = 250, two = 2;
+  CtlFrame fmt = { CTL_REQ_LOG_FMT, 1, 1, &bad };
+  CtlFrame mode = { CTL_REQ_LOG_MODE, 2, 1, &two };
+  CHECK(logHandleFrame(fmt) && logHandleFrame(mode));
+  std::vector<std::string> naks = txFrames();
+  CHECK(naks.size() == 2 && (uint8_t)naks[0][0] == CTL_RSP_NAK && (uint8_t)naks[1][0] == CTL_RSP_NAK);
+}
+
+// ============================================================
+// fp_console over a pseudo-terminal pair
+// ============================================================
+
+static std::atomic<bool> _stop(false);
+static std::atomic<int> _fmtRequests(0);
+static std::atomic<bool> _textAgain(false);
+
+static void deviceLoop(int fd) {
+  bool sent = false;
+  ctlOnRequest([](const CtlFrame &f) {
+    if (f.type == CTL_REQ_LOG_FMT) _fmtRequests++;
+    if (f.type == CTL_REQ_LOG_MODE && f.len == 1 && f.body[0] == 0) _textAgain = true;
+    if (!logHandleFrame(f)) ctlReply(f, (const uint8_t*)"\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00" "1.0.0", 15);
+  });
+  while (!_stop) {
+    pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 10) > 0) {
+      uint8_t buf[512];
+      ssize_t n = read(fd, buf, sizeof(buf));
+      for (ssize_t i = 0; i < n; i++) {
+        if (ctlFeed(buf[i]) == CTL_RX_FRAME) ctlDispatch();
+      }
+    }
+    if (_log_binary && !sent) {
+      for (uint32_t i = 0; i < 10; i++) {
+        _fakeMs = 5000 + i;
+        LOG("[AUTH] Match — ID #%u → credential %u", i + 1, 1);
+        LOG("[SWITCH] %s", i & 1 ? "REGISTER" : "RECOGNIZE");
+      }
+      sent = true;
+    }
+    logDrain();
+    if (!_tx.empty()) {
+      ssize_t w = write(fd, _tx.data(), _tx.size());
+      if (w > 0) _tx.erase(0, (size_t)w);
+    }
+  }
+}
+
+static void testConsole(const char* console) {
+  printf("[TEST] fp_console over a pty pair\n");
+  if (!console) {
+    printf("  no fp_console path given — skipped\n");
+    return;
+  }
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) || unlockpt(master)) {
+    printf("  no pty available (%s) — skipped\n", strerror(errno));
+    return;
+  }
+  termios t;
+  tcgetattr(master, &t);
+  cfmakeraw(&t);
+  tcsetattr(master, TCSANOW, &t);
+
+  resetRing();
+  _txRoom = 1 << 20;
+  _stop = false;
+  std::thread device(deviceLoop, master);
+
+  char out[] = "/tmp/log_ring_console_XXXXXX";
+  int outFd = mkstemp(out);
+  close(outFd);
+  std::string cmd = std::string("exec ") + console + " " + ptsname(master) + " > " + out;
+  FILE* in = popen(cmd.c_str(), "w");   // its stdin: closing it ends the session
+
+  double t0 = nowUs();
+  while (nowUs() - t0 < 3e6) {
+    FILE* f = fopen(out, "r");
+    std::string got;
+    char line[256];
+    while (f && fgets(line, sizeof(line), f)) got += line;
+    if (f) fclose(f);
+    if (got.find("credential 1\n", got.rfind("ID #10")) != std::string::npos &&
+        got.find("[SWITCH] REGISTER") != std::string::npos) break;
+    usleep(10000);
+  }
+  pclose(in);
+  t0 = nowUs();
+  while (!_textAgain && nowUs() - t0 < 1e6) usleep(1000);
+  _stop = true;
+  device.join();
+  close(master);
+
+  std::vector<std::string> lines;
+  FILE* f = fopen(out, "r");
+  char line[256];
+  while (f && fgets(line, sizeof(line), f)) lines.push_back(line);
+  if (f) fclose(f);
+  unlink(out);
+
+  uint32_t matches = 0, switches = 0;
+  for (const std::string &l : lines) {
+    matches += l.find("     5.00") == 0 && l.find("[AUTH] Match — ID #") != std::string::npos;
+    switches += l.find("[SWITCH] RE") != std::string::npos;
+  }
+  CHECK(lines.size() >= 21 && lines[0].find("[console] firmware 1.0.0") == 0);
+  CHECK(lines.size() >= 21 && lines[1] == "     5.000  [AUTH] Match — ID #1 → credential 1\n");
+  CHECK(matches == 10 && switches == 10);
+  CHECK(_fmtRequests == 2);   // one per format, not per record
+  CHECK(_textAgain);
+}
+
+// ============================================================
+// Cost per call
+// ============================================================
+
+static void bench(uint32_t calls) {
+  printf("[TEST] cost per call (%u calls)\n", calls);
+  resetRing();
+  volatile uint8_t id = 17, cred = 3;
+
+  double tLog = 0, tDrainText = 0, tDrainBin = 0;
+  for (int binary = 0; binary < 2; binary++) {
+    resetRing();
+    _ctl_session = true;
+    logSetBinary(binary);
+    for (uint32_t done = 0; done < calls; done += LOG_RING_SLOTS) {
+      double t0 = nowUs();
+      for (uint32_t i = 0; i < LOG_RING_SLOTS; i++) LOG("[AUTH] Match — ID #%u → credential %u", id, cred);
+      double t1 = nowUs();
+      logDrain();
+      double t2 = nowUs();
+      tLog += t1 - t0;
+      (binary ? tDrainBin : tDrainText) += t2 - t1;
+      _tx.clear();
+      _txRoom = 1 << 20;   // the host took it all
+    }
+  }
+  uint32_t rounds = (calls + LOG_RING_SLOTS - 1) / LOG_RING_SLOTS * LOG_RING_SLOTS;
+
+  // The synchronous sequence the LOG() above replaced
+  double t0 = nowUs();
+  for (uint32_t i = 0; i < rounds; i++) {
+    Serial.print("[AUTH] Match — ID #");
+    Serial.print(id);
+    Serial.print(" → credential ");
+    Serial.println(cred);
+    if (_tx.size() > 4096) _tx.clear();
+  }
+  double tPrint = nowUs() - t0;
+
+  printf("  LOG()          %6.1f ns/call\n", tLog * 1000 / (2.0 * rounds));
+  printf("  Serial.print   %6.1f ns/line (host buffer, never blocks)\n", tPrint * 1000 / rounds);
+  printf("  drain text     %6.1f ns/record\n", tDrainText * 1000 / rounds);
+  printf("  drain binary   %6.1f ns/record\n", tDrainBin * 1000 / rounds);
+  CHECK(_log_dropped == 0);
+}
+
+int main(int argc, char** argv) {
+  const char* console = argc > 1 ? argv[1] : nullptr;
+  uint32_t calls = argc > 2 ? (uint32_t)atoi(argv[2]) : 200000;
+
+  testFormat();
+  testRing();
+  testBudget();
+  testBinary();
+  testConsole(console);
+  bench(calls);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
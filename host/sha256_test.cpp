@@ -0,0 +1,336 @@
+// ============================================================
+// sha256_test.cpp — SHA-256, HMAC and HKDF against their published
+// vectors, and the device's key derivation built on them
+//
+// 1. FIPS 180-4 / NIST examples: empty, "abc", the two-block
+//    448-bit message, the 896-bit message, a million 'a'
+// 2. Streaming: every split of a 3-block message into two updates
+//    (all the 64-byte boundary cases), random chunkings, the
+//    million 'a' fed in odd-sized pieces; HMAC streamed the same way
+// 3. RFC 4231 HMAC-SHA256 test cases 1–7 (5 truncated to 128 bits,
+//    6 and 7 with a 131-byte key, longer than one block)
+// 4. RFC 5869 HKDF-SHA256 test cases 1–3 (PRK and OKM), and
+//    Expand refusing more than 255 blocks
+// 5. crypto.h: cryptoSelfTest(), the HKDF subkeys cryptoInit()
+//    derives from the board ID, cryptoMac / cryptoMacVerify
+// 6. Throughput: SHA-256 MB/s and cycles/byte, HMAC and HKDF per
+//    call at the sizes the firmware uses
+//
+//   sha256_test [MB]   (benchmark size, default 16)
+// ============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "crypto.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+// ============================================================
+// Arduino surface crypto.h reaches: clock, Serial, board ID, RNG
+// ============================================================
+
+static const uint8_t BOARD_ID[PICO_UNIQUE_BOARD_ID_SIZE_BYTES] = { 0xE6, 0x61, 0x38, 0x52, 0x83, 0x4A, 0x12, 0x2F };
+
+unsigned long millis() { return 0; }
+unsigned long micros() { return 0; }
+
+SerialPort Serial, Serial1;
+size_t SerialPort::write(uint8_t) { return 1; }
+int SerialPort::available() { return 0; }
+int SerialPort::read() { return -1; }
+int SerialPort::availableForWrite() { return 256; }
+
+void pico_get_unique_board_id(pico_unique_board_id_t* id) { memcpy(id->id, BOARD_ID, sizeof(BOARD_ID)); }
+uint32_t get_rand_32() { return 0x12345678; }
+
+static double nowUs() {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<uint8_t> fromHex(const char* hex) {
+  std::vector<uint8_t> out;
+  for (; hex[0] && hex[1]; hex += 2) out.push_back((uint8_t)strtoul(std::string(hex, 2).c_str(), nullptr, 16));
+  return out;
+}
+
+static std::vector<uint8_t> bytes(const char* s) {
+  return std::vector<uint8_t>(s, s + strlen(s));
+}
+
+static std::vector<uint8_t> fill(uint8_t v, size_t n) {
+  return std::vector<uint8_t>(n, v);
+}
+
+static std::vector<uint8_t> counting(uint8_t from, size_t n) {
+  std::vector<uint8_t> v(n);
+  for (size_t i = 0; i < n; i++) v[i] = (uint8_t)(from + i);
+  return v;
+}
+
+static bool digestIs(const uint8_t* got, const char* hex) {
+  std::vector<uint8_t> want = fromHex(hex);
+  return memcmp(got, want.data(), want.size()) == 0;
+}
+
+static const char* const TWO_BLOCK = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+static const char* const TWO_BLOCK_SHA = "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1";
+static const char* const MILLION_A_SHA = "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+
+// ─── 1. NIST examples ───
+static void testNist() {
+  printf("[TEST] FIPS 180-4 examples\n");
+  static const struct { const char* msg; const char* sha; } vectors[] = {
+    { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { TWO_BLOCK, TWO_BLOCK_SHA },
+    { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+      "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+  };
+  uint8_t out[SHA256_DIGEST_SIZE];
+  for (auto &v : vectors) {
+    sha256((const uint8_t*)v.msg, strlen(v.msg), out);
+    CHECK(digestIs(out, v.sha));
+  }
+
+  std::vector<uint8_t> million(1000000, 'a');
+  sha256(million.data(), million.size(), out);
+  CHECK(digestIs(out, MILLION_A_SHA));
+}
+
+// ─── 2. Streaming across block boundaries ───
+static void testStreaming() {
+  printf("[TEST] streaming: split updates\n");
+  std::mt19937 rng(180);
+  std::vector<uint8_t> msg(3 * SHA256_BLOCK_SIZE + 17);
+  for (uint8_t &b : msg) b = (uint8_t)rng();
+  uint8_t whole[SHA256_DIGEST_SIZE], out[SHA256_DIGEST_SIZE];
+  sha256(msg.data(), msg.size(), whole);
+
+  // Two updates, split at every offset (63 | 1, 64 | 0, 65 ...)
+  for (size_t cut = 0; cut <= msg.size(); cut++) {
+    Sha256Ctx c;
+    sha256Init(&c);
+    sha256Update(&c, msg.data(), cut);
+    sha256Update(&c, msg.data() + cut, msg.size() - cut);
+    sha256Final(&c, out);
+    CHECK(memcmp(out, whole, sizeof(out)) == 0);
+  }
+
+  // Random chunkings, empty updates included
+  for (int round = 0; round < 200; round++) {
+    Sha256Ctx c;
+    sha256Init(&c);
+    for (size_t off = 0; off < msg.size();) {
+      size_t n = std::min<size_t>(rng() % 80, msg.size() - off);
+      sha256Update(&c, msg.data() + off, n);
+      off += n;
+    }
+    sha256Final(&c, out);
+    CHECK(memcmp(out, whole, sizeof(out)) == 0);
+  }
+
+  // The NIST vectors again, a byte at a time and in odd pieces
+  Sha256Ctx c;
+  sha256Init(&c);
+  for (const char* p = TWO_BLOCK; *p; p++) sha256Update(&c, (const uint8_t*)p, 1);
+  sha256Final(&c, out);
+  CHECK(digestIs(out, TWO_BLOCK_SHA));
+
+  std::vector<uint8_t> piece(997, 'a');
+  sha256Init(&c);
+  size_t left = 1000000;
+  while (left) {
+    size_t n = std::min(left, piece.size());
+    sha256Update(&c, piece.data(), n);
+    left -= n;
+  }
+  sha256Final(&c, out);
+  CHECK(digestIs(out, MILLION_A_SHA));
+
+  // HMAC over the same splits
+  static const uint8_t key[] = "streaming key";
+  hmacSha256(key, sizeof(key) - 1, msg.data(), msg.size(), whole);
+  for (size_t cut = 0; cut <= msg.size(); cut += 7) {
+    HmacSha256Ctx h;
+    hmacSha256Init(&h, key, sizeof(key) - 1);
+    hmacSha256Update(&h, msg.data(), cut);
+    hmacSha256Update(&h, msg.data() + cut, msg.size() - cut);
+    hmacSha256Final(&h, out);
+    CHECK(memcmp(out, whole, sizeof(out)) == 0);
+  }
+}
+
+// ─── 3. RFC 4231 ───
+static void testHmac() {
+  printf("[TEST] RFC 4231 HMAC-SHA256\n");
+  const char* case7 = "This is a test using a larger than block-size key and a larger than block-size data. "
+                      "The key needs to be hashed before being used by the HMAC algorithm.";
+  const struct { std::vector<uint8_t> key, msg; const char* mac; } cases[] = {
+    { fill(0x0b, 20), bytes("Hi There"),
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { bytes("Jefe"), bytes("what do ya want for nothing?"),
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+    { fill(0xaa, 20), fill(0xdd, 50),
+      "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe" },
+    { counting(0x01, 25), fill(0xcd, 50),
+      "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b" },
+    { fill(0x0c, 20), bytes("Test With Truncation"),
+      "a3b6167473100ee06e0c796c2955552b" },   // truncated to 128 bits
+    { fill(0xaa, 131), bytes("Test Using Larger Than Block-Size Key - Hash Key First"),
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+    { fill(0xaa, 131), bytes(case7),
+      "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2" },
+  };
+  uint8_t out[SHA256_DIGEST_SIZE];
+  for (auto &c : cases) {
+    hmacSha256(c.key.data(), c.key.size(), c.msg.data(), c.msg.size(), out);
+    CHECK(digestIs(out, c.mac));
+  }
+
+  // A key of exactly one block is used as is, one byte more is hashed
+  std::vector<uint8_t> k64 = fill(0x42, SHA256_BLOCK_SIZE), k65 = fill(0x42, SHA256_BLOCK_SIZE + 1);
+  uint8_t hashed[SHA256_DIGEST_SIZE], viaHash[SHA256_DIGEST_SIZE];
+  hmacSha256(k65.data(), k65.size(), (const uint8_t*)"m", 1, out);
+  sha256(k65.data(), k65.size(), hashed);
+  hmacSha256(hashed, sizeof(hashed), (const uint8_t*)"m", 1, viaHash);
+  CHECK(memcmp(out, viaHash, sizeof(out)) == 0);
+  hmacSha256(k64.data(), k64.size(), (const uint8_t*)"m", 1, viaHash);
+  CHECK(memcmp(out, viaHash, sizeof(out)) != 0);
+}
+
+// ─── 4. RFC 5869 ───
+static void testHkdf() {
+  printf("[TEST] RFC 5869 HKDF-SHA256\n");
+  const struct { std::vector<uint8_t> ikm, salt, info; const char* prk; const char* okm; } cases[] = {
+    { fill(0x0b, 22), counting(0x00, 13), counting(0xf0, 10),
+      "077709362c2e32df0ddc3f0dc47bba6390b6c73bb50f9c3122ec844ad7c2b3e5",
+      "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865" },
+    { counting(0x00, 80), counting(0x60, 80), counting(0xb0, 80),
+      "06a6b88c5853361a06104c9ceb35b45cef760014904671014a193f40c15fc244",
+      "b11e398dc80327a1c8e7f78c596a49344f012eda2d4efad8a050cc4c19afa97c"
+      "59045a99cac7827271cb41c65e590e09da3275600c2f09b8367793a9aca3db71"
+      "cc30c58179ec3e87c14c01d5c1f3434f1d87" },
+    { fill(0x0b, 22), {}, {},
+      "19ef24a32c717b167f33a91d6f648bdf96596776afdb6377ac434c1c293ccb04",
+      "8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d9d201395faa4b61a96c8" },
+  };
+  for (auto &c : cases) {
+    uint8_t prk[SHA256_DIGEST_SIZE];
+    std::vector<uint8_t> want = fromHex(c.okm), okm(want.size());
+    hkdfSha256Extract(c.salt.data(), c.salt.size(), c.ikm.data(), c.ikm.size(), prk);
+    CHECK(digestIs(prk, c.prk));
+    CHECK(hkdfSha256Expand(prk, c.info.data(), c.info.size(), okm.data(), okm.size()));
+    CHECK(okm == want);
+
+    std::fill(okm.begin(), okm.end(), 0);
+    CHECK(hkdfSha256(c.salt.data(), c.salt.size(), c.ikm.data(), c.ikm.size(), c.info.data(), c.info.size(),
+                     okm.data(), okm.size()));
+    CHECK(okm == want);
+  }
+
+  uint8_t prk[SHA256_DIGEST_SIZE] = {};
+  std::vector<uint8_t> big(255 * SHA256_DIGEST_SIZE + 1);
+  CHECK(!hkdfSha256Expand(prk, nullptr, 0, big.data(), big.size()));
+  CHECK(hkdfSha256Expand(prk, nullptr, 0, big.data(), big.size() - 1));
+}
+
+// ─── 5. crypto.h on top ───
+static void testDevice() {
+  printf("[TEST] crypto.h: self-test, subkeys, MAC\n");
+  CHECK(cryptoSelfTest());
+  cryptoInit();
+  CHECK(_crypto_ready);
+
+  uint8_t prk[SHA256_DIGEST_SIZE], enc[32], mac[32];
+  hkdfSha256Extract((const uint8_t*)"fp-unlocker/v1", 14, BOARD_ID, sizeof(BOARD_ID), prk);
+  hkdfSha256Expand(prk, (const uint8_t*)"enc:aes-256", 11, enc, sizeof(enc));
+  hkdfSha256Expand(prk, (const uint8_t*)"mac:hmac-sha256", 15, mac, sizeof(mac));
+  CHECK(memcmp(_crypto_encKey, enc, 32) == 0);
+  CHECK(memcmp(_crypto_macKey, mac, 32) == 0);
+  CHECK(memcmp(enc, mac, 32) != 0);
+  uint8_t legacy[32];
+  sha256(BOARD_ID, sizeof(BOARD_ID), legacy);
+  CHECK(memcmp(_crypto_key, legacy, 32) == 0);
+
+  static const uint8_t record[] = "credential index, 40 bytes of plaintext";
+  uint8_t tag[16], full[SHA256_DIGEST_SIZE];
+  CHECK(cryptoMac(record, sizeof(record), tag, sizeof(tag)));
+  hmacSha256(mac, sizeof(mac), record, sizeof(record), full);
+  CHECK(memcmp(tag, full, sizeof(tag)) == 0);   // truncated HMAC under the MAC subkey
+  CHECK(cryptoMacVerify(record, sizeof(record), tag, sizeof(tag)));
+
+  uint8_t altered[sizeof(record)];
+  memcpy(altered, record, sizeof(record));
+  altered[5] ^= 0x01;
+  CHECK(!cryptoMacVerify(altered, sizeof(altered), tag, sizeof(tag)));
+  tag[15] ^= 0x80;
+  CHECK(!cryptoMacVerify(record, sizeof(record), tag, sizeof(tag)));
+  CHECK(!cryptoMac(record, sizeof(record), full, SHA256_DIGEST_SIZE + 1));
+}
+
+// ─── 6. Throughput ───
+static void benchmark(uint32_t mb) {
+  printf("[TEST] benchmark: %u MB\n", mb);
+  std::vector<uint8_t> data(1 << 20);
+  for (size_t i = 0; i < data.size(); i++) data[i] = (uint8_t)(i * 31);
+  uint8_t out[SHA256_DIGEST_SIZE];
+
+  Sha256Ctx c;
+  sha256Init(&c);
+  double t0 = nowUs();
+  for (uint32_t i = 0; i < mb; i++) sha256Update(&c, data.data(), data.size());
+  sha256Final(&c, out);
+  double us = nowUs() - t0;
+  double bytesTotal = (double)mb * data.size();
+  printf("[BENCH] sha256   %.0f MB/s, %.1f ns/byte\n", bytesTotal / us, us * 1000.0 / bytesTotal);
+
+  // The sizes the firmware hashes: a 48-byte record tag, a subkey
+  uint32_t n = mb * 20000;
+  volatile uint8_t sink = 0;
+  t0 = nowUs();
+  for (uint32_t i = 0; i < n; i++) {
+    hmacSha256(_crypto_macKey, 32, data.data() + (i & 1023), 48, out);
+    sink ^= out[0];
+  }
+  us = nowUs() - t0;
+  printf("[BENCH] hmac     %.0f ns per 48-byte tag (4 compressions)\n", us * 1000.0 / n);
+
+  n /= 4;
+  uint8_t okm[32];
+  t0 = nowUs();
+  for (uint32_t i = 0; i < n; i++) {
+    hkdfSha256(nullptr, 0, data.data() + (i & 1023), 8, (const uint8_t*)"enc:aes-256", 11, okm, sizeof(okm));
+    sink ^= okm[0];
+  }
+  us = nowUs() - t0;
+  printf("[BENCH] hkdf     %.0f ns per 32-byte subkey (extract + expand)\n", us * 1000.0 / n);
+  (void)sink;
+}
+
+int main(int argc, char** argv) {
+  uint32_t mb = argc > 1 ? (uint32_t)atoi(argv[1]) : 16;
+
+  testNist();
+  testStreaming();
+  testHmac();
+  testHkdf();
+  testDevice();
+  benchmark(mb ? mb : 1);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
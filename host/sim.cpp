@@ -0,0 +1,897 @@
+// ============================================================
+// sim.cpp — Simulated device: clock, core1, sensor, HID, EEPROM
+// ============================================================
+#include "sim.h"
+#include "flash_sim.h"
+#include "fp_image.h"
+#include "config.h"
+#include "hid_host.h"
+
+#include <Arduino.h>
+#include <DFRobot_ID809.h>
+#include <Keyboard.h>
+#include <EEPROM.h>
+#include <pico/unique_id.h>
+#include <pico/rand.h>
+#include <pico/time.h>
+#include <hardware/watchdog.h>
+
+#include <map>
+#include <vector>
+#include <deque>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// ─── Sketch entry points (sim_firmware.cpp) ───
+void setup();
+void loop();
+void loop1();
+
+// ─── Rates the modelled ID809 accepts (eDeviceBaudrate_t order) ───
+static const uint32_t _sim_linkRates[] = { 9600, 19200, 38400, 57600, 115200 };
+#define SIM_LINK_RATES 5
+
+// ─── Hardware that survives a power cycle (shared with children) ───
+struct SimPersist {
+  uint8_t templates[SENSOR_CAPACITY];   // finger identity per ID, 0 = empty
+  uint8_t eeprom[SIM_EEPROM_BYTES];
+  uint8_t boardId[PICO_UNIQUE_BOARD_ID_SIZE_BYTES];
+  uint32_t seed;
+  uint32_t boots;
+  bool switchRegister;                  // the physical switch stays put
+  uint32_t sensorBaud;                  // the ID809 keeps its rate
+  uint16_t linkPermille[SIM_LINK_RATES];  // garbled exchanges per rate (‰)
+  uint8_t shared[SIM_SHARED_BYTES];
+};
+
+static SimPersist* _sim_hw = nullptr;
+static const char* _sim_flashPath = nullptr;
+
+// ─── Scheduled event; every one is an interrupt that wakes __wfi() ───
+struct SimEvent {
+  std::function<void()> fn;
+  bool device;   // alarm / noise, not a user input: survives simCancelPending()
+};
+typedef std::multimap<uint64_t, SimEvent> SimEvents;
+
+// ─── Per-boot state ───
+static uint64_t _sim_nowUs = 0;
+static uint64_t _sim_bootUs = 0;
+static uint64_t _sim_deadlineUs = 0;
+static uint64_t _sim_loopUntilUs = 0;   // end of the running simLoopFor(), 0 = none
+static SimEvents _sim_events;
+static std::map<alarm_id_t, SimEvents::iterator> _sim_alarms;
+static alarm_id_t _sim_alarmNext = 1;
+static uint32_t _sim_noiseUs = 0;
+static uint32_t _sim_noiseGen = 0;
+static uint32_t _sim_noise = 0;
+static bool _sim_onCore1 = false;      // the core1 coroutine is running
+static bool _sim_core1Made = false;
+static bool _sim_core1Event = false;   // SEV latched, the next WFE returns at once
+static uint64_t _sim_core1WakeUs = 0;  // core1 busy until then, 0 = parked in WFE
+static ucontext_t _sim_core0Ctx, _sim_core1Ctx;
+alignas(16) static char _sim_core1Stack[1 << 20];
+static uint32_t _sim_sensorOps = 0;
+static uint32_t _sim_rand = 1;
+static uint32_t _sim_linkRand = 1;     // error injection only — keeps get_rand_32() unchanged
+static uint32_t _sim_linkErrors = 0;
+static int _sim_failures = 0;
+
+static uint8_t _sim_finger = 0;
+static uint8_t _sim_captured = 0;
+static uint8_t _sim_failCaptures = 0;
+static void (*_sim_irq)() = nullptr;
+static int _sim_irqMode = 0;
+static void (*_sim_swIrq)() = nullptr;
+
+static std::deque<uint8_t> _sim_input;
+static std::string _sim_line;
+static std::vector<std::pair<uint64_t, std::string>> _sim_log;
+static std::vector<std::pair<std::string, std::function<void()>>> _sim_reactions;
+static bool _sim_echo = false;
+static bool _sim_txInFrame = false;
+static std::string _sim_txFrame;
+static std::function<void(const std::string &)> _sim_frameHandler;
+
+static std::string _sim_typed;
+static uint64_t _sim_enterUs = 0;
+static uint32_t _sim_keyEvents = 0;
+static std::vector<SimHidReport> _sim_reports;
+static HidHost _sim_host;              // the Mac reading them (simHostLayout)
+static uint32_t _sim_overruns = 0;
+static bool _sim_hostCaps = false;
+static bool _sim_hostLeds = true;      // the Mac answers Caps Lock (simHostLedReports)
+static uint32_t _sim_ledAckMs = SIM_HOST_LED_ACK_MS;
+static uint32_t _sim_capsIgnore = 0;   // nth Caps Lock tap from now does nothing (simHostIgnoreCapsTap)
+static uint32_t _sim_capsTyped = 0;    // characters typed with Caps Lock on
+static LedCallbackFcn _sim_ledCb = nullptr;
+static void* _sim_ledCbData = nullptr;
+
+SerialPort Serial, Serial1;
+RP2040Class rp2040;
+HID_Keyboard Keyboard;
+EEPROMClass EEPROM;
+
+// ============================================================
+// CLOCK
+// ============================================================
+
+// ─── Move time forward, firing due events in order ───
+static void _simAdvanceWorld(uint64_t us) {
+  uint64_t target = _sim_nowUs + us;
+  while (!_sim_events.empty() && _sim_events.begin()->first <= target) {
+    auto it = _sim_events.begin();
+    std::function<void()> fn = it->second.fn;
+    if (it->first > _sim_nowUs) _sim_nowUs = it->first;
+    _sim_events.erase(it);
+    fn();
+  }
+  _sim_nowUs = target;
+}
+
+// ─── Core1: a coroutine on the same virtual clock ───
+// Core0 owns the clock. Core1 runs until it waits — WFE with no
+// event latched, or sensor work that takes time — and hands back;
+// core0 resumes it once time reaches its wake-up. Its commands
+// take their time on core1 while core0 keeps polling, as on the
+// device.
+static void _simCore1Main() {
+  for (;;) loop1();
+}
+
+static void _simCore1Suspend(uint64_t wakeUs) {
+  _sim_core1WakeUs = wakeUs;
+  swapcontext(&_sim_core1Ctx, &_sim_core0Ctx);
+}
+
+static void _simCore1RunDue() {
+  while (_sim_core1WakeUs ? _sim_core1WakeUs <= _sim_nowUs : _sim_core1Event) {
+    if (!_sim_core1Made) {
+      getcontext(&_sim_core1Ctx);
+      _sim_core1Ctx.uc_stack.ss_sp = _sim_core1Stack;
+      _sim_core1Ctx.uc_stack.ss_size = sizeof(_sim_core1Stack);
+      _sim_core1Ctx.uc_link = nullptr;
+      makecontext(&_sim_core1Ctx, _simCore1Main, 0);
+      _sim_core1Made = true;
+    }
+    _sim_onCore1 = true;
+    swapcontext(&_sim_core0Ctx, &_sim_core1Ctx);
+    _sim_onCore1 = false;
+  }
+}
+
+// ─── A wait on either core ───
+// Core1 sleeps until core0 has moved the clock on. Core0 advances
+// the world, stopping wherever core1 is due.
+static void _simCoreWait(uint64_t us) {
+  uint64_t target = _sim_nowUs + us;
+  if (_sim_onCore1) {
+    _simCore1Suspend(target);
+    return;
+  }
+  for (;;) {
+    _simCore1RunDue();
+    if (_sim_nowUs >= target) break;
+    uint64_t next = target;
+    if (_sim_core1WakeUs && _sim_core1WakeUs < next) next = _sim_core1WakeUs;
+    _simAdvanceWorld(next - _sim_nowUs);
+  }
+  if (_sim_deadlineUs && _sim_nowUs > _sim_deadlineUs) throw SimHang();
+}
+
+// ─── Time the sensor module spends: on core1, or inline before it starts ───
+static void _simSensorBusy(uint64_t us) {
+  if (_sim_onCore1) _simCoreWait(us);
+  else _simAdvanceWorld(us);
+}
+
+void __wfe() {
+  if (!_sim_onCore1) return;
+  if (!_sim_core1Event) _simCore1Suspend(0);
+  _sim_core1Event = false;
+}
+
+void __sev() { _sim_core1Event = true; }
+
+// Spinning on core1 (ring full) lets core0 run first
+void tight_loop_contents() {
+  if (_sim_onCore1) _simCoreWait(1);
+}
+
+static void _simFlashBusy(uint32_t us) {
+  _simAdvanceWorld(us);
+}
+
+unsigned long micros()              { return (unsigned long)_sim_nowUs; }
+unsigned long millis()              { return (unsigned long)(_sim_nowUs / 1000); }
+void delay(unsigned long ms)        { _simCoreWait((uint64_t)ms * 1000); }
+void delayMicroseconds(unsigned us) { _simCoreWait(us); }
+void yield()                        { _simCoreWait(0); }
+
+uint64_t simNowUs()  { return _sim_nowUs; }
+uint64_t simBootUs() { return _sim_bootUs; }
+
+void simAfter(uint32_t ms, const std::function<void()> &fn) {
+  _sim_events.insert(std::make_pair(_sim_nowUs + (uint64_t)ms * 1000, SimEvent{fn, false}));
+}
+
+void simCancelPending() {
+  for (auto it = _sim_events.begin(); it != _sim_events.end();) {
+    it = it->second.device ? std::next(it) : _sim_events.erase(it);
+  }
+}
+
+// ─── Core0 sleeps until an interrupt ───
+// Any scheduled event wakes it. With none due before the end of the
+// running simLoopFor(), the sleep ends there: the test takes over,
+// and the firmware sees a wakeup without an event.
+void __wfi() {
+  uint64_t until = _sim_loopUntilUs;
+  if (!_sim_events.empty() && (!until || _sim_events.begin()->first < until)) {
+    until = _sim_events.begin()->first;
+  }
+  if (!until) throw SimHang();   // nothing will ever wake it
+  _simCoreWait(until > _sim_nowUs ? until - _sim_nowUs : 0);
+}
+
+// ─── Alarms (pico/time.h) ───
+// Like the SDK, the callback's return value reschedules it under the
+// same id: > 0 that many µs from now, < 0 from the time it was due.
+static void _simAlarmAt(alarm_id_t id, uint64_t atUs, alarm_callback_t callback, void* user_data) {
+  auto fire = [id, atUs, callback, user_data] {
+    _sim_alarms.erase(id);
+    int64_t again = callback(id, user_data);
+    if (again > 0) _simAlarmAt(id, _sim_nowUs + (uint64_t)again, callback, user_data);
+    if (again < 0) _simAlarmAt(id, atUs + (uint64_t)-again, callback, user_data);
+  };
+  _sim_alarms[id] = _sim_events.insert(std::make_pair(atUs, SimEvent{fire, true}));
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void* user_data, bool) {
+  alarm_id_t id = _sim_alarmNext++;
+  _simAlarmAt(id, _sim_nowUs + (uint64_t)ms * 1000, callback, user_data);
+  return id;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void* user_data, bool) {
+  alarm_id_t id = _sim_alarmNext++;
+  _simAlarmAt(id, _sim_nowUs + us, callback, user_data);
+  return id;
+}
+
+bool cancel_alarm(alarm_id_t id) {
+  auto it = _sim_alarms.find(id);
+  if (it == _sim_alarms.end()) return false;
+  _sim_events.erase(it->second);
+  _sim_alarms.erase(it);
+  return true;
+}
+
+// ─── Interrupt noise: wakes the core, brings no work ───
+static void _simNoiseNext(uint32_t gen) {
+  if (gen != _sim_noiseGen || !_sim_noiseUs) return;
+  _sim_events.insert(std::make_pair(_sim_nowUs + _sim_noiseUs, SimEvent{[gen] {
+    _sim_noise++;
+    _simNoiseNext(gen);
+  }, true}));
+}
+
+void simIrqNoise(uint32_t periodUs) {
+  _sim_noiseUs = periodUs;
+  _simNoiseNext(++_sim_noiseGen);
+}
+
+uint32_t simIrqNoiseCount() { return _sim_noise; }
+
+// ============================================================
+// PINS + INTERRUPTS
+// ============================================================
+
+void pinMode(int, int) {}
+
+int digitalRead(int pin) {
+  if (pin == PIN_MODE_SWITCH) return _sim_hw->switchRegister ? LOW : HIGH;
+  if (pin == PIN_IRQ) return _sim_finger ? HIGH : LOW;
+  return LOW;
+}
+
+// Touch Out: RISING / FALLING / CHANGE; the switch: CHANGE only
+void attachInterrupt(int irq, void (*isr)(), int mode) {
+  if (irq == PIN_MODE_SWITCH) _sim_swIrq = isr;
+  if (irq != PIN_IRQ) return;
+  _sim_irq = isr;
+  _sim_irqMode = mode;
+}
+
+void detachInterrupt(int irq) {
+  if (irq == PIN_IRQ) _sim_irq = nullptr;
+  if (irq == PIN_MODE_SWITCH) _sim_swIrq = nullptr;
+}
+
+void noInterrupts() {}
+void interrupts() {}
+
+void simSwitch(bool registerMode) {
+  bool edge = _sim_hw->switchRegister != registerMode;
+  _sim_hw->switchRegister = registerMode;
+  if (edge && _sim_swIrq) _sim_swIrq();
+}
+
+// ─── Touch Out follows the finger; the ISR sees the level after the edge ───
+static void _simTouchOut(uint8_t finger) {
+  bool rising = (_sim_finger == 0 && finger != 0);
+  bool falling = (_sim_finger != 0 && finger == 0);
+  _sim_finger = finger;
+  if (!_sim_irq) return;
+  if ((rising && (_sim_irqMode == RISING || _sim_irqMode == CHANGE)) ||
+      (falling && (_sim_irqMode == FALLING || _sim_irqMode == CHANGE))) {
+    _sim_irq();
+  }
+}
+
+void simFingerOn(uint8_t finger) { _simTouchOut(finger); }
+void simFingerOff()              { _simTouchOut(0); }
+bool simFingerPresent()       { return _sim_finger != 0; }
+void simFailCaptures(uint8_t n) { _sim_failCaptures = n; }
+
+// ============================================================
+// CONSOLE (USB CDC)
+// ============================================================
+
+static void _simLineDone() {
+  if (!_sim_line.empty() && _sim_line.back() == '\r') _sim_line.pop_back();
+  if (_sim_echo) printf("%10.3f  %s\n", _sim_nowUs / 1000.0, _sim_line.c_str());
+  _sim_log.push_back(std::make_pair(_sim_nowUs, _sim_line));
+  // Copy: a reaction may replace the reaction list
+  auto reactions = _sim_reactions;
+  for (auto &r : reactions) {
+    if (_sim_line.find(r.first) != std::string::npos) r.second();
+  }
+  _sim_line.clear();
+}
+
+// Control frames (ctl_proto.h) are split off the text the same way
+// the web UI does it: 0x00 opens a frame, the next 0x00 closes it.
+static void _simFrameDone() {
+  if (_sim_echo) printf("%10.3f  <frame %zu bytes>\n", _sim_nowUs / 1000.0, _sim_txFrame.size());
+  std::string frame;
+  frame.swap(_sim_txFrame);
+  if (_sim_frameHandler) _sim_frameHandler(frame);
+}
+
+size_t SerialPort::write(uint8_t c) {
+  if (this != &Serial) return 1;
+  if (c == 0) {
+    if (_sim_txInFrame && !_sim_txFrame.empty()) {
+      _sim_txInFrame = false;
+      _simFrameDone();
+    } else {
+      _sim_txInFrame = true;
+    }
+  } else if (_sim_txInFrame) {
+    _sim_txFrame += (char)c;
+  } else if (c == '\n') {
+    _simLineDone();
+  } else {
+    _sim_line += (char)c;
+  }
+  return 1;
+}
+
+int SerialPort::available() {
+  return this == &Serial ? (int)_sim_input.size() : 0;
+}
+
+// The simulated host always keeps up with the device
+int SerialPort::availableForWrite() {
+  return this == &Serial ? 4096 : 0;
+}
+
+int SerialPort::read() {
+  if (this != &Serial || _sim_input.empty()) return -1;
+  uint8_t c = _sim_input.front();
+  _sim_input.pop_front();
+  return c;
+}
+
+void simType(const std::string &text) {
+  for (char c : text) _sim_input.push_back((uint8_t)c);
+}
+
+void simEcho(bool on) { _sim_echo = on; }
+
+void simOnLine(const char* contains, const std::function<void()> &fn) {
+  _sim_reactions.push_back(std::make_pair(std::string(contains), fn));
+}
+
+void simOnFrame(const std::function<void(const std::string &)> &fn) { _sim_frameHandler = fn; }
+
+void simClearReactions() { _sim_reactions.clear(); }
+void simClearLog()       { _sim_log.clear(); }
+
+uint64_t simSawAtUs(const char* contains) {
+  for (auto &l : _sim_log) {
+    if (l.second.find(contains) != std::string::npos) return l.first ? l.first : 1;
+  }
+  return 0;
+}
+
+bool simSaw(const char* contains) { return simSawAtUs(contains) != 0; }
+
+std::string simLine(const char* contains) {
+  for (auto &l : _sim_log) {
+    if (l.second.find(contains) != std::string::npos) return l.second;
+  }
+  return std::string();
+}
+
+// ============================================================
+// SENSOR (DFRobot_ID809 stand-in, runs on "core1")
+// ============================================================
+
+static int _simLinkSlot(uint32_t baud) {
+  for (int i = 0; i < SIM_LINK_RATES; i++) {
+    if (_sim_linkRates[i] == baud) return i;
+  }
+  return -1;
+}
+
+// ─── One command/reply exchange ───
+// Costs the wire time at the module's rate plus the module's own
+// work. False if the reply never makes sense to the host: a UART
+// at another rate hears nothing until its timeout, and an injected
+// byte error garbles the exchange.
+static bool _simLinkExchange(uint64_t workUs) {
+  _sim_sensorOps++;
+  uint32_t baud = _sim_hw->sensorBaud;
+  if (Serial1.baud != baud) {
+    _simSensorBusy(SIM_UART_TIMEOUT_US);
+    return false;
+  }
+  _simSensorBusy((uint64_t)SIM_UART_ROUNDTRIP_US * 115200 / baud + workUs);
+  int slot = _simLinkSlot(baud);
+  uint16_t permille = slot < 0 ? 0 : _sim_hw->linkPermille[slot];
+  if (permille) {
+    _sim_linkRand ^= _sim_linkRand << 13;
+    _sim_linkRand ^= _sim_linkRand >> 17;
+    _sim_linkRand ^= _sim_linkRand << 5;
+    if (_sim_linkRand % 1000 < permille) {
+      _sim_linkErrors++;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DFRobot_ID809::begin(Stream &) { return _simLinkExchange(0); }
+bool DFRobot_ID809::isConnected()   { return _simLinkExchange(0); }
+
+// The module answers at the old rate, then switches. A garbled
+// exchange lost either the command (no switch) or only the reply.
+uint8_t DFRobot_ID809::setBaudrate(eDeviceBaudrate_t code) {
+  bool ok = _simLinkExchange(0);
+  if (Serial1.baud != _sim_hw->sensorBaud) return ERR_ID809;
+  if (ok || (_sim_linkRand & 1)) _sim_hw->sensorBaud = _sim_linkRates[(int)code - 1];
+  return ok ? 0 : ERR_ID809;
+}
+
+void simSensorBaud(uint32_t baud) { _sim_hw->sensorBaud = baud; }
+uint32_t simSensorBaud()          { return _sim_hw->sensorBaud; }
+uint32_t simLinkErrorCount()      { return _sim_linkErrors; }
+uint32_t simSensorOps()           { return _sim_sensorOps; }
+
+void simLinkErrors(uint32_t baud, uint16_t permille) {
+  int slot = _simLinkSlot(baud);
+  if (slot >= 0) _sim_hw->linkPermille[slot] = permille;
+}
+
+String DFRobot_ID809::getErrorDescription() { return String("simulated"); }
+
+uint8_t DFRobot_ID809::ctrlLED(eLEDMode_t, eLEDColor_t, uint8_t) {
+  return _simLinkExchange(0) ? 0 : ERR_ID809;
+}
+
+uint8_t DFRobot_ID809::detectFinger() {
+  if (!_simLinkExchange(0)) return ERR_ID809;
+  return _sim_finger ? 1 : 0;
+}
+
+// ─── Blocks until a finger is on the glass or timeout (s) ───
+uint8_t DFRobot_ID809::collectionFingerprint(uint16_t timeout, int) {
+  if (!_simLinkExchange(0)) return ERR_ID809;
+  uint64_t until = _sim_nowUs + (uint64_t)timeout * 1000000ULL;
+  while (!_sim_finger) {
+    if (_sim_nowUs >= until) return ERR_ID809;
+    _simSensorBusy(SIM_FINGER_POLL_US);
+  }
+  uint8_t finger = _sim_finger;
+  _simSensorBusy(SIM_CAPTURE_US);
+  if (_sim_failCaptures) {
+    _sim_failCaptures--;
+    return ERR_ID809;
+  }
+  _sim_captured = finger;
+  return 0;
+}
+
+uint8_t DFRobot_ID809::getEnrollCount() {
+  if (!_simLinkExchange(0)) return ERR_ID809;
+  uint8_t n = 0;
+  for (uint8_t t : _sim_hw->templates) n += (t != 0);
+  return n;
+}
+
+uint8_t DFRobot_ID809::getEnrolledIDList(uint8_t* list) {
+  if (!_simLinkExchange(0)) return ERR_ID809;
+  uint8_t n = 0;
+  for (uint8_t id = 1; id <= SENSOR_CAPACITY; id++) {
+    if (_sim_hw->templates[id - 1]) list[n++] = id;
+  }
+  return 0;
+}
+
+uint8_t DFRobot_ID809::getEmptyID() {
+  if (!_simLinkExchange(0)) return ERR_ID809;
+  for (uint8_t id = 1; id <= SENSOR_CAPACITY; id++) {
+    if (!_sim_hw->templates[id - 1]) return id;
+  }
+  return ERR_ID809;
+}
+
+uint8_t DFRobot_ID809::getStatusID(uint8_t id) {
+  if (!_simLinkExchange(0)) return ERR_ID809;
+  if (id < 1 || id > SENSOR_CAPACITY) return ERR_ID809;
+  return _sim_hw->templates[id - 1] ? 1 : 0;
+}
+
+uint8_t DFRobot_ID809::storeFingerprint(uint8_t id) {
+  if (!_simLinkExchange(SIM_STORE_US)) return ERR_ID809;
+  if (id < 1 || id > SENSOR_CAPACITY || !_sim_captured) return ERR_ID809;
+  _sim_hw->templates[id - 1] = _sim_captured;
+  return 0;
+}
+
+uint8_t DFRobot_ID809::delFingerprint(uint8_t id) {
+  if (!_simLinkExchange(SIM_DELETE_US)) return ERR_ID809;
+  if (id < 1 || id > SENSOR_CAPACITY || !_sim_hw->templates[id - 1]) return ERR_ID809;
+  _sim_hw->templates[id - 1] = 0;
+  return 0;
+}
+
+// ─── 1:N against the last capture; lowest matching ID ───
+uint8_t DFRobot_ID809::search() {
+  if (!_simLinkExchange(SIM_SEARCH_BASE_US + (uint64_t)SIM_SEARCH_PER_ID_US * simTemplateCount())) return ERR_ID809;
+  if (!_sim_captured) return 0;
+  for (uint8_t id = 1; id <= SENSOR_CAPACITY; id++) {
+    if (_sim_hw->templates[id - 1] == _sim_captured) return id;
+  }
+  return 0;
+}
+
+// ─── 1:1 against one ID ───
+uint8_t DFRobot_ID809::verify(uint8_t id) {
+  if (!_simLinkExchange(SIM_SEARCH_BASE_US + SIM_SEARCH_PER_ID_US)) return ERR_ID809;
+  if (id < 1 || id > SENSOR_CAPACITY || !_sim_captured) return 0;
+  return _sim_hw->templates[id - 1] == _sim_captured ? id : 0;
+}
+
+// ─── Template blob: finger identity, then a stream derived from it ───
+// Stands in for the module's feature data; a download is only
+// accepted when the stream still matches (the module's checksum).
+static void _simTemplateBlob(uint8_t finger, uint8_t* out) {
+  uint32_t x = 0x9E3779B9u ^ ((uint32_t)finger * 2654435761u);
+  out[0] = finger;
+  for (uint16_t i = 1; i < SENSOR_TEMPLATE_BYTES; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    out[i] = (uint8_t)x;
+  }
+}
+
+static uint64_t _simWireUs(uint32_t bytes) {
+  return (uint64_t)bytes * 10 * 1000000ULL / _sim_hw->sensorBaud;
+}
+
+static uint64_t _simTemplateWireUs() {
+  return _simWireUs(SENSOR_TEMPLATE_BYTES);
+}
+
+uint8_t DFRobot_ID809::getTemplate(uint16_t id, uint8_t* temp) {
+  if (!_simLinkExchange(_simTemplateWireUs())) return ERR_ID809;
+  if (id < 1 || id > SENSOR_CAPACITY || !_sim_hw->templates[id - 1]) return ERR_ID809;
+  _simTemplateBlob(_sim_hw->templates[id - 1], temp);
+  return 0;
+}
+
+uint8_t DFRobot_ID809::downLoadTemplate(uint16_t id, uint8_t* temp) {
+  if (!_simLinkExchange(_simTemplateWireUs() + SIM_TEMPLATE_LOAD_US)) return ERR_ID809;
+  if (id < 1 || id > SENSOR_CAPACITY || temp[0] == 0) return ERR_ID809;
+  uint8_t expect[SENSOR_TEMPLATE_BYTES];
+  _simTemplateBlob(temp[0], expect);
+  if (memcmp(expect, temp, SENSOR_TEMPLATE_BYTES) != 0) return ERR_ID809;
+  _sim_hw->templates[id - 1] = temp[0];
+  return 0;
+}
+
+// ─── Image of the last capture (fp_image.h) ───
+static uint8_t _simImage(uint8_t* image, uint16_t side) {
+  if (!_simLinkExchange(_simWireUs((uint32_t)side * side))) return ERR_ID809;
+  if (!_sim_captured) return ERR_ID809;
+  fpImageSynth(_sim_captured, image, side, side, SIM_IMAGE_NOISE);
+  return 0;
+}
+
+uint8_t DFRobot_ID809::getFingerImage(uint8_t* image)        { return _simImage(image, 160); }
+uint8_t DFRobot_ID809::getQuarterFingerImage(uint8_t* image) { return _simImage(image, 80); }
+
+void simSensorWipe() {
+  memset(_sim_hw->templates, 0, sizeof(_sim_hw->templates));
+}
+
+uint8_t simTemplateCount() {
+  uint8_t n = 0;
+  for (uint8_t t : _sim_hw->templates) n += (t != 0);
+  return n;
+}
+
+uint8_t simTemplateFinger(uint8_t id) {
+  return (id >= 1 && id <= SENSOR_CAPACITY) ? _sim_hw->templates[id - 1] : 0;
+}
+
+// ============================================================
+// RAM PROBE
+// ============================================================
+
+// Linker symbols: start of .data, end of .bss
+extern "C" char __data_start[], _end[];
+
+// Stack below the caller that flows may have used and returned from
+#define SIM_STACK_SCAN_BYTES (64 * 1024)
+
+// Addresses as integers: the regions are raw RAM, not C++ objects
+static bool _simRegionHolds(uintptr_t lo, uintptr_t hi, const std::string &bytes) {
+  if (hi <= lo || bytes.empty()) return false;
+  return memmem((const void*)lo, hi - lo, bytes.data(), bytes.size()) != nullptr;
+}
+
+__attribute__((noinline)) bool simRamHolds(const std::string &bytes) {
+  volatile uint8_t here = 0;
+  uintptr_t sp = (uintptr_t)&here;
+  return _simRegionHolds((uintptr_t)__data_start, (uintptr_t)_end, bytes) ||
+         _simRegionHolds(sp - SIM_STACK_SCAN_BYTES, sp, bytes);
+}
+
+// ============================================================
+// KEYBOARD (recording) + modelled host
+// ============================================================
+
+size_t HID_Keyboard::write(uint8_t c) {
+  _sim_keyEvents++;
+  _sim_typed += (char)c;
+  if (_sim_hostCaps) _sim_capsTyped++;
+  return 1;
+}
+
+size_t HID_Keyboard::press(uint8_t key) {
+  _sim_keyEvents++;
+  if (key == KEY_RETURN && !_sim_enterUs) _sim_enterUs = _sim_nowUs;
+  if (key == KEY_CAPS_LOCK && _sim_capsIgnore && --_sim_capsIgnore == 0) return 1;   // tap lost
+  if (key == KEY_CAPS_LOCK && _sim_ledCb && _sim_hostLeds) {
+    _sim_hostCaps = !_sim_hostCaps;
+    simAfter(_sim_ledAckMs, [] {
+      _sim_ledCb(false, _sim_hostCaps, false, false, false, _sim_ledCbData);
+    });
+  }
+  return 1;
+}
+
+size_t HID_Keyboard::release(uint8_t) { _sim_keyEvents++; return 1; }
+void HID_Keyboard::releaseAll()       { _sim_keyEvents++; }
+
+// ─── Raw reports: recorded, and read the way a host would ───
+// The modelled Mac (hid_host.h) types them through its layout. A
+// report sent before the endpoint was polled again
+// (HID_POLL_INTERVAL_US) is an overrun.
+void HID_Keyboard::sendReport(KeyReport* r) {
+  _sim_keyEvents++;
+  if (!_sim_reports.empty() && _sim_nowUs - _sim_reports.back().us < HID_POLL_INTERVAL_US) _sim_overruns++;
+  SimHidReport rec { _sim_nowUs, r->modifiers, {} };
+  memcpy(rec.keys, r->keys, sizeof(rec.keys));
+  _sim_reports.push_back(rec);
+
+  if (!_sim_enterUs && memchr(r->keys, HID_USAGE_RETURN, sizeof(r->keys)) &&
+      !memchr(_sim_host.down, HID_USAGE_RETURN, sizeof(_sim_host.down))) {
+    _sim_enterUs = _sim_nowUs;
+  }
+  size_t had = _sim_typed.size();
+  _sim_host.report(r->modifiers, r->keys, _sim_typed);
+  if (_sim_hostCaps) _sim_capsTyped += (uint32_t)(_sim_typed.size() - had);
+}
+
+void HID_Keyboard::onLED(LedCallbackFcn fn, void* cbData) {
+  _sim_ledCb = fn;
+  _sim_ledCbData = cbData;
+}
+
+void simClearKeys() {
+  _sim_typed.clear();
+  _sim_enterUs = 0;
+  _sim_keyEvents = 0;
+  _sim_reports.clear();
+  _sim_overruns = 0;
+  _sim_capsTyped = 0;
+  _sim_host = HidHost(_sim_host.layout);
+}
+
+const std::string& simTyped() { return _sim_typed; }
+uint64_t simEnterUs()         { return _sim_enterUs; }
+uint32_t simKeyEvents()       { return _sim_keyEvents; }
+const std::vector<SimHidReport>& simHidReports() { return _sim_reports; }
+uint32_t simHidOverruns()     { return _sim_overruns; }
+void simHostLayout(uint8_t layout) { _sim_host.layout = layout; }
+void simHostLedReports(bool on)    { _sim_hostLeds = on; }
+bool simHostCapsLock()             { return _sim_hostCaps; }
+void simHostLedAckMs(uint32_t ms)  { _sim_ledAckMs = ms; }
+void simHostIgnoreCapsTap(uint32_t nth) { _sim_capsIgnore = nth; }
+uint32_t simTypedWithCaps()        { return _sim_capsTyped; }
+
+// ============================================================
+// EEPROM, board ID, RNG, watchdog
+// ============================================================
+
+void EEPROMClass::begin(size_t size) {
+  _size = size;
+  memcpy(_data, _sim_hw->eeprom, sizeof(_data));
+}
+
+bool EEPROMClass::commit() {
+  memcpy(_sim_hw->eeprom, _data, sizeof(_data));
+  return true;
+}
+
+void pico_get_unique_board_id(pico_unique_board_id_t* id) {
+  memcpy(id->id, _sim_hw->boardId, sizeof(id->id));
+}
+
+uint32_t get_rand_32() {
+  // xorshift32 — deterministic per world seed + boot number
+  _sim_rand ^= _sim_rand << 13;
+  _sim_rand ^= _sim_rand >> 17;
+  _sim_rand ^= _sim_rand << 5;
+  return _sim_rand;
+}
+
+void watchdog_reboot(uint32_t, uint32_t, uint32_t) {
+  throw SimReboot();
+}
+
+// ============================================================
+// WORLD + BOOT SESSIONS
+// ============================================================
+
+bool simWorldInit(const char* flashPath, uint32_t seed) {
+  void* mem = mmap(nullptr, sizeof(SimPersist), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) return false;
+  _sim_hw = (SimPersist*)mem;
+  _sim_flashPath = flashPath;
+  _sim_hw->seed = seed ? seed : 1;
+  simWipe();
+  return true;
+}
+
+// ─── Factory-fresh device: erased flash + EEPROM, no templates ───
+void simWipe() {
+  memset(_sim_hw->templates, 0, sizeof(_sim_hw->templates));
+  memset(_sim_hw->eeprom, 0xFF, sizeof(_sim_hw->eeprom));
+  memset(_sim_hw->shared, 0, sizeof(_sim_hw->shared));
+  for (uint8_t i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES; i++) {
+    _sim_hw->boardId[i] = (uint8_t)(_sim_hw->seed >> ((i & 3) * 8)) ^ (uint8_t)(0xA5 + i);
+  }
+  _sim_hw->boots = 0;
+  _sim_hw->switchRegister = false;
+  _sim_hw->sensorBaud = SENSOR_BAUD;
+  memset(_sim_hw->linkPermille, 0, sizeof(_sim_hw->linkPermille));
+  flashSimOpen(_sim_flashPath, FLASH_SIM_ERASED);
+  flashSimClose();
+}
+
+void* simShared() { return _sim_hw->shared; }
+
+int simBoot(const std::function<void()> &session) {
+  fflush(stdout);
+  _sim_hw->boots++;
+  pid_t pid = fork();
+  if (pid < 0) return 1;
+
+  if (pid == 0) {
+    _sim_rand = _sim_hw->seed * 2654435761u + _sim_hw->boots;
+    if (!_sim_rand) _sim_rand = 1;
+    _sim_linkRand = _sim_rand ^ 0x9E3779B9u;
+    if (!_sim_linkRand) _sim_linkRand = 1;
+    flashSimOpen(_sim_flashPath, FLASH_SIM_KEEP);
+    flashSimOnBusy(_simFlashBusy);
+
+    int rc = 0;
+    try {
+      setup();
+      _sim_bootUs = _sim_nowUs;
+      session();
+    } catch (const SimReboot &) {
+    } catch (const FlashPowerCut &) {
+    } catch (const SimHang &) {
+      printf("  FAIL hang at t=%.3f ms, last line: %s\n", _sim_nowUs / 1000.0,
+             _sim_log.empty() ? "" : _sim_log.back().second.c_str());
+      rc = 1;
+    }
+    flashSimClose();
+    rc += _sim_failures;
+    fflush(stdout);
+    _exit(rc > 255 ? 255 : rc);
+  }
+
+  int status = 0;
+  if (waitpid(pid, &status, 0) < 0) return 1;
+  if (!WIFEXITED(status)) {
+    printf("  FAIL boot session crashed (signal %d)\n", WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+    return 1;
+  }
+  return WEXITSTATUS(status);
+}
+
+// ============================================================
+// DRIVING THE SKETCH
+// ============================================================
+
+// Flows run inside one loop() call; anything taking far longer than
+// asked is a hang (the deadline check lives in delay()).
+#define SIM_HANG_SLACK_US (300ULL * 1000000ULL)
+
+void simLoopFor(uint32_t ms) {
+  uint64_t until = _sim_nowUs + (uint64_t)ms * 1000;
+  _sim_deadlineUs = until + SIM_HANG_SLACK_US;
+  _sim_loopUntilUs = until;
+  while (_sim_nowUs < until) loop();
+  _sim_deadlineUs = _sim_loopUntilUs = 0;
+}
+
+bool simLoopUntil(const std::function<bool()> &pred, uint32_t timeoutMs) {
+  uint64_t until = _sim_nowUs + (uint64_t)timeoutMs * 1000;
+  _sim_deadlineUs = until + SIM_HANG_SLACK_US;
+  _sim_loopUntilUs = until;
+  bool ok = false;
+  while (!(ok = pred()) && _sim_nowUs < until) loop();
+  _sim_deadlineUs = _sim_loopUntilUs = 0;
+  return ok;
+}
+
+// ============================================================
+// CHECKS + STATS
+// ============================================================
+
+void simFail(const char* file, int line, const char* expr) {
+  printf("  FAIL %s:%d  %s  (t=%.3f ms)\n", file, line, expr, _sim_nowUs / 1000.0);
+  _sim_failures++;
+}
+
+int simFailures() { return _sim_failures; }
+
+void SimStat::add(uint64_t us) {
+  n++;
+  sumUs += (double)us;
+  if (us < minUs) minUs = us;
+  if (us > maxUs) maxUs = us;
+}
+
+void SimStat::print() const {
+  if (n == 0) {
+    printf("[SIM] %-22s n=0\n", name);
+    return;
+  }
+  printf("[SIM] %-22s n=%-5u avg %9.1f ms   min %9.1f   max %9.1f\n",
+         name, n, sumUs / n / 1000.0, minUs / 1000.0, maxUs / 1000.0);
+}
@@ -0,0 +1,171 @@
+// ============================================================
+// sim.h — The firmware as a Linux process (host builds)
+//
+// The real sketch (setup / loop / loop1 and every module it
+// includes) is compiled against the stand-ins in host/fakes and
+// driven by a simulated device:
+//
+//   clock     — virtual µs; delay() just moves time forward and
+//               runs whatever is due (scheduled inputs, core1)
+//   sleep     — __wfi() moves time to the next scheduled event:
+//               every input, alarm or noise tick is an interrupt;
+//               the end of simLoopFor() wakes it without one
+//   core1     — loop1() is a coroutine on the same clock: sensor
+//               commands go through the service rings and take
+//               their time on core1 while core0 keeps polling
+//   sensor    — 80 template IDs holding "finger identities";
+//               capture / search / store cost modelled UART time;
+//               templates can be uploaded and downloaded again
+//               (a blob derived from the finger, checked on the way in),
+//               and the last capture read out as a synthetic image;
+//               it keeps its baud rate across boots, stays silent
+//               to a UART at another rate and garbles replies at
+//               injected per-rate error rates
+//   keyboard  — records every key with its timestamp; a modelled
+//               Mac answers Caps Lock with an LED report
+//   EEPROM, flash, templates — persist across simulated boots
+//
+// Each boot runs in a forked child, so the firmware's file-scope
+// state starts from zero exactly like after a reset, while the
+// persistent hardware (flash file, EEPROM, sensor templates)
+// lives in shared memory.
+//
+// Usage:
+//   simWorldInit(flashPath, seed)   — once, in main()
+//   simWipe()                       — factory-fresh device
+//   simBoot(session)                — power on, setup(), session()
+//     simLoopFor(ms) / simLoopUntil(pred, ms)
+//     simFingerOn(f) / simFingerOff() / simSwitch(reg) / simType(s)
+//     simOnLine(text, fn)           — user reacts to console output
+//     simOnFrame(fn)                — … or to control frames (COBS, no delimiters)
+//     simSaw(text) / simTyped() / simEnterUs()
+//     simHidReports()               — raw keyboard reports, timestamped
+//     simHostLayout(l)              — layout the Mac reads them with
+//     simRamHolds(bytes)            — plaintext left in RAM?
+//   simSensorBaud(b) / simLinkErrors(b, ‰) — sensor link (between boots too)
+//   simSensorWipe()                 — replacement / factory-reset sensor module
+//   simIrqNoise(µs) / simIrqNoiseCount()  — interrupts that bring no work
+// ============================================================
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// ─── Sensor timing model (SEN0348 over UART @ 115200) ───
+#define SIM_UART_ROUNDTRIP_US  4600     // 26-byte command + 26-byte reply (scales with 1/baud)
+#define SIM_UART_TIMEOUT_US    100000   // no reply: rate mismatch / command lost
+#define SIM_CAPTURE_US         300000   // image + feature extraction
+#define SIM_SEARCH_BASE_US     40000    // match setup (1:N search and 1:1 verify)
+#define SIM_SEARCH_PER_ID_US   1500     // per template compared: all for search, one for verify
+#define SIM_STORE_US           60000    // merge + write template
+#define SIM_DELETE_US          20000
+#define SIM_TEMPLATE_LOAD_US   30000    // downLoadTemplate: write the received template
+#define SIM_IMAGE_NOISE        3        // ± grey levels on getFingerImage (fp_image.h)
+#define SIM_FINGER_POLL_US     10000    // sensor's own finger polling
+
+// ─── Modelled Mac (LED output report after a Caps Lock tap) ───
+#define SIM_HOST_LED_ACK_MS    40
+
+#define SIM_SHARED_BYTES       256      // scratch that survives boots
+
+// ─── Thrown out of firmware code to end a boot session ───
+struct SimReboot {};   // watchdog_reboot()
+struct SimHang {};     // virtual deadline passed inside a flow
+
+// ─── World ───
+bool simWorldInit(const char* flashPath, uint32_t seed);
+void simWipe();
+void* simShared();
+
+// Returns the number of failed CHECKs (or 1 for a hang / crash).
+int simBoot(const std::function<void()> &session);
+uint64_t simBootUs();   // virtual time setup() took (this boot)
+
+// ─── Driving the firmware (inside a boot session) ───
+uint64_t simNowUs();
+void simLoopFor(uint32_t ms);
+bool simLoopUntil(const std::function<bool()> &pred, uint32_t timeoutMs);
+void simAfter(uint32_t ms, const std::function<void()> &fn);
+void simCancelPending();            // drop scheduled inputs not yet due
+
+// ─── Inputs ───
+void simSwitch(bool registerMode);
+void simFingerOn(uint8_t finger);   // finger identity 1..255
+void simFingerOff();
+bool simFingerPresent();
+void simType(const std::string &text);
+void simFailCaptures(uint8_t n);    // next n captures return ERR_ID809
+
+// ─── Interrupt noise (USB housekeeping and the like) ───
+void simIrqNoise(uint32_t periodUs);   // an interrupt every periodUs, 0 = off
+uint32_t simIrqNoiseCount();           // noise interrupts so far this boot
+
+// ─── Sensor UART link (persistent, like the module's own setting) ───
+void simSensorBaud(uint32_t baud);  // rate the module is at
+uint32_t simSensorBaud();
+void simLinkErrors(uint32_t baud, uint16_t permille);   // exchanges garbled at that rate
+uint32_t simLinkErrorCount();       // garbled exchanges this boot
+uint32_t simSensorOps();            // sensor commands sent this boot (UART exchanges)
+
+// ─── Console output ───
+void simEcho(bool on);
+void simOnLine(const char* contains, const std::function<void()> &fn);
+void simClearReactions();
+void simClearLog();
+bool simSaw(const char* contains);
+uint64_t simSawAtUs(const char* contains);   // first time seen, 0 if not
+std::string simLine(const char* contains);   // first matching line, "" if not
+void simOnFrame(const std::function<void(const std::string &cobs)> &fn);  // control frames (one handler)
+
+// ─── Keyboard ───
+void simClearKeys();
+const std::string& simTyped();
+uint64_t simEnterUs();      // first KEY_RETURN press since clear, 0 if none
+uint32_t simKeyEvents();
+struct SimHidReport {
+  uint64_t us;
+  uint8_t mods;
+  uint8_t keys[6];
+};
+const std::vector<SimHidReport>& simHidReports();   // raw reports (sendReport) since clear
+uint32_t simHidOverruns();  // reports sent before the host polled the one before
+void simHostLayout(uint8_t layout);   // the Mac's keyboard layout (hid_layouts.h), US at start
+void simHostLedReports(bool on);      // false: Caps Lock taps go unanswered (true at boot)
+bool simHostCapsLock();               // the Mac's Caps Lock state
+void simHostLedAckMs(uint32_t ms);    // LED report this long after a tap (SIM_HOST_LED_ACK_MS at boot)
+void simHostIgnoreCapsTap(uint32_t nth);   // nth Caps Lock tap from now is lost: no toggle, no report (0 = off)
+uint32_t simTypedWithCaps();          // characters typed while the Mac's Caps Lock was on, since clear
+
+// ─── Sensor templates ───
+uint8_t simTemplateCount();
+uint8_t simTemplateFinger(uint8_t id);
+void simSensorWipe();               // every template gone, flash + EEPROM kept
+
+// ─── RAM, as a debugger would read it ───
+// Firmware statics plus the stack the last flows left behind the
+// caller. The simulator's own copies live on the heap, so look for
+// strings longer than the short-string buffer (15 bytes).
+bool simRamHolds(const std::string &bytes);
+
+// ─── Checks + stats ───
+void simFail(const char* file, int line, const char* expr);
+int simFailures();
+
+#define CHECK(cond) do { if (!(cond)) simFail(__FILE__, __LINE__, #cond); } while (0)
+
+struct SimStat {
+  const char* name;
+  uint32_t n = 0;
+  double sumUs = 0;
+  uint64_t minUs = ~0ULL;
+  uint64_t maxUs = 0;
+
+  explicit SimStat(const char* label) : name(label) {}
+  void add(uint64_t us);
+  void print() const;
+};
+
+#endif // SIM_H
@@ -0,0 +1,8 @@
+// ============================================================
+// sim_firmware.cpp — The unmodified sketch, built for the simulator
+//
+// One translation unit, like the Arduino build: every header's
+// file-scope state lives here. Scenarios only talk to it through
+// setup() / loop() and the simulated hardware (sim.h).
+// ============================================================
+#include "../diy_fingerprint_based_unlocker.ino"
@@ -0,0 +1,2106 @@
+// ============================================================
+// sim_scenarios.cpp — End-to-end flows on the simulated device
+//
+//   sim_scenarios [scenario|all] [iterations] [-v]
+//
+//   boot      virgin boot → forced REGISTER; reboots → VALID;
+//             time-to-ready budget, first touch right after boot
+//   unlock    N touches: enrolled / unknown finger, failed
+//             capture, touch during cooldown
+//   register  N re-registrations with fresh fingers + passwords,
+//             a reboot every 25, old finger must stop working
+//   abort     switch flip, password timeout, mismatches, failed
+//             captures, power cut at every flash op of the commit
+//   multi     two credentials + an extra finger
+//   stats     !STATS histograms agree with the modelled timing
+//   proto     control frames: requests, registration answered
+//             by REG_INPUT, events, resync after a bad frame;
+//             STATS_RESET clears the poll gap as !STATS RESET does
+//   secrets   the password is decrypted while the sensor
+//             captures, and no plaintext is left in RAM after a
+//             match, a miss, a failed capture or an orphan match
+//   match     1:1 verify vs 1:N search vs verify-then-search
+//             on 13 templates: same finger again, every finger
+//             in turn, an unknown finger
+//   lift      finger-lift waits run on the Touch Out IRQ: no
+//             sensor commands while the finger rests, next step
+//             right after the lift
+//   idle      event-driven idle vs LOOP_IDLE_MS polling: wakeups
+//             while nothing happens, every noise interrupt counted
+//             as spurious, touch and console pickup latency
+//   cancel    a bouncing switch flip aborts registration one
+//             debounce window after the last bounce: waiting for
+//             the finger, mid-capture, at the password prompt; a
+//             glitch shorter than the window does not
+//   provision CTL_REQ_PROVISION: bad bodies refused, registration
+//             with only the finger presented, a second request
+//             refused while one runs, add-finger, not in RECOGNIZE
+//   backup    a replaced sensor gets its fingers back from the
+//             encrypted backups at boot (restore time vs enrolling
+//             again); a backup altered in flash or left behind
+//             by a replaced credential is not restored
+//   image     !IMAGE / CTL_REQ_IMAGE: captures streamed row by
+//             row after the Enter key, decoded here and compared
+//             with the sensor's image (lossless and quantized);
+//             nothing without a monitor session or when off
+//   typing    a 32-character password typed as a report train:
+//             what the host reads, reports on their deadlines,
+//             none before the endpoint was polled, vs print();
+//             credentials registered for German, French and Swiss
+//             Macs type right through their layout, keep it when
+//             replaced, and come out wrong on a US one
+//   status    HELLO + STATUS frames 150 ms into every capture of
+//             a registration and an unlock: both flows finish, the
+//             stale template count comes back as unknown
+//   service   pings every 23 ms (and console commands) through
+//             registrations and unlocks: every reply within a
+//             bound, the longest poll gap inside a flow (!STATS)
+//             no longer than a flash commit
+//   adaptive  (sim_adaptive only) HID_ADAPTIVE_TIMING 1: a Mac
+//             that answers the Caps Lock probe ends every step on
+//             its ack and leaves Caps Lock off; one that never
+//             answers gets the fixed delays after the first
+//             step's budget, and saves nothing; one that loses
+//             the probe's second tap, and one whose echo comes
+//             after a step's budget, get Caps Lock tapped back
+//             before the password
+//   link      sensor UART rate: found at 9600 and moved to
+//             115200, a noisy rate fails verification, runtime
+//             link errors step down; every choice survives a
+//             reboot until SENSOR_LINK_REPROBE_BOOTS boots later,
+//             when a line that is clean again gets 115200 back;
+//             !LINKBENCH round trip per rate, refused while a
+//             capture is running
+//
+// Latency is simulated time (sensor UART, flash and HID delays
+// are modelled); throughput is wall-clock flows per second.
+// -v echoes the device console with virtual timestamps.
+// ============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+#include "flash_sim.h"
+#include "flash_region.h"    // backup sector offsets
+#include "config.h"
+#include "ctl_proto.h"       // constants + static helpers only (see decodeMsg)
+#include "latency_stats.h"   // StatPhase
+#include "log_decode.h"      // LogDecoder (static template formatter only)
+#include "img_codec.h"       // imgDecodeRow (static)
+#include "fp_image.h"        // what the simulated sensor captured
+#include "hid_report.h"      // hidReportBuild, layout tables (static)
+
+// ─── Survives reboots (simShared) ───
+struct Remembered {
+  uint8_t finger;
+  char password[PASSWORD_MAX_LEN + 1];
+  uint8_t cutFired;
+  uint64_t bootUs;
+  uint64_t firstEnterUs;
+  SimStat registered{"touch → registered"};
+  SimStat unlocked{"touch → Enter key"};
+  SimStat restored{"template restored at boot"};
+};
+static_assert(sizeof(Remembered) <= SIM_SHARED_BYTES, "grow SIM_SHARED_BYTES");
+
+static Remembered& remembered() {
+  return *(Remembered*)simShared();
+}
+
+static void forget() {
+  new (simShared()) Remembered();
+}
+
+static uint32_t _flows = 0;   // flows run by the current scenario
+
+// ============================================================
+// USER MODEL
+// ============================================================
+
+// ─── Answers every registration prompt the way a person would ───
+// An empty password means the user walks away at the password prompt.
+static void userAnswersRegistration(uint8_t finger, const std::string &choice, const std::string &password,
+                                    const std::string &confirm) {
+  simClearReactions();
+  simOnLine("[REG] Credential (", [choice] {
+    simAfter(600, [choice] { simType(choice + "\n"); });
+  });
+  simOnLine("Place finger (", [finger] {
+    simAfter(400, [finger] { simFingerOn(finger); });
+  });
+  simOnLine("Remove finger", [] {
+    simAfter(300, [] { simFingerOff(); });
+  });
+  simOnLine("Capture failed", [] {
+    simAfter(300, [] { simFingerOff(); });
+  });
+  if (password.empty()) return;
+  simOnLine("Enter password", [password] {
+    simAfter(2500, [password] { simType(password + "\n"); });
+  });
+  simOnLine("Confirm password", [confirm] {
+    simAfter(1500, [confirm] { simType(confirm + "\n"); });
+  });
+}
+
+static void userAnswersRegistration(uint8_t finger, const std::string &choice, const std::string &password) {
+  userAnswersRegistration(finger, choice, password, password);
+}
+
+static void flipTo(bool registerMode) {
+  simSwitch(registerMode);
+  simLoopFor(DEBOUNCE_MS * 3);
+}
+
+// ─── Hands off the sensor: nothing left over from the last flow ───
+static void userLetsGo() {
+  simCancelPending();
+  simFingerOff();
+}
+
+static bool registrationEnded() {
+  return simSaw("[REG] Success") || simSaw("[REG] Registration did not complete");
+}
+
+// ─── Touch to start, then answer prompts; true on success ───
+static bool doRegister(uint8_t finger, const std::string &choice, const std::string &password,
+                       const std::string &confirm, SimStat* latency = nullptr) {
+  userLetsGo();
+  flipTo(true);
+  userAnswersRegistration(finger, choice, password, confirm);
+  simClearLog();
+
+  uint64_t t0 = simNowUs();
+  simFingerOn(finger);
+  simAfter(200, [] { simFingerOff(); });
+  simLoopUntil(registrationEnded, 300000);
+  simClearReactions();
+
+  bool ok = simSaw("[REG] Success");
+  if (ok && latency) latency->add(simSawAtUs("[REG] Success") - t0);
+  return ok;
+}
+
+static bool doRegister(uint8_t finger, const std::string &choice, const std::string &password,
+                       SimStat* latency = nullptr) {
+  return doRegister(finger, choice, password, password, latency);
+}
+
+static bool touchEnded() {
+  return simSaw("[AUTH] Cooldown 5s") || simSaw("[AUTH] No match") ||
+         simSaw("[AUTH] Capture failed") || simSaw("[AUTH] Cooldown active") ||
+         simSaw("[AUTH] No registration") || simSaw("[AUTH] Ignoring orphan") ||
+         simSaw("[AUTH] Record read failed");
+}
+
+// ─── One touch in RECOGNIZE; returns what was typed ───
+static std::string doTouch(uint8_t finger, SimStat* toMatch = nullptr, SimStat* toEnter = nullptr) {
+  userLetsGo();
+  flipTo(false);
+  simClearReactions();
+  simClearLog();
+  simClearKeys();
+
+  uint64_t t0 = simNowUs();
+  simFingerOn(finger);
+  simAfter(450, [] { simFingerOff(); });
+  CHECK(simLoopUntil(touchEnded, 60000));
+
+  if (toMatch && simSaw("[AUTH] Match")) toMatch->add(simSawAtUs("[AUTH] Match") - t0);
+  if (toEnter && simEnterUs()) toEnter->add(simEnterUs() - t0);
+  return simTyped();
+}
+
+static std::string randomPassword(std::mt19937 &rng) {
+  std::uniform_int_distribution<int> len(1, PASSWORD_MAX_LEN), ch(32, 126);
+  std::string pw;
+  for (int i = len(rng); i > 0; i--) pw += (char)ch(rng);
+  return pw;
+}
+
+static void remember(uint8_t finger, const std::string &password) {
+  remembered().finger = finger;
+  snprintf(remembered().password, sizeof(remembered().password), "%s", password.c_str());
+}
+
+// ============================================================
+// SCENARIOS
+// ============================================================
+
+// Power-on to "[BOOT] Ready" (setup() returning), any boot state
+#define SIM_BOOT_BUDGET_MS  500
+
+static int scenarioBoot(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+  SimStat virgin("boot (virgin)"), registered("boot (registered)");
+  SimStat firstUnlock("power-on → Enter key");
+
+  fails += simBoot([] {
+    remembered().bootUs = simBootUs();
+    CHECK(simBootUs() <= SIM_BOOT_BUDGET_MS * 1000ULL);
+    CHECK(simSaw("[BOOT] Ready at"));
+    CHECK(simSaw("[BOOT] State: VIRGIN"));
+    CHECK(simSaw("[MODE] REGISTER (forced"));
+    CHECK(doRegister(1, "1", "first-password"));
+    remember(1, "first-password");
+    flipTo(false);
+  });
+  virgin.add(remembered().bootUs);
+
+  for (uint32_t i = 0; i < n; i++) {
+    fails += simBoot([] {
+      remembered().bootUs = simBootUs();
+      CHECK(simBootUs() <= SIM_BOOT_BUDGET_MS * 1000ULL);
+      CHECK(simSaw("[BOOT] State: VALID"));
+      CHECK(simSaw("[MODE] RECOGNIZE"));
+
+      // Finger already waiting when setup() returns — the boot LED
+      // flash is still playing, the touch must not wait for it
+      simClearLog();
+      simClearKeys();
+      simFingerOn(remembered().finger);
+      simAfter(450, [] { simFingerOff(); });
+      CHECK(simLoopUntil(touchEnded, 60000));
+      CHECK(simTyped() == remembered().password);
+      CHECK(simSawAtUs("[SENSOR] Finger detected") <= simBootUs() + 1000ULL);   // first loop pass, no idle wait
+      remembered().firstEnterUs = simEnterUs();
+    });
+    registered.add(remembered().bootUs);
+    firstUnlock.add(remembered().firstEnterUs);
+  }
+  virgin.print();
+  registered.print();
+  firstUnlock.print();
+  _flows += n + 1;
+  return fails;
+}
+
+static int scenarioUnlock(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+  fails += simBoot([] { CHECK(doRegister(7, "1", "correct horse battery staple")); });
+
+  fails += simBoot([n] {
+    std::mt19937 rng(1234);
+    SimStat match("touch → match"), enter("touch → Enter key");
+    uint32_t unlocked = 0, rejected = 0, failed = 0, cooled = 0;
+    bool inCooldown = false;
+
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t kind = rng() % 100;
+      if (inCooldown && kind < 15) {
+        // Second touch right after an unlock
+        CHECK(doTouch(7).empty());
+        CHECK(simSaw("[AUTH] Cooldown active"));
+        cooled++;
+        continue;
+      }
+      if (inCooldown) simLoopFor(COOLDOWN_MS);
+      inCooldown = false;
+
+      if (kind < 55) {
+        CHECK(doTouch(7, &match, &enter) == "correct horse battery staple");
+        inCooldown = true;
+        unlocked++;
+      } else if (kind < 80) {
+        CHECK(doTouch((uint8_t)(100 + rng() % 100)).empty());
+        CHECK(simSaw("[AUTH] No match"));
+        rejected++;
+      } else {
+        simFailCaptures(1);
+        CHECK(doTouch(7).empty());
+        CHECK(simSaw("[AUTH] Capture failed"));
+        failed++;
+      }
+    }
+    printf("[SIM] unlocked %u, rejected %u, capture failed %u, cooldown %u\n",
+           unlocked, rejected, failed, cooled);
+    match.print();
+    enter.print();
+  });
+  _flows += n;
+  return fails;
+}
+
+static int scenarioRegister(uint32_t n) {
+  const uint32_t perBoot = 25;
+  int fails = 0;
+  simWipe();
+  forget();
+
+  for (uint32_t done = 0; done < n; done += perBoot) {
+    uint32_t count = (n - done < perBoot) ? n - done : perBoot;
+    fails += simBoot([done, count] {
+      std::mt19937 rng(done + 1);
+      SimStat &reg = remembered().registered, &enter = remembered().unlocked;
+
+      if (remembered().finger) {
+        CHECK(simSaw("[BOOT] State: VALID"));
+        CHECK(doTouch(remembered().finger) == remembered().password);
+        simLoopFor(COOLDOWN_MS);
+      }
+
+      for (uint32_t i = 0; i < count; i++) {
+        uint8_t oldFinger = remembered().finger;
+        uint8_t finger = (uint8_t)((done + i) % 250 + 1);
+        std::string pw = randomPassword(rng);
+
+        CHECK(doRegister(finger, "1", pw, &reg));
+        remember(finger, pw);
+        CHECK(simTemplateCount() == 1);
+
+        if (oldFinger) CHECK(doTouch(oldFinger).empty());
+        CHECK(doTouch(finger, nullptr, &enter) == pw);
+        simLoopFor(COOLDOWN_MS);
+      }
+    });
+    _flows += count;
+  }
+  remembered().registered.print();
+  remembered().unlocked.print();
+  return fails;
+}
+
+static int scenarioAbort() {
+  int fails = 0;
+  simWipe();
+  forget();
+  fails += simBoot([] { CHECK(doRegister(1, "1", "old-password")); });
+
+  // Each interrupted attempt must leave credential 1 exactly as it was
+  auto oldStillWorks = [] {
+    CHECK(simTemplateCount() == 1);
+    CHECK(doTouch(2).empty());
+    CHECK(doTouch(1) == "old-password");
+    simLoopFor(COOLDOWN_MS);
+  };
+
+  printf("[SIM] abort: switch flipped during capture 2\n");
+  fails += simBoot([&] {
+    flipTo(true);
+    userAnswersRegistration(2, "1", "new-password");
+    simOnLine("Place finger (2/", [] { simAfter(100, [] { simSwitch(false); }); });
+    simClearLog();
+    simFingerOn(2);
+    simAfter(200, [] { simFingerOff(); });
+    CHECK(simLoopUntil(registrationEnded, 120000));
+    CHECK(simSaw("aborting registration"));
+    oldStillWorks();
+  });
+
+  printf("[SIM] abort: nobody types the password\n");
+  fails += simBoot([&] {
+    CHECK(!doRegister(2, "1", ""));
+    CHECK(simSaw("[REG] Password entry timeout"));
+    oldStillWorks();
+  });
+
+  printf("[SIM] abort: three confirm mismatches\n");
+  fails += simBoot([&] {
+    CHECK(!doRegister(2, "1", "new-password", "typo"));
+    CHECK(simSaw("[REG] Too many mismatches"));
+    oldStillWorks();
+  });
+
+  printf("[SIM] abort: every capture fails\n");
+  fails += simBoot([&] {
+    simFailCaptures(MAX_CAPTURE_RETRIES);
+    CHECK(!doRegister(2, "1", "new-password"));
+    CHECK(simSaw("[REG] Max retries"));
+    oldStillWorks();
+  });
+
+  // Power cut at the k-th flash operation after "Committing..."
+  for (uint32_t k = 1; k < 32; k++) {
+    remembered().cutFired = 0;
+    fails += simBoot([k] {
+      flipTo(true);
+      userAnswersRegistration(2, "1", "new-password");
+      simOnLine("[REG] Committing", [k] {
+        remembered().cutFired = 1;
+        flashSimFailAfter(k);
+      });
+      simClearLog();
+      simFingerOn(2);
+      simAfter(200, [] { simFingerOff(); });
+      simLoopUntil(registrationEnded, 300000);
+      // Reaching here means the commit finished before the cut
+      remembered().cutFired = 0;
+    });
+    bool cut = remembered().cutFired;
+
+    fails += simBoot([cut] {
+      CHECK(simSaw("[BOOT] State: VALID"));
+      CHECK(simTemplateCount() == 1);
+      std::string viaOld = doTouch(1);
+      simLoopFor(COOLDOWN_MS);
+      std::string viaNew = doTouch(2);
+      simLoopFor(COOLDOWN_MS);
+      // Exactly one of the two pairs is live — never a mix
+      bool oldPair = (viaOld == "old-password" && viaNew.empty());
+      bool newPair = (viaNew == "new-password" && viaOld.empty());
+      CHECK(oldPair || newPair);
+      if (!cut) CHECK(newPair);
+
+      // Back to the old pair for the next cut point
+      if (newPair) CHECK(doRegister(1, "1", "old-password"));
+    });
+
+    _flows += 2;
+    if (!cut) {
+      printf("[SIM] abort: power cut at flash ops 1..%u of the commit\n", k - 1);
+      break;
+    }
+  }
+  _flows += 5;
+  return fails;
+}
+
+static int scenarioMulti() {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([] {
+    CHECK(doRegister(1, "1", "alpha"));
+    CHECK(doRegister(2, "1+", "unused"));
+    CHECK(doRegister(3, "2", "bravo"));
+    CHECK(simTemplateCount() == 3);
+  });
+
+  auto expectTyped = [](uint8_t finger, const char* password) {
+    CHECK(doTouch(finger) == password);
+    simLoopFor(COOLDOWN_MS);
+  };
+
+  fails += simBoot([&] {
+    CHECK(simSaw("[BOOT] State: VALID"));
+    expectTyped(1, "alpha");
+    expectTyped(2, "alpha");
+    expectTyped(3, "bravo");
+    expectTyped(9, "");
+
+    // Replacing credential 1 drops both of its fingers
+    CHECK(doRegister(4, "1", "charlie"));
+    expectTyped(1, "");
+    expectTyped(2, "");
+    expectTyped(4, "charlie");
+    expectTyped(3, "bravo");
+    CHECK(simTemplateCount() == 2);
+  });
+  _flows += 12;
+  return fails;
+}
+
+// ─── "[STATS] <phase> n p50 p95 p99 max" → {n, p50, p95, p99, max} ───
+struct StatRow { unsigned long n = 0, p50 = 0, p95 = 0, p99 = 0, max = 0; bool ok = false; };
+
+static StatRow statRow(const char* phase) {
+  StatRow r;
+  std::string line = simLine((std::string("[STATS] ") + phase + " ").c_str());
+  size_t at = line.find_first_of("0123456789", 8 + strlen(phase));
+  if (at != std::string::npos) {
+    r.ok = sscanf(line.c_str() + at, "%lu %lu %lu %lu %lu", &r.n, &r.p50, &r.p95, &r.p99, &r.max) == 5;
+  }
+  return r;
+}
+
+// ─── Measured value within one histogram bucket (12.5%) of expected ───
+static bool nearUs(unsigned long got, double expectUs) {
+  return got >= expectUs * 0.98 && got <= expectUs * 1.15;
+}
+
+static int scenarioStats(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+  fails += simBoot([] { CHECK(doRegister(5, "1", "hunter2")); });
+
+  fails += simBoot([n] {
+    simClearLog();
+    simType("!STATS RESET\n");
+    CHECK(simLoopUntil([] { return simSaw("[STATS] Reset"); }, 1000));
+
+    SimStat enter("touch → Enter key");
+    for (uint32_t i = 0; i < n; i++) {
+      CHECK(doTouch(5, nullptr, &enter) == "hunter2");
+      simLoopFor(COOLDOWN_MS);
+    }
+
+    simClearLog();
+    simType("!STATS\n");
+    CHECK(simLoopUntil([] { return simSaw("[STATS] touch>enter"); }, 1000));
+
+    StatRow capture = statRow("capture"), search = statRow("search");
+    StatRow lock = statRow("hid lock"), total = statRow("touch>enter");
+    CHECK(capture.ok && capture.n == n);
+    CHECK(search.ok && search.n == n);
+    CHECK(statRow("record").n == n);
+    CHECK(statRow("prefetch").n == n);   // decrypted during every capture
+    CHECK(total.ok && total.n == n);
+
+    // Sensor phases: modelled work + one UART round trip
+    CHECK(nearUs(capture.p50, SIM_CAPTURE_US + SIM_UART_ROUNDTRIP_US));
+    CHECK(nearUs(search.p99, SIM_SEARCH_BASE_US + SIM_SEARCH_PER_ID_US + SIM_UART_ROUNDTRIP_US));
+    CHECK(lock.n == 0 || nearUs(lock.p50, LOCK_DELAY_MS * 1000.0));
+    // The device's own touch → Enter agrees with what the keyboard saw
+    CHECK(nearUs(total.max, (double)enter.maxUs));
+    printf("[SIM] device touch→Enter p50 %lu us, max %lu us\n", total.p50, total.max);
+    enter.print();
+
+    simClearLog();
+    simType("!STATS RESET\n");
+    simLoopFor(50);
+    simType("!STATS\n");
+    CHECK(simLoopUntil([] { return simSaw("[STATS] touch>enter"); }, 1000));
+    CHECK(statRow("capture").ok && statRow("capture").n == 0);
+    CHECK(statRow("touch>enter").max == 0);
+  });
+  _flows += n;
+  return fails;
+}
+
+// ─── Control protocol client (what web/app.js does) ───
+struct Msg {
+  uint8_t type = 0, seq = 0;
+  std::string body;
+};
+
+static std::vector<Msg> _msgs;   // every frame the device sent
+
+// Firmware headers keep their state in file-scope statics behind
+// non-static inline functions, so only the sketch's TU may call
+// ctlFeed(); the client decodes on its own.
+static bool decodeMsg(const std::string &cobs, Msg &m) {
+  std::string p;
+  for (size_t i = 0; i < cobs.size();) {
+    uint8_t code = (uint8_t)cobs[i++];
+    if (code == 0 || i + code - 1 > cobs.size()) return false;
+    p.append(cobs, i, code - 1);
+    i += code - 1;
+    if (code != 0xFF && i < cobs.size()) p += '\0';
+  }
+  if (p.size() < 4) return false;
+  if (ctlCrc16((const uint8_t*)p.data(), p.size()) != 0) return false;   // CRC appended big-endian
+  m.type = (uint8_t)p[0];
+  m.seq = (uint8_t)p[1];
+  m.body = p.substr(2, p.size() - 4);
+  return true;
+}
+
+static void listenFrames(const std::function<void(const Msg &)> &onEvent = nullptr) {
+  _msgs.clear();
+  simOnFrame([onEvent](const std::string &cobs) {
+    Msg m;
+    CHECK(decodeMsg(cobs, m));
+    _msgs.push_back(m);
+    if (onEvent && m.seq == 0) onEvent(m);
+  });
+}
+
+static std::string frameBytes(uint8_t type, uint8_t seq, const std::string &body) {
+  uint8_t wire[CTL_MAX_WIRE];
+  size_t n = ctlEncode(type, seq, (const uint8_t*)body.data(), body.size(), wire);
+  return std::string((const char*)wire, n);
+}
+
+// ─── One request → its reply (type | CTL_RSP or NAK), empty type on timeout ───
+static Msg request(uint8_t type, uint8_t seq, const std::string &body = std::string()) {
+  simType(frameBytes(type, seq, body));
+  Msg reply;
+  auto answered = [&] {
+    for (const Msg &m : _msgs) {
+      if (m.seq == seq && (m.type == (type | CTL_RSP) || m.type == CTL_RSP_NAK)) {
+        reply = m;
+        return true;
+      }
+    }
+    return false;
+  };
+  simLoopUntil(answered, 1000);
+  return reply;
+}
+
+// ─── !STATS → longest poll gap (ms) ───
+static unsigned long maxPollGap() {
+  simClearLog();
+  simType("!STATS\n");
+  CHECK(simLoopUntil([] { return simSaw("[STATS] max poll gap"); }, 1000));
+  unsigned long gap = ~0UL;
+  sscanf(simLine("[STATS] max poll gap").c_str(), "[STATS] max poll gap %lu ms", &gap);
+  return gap;
+}
+
+static uint32_t eventCount(uint8_t type, uint8_t first = 0) {
+  uint32_t n = 0;
+  for (const Msg &m : _msgs) {
+    if (m.seq == 0 && m.type == type && (!first || (!m.body.empty() && (uint8_t)m.body[0] == first))) n++;
+  }
+  return n;
+}
+
+static int scenarioProto() {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([] {
+    listenFrames();
+
+    // Requests work before HELLO; events don't
+    Msg st = request(CTL_REQ_STATUS, 1);
+    CHECK(st.type == (CTL_REQ_STATUS | CTL_RSP) && st.body.size() >= 10);
+    CHECK(st.body[1] == 0 && st.body[2] == 1 && st.body[5] == 0);   // REGISTER, VIRGIN, no credentials
+
+    Msg hello = request(CTL_REQ_HELLO, 2);
+    CHECK(hello.type == (CTL_REQ_HELLO | CTL_RSP));
+    CHECK(hello.body[0] == CTL_PROTO_VERSION && hello.body.substr(10) == FW_VERSION);
+
+    // Zeros in the body survive COBS; round trip is one loop pass
+    std::string zeros(CTL_MAX_BODY, '\0');
+    for (size_t i = 0; i < zeros.size(); i += 3) zeros[i] = (char)i;
+    uint64_t t0 = simNowUs();
+    Msg pong = request(CTL_REQ_PING, 3, zeros);
+    CHECK(pong.type == (CTL_REQ_PING | CTL_RSP) && pong.body == zeros);
+    printf("[SIM] ping round trip %.1f ms (simulated)\n", (simNowUs() - t0) / 1000.0);
+
+    Msg cfg = request(CTL_REQ_CONFIG, 4);
+    CHECK(cfg.body.size() == 20 && ctlGet32((const uint8_t*)cfg.body.data()) == COOLDOWN_MS);
+    CHECK((uint8_t)cfg.body[16] == PASSWORD_MAX_LEN);
+
+    Msg nak = request(0x30, 5);
+    CHECK(nak.type == CTL_RSP_NAK && nak.body[0] == 0x30 && nak.body[1] == CTL_ERR_UNKNOWN);
+    nak = request(CTL_REQ_REG_INPUT, 6, "x");
+    CHECK(nak.type == CTL_RSP_NAK && nak.body[1] == CTL_ERR_STATE);
+
+    // A corrupted frame is dropped silently; text keeps working
+    std::string bad = frameBytes(CTL_REQ_STATUS, 7, "");
+    bad[2] ^= 0x40;
+    simType(bad);
+    simClearLog();
+    simType("!STATS\n");
+    CHECK(simLoopUntil([] { return simSaw("[STATS] phase"); }, 1000));
+    CHECK(request(CTL_REQ_STATUS, 8).type == (CTL_REQ_STATUS | CTL_RSP));
+    for (const Msg &m : _msgs) CHECK(m.seq != 7);
+
+    // Registration answered entirely by frames, driven by events
+    flipTo(true);
+    uint8_t seq = 20;
+    uint32_t confirms = 0;
+    listenFrames([&](const Msg &e) {
+      if (e.type != CTL_EVT_REG) return;
+      switch ((uint8_t)e.body[0]) {
+        case CTL_REG_CHOOSE:   simAfter(300, [&] { simType(frameBytes(CTL_REQ_REG_INPUT, seq++, "2")); }); break;
+        case CTL_REG_PLACE:    simAfter(400, [] { simFingerOn(3); }); break;
+        case CTL_REG_REMOVE:   simAfter(300, [] { simFingerOff(); }); break;
+        case CTL_REG_PASSWORD: simAfter(500, [&] { simType(frameBytes(CTL_REQ_REG_INPUT, seq++, "delta")); }); break;
+        case CTL_REG_CONFIRM:
+          simAfter(500, [&] { simType(frameBytes(CTL_REQ_REG_INPUT, seq++, confirms++ ? "delta" : "wrong")); });
+          break;
+      }
+    });
+    simClearLog();
+    simFingerOn(3);
+    simAfter(200, [] { simFingerOff(); });
+    CHECK(simLoopUntil([] { return eventCount(CTL_EVT_REG, CTL_REG_DONE) > 0; }, 120000));
+    CHECK(eventCount(CTL_EVT_REG, CTL_REG_MISMATCH) == 1);
+    CHECK(eventCount(CTL_EVT_REG, CTL_REG_PLACE) == COLLECT_COUNT);
+    CHECK(simSaw("[REG] Registration complete (credential 2"));
+    CHECK(!simSaw("delta"));   // only '*' echoed
+
+    // Mode + auth events
+    simLoopFor(3000);
+    userLetsGo();
+    listenFrames();
+    flipTo(false);
+    CHECK(eventCount(CTL_EVT_MODE, 1) == 1);   // MODE_RECOGNIZE
+    CHECK(doTouch(3) == "delta");
+    CHECK(eventCount(CTL_EVT_AUTH, CTL_AUTH_MATCH) == 1);
+    CHECK(eventCount(CTL_EVT_AUTH, CTL_AUTH_UNLOCKED) == 1);
+
+    Msg stats = request(CTL_REQ_STATS, 9);
+    CHECK(stats.body.size() == STAT_PHASES * 20);
+    CHECK(ctlGet32((const uint8_t*)stats.body.data() + STAT_CAPTURE * 20) == 1);
+
+    // STATS_RESET starts the poll gap over too, not just the phases
+    unsigned long before = maxPollGap();
+    CHECK(request(CTL_REQ_STATS_RESET, 10).type == (CTL_REQ_STATS_RESET | CTL_RSP));
+    stats = request(CTL_REQ_STATS, 11);
+    CHECK(ctlGet32((const uint8_t*)stats.body.data() + STAT_CAPTURE * 20) == 0);
+    unsigned long after = maxPollGap();
+    printf("[SIM] max poll gap %lu ms before STATS_RESET, %lu ms after\n", before, after);
+    CHECK(after < before);
+  });
+
+  // After a reboot events stay off until the host says HELLO again
+  fails += simBoot([] {
+    listenFrames();
+    CHECK(doTouch(3) == "delta");
+    CHECK(_msgs.empty());
+    Msg hello = request(CTL_REQ_HELLO, 1);
+    CHECK(hello.body[2] == 0 && hello.body[5] == 1);   // BOOT_VALID, one credential
+
+    // Binary log records: nothing as text, same lines rendered here
+    listenFrames();
+    CHECK(request(CTL_REQ_LOG_MODE, 2, std::string(1, '\1')).type == (CTL_REQ_LOG_MODE | CTL_RSP));
+    simLoopFor(COOLDOWN_MS);
+    simClearLog();
+    simClearKeys();
+    simFingerOn(3);
+    simAfter(450, [] { simFingerOff(); });
+    CHECK(simLoopUntil([] { return eventCount(CTL_EVT_AUTH, CTL_AUTH_UNLOCKED) > 0; }, 60000));
+    simLoopFor(3000);
+    CHECK(simTyped() == "delta");
+    CHECK(!simSaw("[AUTH]") && !simSaw("[HID]"));
+
+    std::vector<Msg> records;
+    for (const Msg &m : _msgs) if (m.type == CTL_EVT_LOG) records.push_back(m);
+    LogDecoder dec;
+    uint8_t seq = 10;
+    uint32_t fetched = 0;
+    std::string text;
+    for (const Msg &r : records) {
+      const uint8_t* b = (const uint8_t*)r.body.data();
+      uint8_t id = LogDecoder::idOf(b, r.body.size());
+      if (!dec.known(id)) {
+        Msg f = request(CTL_REQ_LOG_FMT, seq++, std::string(1, (char)id));
+        dec.learn((const uint8_t*)f.body.data(), f.body.size());
+        fetched++;
+      }
+      uint32_t ms;
+      std::string line;
+      CHECK(dec.decode(b, r.body.size(), ms, line));
+      text += line + "\n";
+    }
+    CHECK(text.find("[AUTH] Capturing...\n[AUTH] Match — ID #") != std::string::npos);
+    CHECK(text.find(" → credential 2\n[AUTH] Sending unlock sequence...") != std::string::npos);
+    CHECK(text.find("[HID] Enter\n") != std::string::npos);
+    CHECK(fetched > 0 && fetched < records.size());   // one fetch per format
+
+    // HELLO starts the next session in text again
+    request(CTL_REQ_HELLO, seq++);
+    simClearLog();
+    flipTo(true);
+    CHECK(simSaw("[SWITCH] REGISTER"));
+  });
+  _flows += 3;
+  return fails;
+}
+
+// Longer than the short-string buffer, so the simulator's own copies
+// (typed keys, the scenario's strings) are on the heap, not scanned
+static const char* const SECRET_PASSWORD = "plaintext-canary-7f3a91c2";
+
+// ─── doTouch(), plus a look at RAM probeMs into the flow ───
+static bool touchHolding(uint8_t finger, const std::string &pw, uint32_t probeMs) {
+  userLetsGo();
+  flipTo(false);
+  simClearReactions();
+  simClearLog();
+  simClearKeys();
+
+  bool held = false;
+  simFingerOn(finger);
+  simAfter(probeMs, [&held, pw] { held = simRamHolds(pw); });
+  simAfter(450, [] { simFingerOff(); });
+  CHECK(simLoopUntil(touchEnded, 60000));
+  return held;
+}
+
+static int scenarioSecrets(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+  fails += simBoot([] { CHECK(doRegister(4, "1", SECRET_PASSWORD)); });
+
+  fails += simBoot([n] {
+    const std::string pw = SECRET_PASSWORD;
+    CHECK(!simRamHolds(pw));   // boot validation never decrypts
+
+    // Capture is SIM_CAPTURE_US; search ends a little after it
+    const uint32_t duringCaptureMs = SIM_CAPTURE_US / 2000;
+    const uint32_t afterSearchMs = (SIM_CAPTURE_US + SIM_SEARCH_BASE_US) / 1000 + 200;
+
+    for (uint32_t i = 0; i < n; i++) {
+      // Match: decrypted before the sensor is done, typed, then wiped
+      CHECK(touchHolding(4, pw, duringCaptureMs));
+      CHECK(simTyped() == pw);
+      CHECK(!simRamHolds(pw));
+      simLoopFor(COOLDOWN_MS);
+
+      // Unknown finger: wiped as soon as the search misses
+      CHECK(touchHolding(9, pw, duringCaptureMs));
+      CHECK(!touchHolding(9, pw, afterSearchMs));
+      CHECK(simSaw("[AUTH] No match"));
+      CHECK(simTyped().empty());
+      CHECK(!simRamHolds(pw));
+
+      // Failed capture
+      simFailCaptures(1);
+      CHECK(doTouch(4).empty());
+      CHECK(simSaw("[AUTH] Capture failed"));
+      CHECK(!simRamHolds(pw));
+    }
+  });
+  _flows += 4 * n;
+  return fails;
+}
+
+// ─── Lift waits: sensor traffic while resting, lift → next step ───
+struct LiftProbe {
+  uint64_t offAt = 0;        // when the user lifted
+  uint32_t opsAtRest = 0;    // sensor commands when the wait began
+  uint32_t restingOps = 0;   // sum over all waits
+};
+static LiftProbe _lift;
+
+// ─── One !MATCH row: attempts, compares, average µs ───
+struct MatchRow {
+  uint32_t n = 0, hits = 0, compares = 0, avgUs = 0;
+};
+
+static MatchRow matchRow(const char* strategy) {
+  simClearLog();
+  simType("!MATCH\n");
+  simLoopFor(50);
+  char key[32];
+  snprintf(key, sizeof(key), "[MATCH] %s ", strategy);
+  MatchRow r;
+  unsigned long n = 0, hits = 0, compares = 0, avg = 0;
+  if (sscanf(simLine(key).c_str() + strlen(key), " %lu %lu %lu %lu", &n, &hits, &compares, &avg) == 4) {
+    r.n = (uint32_t)n;
+    r.hits = (uint32_t)hits;
+    r.compares = (uint32_t)compares;
+    r.avgUs = (uint32_t)avg;
+  }
+  return r;
+}
+
+// ─── !IDLE counters ───
+struct IdleRow {
+  uint32_t idlePermille = 0, wakeups = 0, spurious = 0;
+  uint32_t touch = 0, sw = 0, console = 0, timer = 0;
+};
+
+static IdleRow idleRow() {
+  simClearLog();
+  simType("!IDLE\n");
+  simLoopFor(50);
+  IdleRow r;
+  unsigned long a = 0, b = 0, c = 0, d = 0;
+  std::string head = simLine(", idle ");
+  size_t at = head.find(", idle ");
+  if (at != std::string::npos && sscanf(head.c_str() + at, ", idle %lu.%lu", &a, &b) == 2) {
+    r.idlePermille = (uint32_t)(a * 10 + b);
+  }
+  if (sscanf(simLine("[IDLE] wakeups").c_str(), "[IDLE] wakeups %lu (%*u.%*u/s), spurious %lu", &a, &b) == 2) {
+    r.wakeups = (uint32_t)a;
+    r.spurious = (uint32_t)b;
+  }
+  if (sscanf(simLine("[IDLE] touch").c_str(), "[IDLE] touch %lu switch %lu console %lu timer %lu",
+             &a, &b, &c, &d) == 4) {
+    r.touch = (uint32_t)a;
+    r.sw = (uint32_t)b;
+    r.console = (uint32_t)c;
+    r.timer = (uint32_t)d;
+  }
+  return r;
+}
+
+// ─── !LINKBENCH → µs per ping for each rate (0 = not measured) ───
+static std::vector<std::pair<uint32_t, uint32_t>> linkBench() {
+  simClearLog();
+  simType("!LINKBENCH\n");
+  CHECK(simLoopUntil([] { return simSaw("[LINK]   9600 bps "); }, 60000));
+
+  std::vector<std::pair<uint32_t, uint32_t>> rates;
+  for (uint32_t baud : { 115200u, 57600u, 38400u, 19200u, 9600u }) {
+    char key[32];
+    snprintf(key, sizeof(key), "[LINK] %6u bps ", (unsigned)baud);   // table row, not the status line
+    unsigned long us = 0;
+    sscanf(simLine(key).c_str() + strlen(key), " %lu us/ping", &us);
+    rates.push_back(std::make_pair(baud, (uint32_t)us));
+  }
+  return rates;
+}
+
+static int scenarioLink(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+  SimStat probed("boot (sensor at 9600)"), saved("boot (saved rate)");
+
+  // Module left at 9600 by another host: found, moved up, saved
+  simSensorBaud(9600);
+  fails += simBoot([] {
+    remembered().bootUs = simBootUs();
+    CHECK(simSaw("[BOOT] Sensor init... OK (115200 bps)"));
+    CHECK(simSensorBaud() == 115200);
+    CHECK(doRegister(3, "1", "link-password"));
+    remember(3, "link-password");
+  });
+  probed.add(remembered().bootUs);
+
+  // Saved rate answers first time: no probing, round trips per rate
+  fails += simBoot([] {
+    remembered().bootUs = simBootUs();
+    CHECK(simBootUs() <= SIM_BOOT_BUDGET_MS * 1000ULL);
+    CHECK(simSaw("[BOOT] Sensor init... OK (115200 bps)"));
+
+    auto rates = linkBench();
+    CHECK(simSaw("[LINK] 115200 bps, ceiling 115200, 0 fallback(s)"));
+    uint32_t prev = 0;
+    for (auto &r : rates) {
+      printf("[SIM] link %6u bps       %6.2f ms per ping\n", (unsigned)r.first, r.second / 1000.0);
+      CHECK(r.second > prev);   // slower rate, longer round trip
+      prev = r.second;
+    }
+    CHECK(simSensorBaud() == 115200);   // bench puts the link back
+    CHECK(doTouch(remembered().finger) == remembered().password);
+
+    // Typed mid-capture: refused, the unlock goes on
+    simLoopFor(COOLDOWN_MS);
+    userLetsGo();
+    simClearLog();
+    simClearKeys();
+    simFingerOn(remembered().finger);
+    simAfter(150, [] { simType("!LINKBENCH\n"); });
+    simAfter(450, [] { simFingerOff(); });
+    CHECK(simLoopUntil(touchEnded, 60000));
+    CHECK(simTyped() == remembered().password);
+    simLoopFor(100);
+    CHECK(simSaw("[LINK] Sensor busy"));
+    CHECK(simSaw("[SENSOR] Refused op"));
+  });
+  saved.add(remembered().bootUs);
+
+  // Sensor swapped for one at 9600 on a line too noisy for 115200:
+  // 115200 fails verification, 57600 holds and becomes the ceiling
+  simSensorBaud(9600);
+  simLinkErrors(115200, 400);
+  fails += simBoot([] {
+    remembered().bootUs = simBootUs();
+    CHECK(simSaw("[BOOT] Sensor init... OK (57600 bps)"));
+    CHECK(simSensorBaud() == 57600);
+    CHECK(doTouch(remembered().finger) == remembered().password);
+  });
+  probed.add(remembered().bootUs);
+
+  uint32_t kept = n < SENSOR_LINK_REPROBE_BOOTS - 1 ? n : SENSOR_LINK_REPROBE_BOOTS - 1;   // before the re-probe
+  for (uint32_t i = 0; i < kept; i++) {
+    fails += simBoot([] {
+      remembered().bootUs = simBootUs();
+      CHECK(simSaw("[BOOT] Sensor init... OK (57600 bps)"));   // no retry of 115200
+      CHECK(simLinkErrorCount() == 0);
+      CHECK(doTouch(remembered().finger) == remembered().password);
+      simLoopFor(COOLDOWN_MS);
+    });
+    saved.add(remembered().bootUs);
+  }
+
+  // 57600 goes bad at run time: link errors step down to 38400
+  fails += simBoot([] {
+    simLinkErrors(57600, 400);
+    for (int t = 0; t < 50 && simSensorBaud() == 57600; t++) {
+      doTouch(remembered().finger);
+      simLoopFor(COOLDOWN_MS);
+    }
+    CHECK(simSensorBaud() == 38400);
+    CHECK(simSaw("[SENSOR] Link errors — now 38400 bps"));
+    CHECK(doTouch(remembered().finger) == remembered().password);
+  });
+  fails += simBoot([] {
+    CHECK(simSaw("[BOOT] Sensor init... OK (38400 bps)"));
+    CHECK(doTouch(remembered().finger) == remembered().password);
+    linkBench();
+    CHECK(simSaw("[LINK] 38400 bps, ceiling 38400"));
+    CHECK(simSaw("[LINK] 115200 bps        - (above ceiling)"));
+  });
+
+  // The line is clean again: boot stays at 38400 until the re-probe
+  // puts it back at 115200 (the boot above was the first since the drop)
+  simLinkErrors(115200, 0);
+  simLinkErrors(57600, 0);
+  for (uint32_t i = 1; i < SENSOR_LINK_REPROBE_BOOTS; i++) {
+    fails += simBoot([] {
+      CHECK(simSaw("[BOOT] Sensor init... OK (38400 bps)"));
+    });
+  }
+  fails += simBoot([] {
+    CHECK(simSaw("[BOOT] Sensor init... OK (115200 bps)"));
+    CHECK(simSensorBaud() == 115200);
+    CHECK(doTouch(remembered().finger) == remembered().password);
+    linkBench();
+    CHECK(simSaw("[LINK] 115200 bps, ceiling 115200"));
+  });
+  fails += simBoot([] {
+    CHECK(simSaw("[BOOT] Sensor init... OK (115200 bps)"));
+  });
+
+  probed.print();
+  saved.print();
+  _flows += kept + 6 + SENSOR_LINK_REPROBE_BOOTS;
+  return fails;
+}
+
+static int scenarioLift(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+  _lift = LiftProbe();
+
+  fails += simBoot([n] {
+    SimStat lag("lift → next prompt");
+    for (uint32_t i = 0; i < n; i++) {
+      uint8_t finger = (uint8_t)(40 + i);
+      userLetsGo();
+      flipTo(true);
+      userAnswersRegistration(finger, "1", "lift-password");
+      // Replace the user's quick lift with a 2 s rest on the glass
+      simOnLine("Remove finger", [] {
+        simCancelPending();
+        _lift.opsAtRest = simSensorOps();
+        simAfter(2000, [] {
+          _lift.restingOps += simSensorOps() - _lift.opsAtRest;
+          _lift.offAt = simNowUs();
+          simFingerOff();
+        });
+      });
+      // Registration waits 500 ms after the lift before the next prompt
+      for (int k = 2; k <= COLLECT_COUNT; k++) {
+        simOnLine(("Place finger (" + std::to_string(k) + "/").c_str(), [&lag] {
+          lag.add(simNowUs() - _lift.offAt - 500000);
+        });
+      }
+      simClearLog();
+      simFingerOn(finger);
+      simAfter(200, [] { simFingerOff(); });
+      CHECK(simLoopUntil(registrationEnded, 300000));
+      CHECK(simSaw("[REG] Success"));
+      simClearReactions();
+      remember(finger, "lift-password");
+    }
+    lag.print();
+    CHECK(lag.n == n * (COLLECT_COUNT - 1));
+    CHECK(lag.maxUs <= 2 * TASK_POLL_INTERVAL_MS * 1000ULL);
+
+    // Recognize: finger rests 3 s after the unlock; the wait for its
+    // lift sends nothing, and the next touch is taken right away
+    flipTo(false);
+    for (uint32_t i = 0; i < n; i++) {
+      userLetsGo();
+      simClearLog();
+      simClearKeys();
+      simOnLine("[AUTH] Cooldown 5s", [] {
+        simAfter(2500, [] { _lift.opsAtRest = simSensorOps(); });   // flow done, waiting for the lift
+        simAfter(5500, [] {
+          _lift.restingOps += simSensorOps() - _lift.opsAtRest;
+          simFingerOff();
+        });
+      });
+      simFingerOn(remembered().finger);
+      simLoopFor(COOLDOWN_MS + 6000);
+      simClearReactions();
+      CHECK(!simFingerPresent());
+      CHECK(simTyped() == remembered().password);
+    }
+  });
+  printf("[SIM] sensor commands while resting: %u\n", _lift.restingOps);
+  CHECK(_lift.restingOps == 0);
+  _flows += 2 * n;
+  return fails + (_lift.restingOps != 0);
+}
+
+// Credential 1: fingers 1..12, credential 2: finger 20
+#define MATCH_FINGERS 12
+#define MATCH_OTHER   20
+#define MATCH_UNKNOWN 99
+
+static const char* const MATCH_CMDS[] = { "!MATCH VERIFY\n", "!MATCH SEARCH\n", "!MATCH BOTH\n" };
+static const char* const MATCH_NAMES[] = { "verify", "search", "verify+search" };
+
+static int scenarioMatch(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([] {
+    CHECK(doRegister(1, "1", "alpha"));
+    for (uint8_t f = 2; f <= MATCH_FINGERS; f++) CHECK(doRegister(f, "1+", "unused"));
+    CHECK(doRegister(MATCH_OTHER, "2", "bravo"));
+    CHECK(simTemplateCount() == MATCH_FINGERS + 1);
+  });
+
+  fails += simBoot([n] {
+    auto touch = [](uint8_t finger) {
+      const char* want = finger == MATCH_OTHER ? "bravo" : finger <= MATCH_FINGERS ? "alpha" : "";
+      CHECK(doTouch(finger) == want);
+      simLoopFor(COOLDOWN_MS);
+    };
+
+    // rows[workload][strategy]
+    MatchRow rows[3][RECOG_STRATEGIES];
+    const char* workloads[3] = { "same finger", "every finger", "unknown finger" };
+    for (int w = 0; w < 3; w++) {
+      for (int st = 0; st < RECOG_STRATEGIES; st++) {
+        simType(MATCH_CMDS[st]);
+        touch(5);   // warm-up: last match = finger 5 for every strategy
+        simType("!MATCH RESET\n");
+        simLoopFor(50);
+        for (uint32_t i = 0; i < n; i++) {
+          if (w == 0) touch(5);
+          else if (w == 1) touch((uint8_t)(i % (MATCH_FINGERS + 1) == MATCH_FINGERS ? MATCH_OTHER : i % (MATCH_FINGERS + 1) + 1));
+          else touch(MATCH_UNKNOWN);
+        }
+        rows[w][st] = matchRow(MATCH_NAMES[st]);
+        CHECK(rows[w][st].n == n);
+        CHECK(rows[w][st].hits == (w == 2 ? 0 : n));
+      }
+      for (int st = 0; st < RECOG_STRATEGIES; st++) {
+        const MatchRow &r = rows[w][st];
+        printf("[SIM] %-15s %-14s %7.2f ms  %5.2f compares\n", workloads[w], MATCH_NAMES[st],
+               r.avgUs / 1000.0, r.n ? (double)r.compares / r.n : 0.0);
+      }
+    }
+
+    // Same finger: one 1:1 compare beats comparing all 13 templates
+    CHECK(rows[0][RECOG_VERIFY].compares == n && rows[0][RECOG_VERIFY_SEARCH].compares == n);
+    CHECK(rows[0][RECOG_VERIFY].avgUs < rows[0][RECOG_SEARCH].avgUs);
+    CHECK(rows[0][RECOG_VERIFY_SEARCH].avgUs < rows[0][RECOG_SEARCH].avgUs);
+    // Unknown finger: verify tries every indexed finger, verify+search pays both
+    CHECK(rows[2][RECOG_VERIFY].compares == n * (MATCH_FINGERS + 1));
+    CHECK(rows[2][RECOG_VERIFY_SEARCH].compares == 2 * n);
+    CHECK(rows[2][RECOG_SEARCH].compares == n);
+  });
+  _flows += MATCH_FINGERS + 1 + 3 * RECOG_STRATEGIES * (n + 1);
+  return fails;
+}
+
+// Quiet span: not a whole number of IDLE_MAX_MS, so it ends asleep
+#define IDLE_QUIET_MS  10500
+// Noise period: in 1500 periods never inside the 1 ms before a whole
+// second of the span, where a wakeup already meets the timer's
+// deadline (whole ms) and would stand in for it
+#define IDLE_NOISE_US  7003
+
+static uint64_t _idleAt = 0;   // when the scheduled touch / command went in
+
+static int scenarioIdle(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([] { CHECK(doRegister(1, "1", "idle-password")); });
+
+  fails += simBoot([n] {
+    std::mt19937 rng(7);
+    flipTo(false);
+    simLoopFor(BOOT_LED_MS);
+
+    // Nothing happens for IDLE_QUIET_MS: wakeups per mode, with and without noise
+    auto quiet = [](const char* mode, uint32_t noiseUs, uint32_t* noise) {
+      simType(mode);
+      simType("!IDLE RESET\n");
+      uint32_t before = simIrqNoiseCount();
+      simIrqNoise(noiseUs);
+      simLoopFor(IDLE_QUIET_MS);
+      simIrqNoise(0);
+      *noise = simIrqNoiseCount() - before;
+      return idleRow();
+    };
+    uint32_t noise[3];
+    IdleRow rows[3] = {
+      quiet("!IDLE EVENT\n", 0, &noise[0]),
+      quiet("!IDLE EVENT\n", IDLE_NOISE_US, &noise[1]),
+      quiet("!IDLE POLL\n", IDLE_NOISE_US, &noise[2]),
+    };
+    const char* names[3] = { "event-driven", "event + noise", "polling" };
+    for (int m = 0; m < 3; m++) {
+      const IdleRow &r = rows[m];
+      printf("[SIM] %-14s %5u wakeups (%6.1f/s)  %5u spurious  %4u noise  timer %2u  idle %5.1f %%\n",
+             names[m], r.wakeups, r.wakeups * 1000.0 / IDLE_QUIET_MS, r.spurious, noise[m], r.timer,
+             r.idlePermille / 10.0);
+    }
+    // The timer fires every IDLE_MAX_MS, the end of the span is a wakeup without an event
+    CHECK(rows[0].timer == IDLE_QUIET_MS / IDLE_MAX_MS && rows[0].spurious == 1);
+    CHECK(rows[0].wakeups == rows[0].timer + 1);
+    // Every noise interrupt is spurious: no pass, the timer is not pushed back
+    CHECK(noise[1] == IDLE_QUIET_MS * 1000ULL / IDLE_NOISE_US);
+    CHECK(rows[1].spurious == noise[1] + 1 && rows[1].timer == rows[0].timer);
+    CHECK(rows[1].wakeups == rows[1].spurious + rows[1].timer);
+    // Polling wakes every LOOP_IDLE_MS whatever happens
+    CHECK(rows[2].wakeups >= IDLE_QUIET_MS / LOOP_IDLE_MS - 1);
+    CHECK(rows[0].touch + rows[0].sw + rows[0].console == 0);
+
+    // Touch and console pickup, the event landing anywhere in the wait
+    SimStat touch[2] = { SimStat("touch pickup (event)"), SimStat("touch pickup (poll)") };
+    SimStat console[2] = { SimStat("!IDLE reply (event)"), SimStat("!IDLE reply (poll)") };
+    for (int m = 0; m < 2; m++) {
+      simType(m ? "!IDLE POLL\n" : "!IDLE EVENT\n");
+      simLoopFor(50);
+      for (uint32_t i = 0; i < n; i++) {
+        userLetsGo();
+        simClearReactions();
+        simClearLog();
+        simAfter(1 + rng() % 37, [] {
+          _idleAt = simNowUs();
+          simFingerOn(1);
+          simAfter(450, [] { simFingerOff(); });
+        });
+        CHECK(simLoopUntil(touchEnded, 60000));
+        CHECK(simSaw("[AUTH] Cooldown 5s"));
+        touch[m].add(simSawAtUs("[SENSOR] Finger detected") - _idleAt);
+        simLoopFor(COOLDOWN_MS);
+
+        simClearLog();
+        simAfter(1 + rng() % 37, [] {
+          _idleAt = simNowUs();
+          simType("!IDLE\n");
+        });
+        CHECK(simLoopUntil([] { return simSaw("[IDLE] wakeups"); }, 1000));
+        console[m].add(simSawAtUs("[IDLE] ") - _idleAt);
+      }
+    }
+    for (int m = 0; m < 2; m++) touch[m].print();
+    for (int m = 0; m < 2; m++) console[m].print();
+    CHECK(touch[0].maxUs < 1000 && console[0].maxUs < 1000);
+    CHECK(touch[1].maxUs <= LOOP_IDLE_MS * 1000ULL && touch[1].sumUs > touch[0].sumUs);
+    CHECK(console[1].maxUs <= LOOP_IDLE_MS * 1000ULL && console[1].sumUs > console[0].sumUs);
+  });
+  _flows += 1 + 2 * n;
+  return fails;
+}
+
+// ─── PROVISION body: credential, then the password ───
+static std::string provisionBody(uint8_t cred, const std::string &password) {
+  return std::string(1, (char)cred) + password;
+}
+
+static uint8_t nakCode(const Msg &m) {
+  return m.type == CTL_RSP_NAK && m.body.size() == 2 ? (uint8_t)m.body[1] : 0;
+}
+
+static uint8_t _provFinger = 0;   // the finger the operator presents
+
+static int scenarioProvision(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([n] {
+    listenFrames();
+    CHECK(request(CTL_REQ_HELLO, 1).type == (CTL_REQ_HELLO | CTL_RSP));
+    flipTo(true);
+
+    // Refused before anything starts
+    std::string tooLong(PASSWORD_MAX_LEN + 1, 'x');
+    CHECK(nakCode(request(CTL_REQ_PROVISION, 2, "")) == CTL_ERR_BAD_ARG);
+    CHECK(nakCode(request(CTL_REQ_PROVISION, 3, provisionBody(0, "pw"))) == CTL_ERR_BAD_ARG);
+    CHECK(nakCode(request(CTL_REQ_PROVISION, 4, provisionBody(CRED_MAX_CREDENTIALS + 1, "pw"))) == CTL_ERR_BAD_ARG);
+    CHECK(nakCode(request(CTL_REQ_PROVISION, 5, provisionBody(1, tooLong))) == CTL_ERR_BAD_ARG);
+    CHECK(nakCode(request(CTL_REQ_PROVISION, 6, provisionBody(1, "tab\there"))) == CTL_ERR_BAD_ARG);
+    CHECK(nakCode(request(CTL_REQ_PROVISION, 7, provisionBody(1, ""))) == CTL_ERR_BAD_ARG);   // nothing to add a finger to
+    CHECK(nakCode(request(CTL_REQ_PROVISION, 8, provisionBody(1 | HID_LAYOUTS << 4, "pw"))) == CTL_ERR_BAD_ARG);   // no such layout
+    CHECK(!simSaw("starting registration"));
+
+    // The operator only presents a finger; the tool sent everything else
+    SimStat provisioned("PROVISION → DONE");
+    std::string password;
+    uint8_t seq = 10;
+    for (uint32_t i = 0; i < n; i++) {
+      _provFinger = (uint8_t)(20 + i);
+      password = "fleet-unit-" + std::to_string(i);
+      userLetsGo();
+      listenFrames([&](const Msg &e) {
+        if (e.type != CTL_EVT_REG) return;
+        if ((uint8_t)e.body[0] == CTL_REG_PLACE) simAfter(400, [] { simFingerOn(_provFinger); });
+        if ((uint8_t)e.body[0] == CTL_REG_REMOVE) {
+          simAfter(300, [] { simFingerOff(); });
+          // A second PROVISION while this one runs is refused
+          simAfter(100, [&] { simType(frameBytes(CTL_REQ_PROVISION, seq++, provisionBody(2, "other"))); });
+        }
+      });
+      simClearLog();
+      uint64_t t0 = simNowUs();
+      CHECK(request(CTL_REQ_PROVISION, seq++, provisionBody(1, password)).type == (CTL_REQ_PROVISION | CTL_RSP));
+      CHECK(simLoopUntil([] { return eventCount(CTL_EVT_REG, CTL_REG_DONE) + eventCount(CTL_EVT_REG, CTL_REG_FAILED) > 0; },
+                         120000));
+      CHECK(eventCount(CTL_EVT_REG, CTL_REG_DONE) == 1);
+      provisioned.add(simNowUs() - t0);
+      CHECK(eventCount(CTL_EVT_REG, CTL_REG_CHOOSE) + eventCount(CTL_EVT_REG, CTL_REG_PASSWORD) +
+            eventCount(CTL_EVT_REG, CTL_REG_CONFIRM) == 0);
+      uint32_t refused = 0;
+      for (const Msg &m : _msgs) refused += nakCode(m) == CTL_ERR_STATE;
+      CHECK(refused == COLLECT_COUNT);
+      CHECK(simSaw("[REG] Password provisioned") && !simSaw(password.c_str()));
+      simLoopFor(3000);
+    }
+    provisioned.print();
+    printf("[SIM] %.1f units provisioned per minute (one operator, simulated)\n",
+           60e6 * provisioned.n / provisioned.sumUs);
+    CHECK(simTemplateCount() == 1);
+
+    // Empty password: one more finger for the same credential
+    userLetsGo();
+    _provFinger = 99;
+    listenFrames([](const Msg &e) {
+      if (e.type != CTL_EVT_REG) return;
+      if ((uint8_t)e.body[0] == CTL_REG_PLACE) simAfter(400, [] { simFingerOn(_provFinger); });
+      if ((uint8_t)e.body[0] == CTL_REG_REMOVE) simAfter(300, [] { simFingerOff(); });
+    });
+    CHECK(request(CTL_REQ_PROVISION, seq++, provisionBody(1, "")).type == (CTL_REQ_PROVISION | CTL_RSP));
+    CHECK(simLoopUntil([] { return eventCount(CTL_EVT_REG, CTL_REG_DONE) > 0; }, 120000));
+    CHECK(simTemplateCount() == 2);
+    simLoopFor(3000);
+
+    // Not in RECOGNIZE
+    userLetsGo();
+    flipTo(false);
+    CHECK(nakCode(request(CTL_REQ_PROVISION, seq++, provisionBody(1, "pw"))) == CTL_ERR_STATE);
+    CHECK(doTouch((uint8_t)(20 + n - 1)) == password);
+    simLoopFor(COOLDOWN_MS);
+    CHECK(doTouch(99) == password);
+  });
+  _flows += n + 3;
+  return fails;
+}
+
+// ─── A flip to RECOGNIZE that bounces: edges at 0, 1, 3, 6, 10 ms ───
+static const uint8_t CANCEL_BOUNCE_MS[] = { 0, 1, 3, 6, 10 };
+static uint64_t _cancelEdgeUs = 0;   // last edge so far
+
+static void bounceToRecognize(uint32_t afterMs) {
+  for (size_t i = 0; i < sizeof(CANCEL_BOUNCE_MS); i++) {
+    bool level = i % 2;   // even edges go to RECOGNIZE, and so does the last
+    simAfter(afterMs + CANCEL_BOUNCE_MS[i], [level] {
+      simSwitch(level);
+      _cancelEdgeUs = simNowUs();
+    });
+  }
+}
+
+// ─── Last bounce → "aborting registration" ───
+static uint64_t cancelLatencyUs() {
+  uint64_t at = simSawAtUs("aborting registration");
+  return at > _cancelEdgeUs ? at - _cancelEdgeUs : 0;
+}
+
+static int scenarioCancel(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+  fails += simBoot([] { CHECK(doRegister(1, "1", "old-password")); });
+
+  fails += simBoot([n] {
+    std::mt19937 rng(20);
+    SimStat waiting("flip → abort (waiting for finger)"), password("flip → abort (password prompt)");
+    SimStat capturing("flip → abort (capturing)");
+
+    auto oldStillWorks = [] {
+      CHECK(simTemplateCount() == 1);
+      CHECK(doTouch(1) == "old-password");
+      simLoopFor(COOLDOWN_MS);
+    };
+    // Registration up to the first capture; the finger comes back only if asked
+    auto start = [](bool answer) {
+      userLetsGo();
+      flipTo(true);
+      userAnswersRegistration(2, "1", "new-password");
+      if (!answer) {
+        simClearReactions();
+        simOnLine("[REG] Credential (", [] { simAfter(600, [] { simType("1\n"); }); });
+      }
+      simClearLog();
+      simFingerOn(2);
+      simAfter(200, [] { simFingerOff(); });
+    };
+
+    for (uint32_t i = 0; i < n; i++) {
+      // Nobody touches: before, the flip waited out CAPTURE_TIMEOUT
+      start(false);
+      uint32_t after = 100 + rng() % 2000;
+      simOnLine("Place finger (1/", [after] { bounceToRecognize(after); });
+      CHECK(simLoopUntil(registrationEnded, 60000));
+      CHECK(simSaw("aborting registration") && !simSaw("Capture failed"));
+      waiting.add(cancelLatencyUs());
+      oldStillWorks();
+
+      // Flip while the sensor is capturing: the capture is not taken
+      start(true);
+      simOnLine("Place finger (2/", [] { bounceToRecognize(400 + SIM_CAPTURE_US / 2000); });
+      CHECK(simLoopUntil(registrationEnded, 60000));
+      CHECK(simSaw("aborting registration") && !simSaw("Captured 2/"));
+      capturing.add(cancelLatencyUs());
+      oldStillWorks();
+
+      // Flip at the password prompt
+      start(true);
+      after = 100 + rng() % 2000;
+      simOnLine("Enter password", [after] { bounceToRecognize(after); });
+      CHECK(simLoopUntil(registrationEnded, 60000));
+      CHECK(simSaw("aborting registration") && !simSaw("Confirm password"));
+      password.add(cancelLatencyUs());
+      oldStillWorks();
+    }
+    waiting.print();
+    capturing.print();
+    password.print();
+    // Taken one debounce window after the last bounce, seen on the next task tick;
+    // mid-capture too: core1 finishes the capture, core0 stops waiting for it
+    CHECK(waiting.minUs >= DEBOUNCE_MS * 1000ULL && waiting.maxUs <= (DEBOUNCE_MS + 2) * 1000ULL);
+    CHECK(capturing.minUs >= DEBOUNCE_MS * 1000ULL && capturing.maxUs <= (DEBOUNCE_MS + 2) * 1000ULL);
+    CHECK(password.minUs >= DEBOUNCE_MS * 1000ULL && password.maxUs <= (DEBOUNCE_MS + 2) * 1000ULL);
+
+    // A glitch shorter than the window is no flip
+    start(true);
+    simOnLine("Place finger (1/", [] {
+      simAfter(150, [] { simSwitch(false); });
+      simAfter(150 + DEBOUNCE_MS - 5, [] { simSwitch(true); });
+    });
+    CHECK(simLoopUntil(registrationEnded, 300000));
+    CHECK(simSaw("[REG] Success") && !simSaw("aborting registration"));
+    CHECK(doTouch(1).empty());
+    CHECK(doTouch(2) == "new-password");
+  });
+  _flows += 1 + 3 * n * 2 + 3;
+  return fails;
+}
+
+// ─── Clear one bit in the ciphertext of id's template backup ───
+// Reads headers the way tpl_backup.h lays them out (magic, version, id).
+static bool tamperBackup(uint8_t id) {
+  for (uint32_t slot = 0; slot < TPL_BACKUP_SLOTS; slot++) {
+    uint32_t off = FLASH_REGION_JOURNAL + slot * FLASH_REGION_SECTOR;
+    uint8_t page[FLASH_REGION_PAGE];
+    flashRegionRead(off, page, 8);
+    if (page[0] != 'T' || page[1] != 'P' || page[5] != id) continue;
+    flashRegionRead(off + FLASH_REGION_PAGE, page, sizeof(page));   // ciphertext only
+    for (uint8_t &b : page) {
+      if (b) {
+        b &= (uint8_t)(b - 1);
+        flashRegionProgram(off + FLASH_REGION_PAGE, page);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// ─── "... from backup in N ms" → N ───
+static unsigned long restoreMs() {
+  std::string line = simLine("from backup in ");
+  unsigned long ms = 0;
+  size_t at = line.find(" in ");
+  if (at != std::string::npos) sscanf(line.c_str() + at, " in %lu", &ms);
+  return ms;
+}
+
+static int scenarioBackup(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([] {
+    CHECK(doRegister(1, "1", "alpha"));
+    CHECK(simSaw("[REG] Template backed up"));
+    CHECK(doRegister(2, "1+", "unused", &remembered().registered));   // enrolling a finger, no password
+    CHECK(doRegister(3, "2", "bravo"));
+    CHECK(simTemplateCount() == 3);
+    remembered().registered.print();
+  });
+  _flows += 3;
+
+  // Sensor module swapped: the journal still knows all three fingers
+  for (uint32_t i = 0; i < n; i++) {
+    simSensorWipe();
+    fails += simBoot([] {
+      CHECK(simSaw("[BOOT] Restored 3 template(s) from backup"));
+      CHECK(simSaw("[BOOT] State: VALID") && !simSaw("missing on sensor"));
+      CHECK(simTemplateCount() == 3);
+      remembered().restored.add(restoreMs() * 1000ULL / 3);
+      CHECK(doTouch(2) == "alpha");
+      simLoopFor(COOLDOWN_MS);
+      CHECK(doTouch(3) == "bravo");
+      simLoopFor(COOLDOWN_MS);
+    });
+    _flows += 2;
+  }
+  remembered().restored.print();
+  printf("[SIM] restoring a template takes %.0f ms, enrolling it again %.1f s\n",
+         remembered().restored.sumUs / remembered().restored.n / 1000.0,
+         remembered().registered.sumUs / remembered().registered.n / 1e6);
+
+  // Altered in flash: credential 2's only finger is refused, credential 1 restores
+  fails += simBoot([] { CHECK(tamperBackup(3)); });
+  simSensorWipe();
+  fails += simBoot([] {
+    CHECK(simSaw("[BOOT] Restored 2 template(s) from backup"));
+    CHECK(simSaw("[WARNING] Backup for ID 3 refused"));
+    CHECK(simSaw("[WARNING] Dropping credential #2"));
+    CHECK(simSaw("[BOOT] State: VALID"));
+    CHECK(simTemplateCount() == 2 && simTemplateFinger(3) == 0);
+    CHECK(doTouch(3).empty());
+    CHECK(doTouch(1) == "alpha");
+    simLoopFor(COOLDOWN_MS);
+
+    // Replacing credential 1 retires the backups of fingers 1 and 2
+    CHECK(doRegister(4, "1", "delta"));
+    CHECK(simTemplateCount() == 1);
+  });
+  _flows += 3;
+
+  simSensorWipe();
+  fails += simBoot([] {
+    CHECK(simSaw("[BOOT] Restored 1 template(s) from backup"));
+    CHECK(simSaw("[BOOT] State: VALID") && !simSaw("refused"));
+    CHECK(simTemplateCount() == 1);
+    for (uint8_t id = 1; id <= SENSOR_CAPACITY; id++) {
+      CHECK(simTemplateFinger(id) != 1 && simTemplateFinger(id) != 2);
+    }
+    CHECK(doTouch(1).empty());
+    CHECK(doTouch(4) == "delta");
+  });
+  _flows += 2;
+  return fails;
+}
+
+// ─── One streamed frame as the monitor puts it together ───
+struct ImgFrame {
+  uint8_t w = 0, h = 0, shift = 0;
+  uint32_t rows = 0, coded = 0;
+  bool ok = true;
+  uint64_t firstRowUs = 0, lastRowUs = 0;
+  std::vector<uint8_t> px;
+};
+static ImgFrame _img;
+
+static void listenImage() {
+  _img = ImgFrame();
+  listenFrames([](const Msg &e) {
+    const uint8_t* b = (const uint8_t*)e.body.data();
+    if (e.type == CTL_EVT_IMAGE && e.body.size() == 4) {
+      _img = ImgFrame();
+      _img.w = b[1];
+      _img.h = b[2];
+      _img.shift = b[3];
+      _img.px.assign((size_t)_img.w * _img.h, 0);
+    } else if (e.type == CTL_EVT_IMAGE_ROW && e.body.size() >= 2 && _img.w) {
+      if (!_img.rows) _img.firstRowUs = simNowUs();
+      _img.lastRowUs = simNowUs();
+      _img.ok &= b[1] < _img.h &&
+                 imgDecodeRow(b + 2, e.body.size() - 2, _img.w, _img.shift, &_img.px[(size_t)b[1] * _img.w]);
+      _img.rows++;
+      _img.coded += (uint32_t)e.body.size() - 2;
+    }
+  });
+}
+
+// ─── Every pixel in the step the sensor's pixel fell into ───
+static bool imgMatchesSensor(uint8_t finger) {
+  std::vector<uint8_t> want((size_t)_img.w * _img.h);
+  fpImageSynth(finger, want.data(), _img.w, _img.h, SIM_IMAGE_NOISE);
+  for (size_t i = 0; i < want.size(); i++) {
+    if ((want[i] >> _img.shift) != (_img.px[i] >> _img.shift)) return false;
+  }
+  return true;
+}
+
+static int scenarioImage(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([n] {
+    CHECK(doRegister(5, "1", "echo"));
+    simLoopFor(3000);
+
+    listenImage();
+    CHECK(request(CTL_REQ_HELLO, 1).type == (CTL_REQ_HELLO | CTL_RSP));
+    CHECK(nakCode(request(CTL_REQ_IMAGE, 2, "")) == CTL_ERR_BAD_ARG);
+    CHECK(nakCode(request(CTL_REQ_IMAGE, 3, std::string(1, '\2'))) == CTL_ERR_BAD_ARG);
+    CHECK(nakCode(request(CTL_REQ_IMAGE, 4, std::string("\1") + (char)(IMAGE_SHIFT_MAX + 1))) == CTL_ERR_BAD_ARG);
+    Msg on = request(CTL_REQ_IMAGE, 5, std::string(1, '\1'));
+    CHECK(on.type == (CTL_REQ_IMAGE | CTL_RSP) && on.body.size() == 4);
+    CHECK(on.body[0] == 1 && on.body[1] == 0);
+    uint8_t w = (uint8_t)on.body[2], h = (uint8_t)on.body[3];
+
+    // Lossless, then quantized to 16 levels
+    uint8_t seq = 10;
+    for (uint8_t shift : { 0, 4 }) {
+      CHECK(request(CTL_REQ_IMAGE, seq++, std::string("\1") + (char)shift).type == (CTL_REQ_IMAGE | CTL_RSP));
+      SimStat toEnter("touch → Enter key"), toImage("Enter key → last row");
+      uint32_t coded = 0;
+      for (uint32_t i = 0; i < n; i++) {
+        listenImage();
+        simLoopFor(COOLDOWN_MS);
+        CHECK(doTouch(5, nullptr, &toEnter) == "echo");
+        CHECK(simLoopUntil([h] { return _img.rows == h; }, 15000));
+        simLoopFor(100);   // the frame's log lines
+        CHECK(_img.ok && _img.w == w && _img.h == h && _img.shift == shift);
+        CHECK(imgMatchesSensor(5));
+        CHECK(simEnterUs() && simEnterUs() < _img.firstRowUs);   // the unlock never waits for the image
+        toImage.add(_img.lastRowUs - simEnterUs());
+        coded = _img.coded;
+      }
+      CHECK(simSaw("[IMAGE] Frame ") && simSaw("[IMAGE] Fetch "));
+      printf("[SIM] shift %u: %u → %u bytes per frame (%.1f%%)\n", shift, (unsigned)w * h, coded,
+             100.0 * coded / ((unsigned)w * h));
+      toEnter.print();
+      toImage.print();
+      printf("[SIM]   %s\n", simLine("[IMAGE] Fetch ").c_str());
+    }
+
+    // Off: the next touch sends nothing
+    CHECK(request(CTL_REQ_IMAGE, seq++, std::string(1, '\0')).type == (CTL_REQ_IMAGE | CTL_RSP));
+    listenImage();
+    simLoopFor(COOLDOWN_MS);
+    CHECK(doTouch(5) == "echo");
+    simLoopFor(8000);
+    CHECK(eventCount(CTL_EVT_IMAGE) == 0 && !simSaw("[IMAGE]"));
+  });
+
+  // After a reboot: off, and on without a session streams nothing
+  fails += simBoot([] {
+    listenFrames();
+    simClearLog();
+    simType("!IMAGE\n");
+    CHECK(simLoopUntil([] { return simSaw("[IMAGE] Off"); }, 1000));
+    simType("!IMAGE ON 9\n");
+    CHECK(simLoopUntil([] { return simSaw("[IMAGE] Usage"); }, 1000));
+    simType("!IMAGE ON 2\n");
+    CHECK(simLoopUntil([] { return simSaw("[IMAGE] On, "); }, 1000));
+    CHECK(simSaw("shift 2 (no monitor session)"));
+    CHECK(doTouch(5) == "echo");
+    simLoopFor(8000);
+    CHECK(_msgs.empty() && !simSaw("[IMAGE] Frame"));
+  });
+  _flows += 2 * n + 3;
+  return fails;
+}
+
+static int scenarioTyping(uint32_t n) {
+  static const char* const PW = "Correct-Horse-Battery-Staple-42!";
+  int fails = 0;
+  simWipe();
+  forget();
+  fails += simBoot([] { CHECK(doRegister(6, "1", PW)); });
+
+  fails += simBoot([n] {
+    HidReport want[HID_REPORTS_MAX(PASSWORD_MAX_LEN)];
+    size_t reports = hidReportBuild(PW, want);
+    SimStat train("first → last report"), enter("touch → Enter key");
+
+    for (uint32_t i = 0; i < n; i++) {
+      simLoopFor(COOLDOWN_MS);
+      CHECK(doTouch(6, nullptr, &enter) == PW);
+      const std::vector<SimHidReport> &got = simHidReports();
+      CHECK(got.size() == reports);
+      CHECK(simHidOverruns() == 0);
+      for (size_t k = 0; k < got.size() && k < reports; k++) {
+        CHECK(got[k].mods == want[k].mods && got[k].keys[0] == want[k].key);
+        if (k) CHECK(got[k].us - got[k - 1].us == HID_REPORT_INTERVAL_US);   // on its deadline
+      }
+      if (!got.empty()) train.add(got.back().us - got.front().us);
+    }
+    simLoopFor(100);
+    CHECK(simSaw("[HID] Typed 32 chars in "));
+    printf("[SIM] %zu reports for 32 chars; Keyboard.print() sends 64 (%.0f ms at one per poll)\n",
+           reports, 64 * HID_POLL_INTERVAL_US / 1000.0);
+    train.print();
+    enter.print();
+    printf("[SIM]   %s\n", simLine("[HID] Typed ").c_str());
+  });
+
+  // Per-credential layouts: each types right on its own Mac, and
+  // the same reports come out wrong through another layout
+  static const char* const MIXED = "Zy@#^~`{|}\\-Qa,m;1";
+  static const struct { uint8_t finger; const char* choice; uint8_t layout; } hosts[] = {
+    { 7, "2 DE", HID_LAYOUT_DE }, { 8, "3 fr", HID_LAYOUT_FR }, { 9, "4 CH", HID_LAYOUT_CH },
+  };
+  fails += simBoot([] {
+    for (auto &h : hosts) {
+      CHECK(doRegister(h.finger, h.choice, MIXED));
+      CHECK(simSaw((std::string(", ") + hidLayoutName(h.layout) + " keyboard").c_str()));
+    }
+    CHECK(doRegister(11, "1+", "unused"));   // adding a finger keeps credential 1 on US
+    CHECK(doRegister(10, "2", MIXED));   // replacing without a layout keeps DE
+    CHECK(simSaw(", DE keyboard"));
+  });
+  fails += simBoot([] {
+    for (auto &h : hosts) {
+      simHostLayout(h.layout);
+      simLoopFor(COOLDOWN_MS);
+      CHECK(doTouch(h.finger == 7 ? 10 : h.finger) == MIXED);
+      CHECK(simSaw((std::string("[HID] Typing password (") + hidLayoutName(h.layout) + ")").c_str()));
+      CHECK(simHidOverruns() == 0);
+    }
+    simHostLayout(HID_LAYOUT_US);
+    simLoopFor(COOLDOWN_MS);
+    CHECK(doTouch(9) != MIXED);
+    simLoopFor(COOLDOWN_MS);
+    CHECK(doTouch(6) == PW);
+    simType("!CREDS\n");
+    CHECK(simLoopUntil([] { return simSaw("[CRED] #4: valid, bank A, layout CH"); }, 1000));
+    CHECK(simSaw("[CRED] #1: valid, bank A, layout US"));
+  });
+  _flows += n + 11;
+  return fails;
+}
+
+// ─── HELLO / STATUS while a flow waits on the sensor ───
+// The web UI says HELLO on every reconnect, whenever that lands;
+// the reply must come from the cache, not from a sensor command
+// slipped in under the flow's capture.
+static uint32_t statusReplies(uint32_t &unknown) {
+  uint32_t n = 0;
+  unknown = 0;
+  for (const Msg &m : _msgs) {
+    if (m.type != (CTL_REQ_HELLO | CTL_RSP) && m.type != (CTL_REQ_STATUS | CTL_RSP)) continue;
+    n++;
+    if ((uint8_t)m.body[4] == CTL_STATUS_UNKNOWN) unknown++;
+  }
+  return n;
+}
+
+static int scenarioStatus(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([n] {
+    static uint8_t seq;
+    static uint32_t asked;
+    seq = 1;
+    asked = 0;
+    auto ask = [] {   // a reconnect: HELLO, then STATUS
+      simType(frameBytes(CTL_REQ_HELLO, seq++, ""));
+      simType(frameBytes(CTL_REQ_STATUS, seq++, ""));
+      asked += 2;
+    };
+
+    for (uint32_t i = 0; i < n; i++) {
+      uint8_t finger = (uint8_t)(20 + i);
+      std::string pw = "status " + std::to_string(i);
+
+      // Registration: 150 ms into every capture (finger lands 400 ms after the prompt)
+      userLetsGo();
+      flipTo(true);
+      listenFrames();
+      asked = 0;
+      userAnswersRegistration(finger, "1", pw);
+      simOnLine("Place finger (", [ask] { simAfter(550, ask); });
+      simClearLog();
+      simFingerOn(finger);
+      simAfter(200, [] { simFingerOff(); });
+      CHECK(simLoopUntil(registrationEnded, 300000));
+      simClearReactions();
+      CHECK(simSaw("[REG] Captured 1"));
+      CHECK(simSaw("[REG] Success"));
+      uint32_t unknown, answered = statusReplies(unknown);
+      CHECK(asked == 2 * COLLECT_COUNT && answered == asked);
+      CHECK(unknown > 0);   // step 1 deleted the old templates: the count is stale
+
+      // Recognition: 150 ms into the capture
+      userLetsGo();
+      flipTo(false);
+      listenFrames();
+      asked = 0;
+      simClearLog();
+      simClearKeys();
+      simFingerOn(finger);
+      simAfter(150, ask);
+      simAfter(450, [] { simFingerOff(); });
+      CHECK(simLoopUntil(touchEnded, 60000));
+      CHECK(simTyped() == pw);
+      answered = statusReplies(unknown);
+      CHECK(answered == asked && asked == 2);
+
+      // Idle again: the real count
+      simLoopFor(COOLDOWN_MS);
+      Msg st = request(CTL_REQ_STATUS, seq++);
+      CHECK(st.body.size() >= 10 && (uint8_t)st.body[4] == 1);
+    }
+  });
+  _flows += 2 * n;
+  return fails;
+}
+
+// ─── Console service while flows run ───
+// A host pings every SERVICE_PING_MS through registrations and
+// unlocks, and types a console command now and then outside the
+// prompts (where text is the user's answer). Every ping
+// comes back within SERVICE_RTT_MAX_MS, and !STATS reports the
+// longest gap between two polls inside a flow.
+#define SERVICE_PING_MS     23     // not a multiple of the poll interval
+#define SERVICE_GAP_MAX_MS  (FLASH_SIM_ERASE_US / 1000 + 15)   // a commit's erase + programs hold core0
+#define SERVICE_RTT_MAX_MS  (SERVICE_GAP_MAX_MS + 2 * TASK_POLL_INTERVAL_MS)
+
+struct ServiceProbe {
+  bool on = false;
+  bool text = false;
+  uint8_t seq = 0;
+  uint64_t sentUs[256] = {};
+  uint32_t sent = 0;
+};
+static ServiceProbe _svc;
+
+static void servicePing() {
+  if (!_svc.on) return;
+  _svc.seq = _svc.seq == 255 ? 1 : _svc.seq + 1;   // seq 0 is for events
+  _svc.sentUs[_svc.seq] = simNowUs();
+  _svc.sent++;
+  simType(frameBytes(CTL_REQ_PING, _svc.seq, "svc"));
+  if (_svc.text && _svc.sent % 40 == 0) simType("!IDLE\n");   // text between the frames
+  simAfter(SERVICE_PING_MS, servicePing);
+}
+
+static void serviceStart(bool text) {
+  _svc.on = true;
+  _svc.text = text;
+  simAfter(1 + _svc.sent % SERVICE_PING_MS, servicePing);
+}
+
+static int scenarioService(uint32_t n) {
+  int fails = 0;
+  simWipe();
+  forget();
+
+  fails += simBoot([n] {
+    static SimStat rtt("ping round trip");
+    static uint32_t answered;
+    answered = 0;
+    simOnFrame([](const std::string &cobs) {
+      Msg m;
+      if (!decodeMsg(cobs, m) || m.type != (CTL_REQ_PING | CTL_RSP)) return;
+      CHECK(m.body == "svc");
+      rtt.add(simNowUs() - _svc.sentUs[m.seq]);
+      answered++;
+    });
+    simType("!STATS RESET\n");
+    simLoopFor(10);
+
+    for (uint32_t i = 0; i < n; i++) {
+      uint8_t finger = (uint8_t)(60 + i);
+      std::string pw = "service " + std::to_string(i);
+
+      userLetsGo();
+      flipTo(true);
+      userAnswersRegistration(finger, "1", pw);
+      serviceStart(false);
+      simClearLog();
+      simFingerOn(finger);
+      simAfter(200, [] { simFingerOff(); });
+      CHECK(simLoopUntil(registrationEnded, 300000));
+      CHECK(simSaw("[REG] Success"));
+      simClearReactions();
+
+      userLetsGo();
+      flipTo(false);
+      serviceStart(true);
+      simClearLog();
+      simClearKeys();
+      simFingerOn(finger);
+      simAfter(450, [] { simFingerOff(); });
+      CHECK(simLoopUntil(touchEnded, 60000));
+      CHECK(simTyped() == pw);
+      simLoopFor(COOLDOWN_MS);
+      _svc.on = false;
+      simLoopFor(SERVICE_RTT_MAX_MS);
+    }
+
+    unsigned long gap = maxPollGap();
+    printf("[SIM] %u pings, max poll gap in a flow %lu ms\n", (unsigned)_svc.sent, gap);
+    rtt.print();
+    CHECK(answered == _svc.sent);
+    CHECK(gap <= SERVICE_GAP_MAX_MS);
+    CHECK(rtt.maxUs <= SERVICE_RTT_MAX_MS * 1000ULL);
+  });
+  _flows += 2 * n;
+  return fails;
+}
+
+#if HID_ADAPTIVE_TIMING
+// ─── Adaptive HID timing (sim_adaptive: built with HID_ADAPTIVE_TIMING 1) ───
+// A Mac that answers the Caps Lock probe ends every step on its ack, one
+// that doesn't costs the first step its full budget and then gets
+// the fixed delays. Steps as hidPrintTiming() logs them.
+static const char* const ADAPTIVE_STEPS[] = {
+  "lock", "wake press", "wake settle", "clear field", "type", "enter",
+};
+
+// A probe answered on time: two Caps Lock taps, or the floor
+#define ADAPTIVE_STEP_MAX_MS  (HID_ADAPTIVE_MIN_MS > 100 ? HID_ADAPTIVE_MIN_MS : 100)
+
+struct AdaptiveRun {
+  uint32_t steps = 0, acked = 0, early = 0;   // early: ended before its budget
+  unsigned slowest = 0;
+  long saved = 0;
+  bool fellBack = false;
+};
+
+static AdaptiveRun adaptiveRun() {
+  AdaptiveRun r;
+  for (const char* name : ADAPTIVE_STEPS) {
+    std::string line = simLine((std::string("[HID] ") + name + ": ").c_str());
+    unsigned took = 0, budget = 0;
+    if (sscanf(line.c_str() + strlen("[HID] ") + strlen(name), ": %u/%u ms", &took, &budget) != 2) continue;
+    r.steps++;
+    if (line.find("(ack)") != std::string::npos) r.acked++;
+    if (took < budget) r.early++;
+    if (took > r.slowest) r.slowest = took;
+  }
+  sscanf(simLine("[HID] Saved ").c_str(), "[HID] Saved %ld ms", &r.saved);
+  r.fellBack = simSaw("[HID] Host not answering LED probe");
+  return r;
+}
+
+static int scenarioAdaptive(uint32_t n) {
+  static const long FIXED_MS = LOCK_DELAY_MS + WAKE_PRESSES * WAKE_PRESS_DELAY_MS + WAKE_SETTLE_MS +
+                               FIELD_CLEAR_DELAY_MS + POST_TYPE_DELAY_MS + POST_ENTER_DELAY_MS;
+  int fails = 0;
+  simWipe();
+  forget();
+  fails += simBoot([] { CHECK(doRegister(5, "1", "adaptive")); });
+
+  fails += simBoot([n] {
+    SimStat acking("touch → Enter (host acks)"), silent("touch → Enter (no LED reports)");
+    long savedAck = 0, savedSilent = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+      // Answers every probe SIM_HOST_LED_ACK_MS after the tap
+      simHostLedReports(true);
+      simLoopFor(COOLDOWN_MS);
+      CHECK(doTouch(5, nullptr, &acking) == "adaptive");
+      simLoopFor(POST_ENTER_DELAY_MS);
+      AdaptiveRun a = adaptiveRun();
+      CHECK(a.steps == 6 && a.acked == a.steps && a.slowest <= ADAPTIVE_STEP_MAX_MS);
+      CHECK(!a.fellBack);
+      CHECK(!simHostCapsLock());   // toggled back after each probe
+      CHECK(a.saved >= FIXED_MS - (long)(WAKE_PRESSES + 5) * ADAPTIVE_STEP_MAX_MS);
+      savedAck = a.saved;
+
+      // Never answers: the first step waits out its budget, the rest are fixed
+      simHostLedReports(false);
+      simLoopFor(COOLDOWN_MS);
+      CHECK(doTouch(5, nullptr, &silent) == "adaptive");
+      simLoopFor(POST_ENTER_DELAY_MS);
+      AdaptiveRun f = adaptiveRun();
+      CHECK(f.steps == 6 && f.acked == 0 && f.early == 0);
+      CHECK(f.fellBack);
+      CHECK(f.saved <= 0 && f.saved >= -(long)f.steps);   // fixed delays, a tick over at most
+      CHECK(!simHostCapsLock());
+      savedSilent = f.saved;
+      simHostLedReports(true);
+
+      // Loses the tap that would turn Caps Lock off again
+      simLoopFor(COOLDOWN_MS);
+      simHostIgnoreCapsTap(2);
+      CHECK(doTouch(5) == "adaptive");
+      CHECK(simTypedWithCaps() == 0);
+      CHECK(simSaw("[HID] Caps Lock left on by the probe"));
+      CHECK(adaptiveRun().fellBack);
+      CHECK(!simHostCapsLock());
+
+      // Echoes after the wake press budget: the probe gives up with Caps Lock on
+      simLoopFor(COOLDOWN_MS);
+      simHostLedAckMs(WAKE_PRESS_DELAY_MS + 50);
+      CHECK(doTouch(5) == "adaptive");
+      simHostLedAckMs(SIM_HOST_LED_ACK_MS);
+      CHECK(simTypedWithCaps() == 0);
+      CHECK(simSaw("[HID] Caps Lock left on by the probe"));
+      CHECK(adaptiveRun().fellBack);
+      CHECK(!simHostCapsLock());
+    }
+    printf("[SIM] saved vs fixed delays: %ld ms when the host acks, %ld ms when it doesn't\n",
+           savedAck, savedSilent);
+    acking.print();
+    silent.print();
+    // Enter goes out before the last step's settle
+    CHECK(silent.minUs - acking.maxUs >= (uint64_t)(savedAck - POST_ENTER_DELAY_MS) * 1000);
+  });
+  _flows += 4 * n + 1;
+  return fails;
+}
+#endif
+
+// ============================================================
+
+struct Scenario {
+  const char* name;
+  uint32_t defaultIterations;
+  int (*run)(uint32_t n);
+};
+
+static const Scenario SCENARIOS[] = {
+  { "boot",     5,    scenarioBoot },
+  { "unlock",   1000, scenarioUnlock },
+  { "register", 200,  scenarioRegister },
+  { "abort",    1,    [](uint32_t) { return scenarioAbort(); } },
+  { "multi",    1,    [](uint32_t) { return scenarioMulti(); } },
+  { "stats",    50,   scenarioStats },
+  { "proto",    1,    [](uint32_t) { return scenarioProto(); } },
+  { "secrets",  3,    scenarioSecrets },
+  { "link",     5,    scenarioLink },
+  { "match",    13,   scenarioMatch },
+  { "lift",     5,    scenarioLift },
+  { "idle",     20,   scenarioIdle },
+  { "cancel",   10,   scenarioCancel },
+  { "provision", 10,  scenarioProvision },
+  { "backup",   5,    scenarioBackup },
+  { "image",    3,    scenarioImage },
+  { "typing",   5,    scenarioTyping },
+  { "status",   3,    scenarioStatus },
+  { "service",  5,    scenarioService },
+#if HID_ADAPTIVE_TIMING
+  { "adaptive", 3,    scenarioAdaptive },
+#endif
+};
+
+int main(int argc, char** argv) {
+  const char* which = "all";
+  uint32_t iterations = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) simEcho(true);
+    else if (argv[i][0] >= '0' && argv[i][0] <= '9') iterations = (uint32_t)atoi(argv[i]);
+    else which = argv[i];
+  }
+
+  std::string path = std::string("sim_") + which + ".bin";
+  if (!simWorldInit(path.c_str(), 20240611)) {
+    printf("cannot create simulated device\n");
+    return 1;
+  }
+
+  int failures = 0;
+  bool any = false;
+  for (const Scenario &s : SCENARIOS) {
+    if (strcmp(which, "all") != 0 && strcmp(which, s.name) != 0) continue;
+    any = true;
+    printf("[TEST] %s\n", s.name);
+
+    _flows = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    int f = s.run(iterations ? iterations : s.defaultIterations);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    printf("[SIM] %s: %u flows in %.2f s wall (%.0f flows/s)%s\n", s.name, _flows, secs,
+           secs > 0 ? _flows / secs : 0.0, f ? "  — FAILED" : "");
+    failures += f;
+  }
+
+  if (!any) {
+    printf("unknown scenario '%s'\n", which);
+    return 1;
+  }
+  printf(failures ? "\n%d failure(s)\n" : "\nAll scenarios passed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+// ============================================================
+// spsc_ring_test.cpp — Lock-free ring between two real threads
+//
+// The simulator runs core1 inline on core0's thread, so only this
+// test puts the producer and consumer on different CPUs.
+//
+// 1. One thread: empty / full, FIFO order, index wrap at 2^32
+// 2. Stress: a producer thread pushes N messages through a
+//    SENSOR_QUEUE_DEPTH ring as fast as it can; the consumer
+//    checks every one arrives once, in order, and not torn
+//    (payload derived from the sequence number)
+// 3. Round trip: command ring out, event ring back, like the
+//    sensor service; every reply matches its request, time per
+//    round trip and messages per second
+//
+//   spsc_ring_test [messages]   (default 2,000,000)
+// ============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "config.h"
+#include "spsc_ring.h"
+
+static int _failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { printf("  FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); _failures++; } \
+} while (0)
+
+static double nowUs() {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ─── Shaped like SensorCmd / SensorEvt; every field follows from seq ───
+struct Msg {
+  uint32_t seq;
+  uint8_t  op, a, b, c;
+  uint32_t check;
+};
+
+static Msg makeMsg(uint32_t seq) {
+  Msg m;
+  m.seq = seq;
+  m.op = (uint8_t)seq;
+  m.a = (uint8_t)(seq >> 8);
+  m.b = (uint8_t)(seq >> 16);
+  m.c = (uint8_t)(seq >> 24);
+  m.check = seq * 2654435761u;
+  return m;
+}
+
+// ─── Spin, giving the CPU away now and then (one-CPU hosts) ───
+static inline void relax(uint64_t &spins) {
+  if ((++spins & 63) == 0) std::this_thread::yield();
+}
+
+static bool msgIntact(const Msg &m) {
+  Msg want = makeMsg(m.seq);
+  return m.op == want.op && m.a == want.a && m.b == want.b && m.c == want.c && m.check == want.check;
+}
+
+// ─── 1. Single thread ───
+static void testSingleThread() {
+  printf("[TEST] single thread\n");
+  SpscRing<Msg, SENSOR_QUEUE_DEPTH> q;
+  Msg m;
+  CHECK(q.empty() && !q.pop(m));
+
+  for (uint32_t i = 0; i < SENSOR_QUEUE_DEPTH; i++) CHECK(q.push(makeMsg(i)));
+  CHECK(!q.push(makeMsg(99)));   // full
+  for (uint32_t i = 0; i < SENSOR_QUEUE_DEPTH; i++) CHECK(q.pop(m) && m.seq == i);
+  CHECK(q.empty() && !q.pop(m));
+
+  // Free-running indices wrap at 2^32 without losing a slot
+  q.head.store(0xFFFFFFFCu);
+  q.tail.store(0xFFFFFFFCu);
+  for (uint32_t round = 0; round < 3; round++) {
+    for (uint32_t i = 0; i < SENSOR_QUEUE_DEPTH; i++) CHECK(q.push(makeMsg(round * 100 + i)));
+    CHECK(!q.push(makeMsg(0)));
+    for (uint32_t i = 0; i < SENSOR_QUEUE_DEPTH; i++) CHECK(q.pop(m) && m.seq == round * 100 + i);
+    CHECK(q.empty());
+  }
+  CHECK(q.head.load() < 0x100);   // wrapped
+}
+
+// ─── 2. Producer / consumer threads, one way ───
+static void testStress(uint32_t n) {
+  printf("[TEST] stress: %u messages through a %u-slot ring\n", n, (unsigned)SENSOR_QUEUE_DEPTH);
+  static SpscRing<Msg, SENSOR_QUEUE_DEPTH> q;
+  uint64_t fullSpins = 0;
+
+  double t0 = nowUs();
+  std::thread producer([n, &fullSpins] {
+    for (uint32_t i = 1; i <= n; i++) {
+      while (!q.push(makeMsg(i))) relax(fullSpins);
+    }
+  });
+
+  uint32_t expect = 1, outOfOrder = 0, torn = 0;
+  uint64_t emptySpins = 0;
+  Msg m;
+  while (expect <= n) {
+    if (!q.pop(m)) {
+      relax(emptySpins);
+      continue;
+    }
+    if (m.seq != expect) outOfOrder++;
+    if (!msgIntact(m)) torn++;
+    expect = m.seq + 1;
+  }
+  producer.join();
+  double us = nowUs() - t0;
+
+  CHECK(outOfOrder == 0);   // nothing lost, repeated or reordered
+  CHECK(torn == 0);
+  CHECK(expect == n + 1);
+  CHECK(q.empty());
+  printf("[BENCH] %.1f M msg/s, %.1f ns per message (ring full %llu, empty %llu spins)\n",
+         n / us, us * 1000.0 / n, (unsigned long long)fullSpins, (unsigned long long)emptySpins);
+}
+
+// ─── 3. Request / reply, the sensor service's shape ───
+static void testRoundTrip(uint32_t n) {
+  printf("[TEST] round trip: %u requests\n", n);
+  static SpscRing<Msg, SENSOR_QUEUE_DEPTH> cmdQ, evtQ;
+  static std::atomic<bool> stop{false};
+
+  std::thread core1([] {
+    Msg m;
+    uint64_t spins = 0;
+    while (!stop.load(std::memory_order_acquire)) {
+      if (!cmdQ.pop(m)) {
+        relax(spins);
+        continue;
+      }
+      Msg r = makeMsg(m.seq);
+      r.op = (uint8_t)(m.op ^ 0xFF);   // "result"
+      while (!evtQ.push(r)) relax(spins);
+    }
+  });
+
+  uint32_t mismatched = 0;
+  uint64_t spins = 0;
+  double worst = 0, t0 = nowUs();
+  for (uint32_t i = 1; i <= n; i++) {
+    double t = nowUs();
+    while (!cmdQ.push(makeMsg(i))) relax(spins);
+    Msg r;
+    while (!evtQ.pop(r)) relax(spins);
+    if (r.seq != i || r.op != (uint8_t)(i ^ 0xFF)) mismatched++;
+    double rt = nowUs() - t;
+    if (rt > worst) worst = rt;
+  }
+  double us = nowUs() - t0;
+  stop.store(true, std::memory_order_release);
+  core1.join();
+
+  CHECK(mismatched == 0);
+  CHECK(cmdQ.empty() && evtQ.empty());
+  printf("[BENCH] %.0f ns per round trip, worst %.1f us (%.1f M round trips/s)\n",
+         us * 1000.0 / n, worst, n / us);
+}
+
+int main(int argc, char** argv) {
+  uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 2000000;
+  if (std::thread::hardware_concurrency() < 2) printf("[TEST] note: one CPU, threads take turns\n");
+
+  testSingleThread();
+  testStress(n);
+  testRoundTrip(n / 10 ? n / 10 : 1);
+
+  if (_failures) {
+    printf("[TEST] %d check(s) FAILED\n", _failures);
+    return 1;
+  }
+  printf("[TEST] all passed\n");
+  return 0;
+}
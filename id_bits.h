@@ -0,0 +1,90 @@
+// ============================================================
+// id_bits.h — Fixed-size bitset over sensor template IDs
+//
+// One bit per ID 1..SENSOR_CAPACITY, packed into 32-bit words so
+// set algebra (enrolled AND NOT indexed, ...) and "first free ID"
+// are a few word operations instead of scans over an ID list.
+//
+// Usage:
+//   IdBits b; idBitsClear(b);
+//   idBitsSet(b, id) / idBitsReset(b, id) / idBitsTest(b, id)
+//   idBitsAndNot(a, b)   — ids in a but not in b
+//   idBitsFirst(b)       — lowest id, 0 if empty
+//   idBitsNext(b, id)    — next id after id, 0 if none
+//   idBitsCount(b)
+// ============================================================
+#ifndef ID_BITS_H
+#define ID_BITS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+
+#define ID_BITS_WORDS ((SENSOR_CAPACITY + 31) / 32)
+
+struct IdBits {
+  uint32_t w[ID_BITS_WORDS];
+};
+
+inline void idBitsClear(IdBits &b) {
+  memset(b.w, 0, sizeof(b.w));
+}
+
+inline void idBitsSet(IdBits &b, uint8_t id) {
+  if (id < 1 || id > SENSOR_CAPACITY) return;
+  b.w[(id - 1) >> 5] |= 1UL << ((id - 1) & 31);
+}
+
+inline void idBitsReset(IdBits &b, uint8_t id) {
+  if (id < 1 || id > SENSOR_CAPACITY) return;
+  b.w[(id - 1) >> 5] &= ~(1UL << ((id - 1) & 31));
+}
+
+inline bool idBitsTest(const IdBits &b, uint8_t id) {
+  if (id < 1 || id > SENSOR_CAPACITY) return false;
+  return (b.w[(id - 1) >> 5] >> ((id - 1) & 31)) & 1;
+}
+
+inline IdBits idBitsAndNot(const IdBits &a, const IdBits &b) {
+  IdBits r;
+  for (uint8_t i = 0; i < ID_BITS_WORDS; i++) r.w[i] = a.w[i] & ~b.w[i];
+  return r;
+}
+
+inline IdBits idBitsAnd(const IdBits &a, const IdBits &b) {
+  IdBits r;
+  for (uint8_t i = 0; i < ID_BITS_WORDS; i++) r.w[i] = a.w[i] & b.w[i];
+  return r;
+}
+
+inline bool idBitsAny(const IdBits &b) {
+  for (uint8_t i = 0; i < ID_BITS_WORDS; i++) {
+    if (b.w[i]) return true;
+  }
+  return false;
+}
+
+// ─── Lowest set id strictly greater than after (0 = none) ───
+inline uint8_t idBitsNext(const IdBits &b, uint8_t after) {
+  for (uint8_t i = after >> 5; i < ID_BITS_WORDS; i++) {
+    uint32_t w = b.w[i];
+    if (i == (after >> 5)) w &= 0xFFFFFFFFUL << (after & 31);   // bit index >= after
+    if (w) {
+      uint8_t id = (uint8_t)(i * 32 + __builtin_ctz(w) + 1);
+      return id <= SENSOR_CAPACITY ? id : 0;
+    }
+  }
+  return 0;
+}
+
+inline uint8_t idBitsFirst(const IdBits &b) {
+  return idBitsNext(b, 0);
+}
+
+inline uint8_t idBitsCount(const IdBits &b) {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < ID_BITS_WORDS; i++) n += (uint8_t)__builtin_popcount(b.w[i]);
+  return n;
+}
+
+#endif // ID_BITS_H
@@ -0,0 +1,178 @@
+// ============================================================
+// idle.h — Event-driven main loop: sleep until an interrupt
+//
+// Between flows loop() has nothing to do until something happens.
+// Instead of waking every LOOP_IDLE_MS to look at the console, the
+// switch and the touch flag, idleWait() sleeps the core (__wfi)
+// until one of these brings work:
+//
+//   touch    — Touch Out edge (ISR in irq_finger.h)
+//   switch   — debounced mode switch flip (alarm in switch_control.h)
+//   console  — USB CDC data (the USB interrupt wakes the core)
+//   timer    — alarm at the loop's next deadline (idle LED,
+//              Touch Out settle), a log retry, or IDLE_MAX_MS after
+//              the last pass at the latest
+//
+// ISRs post their event with idlePost(). The last check before
+// sleeping runs with interrupts masked: an event that lands after
+// it stays pending, and WFI wakes on a pending interrupt even
+// while masked — the ISR runs once interrupts are back on.
+//
+// A wakeup with none of the above (USB housekeeping, an interrupt
+// nobody posts for) is spurious: it is counted and idleWait()
+// returns 0, so loop() goes straight back to sleep without a pass.
+//
+// !IDLE POLL brings back the fixed LOOP_IDLE_MS wait, for
+// comparing wakeups and touch pickup latency (IDLE_EVENT_DRIVEN
+// picks the boot default).
+//
+// Usage:
+//   idlePost(ev)              — ISR: something for the loop
+//   idleWait(deadlineMs)      — loop(): sleep; events seen, 0 = spurious
+//   idleSetPolling(on) / idlePolling()
+//   idlePrintStats() / idleResetStats()   — !IDLE / !IDLE RESET
+// ============================================================
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <Arduino.h>
+#include <pico/time.h>
+#include "config.h"
+#include "log_ring.h"
+
+// ─── Wake sources ───
+enum IdleEvent : uint8_t {
+  IDLE_EV_TOUCH   = 1 << 0,
+  IDLE_EV_SWITCH  = 1 << 1,
+  IDLE_EV_CONSOLE = 1 << 2,
+  IDLE_EV_TIMER   = 1 << 3,
+};
+#define IDLE_SOURCES 4
+
+// ─── State ───
+static volatile uint8_t _idle_events = 0;   // posted by ISRs, taken under noInterrupts()
+static volatile alarm_id_t _idle_alarm = 0; // armed wake alarm, 0 = none
+static uint32_t _idle_alarmAt = 0;          // millis() it is armed for
+static uint32_t _idle_passMs = 0;           // last pass that had work
+static bool _idle_polling = !IDLE_EVENT_DRIVEN;
+
+// ─── Stats (!IDLE) ───
+static uint32_t _idle_sinceMs = 0;
+static uint64_t _idle_sleptUs = 0;          // in idleWait(): asleep, or in delay() when polling
+static uint32_t _idle_wakeups = 0;
+static uint32_t _idle_spurious = 0;
+static uint32_t _idle_bySource[IDLE_SOURCES];
+
+// ─── ISR side ───
+inline void idlePost(uint8_t ev) {
+  _idle_events |= ev;
+}
+
+static int64_t _idleOnAlarm(alarm_id_t, void*) {
+  _idle_alarm = 0;
+  idlePost(IDLE_EV_TIMER);
+  return 0;   // one-shot
+}
+
+// ─── Alarm at millis() == at; an alarm already armed for it is kept ───
+static inline void _idleArm(uint32_t at) {
+  if (_idle_alarm && _idle_alarmAt == at) return;
+  if (_idle_alarm) cancel_alarm(_idle_alarm);
+  _idle_alarmAt = at;
+  _idle_alarm = add_alarm_in_ms(at - millis(), _idleOnAlarm, nullptr, true);
+  if (_idle_alarm < 0) _idle_alarm = 0;   // no free alarm: the fixed tick of the next pass
+}
+
+// ─── Events since the last look (call with interrupts masked) ───
+static inline uint8_t _idleTake(uint32_t at) {
+  uint8_t ev = _idle_events;
+  _idle_events = 0;
+  if (Serial.available()) ev |= IDLE_EV_CONSOLE;
+  if ((int32_t)(millis() - at) >= 0) ev |= IDLE_EV_TIMER;
+  return ev;
+}
+
+// ============================================================
+// PUBLIC API
+// ============================================================
+
+// ─── Sleep until there is work; returns the events (0 = spurious) ───
+// deadlineMs: millis() the loop must run by without an interrupt,
+// 0 = none.
+inline uint8_t idleWait(uint32_t deadlineMs) {
+  logDrain();
+  uint32_t now = millis();
+  uint32_t at = _idle_passMs + IDLE_MAX_MS;
+  if (deadlineMs && (int32_t)(deadlineMs - at) < 0) at = deadlineMs;
+  if (logPending() && Serial && (int32_t)(now + TASK_POLL_INTERVAL_MS - at) < 0) {
+    at = now + TASK_POLL_INTERVAL_MS;   // USB buffer was full — try again soon
+  }
+
+  uint8_t ev;
+  uint32_t t0 = micros();
+  if (_idle_polling) {
+    delay(LOOP_IDLE_MS);
+    noInterrupts();
+    ev = _idleTake(at);
+    interrupts();
+  } else {
+    if ((int32_t)(at - now) > 0) _idleArm(at);
+    noInterrupts();
+    ev = _idleTake(at);
+    if (!ev) __wfi();
+    interrupts();   // the ISR that woke us runs here
+    if (ev) {   // work was already waiting — no sleep
+      _idle_passMs = millis();
+      return ev;
+    }
+
+    noInterrupts();
+    ev = _idleTake(at);
+    interrupts();
+  }
+
+  _idle_sleptUs += micros() - t0;
+  _idle_wakeups++;
+  if (!ev) {
+    _idle_spurious++;
+    return 0;
+  }
+  for (uint8_t s = 0; s < IDLE_SOURCES; s++) {
+    if (ev & (1 << s)) _idle_bySource[s]++;
+  }
+  _idle_passMs = millis();
+  return ev;
+}
+
+inline void idleSetPolling(bool on) { _idle_polling = on; }
+inline bool idlePolling()           { return _idle_polling; }
+
+inline void idleResetStats() {
+  _idle_sinceMs = millis();
+  _idle_sleptUs = 0;
+  _idle_wakeups = 0;
+  _idle_spurious = 0;
+  for (uint8_t s = 0; s < IDLE_SOURCES; s++) _idle_bySource[s] = 0;
+}
+
+inline void idlePrintStats() {
+  uint32_t spanMs = millis() - _idle_sinceMs;
+  uint32_t idle = spanMs ? (uint32_t)(_idle_sleptUs / spanMs) : 0;   // ‰ (µs per ms)
+  if (idle > 1000) idle = 1000;
+  uint32_t perTenS = spanMs ? (uint32_t)((uint64_t)_idle_wakeups * 10000 / spanMs) : 0;
+  char line[96];
+  snprintf(line, sizeof(line), "[IDLE] %s, idle %lu.%lu %% of %lu ms",
+           _idle_polling ? "Polling" : "Event-driven", (unsigned long)(idle / 10),
+           (unsigned long)(idle % 10), (unsigned long)spanMs);
+  Serial.println(line);
+  snprintf(line, sizeof(line), "[IDLE] wakeups %lu (%lu.%lu/s), spurious %lu",
+           (unsigned long)_idle_wakeups, (unsigned long)(perTenS / 10), (unsigned long)(perTenS % 10),
+           (unsigned long)_idle_spurious);
+  Serial.println(line);
+  snprintf(line, sizeof(line), "[IDLE] touch %lu  switch %lu  console %lu  timer %lu",
+           (unsigned long)_idle_bySource[0], (unsigned long)_idle_bySource[1],
+           (unsigned long)_idle_bySource[2], (unsigned long)_idle_bySource[3]);
+  Serial.println(line);
+}
+
+#endif // IDLE_H
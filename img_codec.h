@@ -0,0 +1,121 @@
+// ============================================================
+// img_codec.h — Row code for streamed capture images
+//
+// Every pixel is quantized (v = px >> shift) and replaced by its
+// difference to the left neighbour (the first to 0), mod 256.
+// Ridges change slowly and the background is flat, so most
+// differences are small or zero:
+//
+//   00nnnnnn  literal — n+1 difference bytes follow
+//   01nnnnnn  n+1 zero differences
+//   1nnnnnnn  n+1 differences in -8..7, two per byte, low nibble first
+//
+// Runs are only taken where they beat literals, so a row never
+// codes to more than IMG_ROW_MAX(w) = w + ceil(w / 64) bytes. Each
+// row decodes on its own. The decoder puts a quantized pixel back
+// in the middle of its step. web/app.js holds the same decoder.
+//
+// No state: the sketch (img_stream.h) and host tools share it.
+//
+// Usage:
+//   imgEncodeRow(px, w, shift, out)       — coded length
+//   imgDecodeRow(in, n, w, shift, px)     — false if malformed
+// ============================================================
+#ifndef IMG_CODEC_H
+#define IMG_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IMG_ROW_MAX(w)   ((w) + ((w) + 63) / 64)   // coded row, worst case
+
+// Shortest runs worth a token of their own: the saving must pay
+// for the literal header that follows them.
+#define IMG_ZERO_RUN_MIN   3
+#define IMG_SMALL_RUN_MIN  4
+
+static inline uint8_t _imgDelta(const uint8_t* px, uint16_t i, uint8_t shift) {
+  return (uint8_t)((px[i] >> shift) - (i ? px[i - 1] >> shift : 0));
+}
+
+static inline bool _imgSmall(uint8_t d) {
+  return (int8_t)d >= -8 && (int8_t)d <= 7;
+}
+
+// ─── Code one row into out[IMG_ROW_MAX(w)]; returns the length ───
+static inline size_t imgEncodeRow(const uint8_t* px, uint16_t w, uint8_t shift, uint8_t* out) {
+  auto zeros = [&](uint16_t i, uint16_t cap) {
+    uint16_t n = 0;
+    while (i + n < w && n < cap && _imgDelta(px, i + n, shift) == 0) n++;
+    return n;
+  };
+  auto smalls = [&](uint16_t i, uint16_t cap) {   // stops where a zero run takes over
+    uint16_t n = 0;
+    while (i + n < w && n < cap && _imgSmall(_imgDelta(px, i + n, shift)) &&
+           zeros(i + n, IMG_ZERO_RUN_MIN) < IMG_ZERO_RUN_MIN) n++;
+    return n;
+  };
+
+  size_t o = 0;
+  uint16_t i = 0;
+  while (i < w) {
+    uint16_t n = zeros(i, 64);
+    if (n >= IMG_ZERO_RUN_MIN) {
+      out[o++] = (uint8_t)(0x40 | (n - 1));
+      i += n;
+      continue;
+    }
+    n = smalls(i, 128);
+    if (n >= IMG_SMALL_RUN_MIN) {
+      out[o++] = (uint8_t)(0x80 | (n - 1));
+      for (uint16_t k = 0; k < n; k += 2) {
+        uint8_t lo = _imgDelta(px, i + k, shift) & 0x0F;
+        uint8_t hi = k + 1 < n ? _imgDelta(px, i + k + 1, shift) & 0x0F : 0;
+        out[o++] = (uint8_t)(lo | (hi << 4));
+      }
+      i += n;
+      continue;
+    }
+    n = 0;
+    while (i + n < w && n < 64 && (n == 0 || (zeros(i + n, IMG_ZERO_RUN_MIN) < IMG_ZERO_RUN_MIN &&
+                                              smalls(i + n, IMG_SMALL_RUN_MIN) < IMG_SMALL_RUN_MIN))) n++;
+    out[o++] = (uint8_t)(n - 1);
+    for (uint16_t k = 0; k < n; k++) out[o++] = _imgDelta(px, i + k, shift);
+    i += n;
+  }
+  return o;
+}
+
+// ─── Decode one row into px[w]; false if in[] is not a whole row ───
+static inline bool imgDecodeRow(const uint8_t* in, size_t n, uint16_t w, uint8_t shift, uint8_t* px) {
+  const uint8_t mid = shift ? (uint8_t)(1u << (shift - 1)) : 0;
+  uint8_t v = 0;
+  uint16_t x = 0;
+  auto put = [&](uint8_t d) {
+    v = (uint8_t)(v + d);
+    px[x++] = (uint8_t)((v << shift) | mid);
+  };
+
+  size_t i = 0;
+  while (i < n) {
+    uint8_t t = in[i++];
+    uint16_t k = (uint16_t)((t & 0x80 ? t & 0x7F : t & 0x3F) + 1);
+    if (x + k > w) return false;
+    if (t & 0x80) {
+      if (i + (k + 1) / 2 > n) return false;
+      for (uint16_t j = 0; j < k; j++) {
+        uint8_t nib = (uint8_t)((in[i + j / 2] >> ((j & 1) * 4)) & 0x0F);
+        put(nib & 0x08 ? (uint8_t)(nib | 0xF0) : nib);
+      }
+      i += (k + 1) / 2;
+    } else if (t & 0x40) {
+      while (k--) put(0);
+    } else {
+      if (i + k > n) return false;
+      while (k--) put(in[i++]);
+    }
+  }
+  return x == w;
+}
+
+#endif // IMG_CODEC_H
@@ -0,0 +1,146 @@
+// ============================================================
+// img_stream.h — Capture images streamed to the web monitor
+//
+// Diagnostic mode (!IMAGE ON, CTL_REQ_IMAGE): after a recognition
+// capture the sensor's grayscale image is read back over the
+// sensor UART (sensorImage) and sent as control events, one frame
+// per row, so the monitor draws rows while the rest still travel:
+//
+//   CTL_EVT_IMAGE      frame, w, h, shift
+//   CTL_EVT_IMAGE_ROW  frame, row, coded row   × h
+//
+// The library only hands out whole images, so core1 fills one
+// static buffer; core0 codes each row into one event body on the
+// stack and writes it straight out — no coded copy of the frame.
+//
+// Rows are delta + run-length coded (img_codec.h), quantized by
+// shift bits if asked; each decodes on its own, so a lost row frame
+// costs that row only.
+//
+// Images go out only while a control session is open (HELLO),
+// after the unlock; the flow waits for the fetch (≈ 2.2 s for
+// 160 × 160 at 115200 baud) before it waits for the lift.
+//
+// Usage:
+//   imgStreamSet(on, shift) / imgStreamOn()
+//   imgStreamCapture()        — after a capture, if on
+//   imgHandleFrame(f)         — CTL_REQ_IMAGE
+//   imgPrintStatus()          — !IMAGE
+// ============================================================
+#ifndef IMG_STREAM_H
+#define IMG_STREAM_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ctl_proto.h"
+#include "sensor_service.h"
+#include "log_ring.h"
+#include "img_codec.h"
+
+#define IMG_W            (IMAGE_QUARTER ? 80 : 160)
+#define IMG_H            (IMAGE_QUARTER ? 80 : 160)
+
+static_assert(IMG_ROW_MAX(IMG_W) + 2 <= CTL_MAX_BODY, "coded row exceeds CTL_MAX_BODY");
+static_assert(IMAGE_SHIFT_MAX <= 7, "IMAGE_SHIFT_MAX must be below 8");
+
+#if IMAGE_DIAG
+
+// ─── State ───
+static uint8_t _img_buf[IMG_W * IMG_H];   // core1 fills it, core0 codes it
+static bool _img_on = false;
+static uint8_t _img_shift = 0;
+static uint8_t _img_frame = 0;
+
+struct ImgStats {
+  uint32_t frames;
+  uint32_t rawBytes;     // last frame
+  uint32_t codedBytes;   // last frame, row frames' bodies
+  uint32_t fetchMs;
+  uint32_t sendMs;
+};
+static ImgStats _img_stats;
+
+inline bool imgStreamOn()     { return _img_on; }
+inline uint8_t imgStreamShift() { return _img_shift; }
+
+// ─── On / off; false if shift is out of range ───
+inline bool imgStreamSet(bool on, uint8_t shift) {
+  if (shift > IMAGE_SHIFT_MAX) return false;
+  _img_on = on;
+  _img_shift = on ? shift : 0;
+  return true;
+}
+
+// ─── Fetch the last capture and stream it; false if nothing was sent ───
+inline bool imgStreamCapture() {
+  if (!_img_on || !ctlSessionActive()) return false;
+
+  uint32_t t0 = millis();
+  if (sensorImage(IMAGE_QUARTER, _img_buf) != 0) {
+    LOG("[IMAGE] Fetch failed");
+    return false;
+  }
+  uint32_t t1 = millis();
+
+  uint8_t frame = ++_img_frame;
+  uint8_t head[4] = { frame, IMG_W, IMG_H, _img_shift };
+  ctlEvent(CTL_EVT_IMAGE, head, sizeof(head));
+
+  uint8_t body[2 + IMG_ROW_MAX(IMG_W)];
+  uint32_t coded = 0;
+  body[0] = frame;
+  for (uint16_t y = 0; y < IMG_H; y++) {
+    body[1] = (uint8_t)y;
+    size_t n = imgEncodeRow(_img_buf + (uint32_t)y * IMG_W, IMG_W, _img_shift, body + 2);
+    ctlEvent(CTL_EVT_IMAGE_ROW, body, 2 + n);
+    coded += n;
+  }
+
+  ImgStats &s = _img_stats;
+  s.frames++;
+  s.rawBytes = (uint32_t)IMG_W * IMG_H;
+  s.codedBytes = coded;
+  s.fetchMs = t1 - t0;
+  s.sendMs = millis() - t1;
+  LOG("[IMAGE] Frame %u: %lu → %lu bytes (%lu%%)", frame, (unsigned long)s.rawBytes,
+      (unsigned long)coded, (unsigned long)(coded * 100 / s.rawBytes));
+  LOG("[IMAGE] Fetch %lu ms, send %lu ms", (unsigned long)s.fetchMs, (unsigned long)s.sendMs);
+  return true;
+}
+
+// ─── CTL_REQ_IMAGE: [0] on, [1] shift (optional) ───
+inline void imgHandleFrame(const CtlFrame &f) {
+  if (f.len < 1 || f.len > 2 || f.body[0] > 1 ||
+      !imgStreamSet(f.body[0] == 1, f.len == 2 ? f.body[1] : 0)) {
+    ctlNak(f, CTL_ERR_BAD_ARG);
+    return;
+  }
+  uint8_t body[4] = { _img_on, _img_shift, IMG_W, IMG_H };
+  ctlReply(f, body, sizeof(body));
+}
+
+// ─── !IMAGE ───
+inline void imgPrintStatus() {
+  char line[128];
+  const ImgStats &s = _img_stats;
+  snprintf(line, sizeof(line), "[IMAGE] %s, %ux%u, shift %u%s", _img_on ? "On" : "Off",
+           IMG_W, IMG_H, _img_shift, ctlSessionActive() ? "" : " (no monitor session)");
+  Serial.println(line);
+  if (!s.frames) return;
+  snprintf(line, sizeof(line), "[IMAGE] %lu frame(s); last %lu → %lu bytes, fetch %lu ms, send %lu ms",
+           (unsigned long)s.frames, (unsigned long)s.rawBytes, (unsigned long)s.codedBytes,
+           (unsigned long)s.fetchMs, (unsigned long)s.sendMs);
+  Serial.println(line);
+}
+
+#else
+
+inline bool imgStreamOn()                   { return false; }
+inline bool imgStreamSet(bool, uint8_t)     { return false; }
+inline bool imgStreamCapture()              { return false; }
+inline void imgHandleFrame(const CtlFrame &f) { ctlNak(f, CTL_ERR_DISABLED); }
+inline void imgPrintStatus() { Serial.println("[IMAGE] Disabled (IMAGE_DIAG 0 in config.h)"); }
+
+#endif // IMAGE_DIAG
+
+#endif // IMG_STREAM_H
@@ -1,55 +1,129 @@
 // ============================================================
 // irq_finger.h — IRQ-based finger detection via SEN0348 Touch Out
 //
-// The SEN0348's blue IRQ wire (Touch Out) goes HIGH when a finger
-// touches the sensor. This replaces the polling approach
-// (detectFinger() every 50ms) with an interrupt-driven edge detect.
+// The SEN0348's blue IRQ wire (Touch Out) is HIGH while a finger
+// is on the sensor. The interrupt fires on both edges and feeds
+// the debounced edge record in finger_edges.h, so touch and lift
+// are both known without a sensor command: waiting for a lift
+// reads RAM and the pin instead of asking detectFinger() over
+// UART every 100 ms.
 //
 // Usage:
-//   irqFingerInit()       — call once in setup after sensor init
-//   irqFingerDetected()   — returns true once per touch (auto-clears)
-//   irqFingerClear()      — manually clear flag (e.g., on mode switch)
-//
-// Note: detectFinger() is still used for finger-removal waits
-// inside registration/recognition flows. IRQ only replaces the
-// "is a new finger present?" polling in the main loop.
+//   irqFingerInit()             — call once in setup after sensor init
+//   irqFingerDetected()         — returns true once per touch (auto-clears)
+//   irqFingerClear()            — manually clear flag (e.g., on mode switch)
+//   irqFingerPresent()          — finger on the glass now (debounced)
+//   irqFingerSettling(&atMs)    — a change is waiting out the bounce window
+//   irqFingerAwaitTouch(ms, abort) — wait for a finger, pollers keep running
+//   irqFingerAwaitLift(ms, abort) — wait for the lift, pollers keep running
+//   irqFingerTouchUs() / irqFingerLiftUs() — micros() of the last edges
 // ============================================================
 #ifndef IRQ_FINGER_H
 #define IRQ_FINGER_H
 
 #include <Arduino.h>
 #include "config.h"
+#include "finger_edges.h"
+#include "idle.h"
+#include "log_ring.h"
+#include "tasks.h"
 
-// ─── Volatile flag set by ISR ───
-static volatile bool _irq_fingerTouchFlag = false;
+// ─── Edge record, written by the ISR ───
+// Main-loop access goes through noInterrupts() / interrupts().
+static FingerEdges _irq_edges;
 
 // ─── ISR — keep minimal (no Serial, no delays) ───
-static void _irqOnFingerTouch() {
-  _irq_fingerTouchFlag = true;
+// Only a touch is news for the idle loop; lifts and bounces wake
+// it without an event.
+static void _irqOnFingerEdge() {
+  fingerEdgeFeed(_irq_edges, digitalRead(PIN_IRQ) == HIGH, (uint32_t)micros());
+  if (_irq_edges.touched) idlePost(IDLE_EV_TOUCH);
 }
 
 // ─── Init: attach interrupt on sensor's Touch Out pin ───
 // Call after sensor is initialized and confirmed working.
 inline void irqFingerInit() {
   pinMode(PIN_IRQ, INPUT_PULLDOWN);  // Touch Out is active-HIGH
-  attachInterrupt(digitalPinToInterrupt(PIN_IRQ), _irqOnFingerTouch, RISING);
-  Serial.println("[BOOT] IRQ finger detection OK (GPIO" + String(PIN_IRQ) + ")");
+  fingerEdgeInit(_irq_edges, digitalRead(PIN_IRQ) == HIGH, (uint32_t)micros());
+  attachInterrupt(digitalPinToInterrupt(PIN_IRQ), _irqOnFingerEdge, CHANGE);
+  LOG("[BOOT] IRQ finger detection OK (GPIO%u)", PIN_IRQ);
 }
 
 // ─── Check if a new finger touch was detected ───
 // Returns true exactly once per touch event (auto-clears the flag).
 inline bool irqFingerDetected() {
-  if (_irq_fingerTouchFlag) {
-    _irq_fingerTouchFlag = false;
-    return true;
-  }
-  return false;
+  noInterrupts();
+  fingerEdgeSettle(_irq_edges, (uint32_t)micros());
+  bool touched = _irq_edges.touched;
+  _irq_edges.touched = false;
+  interrupts();
+  return touched;
+}
+
+// ─── Timestamps of the last touch / lift edge ───
+inline uint32_t irqFingerTouchUs() {
+  return _irq_edges.touchUs;
+}
+
+inline uint32_t irqFingerLiftUs() {
+  return _irq_edges.liftUs;
 }
 
 // ─── Manually clear the flag ───
 // Call on mode switch or after handling a touch to avoid stale triggers.
 inline void irqFingerClear() {
-  _irq_fingerTouchFlag = false;
+  noInterrupts();
+  _irq_edges.touched = false;
+  interrupts();
+}
+
+// ─── Change held back by the bounce window: millis() it can be taken ───
+// A touch right after a lift is one; the idle loop wakes for it.
+inline bool irqFingerSettling(uint32_t* atMs) {
+  noInterrupts();
+  fingerEdgeSettle(_irq_edges, (uint32_t)micros());
+  bool held = _irq_edges.rawLevel != _irq_edges.present;
+  uint32_t heldUs = (uint32_t)micros() - _irq_edges.rawUs;
+  interrupts();
+  if (!held) return false;
+  uint32_t leftUs = heldUs < FINGER_DEBOUNCE_US ? FINGER_DEBOUNCE_US - heldUs : 0;
+  *atMs = millis() + leftUs / 1000 + 1;
+  return true;
+}
+
+// ─── Finger on the glass? (no sensor traffic) ───
+inline bool irqFingerPresent() {
+  noInterrupts();
+  fingerEdgeSettle(_irq_edges, (uint32_t)micros());
+  bool present = _irq_edges.present;
+  interrupts();
+  return present;
+}
+
+// ─── Wait for a finger on the glass ───
+// Same contract as irqFingerAwaitLift. Unlike a sensor capture the
+// wait is on core0, so abort is seen within a millisecond.
+inline bool irqFingerAwaitTouch(unsigned long timeoutMs, TaskPredFn abort = nullptr) {
+  unsigned long start = millis();
+  while (!irqFingerPresent()) {
+    if (abort && abort()) return false;
+    if (timeoutMs && millis() - start >= timeoutMs) return false;
+    taskDelay(1);
+  }
+  return true;
+}
+
+// ─── Wait for the finger to leave the glass ───
+// timeoutMs 0 = no limit. abort (optional) is checked on every
+// pass. True once lifted, false on timeout or abort.
+inline bool irqFingerAwaitLift(unsigned long timeoutMs, TaskPredFn abort = nullptr) {
+  unsigned long start = millis();
+  while (irqFingerPresent()) {
+    if (abort && abort()) return false;
+    if (timeoutMs && millis() - start >= timeoutMs) return false;
+    taskDelay(1);
+  }
+  return true;
 }
 
 #endif // IRQ_FINGER_H
@@ -0,0 +1,162 @@
+// ============================================================
+// latency_stats.h — Per-phase unlock latency histograms
+//
+// Every phase between a touch and the typed password is timed
+// with micros() and counted into a fixed-size log-linear
+// histogram: 8 linear buckets per power of two, so any value
+// from 1 µs to ~4.5 min lands within 12.5% of its bucket's upper
+// edge. Percentiles come from walking the buckets; max is exact.
+//
+// With LATENCY_STATS 0 (config.h) the STAT_* macros expand to
+// nothing — no timer reads, no histogram storage.
+//
+// Usage:
+//   STAT_T0(t)              — take a start timestamp named t
+//   STAT_SINCE(phase, t)    — record micros() - t into phase
+//   STAT_FLOW_START(us)     — origin for the whole flow (touch edge)
+//   STAT_FLOW(phase)        — record micros() - origin into phase
+//   statPrint() / statReset()   — !STATS / !STATS RESET
+// ============================================================
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// ─── Phases ───
+enum StatPhase : uint8_t {
+  STAT_IRQ_PICKUP,      // touch edge (ISR) → handleRecognizeMode
+  STAT_CAPTURE,         // collectionFingerprint round trip
+  STAT_SEARCH,          // match step: verify and/or search (RECOG_STRATEGY)
+  STAT_RECORD,          // match → password ready (read + decrypt only if not prefetched)
+  STAT_PREFETCH,        // credentials decrypted while the sensor captures
+  STAT_HID_LOCK,        // hidUnlockSequence steps, incl. settle
+  STAT_HID_WAKE,
+  STAT_HID_CLEAR,
+  STAT_HID_TYPE,
+  STAT_HID_ENTER,
+  STAT_TOUCH_TO_ENTER,  // touch edge → Enter pressed
+  STAT_PHASES
+};
+
+// ─── Histogram geometry ───
+#define STAT_SUB_BITS  3
+#define STAT_SUB       (1 << STAT_SUB_BITS)                  // linear steps per octave
+#define STAT_MAX_EXP   27                                     // top octave [2^27, 2^28) µs
+#define STAT_BUCKETS   ((STAT_MAX_EXP - STAT_SUB_BITS + 2) * STAT_SUB)
+
+// ─── Bucket math (always available — the host tests use it) ───
+// Values below STAT_SUB get one bucket each; above that, bucket =
+// octave × STAT_SUB + the next STAT_SUB_BITS bits below the MSB.
+static inline uint16_t statBucketOf(uint32_t us) {
+  if (us < STAT_SUB) return (uint16_t)us;
+  uint8_t e = (uint8_t)(31 - __builtin_clz(us));
+  if (e > STAT_MAX_EXP) return STAT_BUCKETS - 1;
+  return (uint16_t)((e - STAT_SUB_BITS + 1) * STAT_SUB + ((us >> (e - STAT_SUB_BITS)) & (STAT_SUB - 1)));
+}
+
+// ─── Largest value that falls into bucket b ───
+static inline uint32_t statBucketHigh(uint16_t b) {
+  if (b < STAT_SUB) return b;
+  uint8_t e = (uint8_t)(b / STAT_SUB + STAT_SUB_BITS - 1);
+  uint32_t low = (uint32_t)(STAT_SUB + (b % STAT_SUB)) << (e - STAT_SUB_BITS);
+  return low + (1UL << (e - STAT_SUB_BITS)) - 1;
+}
+
+#if LATENCY_STATS
+
+struct StatHist {
+  uint32_t count;
+  uint32_t maxUs;
+  uint16_t bucket[STAT_BUCKETS];   // saturates at 65535
+};
+
+// ─── State ───
+static StatHist _stat_hist[STAT_PHASES];
+static uint32_t _stat_flowUs = 0;
+static bool _stat_flowActive = false;
+
+inline void statRecord(StatPhase p, uint32_t us) {
+  StatHist &h = _stat_hist[p];
+  uint16_t &b = h.bucket[statBucketOf(us)];
+  if (b != 0xFFFF) b++;
+  h.count++;
+  if (us > h.maxUs) h.maxUs = us;
+}
+
+inline void statFlowStart(uint32_t originUs) {
+  _stat_flowUs = originUs;
+  _stat_flowActive = true;
+}
+
+inline void statFlowRecord(StatPhase p) {
+  if (_stat_flowActive) statRecord(p, (uint32_t)micros() - _stat_flowUs);
+}
+
+// ─── Upper bucket edge holding the q-th permille sample ───
+inline uint32_t statPercentile(StatPhase p, uint16_t permille) {
+  const StatHist &h = _stat_hist[p];
+  if (h.count == 0) return 0;
+  uint32_t rank = (uint32_t)(((uint64_t)h.count * permille + 999) / 1000);
+  if (rank == 0) rank = 1;
+  uint32_t seen = 0;
+  for (uint16_t b = 0; b < STAT_BUCKETS; b++) {
+    seen += h.bucket[b];
+    if (seen >= rank) {
+      uint32_t high = statBucketHigh(b);
+      return high < h.maxUs ? high : h.maxUs;
+    }
+  }
+  return h.maxUs;
+}
+
+inline uint32_t statCount(StatPhase p) { return _stat_hist[p].count; }
+inline uint32_t statMax(StatPhase p)   { return _stat_hist[p].maxUs; }
+
+inline void statReset() {
+  memset(_stat_hist, 0, sizeof(_stat_hist));
+  _stat_flowActive = false;
+}
+
+static inline void _statPrintCol(uint32_t v) {
+  char buf[12];
+  snprintf(buf, sizeof(buf), " %9lu", (unsigned long)v);
+  Serial.print(buf);
+}
+
+inline void statPrint() {
+  static const char* const names[STAT_PHASES] = {
+    "irq pickup", "capture", "search", "record", "prefetch", "hid lock",
+    "hid wake", "hid clear", "hid type", "hid enter", "touch>enter"
+  };
+  Serial.println("[STATS] phase            n       p50       p95       p99       max (us)");
+  for (uint8_t p = 0; p < STAT_PHASES; p++) {
+    char head[32];
+    snprintf(head, sizeof(head), "[STATS] %-11s %6lu", names[p], (unsigned long)_stat_hist[p].count);
+    Serial.print(head);
+    _statPrintCol(statPercentile((StatPhase)p, 500));
+    _statPrintCol(statPercentile((StatPhase)p, 950));
+    _statPrintCol(statPercentile((StatPhase)p, 990));
+    _statPrintCol(_stat_hist[p].maxUs);
+    Serial.println();
+  }
+}
+
+#define STAT_T0(t)              uint32_t t = (uint32_t)micros()
+#define STAT_SINCE(phase, t)    statRecord(phase, (uint32_t)micros() - (t))
+#define STAT_FLOW_START(us)     statFlowStart(us)
+#define STAT_FLOW(phase)        statFlowRecord(phase)
+
+#else
+
+inline void statReset() {}
+inline void statPrint() { Serial.println("[STATS] Disabled (LATENCY_STATS 0 in config.h)"); }
+
+#define STAT_T0(t)              do {} while (0)
+#define STAT_SINCE(phase, t)    do {} while (0)
+#define STAT_FLOW_START(us)     do {} while (0)
+#define STAT_FLOW(phase)        do {} while (0)
+
+#endif // LATENCY_STATS
+
+#endif // LATENCY_STATS_H
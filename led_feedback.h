@@ -1,21 +1,25 @@
 // ============================================================
 // led_feedback.h — LED ring semantic state wrappers
+//
+// LED commands go through the sensor service, so on core1 builds
+// they are queued and return immediately.
 // ============================================================
 #ifndef LED_FEEDBACK_H
 #define LED_FEEDBACK_H
 
 #include <DFRobot_ID809.h>
+#include "sensor_service.h"
 
 // ─── State ───
-static DFRobot_ID809* _led_fp = nullptr;
+static bool _led_ready = false;
 
 // ─── Init ───
-// Call once after fingerprint.begin() succeeds.
-inline void ledInit(DFRobot_ID809* fp) { _led_fp = fp; }
+// Call once after the sensor service is initialized.
+inline void ledInit() { _led_ready = true; }
 
 // ─── Internal helper (uses library enum types, not uint8_t) ───
 static inline void _ledCtrl(DFRobot_ID809::eLEDMode_t mode, DFRobot_ID809::eLEDColor_t color, uint8_t count) {
-  if (_led_fp) _led_fp->ctrlLED(mode, color, count);
+  if (_led_ready) sensorCtrlLED(mode, color, count);
 }
 
 // ─── Boot ───
@@ -0,0 +1,381 @@
+// ============================================================
+// log_ring.h — Deferred log records instead of blocking prints
+//
+// LOG("[AUTH] Match — ID #%u → credential %u", id, cred) costs a
+// millis() read and a few stores: the format string is not looked
+// at on the call path. Each call site interns its format once (the
+// index into a pointer table is the record's ID) and queues
+// { ms, ID, raw args } into a fixed RAM ring.
+//
+// logDrain() — a task poller, also run from loop() — renders the
+// oldest records and writes only as many as the USB CDC buffer
+// takes without blocking (Serial.availableForWrite()). Until a
+// terminal opens the port (!Serial) nothing is written, so the boot
+// log waits in the ring. When the ring is full the newest record is
+// dropped and counted; a "[LOG] n record(s) dropped" record marks
+// the gap.
+//
+// After CTL_REQ_LOG_MODE the drain sends CTL_EVT_LOG frames instead
+// of text, so the device does no formatting at all. The host asks
+// once per ID for the format (CTL_REQ_LOG_FMT) and renders the line
+// itself (host/log_decode.h, web/app.js). HELLO returns to text.
+// IDs are handed out in first-use order, so they hold for one boot;
+// hosts start with an empty cache on every connect.
+//
+// Conversions: %u %d %i %x %X %c %s %%, with optional '-' / '0'
+// flags and a width; l and h are accepted and ignored. %s must
+// point at storage that outlives the record (literals, modeName()).
+//
+// Core0 only. Output written straight to Serial (prompts, reports)
+// must call logFlush() first so it does not overtake the queue.
+//
+// Usage:
+//   LOG(fmt, args...)         — queue a record (≤ LOG_MAX_ARGS args)
+//   logDrain()                — write what fits without blocking
+//   logFlush()                — write everything (blocking)
+//   logHandleFrame(f)         — CTL_REQ_LOG_MODE / CTL_REQ_LOG_FMT
+//   logBenchmark(n)           — !LOGBENCH
+//   logFormat(...)            — render a format (device + host tools)
+// ============================================================
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ctl_proto.h"
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS must be a power of two");
+static_assert(LOG_MAX_FORMATS <= 255, "format IDs are one byte");
+
+// ─── One argument as the formatter sees it ───
+// Integers in v; %s as pointer + length (binary records carry the
+// bytes inline, without a terminator).
+struct LogArg {
+  uint32_t v;
+  const char* s;
+  uint16_t n;
+};
+
+// ─── Render fmt into out[cap] (always terminated) ───
+// next(conv, arg) supplies the argument for each conversion and
+// returns false when there is none. Returns the rendered length.
+template <class Next>
+static inline size_t logFormat(char* out, size_t cap, const char* fmt, Next next) {
+  size_t o = 0;
+  auto put = [&](char c) { if (o + 1 < cap) out[o++] = c; };
+  auto pad = [&](size_t n, char c) { while (n--) put(c); };
+
+  while (*fmt) {
+    char c = *fmt++;
+    if (c != '%') { put(c); continue; }
+    if (*fmt == '%') { put('%'); fmt++; continue; }
+
+    bool left = false, zero = false;
+    for (;; fmt++) {
+      if (*fmt == '-') left = true;
+      else if (*fmt == '0') zero = true;
+      else break;
+    }
+    size_t width = 0;
+    while (*fmt >= '0' && *fmt <= '9') width = width * 10 + (size_t)(*fmt++ - '0');
+    while (*fmt == 'l' || *fmt == 'h') fmt++;
+    char conv = *fmt;
+    if (!conv) break;
+    fmt++;
+
+    LogArg a = { 0, nullptr, 0 };
+    if (!next(conv, a)) { put('?'); continue; }
+
+    char digits[12];
+    const char* body = digits;
+    size_t len = 0;
+    bool neg = false;
+    switch (conv) {
+      case 'd': case 'i': {
+        int32_t sv = (int32_t)a.v;
+        neg = sv < 0;
+        uint32_t u = neg ? 0u - (uint32_t)sv : (uint32_t)sv;
+        do { digits[11 - len++] = (char)('0' + u % 10); u /= 10; } while (u);
+        body = digits + 12 - len;
+        break;
+      }
+      case 'u': {
+        uint32_t u = a.v;
+        do { digits[11 - len++] = (char)('0' + u % 10); u /= 10; } while (u);
+        body = digits + 12 - len;
+        break;
+      }
+      case 'x': case 'X': {
+        const char* hex = conv == 'x' ? "0123456789abcdef" : "0123456789ABCDEF";
+        uint32_t u = a.v;
+        do { digits[11 - len++] = hex[u & 0xF]; u >>= 4; } while (u);
+        body = digits + 12 - len;
+        break;
+      }
+      case 'c':
+        digits[0] = (char)a.v;
+        len = 1;
+        zero = false;
+        break;
+      case 's':
+        body = a.s ? a.s : "(null)";
+        len = a.s ? a.n : 6;
+        zero = false;
+        break;
+      default:   // unsupported conversion — show it, keep going
+        put('%');
+        put(conv);
+        continue;
+    }
+
+    size_t total = len + neg;
+    size_t fill = width > total ? width - total : 0;
+    if (!left && !zero) pad(fill, ' ');
+    if (neg) put('-');
+    if (!left && zero) pad(fill, '0');
+    for (size_t i = 0; i < len; i++) put(body[i]);
+    if (left) pad(fill, ' ');
+  }
+  if (cap) out[o] = '\0';
+  return o;
+}
+
+struct LogRecord {
+  uint32_t ms;
+  uint8_t id;         // 1-based index into _log_fmt, 0 = table full
+  uint8_t nargs;
+  uintptr_t arg[LOG_MAX_ARGS];
+};
+
+// ─── State ───
+static LogRecord _log_ring[LOG_RING_SLOTS];
+static uint16_t _log_head = 0;       // free-running; slot = index & (SLOTS - 1)
+static uint16_t _log_tail = 0;
+static const char* _log_fmt[LOG_MAX_FORMATS];
+static uint8_t _log_formats = 0;
+static uint32_t _log_gap = 0;        // drops not yet reported in the stream
+static bool _log_binary = false;     // CTL_EVT_LOG frames instead of text
+static char _log_line[LOG_LINE_MAX + 2];
+
+// ─── Counters (!LOGBENCH, host tests) ───
+static uint32_t _log_records = 0;
+static uint32_t _log_dropped = 0;
+
+// ─── Format table ───
+// First use of a call site; the site keeps the ID in a static.
+inline uint8_t logIntern(const char* fmt) {
+  if (_log_formats >= LOG_MAX_FORMATS) return 0;
+  _log_fmt[_log_formats++] = fmt;
+  return _log_formats;
+}
+
+inline const char* logFormatOf(uint8_t id) {
+  if (id == 0) return "[LOG] Format table full (LOG_MAX_FORMATS)";
+  return id <= _log_formats && id <= LOG_MAX_FORMATS ? _log_fmt[id - 1] : nullptr;
+}
+
+inline uint16_t logPending() { return (uint16_t)(_log_head - _log_tail); }
+
+static inline void _logPut(uint8_t id, uint8_t n, const uintptr_t* args) {
+  LogRecord &r = _log_ring[_log_head & (LOG_RING_SLOTS - 1)];
+  r.ms = millis();
+  r.id = id;
+  r.nargs = n;
+  for (uint8_t i = 0; i < n; i++) r.arg[i] = args[i];
+  _log_head++;
+  _log_records++;
+}
+
+// ─── Drop marker, queued once there is room again ───
+static inline void _logPutGap() {
+  static uint8_t id = 0;
+  if (!id) id = logIntern("[LOG] %u record(s) dropped");
+  uintptr_t n = _log_gap;
+  _logPut(id, 1, &n);
+  _log_gap = 0;
+}
+
+inline void logRecord(uint8_t id, uint8_t n, const uintptr_t* args) {
+  // Keep one slot for the drop marker while a gap is open
+  if (logPending() + (_log_gap ? 2 : 1) > LOG_RING_SLOTS) {
+    _log_gap++;
+    _log_dropped++;
+    return;
+  }
+  if (_log_gap) _logPutGap();
+  _logPut(id, n, args);
+}
+
+template <class T>
+static inline uintptr_t _logArg(T v) { return (uintptr_t)v; }
+static inline uintptr_t _logArg(const char* s) { return (uintptr_t)s; }
+
+template <class... A>
+inline void logPush(uint8_t id, A... args) {
+  static_assert(sizeof...(A) <= LOG_MAX_ARGS, "LOG: more than LOG_MAX_ARGS arguments");
+  const uintptr_t a[sizeof...(A) + 1] = { _logArg(args)..., 0 };
+  logRecord(id, (uint8_t)sizeof...(A), a);
+}
+
+#define LOG(fmt, ...) do {                                 \
+    static uint8_t _log_site = 0;                          \
+    if (!_log_site) _log_site = logIntern(fmt);            \
+    logPush(_log_site, ##__VA_ARGS__);                     \
+  } while (0)
+
+// ─── Render one queued record as text ───
+inline size_t logRender(const LogRecord &r, char* out, size_t cap) {
+  const char* fmt = logFormatOf(r.id);
+  uint8_t i = 0;
+  return logFormat(out, cap, fmt ? fmt : "[LOG] ?", [&](char conv, LogArg &a) {
+    if (i >= r.nargs) return false;
+    uintptr_t v = r.arg[i++];
+    if (conv == 's') {
+      a.s = (const char*)v;
+      a.n = a.s ? (uint16_t)strlen(a.s) : 0;
+    } else {
+      a.v = (uint32_t)v;
+    }
+    return true;
+  });
+}
+
+// ─── CTL_EVT_LOG body ───
+//   [0..3] ms  [4] format ID  then per conversion in the format:
+//   d/i/u/x/X → u32 LE, c → 1 byte, s → length byte + bytes
+inline size_t logEncodeBody(const LogRecord &r, uint8_t* body, size_t cap) {
+  ctlPut32(body, r.ms);
+  body[4] = r.id;
+  size_t o = 5;
+  const char* fmt = logFormatOf(r.id);
+  uint8_t i = 0;
+  for (const char* p = fmt ? fmt : ""; *p && i < r.nargs; p++) {
+    if (*p != '%') continue;
+    p++;
+    if (*p == '%') continue;
+    while (*p == '-' || *p == '0' || (*p >= '1' && *p <= '9') || *p == 'l' || *p == 'h') p++;
+    if (!*p) break;
+    uintptr_t v = r.arg[i++];
+    if (*p == 's') {
+      const char* s = (const char*)v;
+      size_t n = s ? strlen(s) : 0;
+      if (n > 255) n = 255;
+      if (o + 1 + n > cap) n = o + 1 < cap ? cap - o - 1 : 0;
+      if (o + 1 > cap) break;
+      body[o++] = (uint8_t)n;
+      memcpy(body + o, s, n);
+      o += n;
+    } else if (*p == 'c') {
+      if (o + 1 > cap) break;
+      body[o++] = (uint8_t)v;
+    } else {
+      if (o + 4 > cap) break;
+      ctlPut32(body + o, (uint32_t)v);
+      o += 4;
+    }
+  }
+  return o;
+}
+
+// ─── Write the oldest record; false if it does not fit yet ───
+static inline bool _logWriteOne(bool block) {
+  const LogRecord &r = _log_ring[_log_tail & (LOG_RING_SLOTS - 1)];
+  const uint8_t* out;
+  size_t n;
+  if (_log_binary && ctlSessionActive()) {
+    uint8_t body[CTL_MAX_BODY];
+    n = ctlEncode(CTL_EVT_LOG, 0, body, logEncodeBody(r, body, sizeof(body)), _ctl_tx);
+    out = _ctl_tx;
+  } else {
+    n = logRender(r, _log_line, LOG_LINE_MAX + 1);
+    _log_line[n++] = '\r';
+    _log_line[n++] = '\n';
+    out = (const uint8_t*)_log_line;
+  }
+  if (!block && (size_t)Serial.availableForWrite() < n) return false;
+  Serial.write(out, n);
+  _log_tail++;
+  return true;
+}
+
+// ─── Poller: write while the USB buffer has room ───
+// The drop marker goes in as soon as a slot frees up, behind the
+// records that were already queued when the drops happened.
+inline void logDrain() {
+  if (!Serial) return;   // no terminal yet — keep the records
+  while (true) {
+    if (_log_gap && logPending() < LOG_RING_SLOTS) _logPutGap();
+    if (!logPending() || !_logWriteOne(false)) break;
+  }
+}
+
+// ─── Everything out, in order (before direct Serial output) ───
+// Without a terminal the records stay queued for when one opens.
+inline void logFlush() {
+  if (!Serial) return;
+  if (_log_gap) _logPutGap();
+  while (logPending()) _logWriteOne(true);
+}
+
+inline void logSetBinary(bool on) {
+  logFlush();   // records already queued keep the old encoding
+  _log_binary = on;
+}
+
+// ─── !LOGBENCH: one call, LOG() vs the prints it replaces ───
+// The same n lines go out both ways; the drain is timed on its
+// own. n must fit the ring.
+inline void logBenchmark(uint8_t n) {
+  logFlush();
+  unsigned long t0 = micros();
+  for (uint8_t i = 1; i <= n; i++) LOG("[LOGBENCH] line %u of %u", i, n);
+  unsigned long t1 = micros();
+  logFlush();
+  unsigned long t2 = micros();
+  for (uint8_t i = 1; i <= n; i++) {
+    Serial.print("[LOGBENCH] line ");
+    Serial.print(i);
+    Serial.print(" of ");
+    Serial.println(n);
+  }
+  unsigned long t3 = micros();
+
+  Serial.print("[LOGBENCH] LOG() ");
+  Serial.print((t1 - t0) * 1000UL / n);
+  Serial.print(" ns/call, Serial.print ");
+  Serial.print((t3 - t2) * 1000UL / n);
+  Serial.print(" ns/line, drain ");
+  Serial.print((t2 - t1) * 1000UL / n);
+  Serial.println(" ns/record");
+}
+
+// ─── Control requests for the log stream ───
+// Returns false for any other frame type.
+inline bool logHandleFrame(const CtlFrame &f) {
+  if (f.type == CTL_REQ_LOG_MODE) {
+    if (f.len != 1 || f.body[0] > 1) {
+      ctlNak(f, CTL_ERR_BAD_ARG);
+    } else {
+      ctlReply(f, nullptr, 0);
+      logSetBinary(f.body[0] == 1);
+    }
+    return true;
+  }
+  if (f.type == CTL_REQ_LOG_FMT) {
+    const char* fmt = f.len == 1 ? logFormatOf(f.body[0]) : nullptr;
+    if (!fmt) {
+      ctlNak(f, CTL_ERR_BAD_ARG);
+      return true;
+    }
+    uint8_t body[CTL_MAX_BODY];
+    size_t n = strlen(fmt);
+    if (n > CTL_MAX_BODY - 1) n = CTL_MAX_BODY - 1;
+    body[0] = f.body[0];
+    memcpy(body + 1, fmt, n);
+    ctlReply(f, body, n + 1);
+    return true;
+  }
+  return false;
+}
+
+#endif // LOG_RING_H
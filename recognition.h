@@ -2,10 +2,33 @@
 // recognition.h — Fingerprint match + HID unlock flow
 //
 // Flow:
-//   1. Finger detected → capture → search
-//   2. Match → read password from EEPROM → HID unlock sequence
+//   1. Finger detected → capture (core1) → match
+//   2. Match → credential from the index (O(1)) → HID unlock
+//      sequence with its password
 //   3. No match → red LED, continue waiting
 //   4. 5s cooldown between successful unlocks
+//
+// While core1 waits for the capture, core0 decrypts every usable
+// credential into _rec_secrets, so a match types at once instead of
+// reading + decrypting first. The buffer is a static (never a stack
+// copy that moves around), wiped by a guard on every way out of
+// runRecognition(), and .bss, so a reset mid-flow clears it too.
+// !STATS "prefetch" is the decrypt time taken off the touch → Enter
+// path; "record" is what is left on it.
+//
+// Matching (RECOG_STRATEGY, !MATCH): a 1:N search compares against
+// every template on the sensor, yet only fingers in the index can
+// unlock. verify does 1:1 compares against indexed fingers only,
+// the last matched one first; verify+search tries the last match
+// 1:1 and falls back to a search. Each strategy keeps its own
+// count / hits / compares / time so they can be compared on the
+// same sensor.
+//
+// Usage:
+//   recCheckRegistration()   — on mode entry
+//   runRecognition()         — one touch
+//   recSetStrategy(s) / recStrategyName(s) / recPrintMatchStats()
+//   recCaptured()            — last touch was captured (image stream)
 // ============================================================
 #ifndef RECOGNITION_H
 #define RECOGNITION_H
@@ -15,13 +38,109 @@
 #include "config.h"
 #include "switch_control.h"
 #include "led_feedback.h"
+#include "sensor_service.h"
 #include "eeprom_storage.h"
+#include "crypto.h"
+#include "cred_index.h"
+#include "id_bits.h"
 #include "hid_unlock.h"
+#include "latency_stats.h"
+#include "ctl_proto.h"
+#include "log_ring.h"
+#include "tasks.h"
 
 // ─── State ───
 static unsigned long _rec_cooldownUntil = 0;
 static bool _rec_noRegistration = false;
 
+// ─── Passwords decrypted ahead of the match ───
+struct RecSecrets {
+  char password[CRED_MAX_CREDENTIALS][PASSWORD_MAX_LEN + 1];
+  uint8_t length[CRED_MAX_CREDENTIALS];
+  uint8_t ready;   // bit c-1: password[c-1] holds credential c
+};
+static RecSecrets _rec_secrets;
+
+// ─── Match strategy + per-strategy counters ───
+struct RecMatchStats {
+  uint32_t n;          // matches attempted
+  uint32_t hits;       // … that found an ID
+  uint32_t compares;   // sensor match commands sent
+  uint32_t sumUs;
+  uint32_t maxUs;
+};
+static uint8_t _rec_strategy = RECOG_STRATEGY;
+static uint8_t _rec_lastId = 0;   // last matched finger, tried first
+static bool _rec_captured = false;   // the last touch left an image in the sensor
+static RecMatchStats _rec_matchStats[RECOG_STRATEGIES];
+
+static inline void _recWipe() {
+  cryptoWipe(&_rec_secrets, sizeof(_rec_secrets));
+}
+
+// ─── Wipes _rec_secrets when the flow leaves scope, whichever return ───
+struct RecSecretsGuard {
+  RecSecretsGuard() = default;
+  RecSecretsGuard(const RecSecretsGuard &) = delete;
+  ~RecSecretsGuard() { _recWipe(); }
+};
+
+// ─── Decrypt every credential with an authentic record ───
+// Runs while the sensor captures; a failure just leaves that
+// credential to the normal read after the match.
+static inline void _recPrefetch() {
+  for (uint8_t c = 1; c <= CRED_MAX_CREDENTIALS; c++) {
+    if (!credRecordValid(c)) continue;
+    if (credReadPassword(c, _rec_secrets.password[c - 1], _rec_secrets.length[c - 1])) {
+      _rec_secrets.ready |= (uint8_t)(1u << (c - 1));
+    }
+  }
+}
+
+// ─── Worth a 1:1 compare: indexed, record usable, on the sensor ───
+static inline bool _recCandidate(uint8_t id) {
+  uint8_t c = credLookup(id);
+  return c && credRecordValid(c) && (!sensorOccupancyKnown() || sensorIsEnrolled(id));
+}
+
+static inline bool _recVerify(uint8_t id, uint8_t &compares) {
+  compares++;
+  return sensorVerify(id) == id;
+}
+
+// ─── Match the last capture; ID, 0 = no match, ERR_ID809 ───
+static inline uint8_t _recMatch(uint8_t strategy, uint8_t &compares) {
+  compares = 0;
+  if (strategy == RECOG_SEARCH) {
+    compares = 1;
+    return sensorSearch();
+  }
+
+  uint8_t first = _recCandidate(_rec_lastId) ? _rec_lastId : 0;
+  if (first && _recVerify(first, compares)) return first;
+
+  if (strategy == RECOG_VERIFY_SEARCH) {
+    compares++;
+    return sensorSearch();
+  }
+
+  const IdBits &ids = credAssigned();
+  for (uint8_t id = idBitsFirst(ids); id; id = idBitsNext(ids, id)) {
+    if (id == first || !_recCandidate(id)) continue;
+    if (_recVerify(id, compares)) return id;
+  }
+  return 0;
+}
+
+static inline void _recMatchRecord(uint8_t strategy, uint32_t us, uint8_t compares, bool hit) {
+  RecMatchStats &m = _rec_matchStats[strategy];
+  m.n++;
+  m.hits += hit;
+  m.compares += compares;
+  m.sumUs += us;
+  if (us > m.maxUs) m.maxUs = us;
+}
+
 // ─── Check if in cooldown ───
 static inline bool _recInCooldown() {
   if (_rec_cooldownUntil == 0) return false;
@@ -32,118 +151,183 @@ static inline bool _recInCooldown() {
 }
 
 // ─── Validate registration exists (call once on mode entry) ───
-// Returns true if a valid registration exists (fingerprint + password).
-inline bool recCheckRegistration(DFRobot_ID809 &fp) {
-  uint8_t activeSlot = eepromGetActiveSlot();
-  if (activeSlot == 0) {
-    _rec_noRegistration = true;
-    return false;
-  }
+// Returns true if at least one credential has a valid record and
+// a finger that is actually enrolled on the sensor. Served from
+// the index + occupancy cache — no UART traffic unless the
+// templates changed since the last check.
+inline bool recCheckRegistration() {
+  bool listed = sensorOccupancyKnown();
+  bool anyEnrolled = sensorCachedEnrollCount() > 0;
 
-  // Verify the sensor actually has a fingerprint in that slot
-  // We do this by checking enrolled count — if 0, no fingerprints at all
-  if (fp.getEnrollCount() == 0) {
-    _rec_noRegistration = true;
-    return false;
+  for (uint8_t c = 1; c <= CRED_MAX_CREDENTIALS; c++) {
+    if (!credRecordValid(c)) continue;
+    bool present = listed ? idBitsAny(idBitsAnd(credFingers(c), sensorOccupancy()))
+                          : anyEnrolled;
+    if (present) {
+      _rec_noRegistration = false;
+      return true;
+    }
   }
 
-  _rec_noRegistration = false;
-  return true;
+  _rec_noRegistration = true;
+  return false;
 }
 
 // ─── Handle a single recognition cycle ───
 // Called from main loop when finger is newly detected in RECOGNIZE mode.
 // Returns true if unlock sequence was sent.
-inline bool runRecognition(DFRobot_ID809 &fp) {
+inline bool runRecognition() {
   // Guard: no registration
   if (_rec_noRegistration) {
-    Serial.println("[AUTH] No registration — flip to REGISTER");
+    LOG("[AUTH] No registration — flip to REGISTER");
+    ctlEventAuth(CTL_AUTH_NO_REGISTRATION);
     ledNoRegistration();
     return false;
   }
 
   // Guard: cooldown active
   if (_recInCooldown()) {
-    Serial.println("[AUTH] Cooldown active — ignoring touch");
+    LOG("[AUTH] Cooldown active — ignoring touch");
+    ctlEventAuth(CTL_AUTH_COOLDOWN);
     return false;
   }
 
-  // ── Capture fingerprint ──
-  Serial.println("[AUTH] Capturing...");
+  RecSecretsGuard wipe;
+  _rec_captured = false;
+
+  // ── Capture fingerprint (core1), decrypt meanwhile (core0) ──
+  LOG("[AUTH] Capturing...");
 
-  uint8_t ret = fp.collectionFingerprint(MATCH_TIMEOUT);
+  STAT_T0(tCapture);
+  SensorTicket capture = sensorCaptureStart(MATCH_TIMEOUT);
+  STAT_T0(tPrefetch);
+  _recPrefetch();
+  STAT_SINCE(STAT_PREFETCH, tPrefetch);
+  uint8_t ret = sensorCaptureResult(capture);
+  STAT_SINCE(STAT_CAPTURE, tCapture);
   if (ret == ERR_ID809) {
-    Serial.println("[AUTH] Capture failed");
+    _recWipe();
+    LOG("[AUTH] Capture failed");
+    ctlEventAuth(CTL_AUTH_CAPTURE_FAIL);
     ledCaptureFail();
-    delay(1000);
+    taskWaitUntil(switchChanged, 1000);
     ledRecognizeReady();
     return false;
   }
+  _rec_captured = true;
 
-  // ── Search for match ──
-  uint8_t matchID = fp.search();
+  // ── Match: 1:1 verify and/or 1:N search ──
+  STAT_T0(tSearch);
+  uint32_t tMatch = micros();
+  uint8_t strategy = _rec_strategy;
+  uint8_t compares;
+  uint8_t matchID = _recMatch(strategy, compares);
+  _recMatchRecord(strategy, micros() - tMatch, compares, matchID != 0 && matchID != ERR_ID809);
+  STAT_SINCE(STAT_SEARCH, tSearch);
 
   if (matchID == 0 || matchID == ERR_ID809) {
     // No match
-    Serial.println("[AUTH] No match");
+    _recWipe();
+    LOG("[AUTH] No match");
+    ctlEventAuth(CTL_AUTH_NO_MATCH);
     ledNoMatch();
-    delay(1500);
+    taskWaitUntil(switchChanged, 1500);
     ledRecognizeReady();
     return false;
   }
 
   // ── Match found ──
-  Serial.print("[AUTH] Match — slot #");
-  Serial.println(matchID);
-
-  // Verify this is our active slot
-  uint8_t activeSlot = eepromGetActiveSlot();
-  if (matchID != activeSlot) {
-    // Matched an orphan slot, not our active registration
-    Serial.print("[AUTH] Matched slot ");
-    Serial.print(matchID);
-    Serial.print(" but active is ");
-    Serial.println(activeSlot);
-    Serial.println("[AUTH] Ignoring orphan match");
+  uint8_t cred = credLookup(matchID);
+
+  if (cred == 0) {
+    // Matched a template no credential owns (e.g. interrupted registration)
+    _recWipe();
+    LOG("[AUTH] Match — ID #%u, not in index", matchID);
+    LOG("[AUTH] Ignoring orphan match");
+    ctlEventAuth(CTL_AUTH_ORPHAN, matchID);
     ledNoMatch();
-    delay(1500);
+    taskWaitUntil(switchChanged, 1500);
     ledRecognizeReady();
     return false;
   }
+  _rec_lastId = matchID;
+  LOG("[AUTH] Match — ID #%u → credential %u", matchID, cred);
+  ctlEventAuth(CTL_AUTH_MATCH, matchID, cred);
 
-  // ── Read password from EEPROM ──
-  uint8_t slot;
-  char password[PASSWORD_MAX_LEN + 1];
-  uint8_t pwdLen;
-
-  if (!eepromReadRegistration(slot, password, pwdLen)) {
-    Serial.println("[AUTH] EEPROM read failed — registration corrupt?");
-    ledNoRegistration();
-    return false;
+  // ── That credential's password (decrypted during the capture) ──
+  // Read now only if the prefetch missed it (record written since).
+  STAT_T0(tRecord);
+  uint8_t bit = (uint8_t)(1u << (cred - 1));
+  if (!(_rec_secrets.ready & bit)) {
+    if (!credReadPassword(cred, _rec_secrets.password[cred - 1], _rec_secrets.length[cred - 1])) {
+      _recWipe();
+      LOG("[AUTH] Record read failed — registration corrupt?");
+      ctlEventAuth(CTL_AUTH_RECORD_FAIL, matchID, cred);
+      ledNoRegistration();
+      return false;
+    }
+    _rec_secrets.ready |= bit;
   }
+  STAT_SINCE(STAT_RECORD, tRecord);
 
   // ── Execute HID unlock ──
   ledMatchFound();
-  Serial.println("[AUTH] Sending unlock sequence...");
+  LOG("[AUTH] Sending unlock sequence...");
 
-  hidUnlockSequence(password);
+  hidUnlockSequence(_rec_secrets.password[cred - 1], credLayout(cred));
 
-  // Clear password from RAM immediately
-  memset(password, 0, sizeof(password));
+  // Clear passwords from RAM immediately
+  _recWipe();
 
-  Serial.println("[AUTH] Unlock complete");
+  LOG("[AUTH] Unlock complete");
+  ctlEventAuth(CTL_AUTH_UNLOCKED, matchID, cred);
 
   // ── Start cooldown ──
   _rec_cooldownUntil = millis() + COOLDOWN_MS;
-  Serial.println("[AUTH] Cooldown 5s...");
+  LOG("[AUTH] Cooldown 5s...");
 
   ledMatchFound();
-  delay(2000);
+  taskWaitUntil(switchChanged, 2000);
   ledCooldown();
 
   return true;
 }
 
+// ─── Strategy (RAM only; boots with RECOG_STRATEGY) ───
+inline void recSetStrategy(uint8_t strategy) {
+  if (strategy < RECOG_STRATEGIES) _rec_strategy = strategy;
+}
+
+inline uint8_t recStrategy() { return _rec_strategy; }
+
+// ─── The last runRecognition() got a capture (img_stream.h) ───
+inline bool recCaptured() { return _rec_captured; }
+
+inline const char* recStrategyName(uint8_t strategy) {
+  static const char* const names[RECOG_STRATEGIES] = { "verify", "search", "verify+search" };
+  return strategy < RECOG_STRATEGIES ? names[strategy] : "?";
+}
+
+inline void recResetMatchStats() {
+  memset(_rec_matchStats, 0, sizeof(_rec_matchStats));
+}
+
+// ─── !MATCH: per-strategy counters ───
+inline void recPrintMatchStats() {
+  char line[96];
+  snprintf(line, sizeof(line), "[MATCH] Strategy %s, last match ID #%u",
+           recStrategyName(_rec_strategy), _rec_lastId);
+  Serial.println(line);
+  Serial.println("[MATCH] strategy           n    hits  compares    avg us    max us");
+  for (uint8_t s = 0; s < RECOG_STRATEGIES; s++) {
+    const RecMatchStats &m = _rec_matchStats[s];
+    snprintf(line, sizeof(line), "[MATCH] %-13s %6lu  %6lu  %8lu  %8lu  %8lu", recStrategyName(s),
+             (unsigned long)m.n, (unsigned long)m.hits, (unsigned long)m.compares,
+             (unsigned long)(m.n ? m.sumUs / m.n : 0), (unsigned long)m.maxUs);
+    Serial.println(line);
+  }
+}
+
 // ─── Reset state (call on mode switch) ───
 inline void recReset() {
   _rec_cooldownUntil = 0;
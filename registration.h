@@ -1,8 +1,31 @@
 // ============================================================
-// registration.h — Two-slot safe fingerprint + password registration
+// registration.h — A/B-safe fingerprint + password registration
 //
 // Key principle: never destroy old registration until new one is
 // fully committed and verified. Old pair stays intact on any failure.
+//
+// The user picks a credential (1..CRED_MAX_CREDENTIALS) first:
+//   "2"  — replace credential 2 (new finger + new password)
+//   "2+" — add another finger to credential 2 (password unchanged)
+//   "2 DE" — replace credential 2, its Mac has a German keyboard
+//            (hid_layouts.h; without one a replacement keeps the
+//            credential's layout, a new one gets HID_LAYOUT_DEFAULT)
+// The new finger is enrolled into a free sensor ID and only
+// becomes reachable through the index commit (cred_index.h).
+//
+// Each prompt is also announced as a CTL_EVT_REG event, and a
+// CTL_REQ_REG_INPUT frame answers it like a typed line (ctl_proto.h).
+//
+// For batch provisioning a CTL_REQ_PROVISION frame hands over the
+// credential, its layout and password up front: the next registration starts
+// without a touch and only asks for the finger. An empty password
+// adds a finger, like "N+".
+//
+// Each committed finger's template is backed up (tpl_backup.h) so
+// a replaced sensor gets it back at boot without re-enrolling.
+//
+// The flow is interactive, so it prints directly rather than through
+// LOG(); queued records are flushed first to keep the order.
 // ============================================================
 #ifndef REGISTRATION_H
 #define REGISTRATION_H
@@ -12,61 +35,129 @@
 #include "config.h"
 #include "switch_control.h"
 #include "led_feedback.h"
+#include "sensor_service.h"
 #include "eeprom_storage.h"
+#include "cred_index.h"
+#include "tpl_backup.h"
+#include "tasks.h"
+#include "irq_finger.h"
+#include "ctl_proto.h"
+#include "log_ring.h"
 
 // ─── State for abort detection ───
 static uint8_t _reg_stagingSlot = 0;
 static bool _reg_fingerprintStored = false;
+static CancelToken _reg_cancel = TASK_NO_CANCEL;   // switch position this run started in
+
+// ─── Provisioning (CTL_REQ_PROVISION), taken by the next run ───
+static uint8_t _reg_provCred = 0;   // 0 = none pending
+static uint8_t _reg_provLen = 0;    // 0 = add a finger
+static uint8_t _reg_provLayout = HID_LAYOUT_US;
+static char _reg_provPassword[PASSWORD_MAX_LEN + 1];
 
 // ─── Abort check: returns true if switch changed mid-operation ───
+// The switch ISR cancels the token, so this is a plain flag test.
+static inline bool _regCancelled() { return taskCancelled(_reg_cancel); }
+
 static inline bool _regCheckAbort() {
-  switchRead();
-  if (switchChanged()) {
+  if (_regCancelled()) {
     Serial.println("[WARNING] Switch changed — aborting registration");
     return true;
   }
   return false;
 }
 
-// ─── Rollback: clean up staging slot, preserve old registration ───
-static inline void _regRollback(DFRobot_ID809 &fp) {
+// ─── Committed finger → encrypted backup (best effort) ───
+static inline void _regBackupTemplate(uint8_t id) {
+  uint32_t t0 = millis();
+  if (tplBackupSave(id)) {
+    Serial.print("[REG] Template backed up (");
+    Serial.print(millis() - t0);
+    Serial.println(" ms)");
+  } else if (tplBackupAvailable()) {
+    Serial.println("[REG] Template backup failed — this finger must be re-enrolled on a new sensor");
+  }
+}
+
+// ─── Rollback: clean up staging ID, preserve old registration ───
+static inline void _regRollback() {
   if (_reg_fingerprintStored && _reg_stagingSlot > 0) {
-    fp.delFingerprint(_reg_stagingSlot);
-    Serial.print("[REG] Cleaned staging slot ");
+    sensorDelete(_reg_stagingSlot);
+    Serial.print("[REG] Cleaned staging ID ");
     Serial.println(_reg_stagingSlot);
   }
   _reg_fingerprintStored = false;
   Serial.println("[REG] Rolled back — old registration preserved");
 }
 
-// ─── Read password from Serial with masked echo ───
-// Returns length of password read, 0 on timeout or abort.
-static inline uint8_t _regReadPassword(char* buf, const char* prompt) {
+// ─── Take a CTL_REQ_REG_INPUT frame as the whole line ───
+// Returns the length, -1 (after a NAK) if it can't be a line.
+static inline int16_t _regTakeFrameLine(char* buf, uint8_t maxLen, bool masked) {
+  const CtlFrame &f = ctlFrame();
+  bool ok = f.len <= maxLen;
+  for (uint8_t i = 0; ok && i < f.len; i++) ok = f.body[i] >= 32 && f.body[i] <= 126;
+  if (!ok) {
+    ctlNak(f, CTL_ERR_BAD_ARG);
+    return -1;
+  }
+  memcpy(buf, f.body, f.len);
+  buf[f.len] = '\0';
+  for (uint8_t i = 0; i < f.len; i++) Serial.print(masked ? '*' : buf[i]);
+  ctlReply(f, nullptr, 0);
+  return f.len;
+}
+
+// ─── Read a line from Serial ───
+// masked: echo '*' and refuse empty input (passwords).
+// Control frames are serviced while waiting; a REG_INPUT frame
+// supplies the whole line at once.
+// Returns the length read, -1 on timeout or abort.
+// Caller must own the console (see _regReadPassword).
+static inline int16_t _regReadLineRaw(char* buf, uint8_t maxLen, const char* prompt, bool masked,
+                                      CtlRegStep step) {
+  logFlush();
   Serial.println(prompt);
-  memset(buf, 0, PASSWORD_MAX_LEN + 1);
+  ctlEventReg(step, step == CTL_REG_CHOOSE ? CRED_MAX_CREDENTIALS : 0);
+  memset(buf, 0, maxLen + 1);
 
   uint8_t idx = 0;
   unsigned long startTime = millis();
 
-  while (idx < PASSWORD_MAX_LEN) {
+  while (idx < maxLen) {
     // Check abort
-    if (_regCheckAbort()) return 0;
+    if (_regCheckAbort()) return -1;
 
     // Check timeout
     if ((millis() - startTime) > PASSWORD_TIMEOUT_MS) {
       Serial.println();
-      Serial.println("[REG] Password entry timeout");
-      return 0;
+      Serial.println(masked ? "[REG] Password entry timeout" : "[REG] Input timeout");
+      ctlEventReg(CTL_REG_TIMEOUT);
+      return -1;
     }
 
     if (Serial.available()) {
       char c = Serial.read();
 
+      CtlRx rx = ctlFeed((uint8_t)c);
+      if (rx == CTL_RX_BUSY) continue;  // mid-frame: keep draining
+      if (rx == CTL_RX_FRAME) {
+        if (ctlFrame().type != CTL_REQ_REG_INPUT) {
+          ctlDispatch();
+          continue;
+        }
+        int16_t len = _regTakeFrameLine(buf, maxLen, masked);
+        if (len < 0) continue;
+        idx = (uint8_t)len;
+        c = '\n';  // finish it like a typed line
+      }
+
       if (c == '\n' || c == '\r') {
         Serial.println();  // newline after masked input
-        if (idx == 0) {
+        if (idx == 0 && masked) {
           Serial.println("[REG] Empty password not allowed");
+          ctlEventReg(CTL_REG_EMPTY);
           Serial.println(prompt);
+          ctlEventReg(step);
           startTime = millis();  // reset timeout
           continue;
         }
@@ -76,17 +167,17 @@ static inline uint8_t _regReadPassword(char* buf, const char* prompt) {
         // Backspace
         if (idx > 0) {
           idx--;
-          Serial.print("\b \b");  // erase last '*'
+          Serial.print("\b \b");  // erase last char
         }
       } else if (c >= 32 && c <= 126) {
         // Printable char
         buf[idx++] = c;
-        Serial.print('*');
+        Serial.print(masked ? '*' : c);
         startTime = millis();  // reset timeout on activity
       }
     }
 
-    delay(10);
+    taskDelay(1);  // a switch flip is seen on the next pass
   }
 
   // Buffer full
@@ -95,30 +186,151 @@ static inline uint8_t _regReadPassword(char* buf, const char* prompt) {
   return idx;
 }
 
+// ─── Read password with the console claimed ───
+// Keeps the background serial-command poller off our bytes.
+// Returns length, 0 on timeout or abort.
+static inline uint8_t _regReadPassword(char* buf, const char* prompt, CtlRegStep step) {
+  taskConsoleClaim();
+  int16_t len = _regReadLineRaw(buf, PASSWORD_MAX_LEN, prompt, true, step);
+  taskConsoleRelease();
+  return len > 0 ? (uint8_t)len : 0;
+}
+
+// ─── Layout a replacement types with unless one is named ───
+static inline uint8_t _regDefaultLayout(uint8_t c) {
+  return credInUse(c) ? credLayout(c) : (uint8_t)HID_LAYOUT_DEFAULT;
+}
+
+// ─── Ask which credential to register ───
+// Returns 1..CRED_MAX_CREDENTIALS, 0 on timeout or abort.
+// addFinger is set for "N+" on a credential that already exists;
+// layout is the one named ("N DE") or the default.
+static inline uint8_t _regChooseCredential(bool &addFinger, uint8_t &layout) {
+  addFinger = false;
+  layout = _regDefaultLayout(1);
+  if (CRED_MAX_CREDENTIALS == 1) return 1;
+
+  char prompt[112];
+  snprintf(prompt, sizeof(prompt),
+           "[REG] Credential (1-%u; append + to add a finger, or US/UK/DE/FR/CH for the Mac's keyboard; Enter = 1):",
+           (unsigned)CRED_MAX_CREDENTIALS);
+
+  char line[8];
+  while (true) {
+    taskConsoleClaim();
+    int16_t len = _regReadLineRaw(line, sizeof(line) - 1, prompt, false, CTL_REG_CHOOSE);
+    taskConsoleRelease();
+    if (len < 0) return 0;
+    if (len == 0) return 1;
+
+    uint8_t c = (uint8_t)(line[0] - '0');
+    bool plus = (len == 2 && line[1] == '+');
+    uint8_t named = (len == 4 && line[1] == ' ') ? hidLayoutFind(line + 2) : (uint8_t)HID_LAYOUTS;
+    if (c >= 1 && c <= CRED_MAX_CREDENTIALS && (len == 1 || plus || named < HID_LAYOUTS)) {
+      if (plus && !credInUse(c)) {
+        Serial.print("[REG] Credential ");
+        Serial.print(c);
+        Serial.println(" is empty — registering it with a password");
+        plus = false;
+      }
+      addFinger = plus;
+      layout = named < HID_LAYOUTS ? named : _regDefaultLayout(c);
+      return c;
+    }
+    Serial.println("[REG] Invalid choice");
+  }
+}
+
+// ─── Provisioning ───
+// body: [0] credential (bits 0-3) and HidLayout (bits 4-7, 0 = US),
+// [1..] password (printable, may be empty for an existing
+// credential). Returns 0 once pending, else the NAK code.
+inline uint8_t regProvision(const uint8_t* body, uint8_t len) {
+  if (len < 1 || len - 1 > PASSWORD_MAX_LEN) return CTL_ERR_BAD_ARG;
+  uint8_t cred = body[0] & 0x0F, layout = body[0] >> 4;
+  if (cred < 1 || cred > CRED_MAX_CREDENTIALS || layout >= HID_LAYOUTS) return CTL_ERR_BAD_ARG;
+  if (len == 1 && !credInUse(cred)) return CTL_ERR_BAD_ARG;   // a new credential needs a password
+  for (uint8_t i = 1; i < len; i++) {
+    if (body[i] < 32 || body[i] > 126) return CTL_ERR_BAD_ARG;
+  }
+  if (_reg_provCred) return CTL_ERR_STATE;
+  _reg_provCred = cred;
+  _reg_provLayout = layout;
+  _reg_provLen = len - 1;
+  memcpy(_reg_provPassword, body + 1, _reg_provLen);
+  return 0;
+}
+
+inline bool regProvisionPending() { return _reg_provCred != 0; }
+
+// ─── Drop a pending provision (mode flip, end of every run) ───
+inline void regProvisionClear() {
+  memset(_reg_provPassword, 0, sizeof(_reg_provPassword));
+  _reg_provCred = 0;
+  _reg_provLen = 0;
+  _reg_provLayout = HID_LAYOUT_US;
+}
+
+// ─── Take the provisioned password into buf; returns its length ───
+static inline uint8_t _regTakeProvision(char* buf) {
+  uint8_t len = _reg_provLen;
+  memcpy(buf, _reg_provPassword, len);
+  buf[len] = '\0';
+  regProvisionClear();
+  Serial.println("[REG] Password provisioned");
+  return len;
+}
+
 // ─── Main registration flow ───
 // Returns true if registration succeeded.
-// fingerprint: reference to the DFRobot_ID809 instance
-inline bool runRegistration(DFRobot_ID809 &fp) {
+inline bool runRegistration() {
+  logFlush();
   Serial.println("[MODE] REGISTER");
 
   // Reset state
   _reg_fingerprintStored = false;
+  _reg_cancel = switchToken();
+
+  // ── Step 0: Which credential ──
+  bool addFinger = _reg_provCred && _reg_provLen == 0;
+  uint8_t layout = _reg_provLayout;
+  uint8_t cred = _reg_provCred ? _reg_provCred : _regChooseCredential(addFinger, layout);
+  if (cred == 0) {
+    ledRegisterFail();
+    return false;
+  }
 
-  // ── Determine slots ──
-  uint8_t activeSlot = eepromGetActiveSlot();
-  _reg_stagingSlot = eepromGetStagingSlot();
+  // ── Determine staging ID (free on the sensor and in the index) ──
+  _reg_stagingSlot = credFreeId();
+  if (_reg_stagingSlot == 0) {
+    Serial.println("[REG] Sensor full — no free template ID");
+    ledRegisterFail();
+    return false;
+  }
 
-  Serial.print("[REG] Active slot: ");
-  Serial.print(activeSlot == 0 ? "none (virgin)" : String(activeSlot).c_str());
-  Serial.print(", staging to slot: ");
+  Serial.print("[REG] Credential ");
+  Serial.print(cred);
+  Serial.print(credInUse(cred) ? " (" : " (new");
+  if (credInUse(cred)) {
+    Serial.print(credFingerCount(cred));
+    Serial.print(" finger(s)");
+  }
+  Serial.print(addFinger ? "), adding finger" : "), replacing");
+  if (!addFinger) {
+    Serial.print(", ");
+    Serial.print(hidLayoutName(layout));
+    Serial.print(" keyboard");
+  }
+  Serial.print(", staging to ID ");
   Serial.println(_reg_stagingSlot);
 
-  // ── Step 1: Clean staging slot ──
-  fp.delFingerprint(_reg_stagingSlot);  // ignore error if empty
-  Serial.print("[REG] Cleaned staging slot ");
+  // ── Step 1: Clean staging ID ──
+  tplBackupDrop(_reg_stagingSlot);
+  sensorDelete(_reg_stagingSlot);  // ignore error if empty
+  Serial.print("[REG] Cleaned staging ID ");
   Serial.println(_reg_stagingSlot);
 
-  // ── Step 2: Fingerprint enrollment (3× capture to staging slot) ──
+  // ── Step 2: Fingerprint enrollment (3× capture to staging ID) ──
   ledWaitingFinger();
 
   for (uint8_t i = 0; i < COLLECT_COUNT; i++) {
@@ -127,7 +339,7 @@ inline bool runRegistration(DFRobot_ID809 &fp) {
     while (retries < MAX_CAPTURE_RETRIES) {
       // Check abort before each capture
       if (_regCheckAbort()) {
-        _regRollback(fp);
+        _regRollback();
         return false;
       }
 
@@ -136,10 +348,17 @@ inline bool runRegistration(DFRobot_ID809 &fp) {
       Serial.print("/");
       Serial.print(COLLECT_COUNT);
       Serial.println(")...");
+      ctlEventReg(CTL_REG_PLACE, i + 1, COLLECT_COUNT);
       ledWaitingFinger();
 
-      // Wait for finger with timeout
-      uint8_t ret = fp.collectionFingerprint(CAPTURE_TIMEOUT);
+      // Wait for the finger on Touch Out (abortable), then capture.
+      // A flip mid-capture abandons the reply; the sensor finishes alone.
+      uint8_t ret = irqFingerAwaitTouch(CAPTURE_TIMEOUT * 1000UL, _regCancelled)
+                      ? sensorCapture(CAPTURE_TIMEOUT, _reg_cancel) : ERR_ID809;
+      if (_regCheckAbort()) {
+        _regRollback();
+        return false;
+      }
 
       if (ret != ERR_ID809) {
         // Capture succeeded
@@ -151,14 +370,12 @@ inline bool runRegistration(DFRobot_ID809 &fp) {
 
         // Wait for finger removal
         Serial.println("[REG] Remove finger...");
-        while (fp.detectFinger()) {
-          if (_regCheckAbort()) {
-            _regRollback(fp);
-            return false;
-          }
-          delay(100);
+        ctlEventReg(CTL_REG_REMOVE);
+        if (!irqFingerAwaitLift(0, _regCheckAbort)) {
+          _regRollback();
+          return false;
         }
-        delay(500);
+        taskDelay(500);
         break;  // move to next capture
       } else {
         // Capture failed
@@ -169,57 +386,84 @@ inline bool runRegistration(DFRobot_ID809 &fp) {
         Serial.print("/");
         Serial.print(MAX_CAPTURE_RETRIES);
         Serial.println(")");
+        ctlEventReg(CTL_REG_CAPTURE_FAIL, retries, MAX_CAPTURE_RETRIES);
 
         if (retries >= MAX_CAPTURE_RETRIES) {
           Serial.println("[REG] Max retries — enrollment failed");
           ledRegisterFail();
-          _regRollback(fp);
+          _regRollback();
           return false;
         }
 
-        delay(1000);
+        taskDelay(1000);
 
         // Wait for finger removal before retry
-        while (fp.detectFinger()) delay(100);
+        irqFingerAwaitLift(0);
       }
     }
   }
 
-  // Store fingerprint to staging slot
-  Serial.print("[REG] Storing to staging slot ");
+  // Store fingerprint to staging ID
+  Serial.print("[REG] Storing to staging ID ");
   Serial.print(_reg_stagingSlot);
   Serial.print("... ");
 
-  uint8_t storeResult = fp.storeFingerprint(_reg_stagingSlot);
+  uint8_t storeResult = sensorStore(_reg_stagingSlot);
   if (storeResult != 0) {
     Serial.println("FAILED");
     ledRegisterFail();
-    _regRollback(fp);
+    _regRollback();
     return false;
   }
 
   Serial.println("OK");
   _reg_fingerprintStored = true;
 
+  // ── Add-finger: the index commit is all that's left ──
+  if (addFinger) {
+    if (!credCommitAddFinger(cred, _reg_stagingSlot)) {
+      Serial.println("[REG] Index commit failed!");
+      ledRegisterFail();
+      _regRollback();
+      return false;
+    }
+    _regBackupTemplate(_reg_stagingSlot);
+    ledRegisterSuccess();
+    Serial.print("[REG] Finger ID ");
+    Serial.print(_reg_stagingSlot);
+    Serial.print(" added to credential ");
+    Serial.println(cred);
+    ctlEventReg(CTL_REG_DONE, cred, _reg_stagingSlot);
+    taskDelay(2000);  // show green LED
+    _reg_fingerprintStored = false;
+    return true;
+  }
+
   // ── Step 3: Password input via Serial ──
   ledWaitingPassword();
 
   char password[PASSWORD_MAX_LEN + 1];
   char confirm[PASSWORD_MAX_LEN + 1];
 
-  uint8_t pwdLen = _regReadPassword(password, "[REG] Enter password (max 32 chars, Enter to confirm):");
+  bool provisioned = regProvisionPending();
+  uint8_t pwdLen = provisioned ? _regTakeProvision(password)
+                               : _regReadPassword(password, "[REG] Enter password (max 32 chars, Enter to confirm):",
+                                                  CTL_REG_PASSWORD);
   if (pwdLen == 0) {
     ledRegisterFail();
-    _regRollback(fp);
+    _regRollback();
     return false;
   }
 
+  if (provisioned) goto password_confirmed;   // the frame was typed by a tool, not a person
+
   // Confirm password with retries
   for (uint8_t attempt = 0; attempt < PASSWORD_MAX_CONFIRM_ATTEMPTS; attempt++) {
-    uint8_t confirmLen = _regReadPassword(confirm, "[REG] Confirm password:");
+    uint8_t confirmLen = _regReadPassword(confirm, "[REG] Confirm password:", CTL_REG_CONFIRM);
     if (confirmLen == 0) {
+      memset(password, 0, sizeof(password));
       ledRegisterFail();
-      _regRollback(fp);
+      _regRollback();
       return false;
     }
 
@@ -234,11 +478,14 @@ inline bool runRegistration(DFRobot_ID809 &fp) {
     Serial.print("/");
     Serial.print(PASSWORD_MAX_CONFIRM_ATTEMPTS);
     Serial.println(")");
+    ctlEventReg(CTL_REG_MISMATCH, attempt + 1, PASSWORD_MAX_CONFIRM_ATTEMPTS);
 
     if (attempt + 1 >= PASSWORD_MAX_CONFIRM_ATTEMPTS) {
       Serial.println("[REG] Too many mismatches");
+      memset(password, 0, sizeof(password));
+      memset(confirm, 0, sizeof(confirm));
       ledRegisterFail();
-      _regRollback(fp);
+      _regRollback();
       return false;
     }
   }
@@ -248,49 +495,43 @@ password_confirmed:
   memset(confirm, 0, sizeof(confirm));
 
   // ── Step 4: Atomic commit ──
+  // Password goes to the idle A/B bank; the index append that flips
+  // the bank and hands the credential to the new finger is the
+  // commit point. On failure the old pair is untouched.
   Serial.println("[REG] Committing...");
+  IdBits oldFingers = credFingers(cred);
 
-  // Backup old registration in case we need to restore
-  uint8_t oldSlot = 0;
-  char oldPwd[PASSWORD_MAX_LEN + 1] = {0};
-  uint8_t oldLen = 0;
-  bool hadOldReg = eepromReadRegistration(oldSlot, oldPwd, oldLen);
-
-  // Write new registration
-  if (!eepromWriteRegistration(_reg_stagingSlot, password, pwdLen)) {
-    Serial.println("[REG] EEPROM verify failed!");
-    ledRegisterFail();
+  bool committed = credCommitReplace(cred, _reg_stagingSlot, password, pwdLen, layout);
 
-    // Restore old EEPROM if there was a previous registration
-    if (hadOldReg) {
-      eepromWriteRegistration(oldSlot, oldPwd, oldLen);
-      Serial.println("[REG] Old EEPROM data restored");
-    } else {
-      eepromClearRegistration();
-    }
+  // Clear sensitive data from RAM
+  memset(password, 0, sizeof(password));
 
-    // Clean staging fingerprint
-    _regRollback(fp);
+  if (!committed) {
+    Serial.println("[REG] Commit verify failed!");
+    ledRegisterFail();
+    _regRollback();
     return false;
   }
 
-  // ── Success! Now safe to delete old slot ──
-  if (activeSlot > 0 && activeSlot != _reg_stagingSlot) {
-    fp.delFingerprint(activeSlot);
-    Serial.print("[REG] Deleted old slot ");
-    Serial.println(activeSlot);
-  }
+  _regBackupTemplate(_reg_stagingSlot);
 
-  // Clear sensitive data from RAM
-  memset(password, 0, sizeof(password));
-  memset(oldPwd, 0, sizeof(oldPwd));
+  // ── Success! Now safe to delete the credential's old fingers ──
+  for (uint8_t id = idBitsFirst(oldFingers); id; id = idBitsNext(oldFingers, id)) {
+    tplBackupDrop(id);
+    sensorDelete(id);
+    Serial.print("[REG] Deleted old finger ID ");
+    Serial.println(id);
+  }
 
   ledRegisterSuccess();
-  Serial.print("[REG] Registration complete (slot ");
+  Serial.print("[REG] Registration complete (credential ");
+  Serial.print(cred);
+  Serial.print(" → ID ");
   Serial.print(_reg_stagingSlot);
-  Serial.println(" now active)");
+  Serial.println(")");
+  ctlEventReg(CTL_REG_DONE, cred, _reg_stagingSlot);
 
-  delay(2000);  // show green LED
+  taskDelay(2000);  // show green LED
   _reg_fingerprintStored = false;
 
   return true;
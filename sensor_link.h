@@ -0,0 +1,216 @@
+// ============================================================
+// sensor_link.h — Sensor UART rate: probe, negotiate, persist,
+//                 fall back
+//
+// The ID809 keeps its baud rate across power cycles and speaks one
+// of SENSOR_BAUD_RATES (config.h). At boot sensorLinkOpen() tries
+// the rate saved in the journal first, then the others fastest
+// first; the one that answers is the current rate. If that is
+// slower than the ceiling — the fastest rate not yet seen failing —
+// the sensor is asked for the ceiling (setBaudrate), Serial1 is
+// reopened there, and the rate is only trusted after
+// SENSOR_LINK_VERIFY_PINGS isConnected() in a row. A rate that
+// fails verification lowers the ceiling; the next one down is tried.
+//
+// A lowered ceiling is not for good: a burst of noise, a loose
+// cable since reseated or a swapped sensor would otherwise cap the
+// link for the life of the journal. The record counts boots since
+// the ceiling last dropped; after SENSOR_LINK_REPROBE_BOOTS of them
+// boot tries the fastest rate again (and verifies it as above). A
+// rate that still fails lowers the ceiling and restarts the count.
+//
+// At run time the sensor service calls sensorLinkCheck() after any
+// command that returned ERR_ID809: one ping tells a sensor-side
+// error (capture timeout, empty ID) from a garbled link. After
+// SENSOR_LINK_MAX_ERRORS link errors in a row the link steps down
+// a rate and the ceiling follows it, for this boot and until the
+// next re-probe. The command that hit the
+// errors fails as any sensor error would; the next one runs at the
+// new rate. Core0 writes the change to the journal
+// (sensorLinkSave() in sensor_service.h, from loop()).
+//
+// Whoever owns the sensor calls these: core0 during boot, core1
+// once sensorServiceStart() has handed it over.
+//
+// Usage:
+//   sensorLinkOpen(fp)        — boot: find + negotiate (false = no answer)
+//   sensorLinkCheck(fp)       — after a command returned ERR_ID809
+//   sensorLinkBench(fp, us)   — ping time per rate (µs, 0 = not measured)
+//   sensorLinkBaud() / sensorLinkCeiling() / sensorLinkFallbacks() / sensorLinkBoots()
+// ============================================================
+#ifndef SENSOR_LINK_H
+#define SENSOR_LINK_H
+
+#include <Arduino.h>
+#include <DFRobot_ID809.h>
+#include <atomic>
+#include <stddef.h>
+#include "config.h"
+#include "cred_store.h"
+
+static const uint32_t _link_rates[] = SENSOR_BAUD_RATES;
+#define SENSOR_LINK_RATES ((uint8_t)(sizeof(_link_rates) / sizeof(_link_rates[0])))
+
+static_assert(CRED_KEY_SENSOR_LINK < CRED_STORE_MAX_KEYS, "CRED_KEY_SENSOR_LINK outside the journal");
+
+// ─── Journal record ───
+#define SENSOR_LINK_MAGIC 0x4B4E494CUL   // "LINK"
+
+struct SensorLinkRecord {
+  uint32_t magic;
+  uint32_t baud;      // rate the sensor was left at
+  uint32_t ceiling;   // fastest rate not seen failing
+  uint32_t boots;     // boots since the ceiling was lowered (absent in old records)
+};
+
+// ─── State (owning core writes, core0 reads for save / report) ───
+static uint8_t _link_rate = 0;        // index into _link_rates, 0 = fastest
+static uint8_t _link_ceiling = 0;
+static uint8_t _link_errors = 0;      // link errors in a row
+static uint16_t _link_fallbacks = 0;
+static uint32_t _link_boots = 0;      // boots since the ceiling was lowered
+static std::atomic<bool> _link_dirty{false};   // rate / ceiling not saved yet
+
+static inline uint8_t _linkIndexOf(uint32_t baud) {
+  for (uint8_t i = 0; i < SENSOR_LINK_RATES; i++) {
+    if (_link_rates[i] == baud) return i;
+  }
+  return SENSOR_LINK_RATES;
+}
+
+static inline DFRobot_ID809::eDeviceBaudrate_t _linkCode(uint32_t baud) {
+  switch (baud) {
+    case 9600:  return DFRobot_ID809::e9600bps;
+    case 19200: return DFRobot_ID809::e19200bps;
+    case 38400: return DFRobot_ID809::e38400bps;
+    case 57600: return DFRobot_ID809::e57600bps;
+  }
+  return DFRobot_ID809::e115200bps;
+}
+
+static inline void _linkUart(uint8_t i) {
+  Serial1.end();
+  Serial1.begin(_link_rates[i]);
+  _link_rate = i;
+}
+
+// ─── n pings in a row; average round trip into *avgUs ───
+static inline bool _linkPing(DFRobot_ID809 &fp, uint8_t n, uint32_t* avgUs = nullptr) {
+  uint32_t t0 = micros();
+  for (uint8_t k = 0; k < n; k++) {
+    if (!fp.isConnected()) return false;
+  }
+  if (avgUs) *avgUs = (micros() - t0) / n;
+  return true;
+}
+
+// ─── Whichever rate the sensor answers at: first, then fastest first ───
+static inline bool _linkFind(DFRobot_ID809 &fp, uint8_t first, bool firstTried = false) {
+  if (!firstTried) {
+    _linkUart(first);
+    if (fp.isConnected()) return true;
+  }
+  for (uint8_t i = 0; i < SENSOR_LINK_RATES; i++) {
+    if (i == first) continue;
+    _linkUart(i);
+    if (fp.isConnected()) return true;
+  }
+  _linkUart(first);
+  return false;
+}
+
+// ─── Move the sensor to rate `to` and verify it ───
+// The request goes out at the old rate and can be lost on a bad
+// link, so it is repeated until the sensor answers at the new one.
+// On failure the link is left wherever the sensor answers.
+static inline bool _linkSwitch(DFRobot_ID809 &fp, uint8_t to) {
+  uint8_t from = _link_rate;
+  for (uint8_t a = 0; a < SENSOR_LINK_MAX_ERRORS; a++) {
+    fp.setBaudrate(_linkCode(_link_rates[to]));   // reply at the old rate, may be garbled
+    _linkUart(to);
+    if (fp.isConnected()) {
+      if (_linkPing(fp, SENSOR_LINK_VERIFY_PINGS)) return true;
+      break;   // switched, but the new rate does not hold up
+    }
+    _linkUart(from);   // request lost — still at the old rate
+  }
+  _linkFind(fp, _link_rate);
+  return false;
+}
+
+// ============================================================
+// PUBLIC API
+// ============================================================
+
+// ─── Boot: find the sensor's rate, move it to the fastest that holds ───
+// Serial1 must already be open (any rate). Returns false if the
+// sensor answers at none of the rates.
+inline bool sensorLinkOpen(DFRobot_ID809 &fp) {
+  SensorLinkRecord rec = {};
+  bool saved = credStoreRead(CRED_KEY_SENSOR_LINK, &rec, sizeof(rec)) >= offsetof(SensorLinkRecord, boots) &&
+               rec.magic == SENSOR_LINK_MAGIC && _linkIndexOf(rec.baud) < SENSOR_LINK_RATES &&
+               _linkIndexOf(rec.ceiling) < SENSOR_LINK_RATES;
+  uint8_t first = _linkIndexOf(saved ? rec.baud : (uint32_t)SENSOR_BAUD);
+  if (first >= SENSOR_LINK_RATES) first = 0;
+  _link_ceiling = saved ? _linkIndexOf(rec.ceiling) : 0;
+  if (_link_ceiling && rec.boots >= SENSOR_LINK_REPROBE_BOOTS) _link_ceiling = 0;   // time to try again
+  uint8_t ceiling = _link_ceiling;
+
+  _linkUart(first);
+  if (!fp.begin(Serial1) && !_linkFind(fp, first, true)) return false;
+
+  // Up to the ceiling; every rate that fails verification lowers it
+  while (_link_rate > _link_ceiling) {
+    if (_linkSwitch(fp, _link_ceiling)) break;
+    _link_ceiling++;
+  }
+  if (_link_rate < _link_ceiling) _linkSwitch(fp, _link_ceiling);
+
+  // Count boots only while below the top rate; a drop restarts it
+  _link_errors = 0;
+  _link_boots = !_link_ceiling || _link_ceiling > ceiling ? 0 : rec.boots + 1;
+  if (!saved || rec.baud != _link_rates[_link_rate] || rec.ceiling != _link_rates[_link_ceiling] ||
+      rec.boots != _link_boots) {
+    _link_dirty.store(true, std::memory_order_release);
+  }
+  return true;
+}
+
+// ─── After ERR_ID809: sensor error or link error? ───
+// Steps the link down after SENSOR_LINK_MAX_ERRORS link errors in
+// a row (the ceiling follows, so the next boots start there until
+// the re-probe).
+inline void sensorLinkCheck(DFRobot_ID809 &fp) {
+  if (fp.isConnected()) {
+    _link_errors = 0;
+    return;
+  }
+  if (++_link_errors < SENSOR_LINK_MAX_ERRORS) return;
+  _link_errors = 0;
+
+  for (uint8_t to = _link_rate + 1; to < SENSOR_LINK_RATES; to++) {
+    if (_linkSwitch(fp, to)) break;
+  }
+  _link_ceiling = _link_rate;
+  _link_boots = 0;
+  _link_fallbacks++;
+  _link_dirty.store(true, std::memory_order_release);
+}
+
+// ─── Average ping per rate, ceiling and slower; back home after ───
+inline void sensorLinkBench(DFRobot_ID809 &fp, uint32_t* us) {
+  uint8_t home = _link_rate;
+  for (uint8_t i = 0; i < SENSOR_LINK_RATES; i++) us[i] = 0;
+  for (uint8_t i = _link_ceiling; i < SENSOR_LINK_RATES; i++) {
+    if (i != _link_rate && !_linkSwitch(fp, i)) continue;
+    _linkPing(fp, SENSOR_LINK_BENCH_PINGS, &us[i]);
+  }
+  if (_link_rate != home) _linkSwitch(fp, home);
+}
+
+inline uint32_t sensorLinkBaud()      { return _link_rates[_link_rate]; }
+inline uint32_t sensorLinkCeiling()   { return _link_rates[_link_ceiling]; }
+inline uint16_t sensorLinkFallbacks() { return _link_fallbacks; }
+inline uint32_t sensorLinkBoots()     { return _link_boots; }
+
+#endif // SENSOR_LINK_H
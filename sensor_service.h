@@ -0,0 +1,427 @@
+// ============================================================
+// sensor_service.h — Fingerprint sensor owned by RP2350 core1
+//
+// Core1 runs a small "sensor service" that exclusively owns
+// Serial1 and the DFRobot_ID809 object. Core0 (flows, HID,
+// console) talks to it through two SPSC rings:
+//
+//   core0 ──SensorCmd──▶ core1   (capture, search, LED, ...)
+//   core0 ◀──SensorEvt── core1   (result of each command)
+//
+// Synchronous calls (sensorCapture, sensorSearch, ...) post a
+// command and then keep the task pollers running until the
+// matching reply arrives, so the console and switch stay live
+// while the UART round trip happens on the other core. A call
+// given a CancelToken stops waiting as soon as it is cancelled;
+// core1 finishes the command and its reply is dropped. LED
+// commands are fire-and-forget.
+//
+// Core0 waits on one reply at a time. The pollers run inside that
+// wait, so a call from one (console command, control frame) would
+// take the flow's reply for an abandoned one and drop it; such a
+// call is refused with ERR_ID809 and logged instead.
+//
+// With SENSOR_SERVICE_CORE1 set to 0 every wrapper calls the
+// library directly on the caller's core (single-core fallback).
+//
+// Enrollment occupancy (count + ID bitmap) is cached and only
+// re-queried after sensorStore() / sensorDelete() bump the cache
+// generation (see state_cache.h).
+//
+// Usage:
+//   sensorServiceInit(&fp)   — after fp.begin() succeeds
+//   sensorServiceStart()     — hand ownership to core1
+//   sensorServiceRun()       — call from loop1() on core1
+//   sensorWaitIdle()         — block until core1 has drained
+//   sensorCapture(s, token)  — capture; ERR_ID809 once the token is cancelled
+//   sensorCaptureStart(s)    — capture on core1, core0 carries on
+//   sensorCaptureResult(t)   — … then wait for its result
+//   sensorLinkSave()         — journal a rate change (core0, loop())
+//   sensorLinkBenchmark()    — !LINKBENCH: ping time per UART rate
+//   sensorTemplateGet/Put(id, tpl) — raw template out of / into an ID
+//   sensorImage(quarter, px) — grayscale image of the last capture
+//   sensorPeekEnrollCount()  — template count safe from a poller (0xFF = unknown)
+// ============================================================
+#ifndef SENSOR_SERVICE_H
+#define SENSOR_SERVICE_H
+
+#include <Arduino.h>
+#include <DFRobot_ID809.h>
+#include <atomic>
+#include "config.h"
+#include "spsc_ring.h"
+#include "tasks.h"
+#include "state_cache.h"
+#include "id_bits.h"
+#include "log_ring.h"
+#include "cred_store.h"
+#include "sensor_link.h"
+
+// ─── Commands / events ───
+enum SensorOp : uint8_t {
+  SOP_CAPTURE,       // a = timeout (s)
+  SOP_SEARCH,
+  SOP_VERIFY,        // a = ID
+  SOP_DETECT,
+  SOP_LED,           // a = mode, b = color, c = blink count
+  SOP_STORE,         // a = ID
+  SOP_DELETE,        // a = ID
+  SOP_ENROLL_COUNT,
+  SOP_ID_LIST,       // buf = uint8_t[SENSOR_CAPACITY]
+  SOP_LINK_BENCH,    // buf = uint32_t[SENSOR_LINK_RATES]
+  SOP_TPL_GET,       // a = ID, buf = uint8_t[SENSOR_TEMPLATE_BYTES] (out)
+  SOP_TPL_PUT,       // a = ID, buf = uint8_t[SENSOR_TEMPLATE_BYTES] (in)
+  SOP_IMAGE          // a = 1 for the quarter image, buf = pixels of the last capture
+};
+
+struct SensorCmd {
+  uint16_t seq;
+  uint8_t  op;
+  uint8_t  a, b, c;
+  bool     wantReply;
+  uint8_t* buf;
+};
+
+struct SensorEvt {
+  uint16_t seq;
+  uint8_t  op;
+  uint8_t  result;
+};
+
+// ─── State ───
+static DFRobot_ID809* _sensor_fp = nullptr;
+static SpscRing<SensorCmd, SENSOR_QUEUE_DEPTH> _sensor_cmdQ;
+static SpscRing<SensorEvt, SENSOR_QUEUE_DEPTH> _sensor_evtQ;
+static std::atomic<bool> _sensor_started{false};
+static std::atomic<bool> _sensor_busy{false};   // core1 is executing a command
+static uint16_t _sensor_nextSeq = 1;             // core0 only
+static uint8_t _sensor_awaited = 0;              // core0: replies a flow still waits for
+
+// ─── Execute one command against the library (owning core) ───
+static inline uint8_t _sensorExecOp(const SensorCmd &cmd) {
+  DFRobot_ID809 &fp = *_sensor_fp;
+  switch (cmd.op) {
+    case SOP_CAPTURE:      return fp.collectionFingerprint(cmd.a);
+    case SOP_SEARCH:       return fp.search();
+    case SOP_VERIFY:       return fp.verify(cmd.a);
+    case SOP_DETECT:       return fp.detectFinger();
+    case SOP_LED:          return fp.ctrlLED((DFRobot_ID809::eLEDMode_t)cmd.a,
+                                             (DFRobot_ID809::eLEDColor_t)cmd.b, cmd.c);
+    case SOP_STORE:        return fp.storeFingerprint(cmd.a);
+    case SOP_DELETE:       return fp.delFingerprint(cmd.a);
+    case SOP_ENROLL_COUNT: return fp.getEnrollCount();
+    case SOP_ID_LIST:      return fp.getEnrolledIDList(cmd.buf);
+    case SOP_LINK_BENCH:   sensorLinkBench(fp, (uint32_t*)cmd.buf); return 0;
+    case SOP_TPL_GET:      return fp.getTemplate(cmd.a, cmd.buf);
+    case SOP_TPL_PUT:      return fp.downLoadTemplate(cmd.a, cmd.buf);
+    case SOP_IMAGE:        return cmd.a ? fp.getQuarterFingerImage(cmd.buf) : fp.getFingerImage(cmd.buf);
+  }
+  return ERR_ID809;
+}
+
+// Every sensor error also asks whether the link itself is failing
+static inline uint8_t _sensorExec(const SensorCmd &cmd) {
+  uint8_t result = _sensorExecOp(cmd);
+  if (result == ERR_ID809) sensorLinkCheck(*_sensor_fp);
+  return result;
+}
+
+// ─── Init / start (core0) ───
+inline void sensorServiceInit(DFRobot_ID809* fp) {
+  _sensor_fp = fp;
+}
+
+inline void sensorServiceStart() {
+#if SENSOR_SERVICE_CORE1
+  _sensor_started.store(true, std::memory_order_release);
+  __sev();
+  LOG("[BOOT] Sensor service on core1 OK");
+#endif
+}
+
+// ─── Service loop body (core1) ───
+// Drains every pending command, then sleeps until core0 signals.
+inline void sensorServiceRun() {
+  if (!_sensor_started.load(std::memory_order_acquire)) {
+    __wfe();
+    return;
+  }
+
+  SensorCmd cmd;
+  if (!_sensor_cmdQ.pop(cmd)) {
+    __wfe();
+    return;
+  }
+
+  _sensor_busy.store(true, std::memory_order_release);
+  uint8_t result = _sensorExec(cmd);
+  if (cmd.wantReply) {
+    SensorEvt evt = { cmd.seq, cmd.op, result };
+    while (!_sensor_evtQ.push(evt)) tight_loop_contents();  // core0 always drains
+    __sev();
+  }
+  _sensor_busy.store(false, std::memory_order_release);
+}
+
+// ─── Post a command (core0) ───
+static inline uint16_t _sensorPost(uint8_t op, uint8_t a, uint8_t b, uint8_t c,
+                                   bool wantReply, uint8_t* buf) {
+  SensorCmd cmd = { _sensor_nextSeq++, op, a, b, c, wantReply, buf };
+  if (wantReply) _sensor_awaited++;
+  while (!_sensor_cmdQ.push(cmd)) taskDelay(1);  // ring full — core1 is busy
+  __sev();
+  return cmd.seq;
+}
+
+// ─── A reply is already awaited: refuse (a poller inside a flow's wait) ───
+static inline bool _sensorRefuseNested(uint8_t op) {
+  if (!_sensor_awaited) return false;
+  LOG("[SENSOR] Refused op %u: a flow is waiting on the sensor", (unsigned)op);
+  return true;
+}
+
+// ─── Wait for the reply to seq, servicing pollers meanwhile ───
+// Replies to older (abandoned) requests are discarded — with one
+// reply awaited at a time nothing else can be in the ring. A
+// cancelled token abandons this one.
+static inline uint8_t _sensorAwait(uint16_t seq, const CancelToken &cancel = TASK_NO_CANCEL) {
+  SensorEvt evt;
+  while (true) {
+    while (_sensor_evtQ.pop(evt)) {
+      if (evt.seq == seq) {
+        _sensor_awaited--;
+        return evt.result;
+      }
+    }
+    if (taskCancelled(cancel)) {
+      _sensor_awaited--;
+      return ERR_ID809;
+    }
+    taskDelay(1);
+  }
+}
+
+// ─── Synchronous call ───
+// Without core1 the command runs inline and cannot be cancelled.
+static inline uint8_t _sensorCall(uint8_t op, uint8_t a = 0, uint8_t b = 0, uint8_t c = 0,
+                                  uint8_t* buf = nullptr, const CancelToken &cancel = TASK_NO_CANCEL) {
+#if SENSOR_SERVICE_CORE1
+  if (_sensor_started.load(std::memory_order_acquire)) {
+    if (_sensorRefuseNested(op)) return ERR_ID809;
+    return _sensorAwait(_sensorPost(op, a, b, c, true, buf), cancel);
+  }
+#endif
+  SensorCmd cmd = { 0, op, a, b, c, false, buf };
+  return _sensorExec(cmd);
+}
+
+// ─── Block until core1 has no queued or running command ───
+// Call before anything that stalls core1 (e.g. flash commits).
+inline void sensorWaitIdle() {
+#if SENSOR_SERVICE_CORE1
+  while (!_sensor_cmdQ.empty() || _sensor_busy.load(std::memory_order_acquire)) {
+    taskDelay(1);
+  }
+#endif
+}
+
+// ============================================================
+// PUBLIC API — same return conventions as DFRobot_ID809
+// ============================================================
+
+inline uint8_t sensorCapture(uint8_t timeoutS, const CancelToken &cancel = TASK_NO_CANCEL) {
+  return _sensorCall(SOP_CAPTURE, timeoutS, 0, 0, nullptr, cancel);
+}
+
+// ─── Split capture: core0 works while core1 waits on the sensor ───
+// Without core1 the capture runs inside Start and Result just
+// hands back what it returned.
+struct SensorTicket {
+  uint16_t seq;      // 0 = already done
+  uint8_t  result;
+};
+
+inline SensorTicket sensorCaptureStart(uint8_t timeoutS) {
+#if SENSOR_SERVICE_CORE1
+  if (_sensor_started.load(std::memory_order_acquire)) {
+    if (_sensorRefuseNested(SOP_CAPTURE)) return { 0, ERR_ID809 };
+    return { _sensorPost(SOP_CAPTURE, timeoutS, 0, 0, true, nullptr), 0 };
+  }
+#endif
+  return { 0, _sensorCall(SOP_CAPTURE, timeoutS) };
+}
+
+inline uint8_t sensorCaptureResult(const SensorTicket &t) {
+  return t.seq ? _sensorAwait(t.seq) : t.result;
+}
+inline uint8_t sensorSearch()                    { return _sensorCall(SOP_SEARCH); }
+inline uint8_t sensorVerify(uint8_t id)          { return _sensorCall(SOP_VERIFY, id); }
+inline uint8_t sensorDetectFinger()              { return _sensorCall(SOP_DETECT); }
+inline uint8_t sensorEnrollCount()               { return _sensorCall(SOP_ENROLL_COUNT); }
+inline uint8_t sensorEnrolledIDList(uint8_t* list) {
+  return _sensorCall(SOP_ID_LIST, 0, 0, 0, list);
+}
+
+// ─── Template mutations invalidate every cache ───
+inline uint8_t sensorStore(uint8_t id) {
+  uint8_t ret = _sensorCall(SOP_STORE, id);
+  cacheBump();
+  return ret;
+}
+
+inline uint8_t sensorDelete(uint8_t id) {
+  uint8_t ret = _sensorCall(SOP_DELETE, id);
+  cacheBump();
+  return ret;
+}
+
+// ─── Raw templates (SENSOR_TEMPLATE_BYTES, tpl_backup.h) ───
+inline uint8_t sensorTemplateGet(uint8_t id, uint8_t* tpl) {
+  return _sensorCall(SOP_TPL_GET, id, 0, 0, tpl);
+}
+
+inline uint8_t sensorTemplatePut(uint8_t id, uint8_t* tpl) {
+  uint8_t ret = _sensorCall(SOP_TPL_PUT, id, 0, 0, tpl);
+  cacheBump();
+  return ret;
+}
+
+// ─── Grayscale image of the last capture (img_stream.h) ───
+inline uint8_t sensorImage(bool quarter, uint8_t* pixels) {
+  return _sensorCall(SOP_IMAGE, quarter, 0, 0, pixels);
+}
+
+// ============================================================
+// OCCUPANCY CACHE — enrolled count + ID bitmap
+// ============================================================
+
+static IdBits _sensor_occBits;
+static uint8_t _sensor_occCount = 0;
+static bool _sensor_occListed = false;   // bitmap is authoritative
+static uint32_t _sensor_occGen = 0;      // 0 = never filled
+
+// ─── Refill count + bitmap if stale ───
+// Returns false if the sensor couldn't be queried at all.
+// If only the ID list fails, the count is kept but the bitmap
+// is marked unlisted (callers fall back to count-only logic).
+static inline bool _sensorOccRefresh() {
+  if (cacheFresh(_sensor_occGen)) {
+    cacheHit(CACHE_SENSOR);
+    return true;
+  }
+  cacheMiss(CACHE_SENSOR);
+
+  idBitsClear(_sensor_occBits);
+  _sensor_occListed = false;
+
+  uint8_t count = sensorEnrollCount();
+  if (count > SENSOR_CAPACITY) return false;  // ERR_ID809 or garbage
+  _sensor_occCount = count;
+
+  if (count == 0) {
+    _sensor_occListed = true;
+  } else {
+    uint8_t idList[SENSOR_CAPACITY];
+    memset(idList, 0, sizeof(idList));
+    if (sensorEnrolledIDList(idList) == 0) {
+      for (uint8_t i = 0; i < count; i++) {
+        idBitsSet(_sensor_occBits, idList[i]);
+      }
+      _sensor_occListed = true;
+    }
+  }
+
+  _sensor_occGen = cacheGeneration();
+  return true;
+}
+
+// ─── Enrolled template count (cached). 0 if the sensor didn't answer. ───
+inline uint8_t sensorCachedEnrollCount() {
+  if (!_sensorOccRefresh()) return 0;
+  return _sensor_occCount;
+}
+
+// ─── Enrolled count for pollers (HELLO / STATUS) ───
+// A poller can run inside a flow's wait for the sensor; refreshing the
+// cache there would be a nested call. While a reply is awaited, answer
+// from a fresh cache or SENSOR_COUNT_UNKNOWN.
+#define SENSOR_COUNT_UNKNOWN 0xFF
+
+inline uint8_t sensorPeekEnrollCount() {
+  if (!_sensor_awaited) return sensorCachedEnrollCount();
+  return cacheFresh(_sensor_occGen) ? _sensor_occCount : SENSOR_COUNT_UNKNOWN;
+}
+
+// ─── Is the bitmap authoritative? (false if getEnrolledIDList failed) ───
+inline bool sensorOccupancyKnown() {
+  return _sensorOccRefresh() && _sensor_occListed;
+}
+
+// ─── Is a template stored at id? (cached, O(1)) ───
+inline bool sensorIsEnrolled(uint8_t id) {
+  if (!_sensorOccRefresh()) return false;
+  return idBitsTest(_sensor_occBits, id);
+}
+
+// ─── Whole bitmap (cached). Empty if the sensor didn't answer. ───
+inline const IdBits& sensorOccupancy() {
+  _sensorOccRefresh();
+  return _sensor_occBits;
+}
+
+// ─── LED: fire-and-forget on core1 ───
+inline void sensorCtrlLED(DFRobot_ID809::eLEDMode_t mode, DFRobot_ID809::eLEDColor_t color, uint8_t count) {
+#if SENSOR_SERVICE_CORE1
+  if (_sensor_started.load(std::memory_order_acquire)) {
+    _sensorPost(SOP_LED, (uint8_t)mode, (uint8_t)color, count, false, nullptr);
+    return;
+  }
+#endif
+  if (_sensor_fp) _sensor_fp->ctrlLED(mode, color, count);
+}
+
+// ============================================================
+// UART LINK — rate changes made on the owning core (sensor_link.h)
+// ============================================================
+
+static uint16_t _sensor_linkReported = 0;   // fallbacks already logged
+
+// ─── Journal the link rate if it changed (core0) ───
+inline void sensorLinkSave() {
+  if (!_link_dirty.exchange(false, std::memory_order_acquire)) return;
+  if (_link_fallbacks != _sensor_linkReported) {
+    _sensor_linkReported = _link_fallbacks;
+    LOG("[SENSOR] Link errors — now %u bps", (unsigned)sensorLinkBaud());
+  }
+  SensorLinkRecord rec = { SENSOR_LINK_MAGIC, sensorLinkBaud(), sensorLinkCeiling(), sensorLinkBoots() };
+  sensorWaitIdle();   // flash commit parks core1
+  credStoreWrite(CRED_KEY_SENSOR_LINK, &rec, sizeof(rec));
+}
+
+// ─── !LINKBENCH: round trip at every rate the link may use ───
+// Core1 walks the rates from the ceiling down and switches back;
+// rates above the ceiling are not tried. Refused while a flow
+// waits on the sensor (the only way the bench op fails).
+inline void sensorLinkBenchmark() {
+  uint32_t us[SENSOR_LINK_RATES];
+  if (_sensorCall(SOP_LINK_BENCH, 0, 0, 0, (uint8_t*)us) != 0) {
+    Serial.println("[LINK] Sensor busy — try again when idle");
+    return;
+  }
+
+  char line[64];
+  snprintf(line, sizeof(line), "[LINK] %lu bps, ceiling %lu, %u fallback(s)",
+           (unsigned long)sensorLinkBaud(), (unsigned long)sensorLinkCeiling(), sensorLinkFallbacks());
+  Serial.println(line);
+  for (uint8_t i = 0; i < SENSOR_LINK_RATES; i++) {
+    if (us[i]) {
+      snprintf(line, sizeof(line), "[LINK] %6lu bps %8lu us/ping", (unsigned long)_link_rates[i], (unsigned long)us[i]);
+    } else {
+      snprintf(line, sizeof(line), "[LINK] %6lu bps        - (%s)", (unsigned long)_link_rates[i],
+               i < _link_ceiling ? "above ceiling" : "failed");
+    }
+    Serial.println(line);
+  }
+}
+
+#endif // SENSOR_SERVICE_H
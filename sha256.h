@@ -0,0 +1,263 @@
+// ============================================================
+// sha256.h — Streaming SHA-256 (FIPS 180-4) + HMAC + HKDF
+//
+// Incremental init/update/final over any input length. The
+// message schedule is a rolling 16-word window (64 bytes of
+// stack instead of 256), expanded in place as the rounds run.
+//
+// HMAC-SHA256 (RFC 2104) and HKDF-SHA256 (RFC 5869) are built
+// on the same context.
+//
+// Usage:
+//   sha256Init(&c); sha256Update(&c, p, n); sha256Final(&c, out)
+//   sha256(data, len, out)                    — one-shot
+//   hmacSha256(key, klen, msg, mlen, out)     — one-shot
+//   hkdfSha256(salt, slen, ikm, ilen, info, nlen, okm, olen)
+// ============================================================
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define SHA256_BLOCK_SIZE  64
+#define SHA256_DIGEST_SIZE 32
+
+static const uint32_t _sha256_k[64] = {
+  0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+  0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+  0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+  0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+  0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+  0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+  0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+  0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+};
+
+static inline uint32_t _sha_rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32 - n)); }
+static inline uint32_t _sha_ch(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (~x & z); }
+static inline uint32_t _sha_maj(uint32_t x, uint32_t y, uint32_t z) { return (x & y) ^ (x & z) ^ (y & z); }
+static inline uint32_t _sha_ep0(uint32_t x) { return _sha_rotr(x,2) ^ _sha_rotr(x,13) ^ _sha_rotr(x,22); }
+static inline uint32_t _sha_ep1(uint32_t x) { return _sha_rotr(x,6) ^ _sha_rotr(x,11) ^ _sha_rotr(x,25); }
+static inline uint32_t _sha_sig0(uint32_t x) { return _sha_rotr(x,7) ^ _sha_rotr(x,18) ^ (x >> 3); }
+static inline uint32_t _sha_sig1(uint32_t x) { return _sha_rotr(x,17) ^ _sha_rotr(x,19) ^ (x >> 10); }
+
+// ─── Context ───
+struct Sha256Ctx {
+  uint32_t h[8];
+  uint8_t  buf[SHA256_BLOCK_SIZE];
+  uint8_t  bufLen;
+  uint64_t totalLen;   // bytes
+};
+
+// ─── Compress one 64-byte block ───
+static inline void _sha256Block(uint32_t h[8], const uint8_t* p) {
+  uint32_t w[16];
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)p[i*4] << 24) | ((uint32_t)p[i*4+1] << 16) |
+           ((uint32_t)p[i*4+2] << 8) | ((uint32_t)p[i*4+3]);
+  }
+
+  uint32_t a=h[0], b=h[1], c=h[2], d=h[3], e=h[4], f=h[5], g=h[6], hh=h[7];
+  for (int i = 0; i < 64; i++) {
+    // Rolling schedule: w[i & 15] becomes W[i] in place
+    if (i >= 16) {
+      w[i & 15] += _sha_sig1(w[(i - 2) & 15]) + w[(i - 7) & 15] + _sha_sig0(w[(i - 15) & 15]);
+    }
+    uint32_t t1 = hh + _sha_ep1(e) + _sha_ch(e,f,g) + _sha256_k[i] + w[i & 15];
+    uint32_t t2 = _sha_ep0(a) + _sha_maj(a,b,c);
+    hh=g; g=f; f=e; e=d+t1; d=c; c=b; b=a; a=t1+t2;
+  }
+  h[0]+=a; h[1]+=b; h[2]+=c; h[3]+=d; h[4]+=e; h[5]+=f; h[6]+=g; h[7]+=hh;
+
+  memset(w, 0, sizeof(w));
+}
+
+// ─── Init ───
+static inline void sha256Init(Sha256Ctx* ctx) {
+  static const uint32_t iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(ctx->h, iv, sizeof(iv));
+  ctx->bufLen = 0;
+  ctx->totalLen = 0;
+}
+
+// ─── Absorb data (any length, any number of calls) ───
+static inline void sha256Update(Sha256Ctx* ctx, const uint8_t* data, size_t len) {
+  if (len == 0) return;
+  ctx->totalLen += len;
+
+  // Top up a partial block first
+  if (ctx->bufLen > 0) {
+    size_t take = SHA256_BLOCK_SIZE - ctx->bufLen;
+    if (take > len) take = len;
+    memcpy(ctx->buf + ctx->bufLen, data, take);
+    ctx->bufLen += (uint8_t)take;
+    data += take;
+    len -= take;
+    if (ctx->bufLen < SHA256_BLOCK_SIZE) return;
+    _sha256Block(ctx->h, ctx->buf);
+    ctx->bufLen = 0;
+  }
+
+  // Whole blocks straight from the caller's buffer
+  while (len >= SHA256_BLOCK_SIZE) {
+    _sha256Block(ctx->h, data);
+    data += SHA256_BLOCK_SIZE;
+    len -= SHA256_BLOCK_SIZE;
+  }
+
+  if (len > 0) {
+    memcpy(ctx->buf, data, len);
+    ctx->bufLen = (uint8_t)len;
+  }
+}
+
+// ─── Pad, output digest (big-endian), wipe context ───
+static inline void sha256Final(Sha256Ctx* ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+  uint64_t bitlen = ctx->totalLen * 8;
+
+  ctx->buf[ctx->bufLen++] = 0x80;
+  if (ctx->bufLen > 56) {
+    memset(ctx->buf + ctx->bufLen, 0, SHA256_BLOCK_SIZE - ctx->bufLen);
+    _sha256Block(ctx->h, ctx->buf);
+    ctx->bufLen = 0;
+  }
+  memset(ctx->buf + ctx->bufLen, 0, 56 - ctx->bufLen);
+  for (int i = 0; i < 8; i++) {
+    ctx->buf[63 - i] = (uint8_t)(bitlen >> (8 * i));
+  }
+  _sha256Block(ctx->h, ctx->buf);
+
+  for (int i = 0; i < 8; i++) {
+    digest[i*4+0] = (uint8_t)(ctx->h[i] >> 24);
+    digest[i*4+1] = (uint8_t)(ctx->h[i] >> 16);
+    digest[i*4+2] = (uint8_t)(ctx->h[i] >> 8);
+    digest[i*4+3] = (uint8_t)(ctx->h[i]);
+  }
+
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+// ─── One-shot ───
+static inline void sha256(const uint8_t* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]) {
+  Sha256Ctx ctx;
+  sha256Init(&ctx);
+  sha256Update(&ctx, data, len);
+  sha256Final(&ctx, digest);
+}
+
+// ============================================================
+// HMAC-SHA256 (RFC 2104)
+// ============================================================
+
+struct HmacSha256Ctx {
+  Sha256Ctx inner;
+  uint8_t   opad[SHA256_BLOCK_SIZE];   // key ^ 0x5c, kept for final
+};
+
+static inline void hmacSha256Init(HmacSha256Ctx* ctx, const uint8_t* key, size_t keyLen) {
+  uint8_t k[SHA256_BLOCK_SIZE];
+  memset(k, 0, sizeof(k));
+  if (keyLen > SHA256_BLOCK_SIZE) {
+    sha256(key, keyLen, k);
+  } else {
+    memcpy(k, key, keyLen);
+  }
+
+  uint8_t ipad[SHA256_BLOCK_SIZE];
+  for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+    ipad[i] = k[i] ^ 0x36;
+    ctx->opad[i] = k[i] ^ 0x5c;
+  }
+  sha256Init(&ctx->inner);
+  sha256Update(&ctx->inner, ipad, sizeof(ipad));
+
+  memset(k, 0, sizeof(k));
+  memset(ipad, 0, sizeof(ipad));
+}
+
+static inline void hmacSha256Update(HmacSha256Ctx* ctx, const uint8_t* data, size_t len) {
+  sha256Update(&ctx->inner, data, len);
+}
+
+static inline void hmacSha256Final(HmacSha256Ctx* ctx, uint8_t mac[SHA256_DIGEST_SIZE]) {
+  uint8_t innerHash[SHA256_DIGEST_SIZE];
+  sha256Final(&ctx->inner, innerHash);
+
+  Sha256Ctx outer;
+  sha256Init(&outer);
+  sha256Update(&outer, ctx->opad, sizeof(ctx->opad));
+  sha256Update(&outer, innerHash, sizeof(innerHash));
+  sha256Final(&outer, mac);
+
+  memset(innerHash, 0, sizeof(innerHash));
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+static inline void hmacSha256(const uint8_t* key, size_t keyLen, const uint8_t* msg, size_t msgLen,
+                              uint8_t mac[SHA256_DIGEST_SIZE]) {
+  HmacSha256Ctx ctx;
+  hmacSha256Init(&ctx, key, keyLen);
+  hmacSha256Update(&ctx, msg, msgLen);
+  hmacSha256Final(&ctx, mac);
+}
+
+// ============================================================
+// HKDF-SHA256 (RFC 5869)
+// ============================================================
+
+// ─── Extract: PRK = HMAC(salt, IKM) ───
+static inline void hkdfSha256Extract(const uint8_t* salt, size_t saltLen, const uint8_t* ikm, size_t ikmLen,
+                                     uint8_t prk[SHA256_DIGEST_SIZE]) {
+  uint8_t zeros[SHA256_DIGEST_SIZE];
+  if (salt == nullptr || saltLen == 0) {
+    memset(zeros, 0, sizeof(zeros));
+    salt = zeros;
+    saltLen = sizeof(zeros);
+  }
+  hmacSha256(salt, saltLen, ikm, ikmLen, prk);
+}
+
+// ─── Expand: OKM = T(1) | T(2) | ... truncated to okmLen (≤ 255·32) ───
+static inline bool hkdfSha256Expand(const uint8_t prk[SHA256_DIGEST_SIZE], const uint8_t* info, size_t infoLen,
+                                    uint8_t* okm, size_t okmLen) {
+  if (okmLen > 255 * SHA256_DIGEST_SIZE) return false;
+
+  uint8_t t[SHA256_DIGEST_SIZE];
+  size_t tLen = 0;
+  uint8_t counter = 1;
+
+  while (okmLen > 0) {
+    HmacSha256Ctx ctx;
+    hmacSha256Init(&ctx, prk, SHA256_DIGEST_SIZE);
+    hmacSha256Update(&ctx, t, tLen);
+    hmacSha256Update(&ctx, info, infoLen);
+    hmacSha256Update(&ctx, &counter, 1);
+    hmacSha256Final(&ctx, t);
+    tLen = SHA256_DIGEST_SIZE;
+
+    size_t n = okmLen < SHA256_DIGEST_SIZE ? okmLen : SHA256_DIGEST_SIZE;
+    memcpy(okm, t, n);
+    okm += n;
+    okmLen -= n;
+    counter++;
+  }
+
+  memset(t, 0, sizeof(t));
+  return true;
+}
+
+// ─── Extract + expand ───
+static inline bool hkdfSha256(const uint8_t* salt, size_t saltLen, const uint8_t* ikm, size_t ikmLen,
+                              const uint8_t* info, size_t infoLen, uint8_t* okm, size_t okmLen) {
+  uint8_t prk[SHA256_DIGEST_SIZE];
+  hkdfSha256Extract(salt, saltLen, ikm, ikmLen, prk);
+  bool ok = hkdfSha256Expand(prk, info, infoLen, okm, okmLen);
+  memset(prk, 0, sizeof(prk));
+  return ok;
+}
+
+#endif // SHA256_H
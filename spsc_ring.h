@@ -0,0 +1,54 @@
+// ============================================================
+// spsc_ring.h — Fixed-capacity lock-free single-producer /
+//               single-consumer ring
+//
+// One side only calls push(), the other only pop(). Indices are
+// free-running 32-bit counters; the slot is (index % N), so N
+// must be a power of two. Publication uses release/acquire
+// ordering, which is all that's needed between the two RP2350
+// cores (or two host threads) — no locks, no interrupts off.
+//
+// Usage:
+//   static SpscRing<Msg, 8> q;
+//   q.push(msg)   — producer side, false if full
+//   q.pop(msg)    — consumer side, false if empty
+// ============================================================
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, uint32_t N>
+struct SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+  T buf[N];
+  std::atomic<uint32_t> head{0};  // next slot to write (producer-owned)
+  std::atomic<uint32_t> tail{0};  // next slot to read  (consumer-owned)
+
+  // ─── Producer ───
+  bool push(const T& item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N) return false;  // full
+    buf[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // ─── Consumer ───
+  bool pop(T& item) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;  // empty
+    item = buf[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // ─── Either side (snapshot, may be stale by the time it returns) ───
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,64 @@
+// ============================================================
+// state_cache.h — Generation counter for RAM caches of
+//                 registration + sensor state
+//
+// Every cache entry remembers the generation it was filled at.
+// Anything that changes persistent state (EEPROM write/clear,
+// sensor store/delete) calls cacheBump(), which makes every
+// entry stale at once. Reads then cost one compare on the hot
+// path and only go back to EEPROM / UART after a change.
+//
+// Usage:
+//   cacheBump()                 — after any state mutation
+//   cacheFresh(gen)             — is an entry filled at gen valid?
+//   cacheHit(id) / cacheMiss(id)
+//   cachePrintStats()
+// ============================================================
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <Arduino.h>
+
+// ─── Cache IDs (for hit/miss counters) ───
+enum CacheId : uint8_t {
+  CACHE_REG,      // EEPROM registration header (slot, length, validity)
+  CACHE_SENSOR,   // sensor occupancy bitmap
+  CACHE_COUNT
+};
+
+// ─── State ───
+// Starts at 1 so a zero-initialized entry is never fresh.
+static uint32_t _cache_generation = 1;
+static uint32_t _cache_hits[CACHE_COUNT];
+static uint32_t _cache_misses[CACHE_COUNT];
+
+inline uint32_t cacheGeneration()       { return _cache_generation; }
+inline void cacheBump()                 { _cache_generation++; }
+inline bool cacheFresh(uint32_t gen)    { return gen == _cache_generation; }
+
+inline void cacheHit(CacheId id)        { _cache_hits[id]++; }
+inline void cacheMiss(CacheId id)       { _cache_misses[id]++; }
+inline uint32_t cacheHits(CacheId id)   { return _cache_hits[id]; }
+inline uint32_t cacheMisses(CacheId id) { return _cache_misses[id]; }
+
+inline void cacheResetStats() {
+  memset(_cache_hits, 0, sizeof(_cache_hits));
+  memset(_cache_misses, 0, sizeof(_cache_misses));
+}
+
+inline void cachePrintStats() {
+  static const char* const names[CACHE_COUNT] = { "registration", "sensor" };
+  for (uint8_t i = 0; i < CACHE_COUNT; i++) {
+    Serial.print("[CACHE] ");
+    Serial.print(names[i]);
+    Serial.print(": ");
+    Serial.print(_cache_hits[i]);
+    Serial.print(" hits, ");
+    Serial.print(_cache_misses[i]);
+    Serial.println(" misses");
+  }
+  Serial.print("[CACHE] Generation ");
+  Serial.println(_cache_generation);
+}
+
+#endif // STATE_CACHE_H
@@ -1,11 +1,32 @@
 // ============================================================
-// switch_control.h — SPDT switch with software debounce
+// switch_control.h — SPDT switch, interrupt debounce + cancel token
+//
+// Every edge on PIN_MODE_SWITCH restarts a one-shot alarm; when the
+// pin has been quiet for DEBOUNCE_MS the alarm samples it. A new
+// position is taken right there, in interrupt context:
+//
+//   - switchChanged() turns true for loop() / the flows
+//   - the switch generation moves on, cancelling every
+//     switchToken() taken before (sensor waits, password reads)
+//   - the idle loop is woken (idle.h)
+//
+// Nobody has to poll, so a flip is seen within one debounce window
+// of the last bounce even while a flow is blocked.
+//
+// Usage:
+//   switchInit()                  — once in setup (attaches the ISR)
+//   switchRead()                  — debounced position
+//   switchChanged() / switchAckChange()
+//   switchToken()                 — CancelToken for the current position
 // ============================================================
 #ifndef SWITCH_CONTROL_H
 #define SWITCH_CONTROL_H
 
 #include <Arduino.h>
+#include <pico/time.h>
 #include "config.h"
+#include "idle.h"
+#include "tasks.h"
 
 // ─── Types ───
 enum DeviceMode {
@@ -13,12 +34,39 @@ enum DeviceMode {
   MODE_RECOGNIZE   // Switch HIGH (internal pull-up)
 };
 
-// ─── State (file-scoped) ───
-static int _sw_lastReading         = -1;
-static unsigned long _sw_lastChangeTime = 0;
-static DeviceMode _sw_stableMode   = MODE_RECOGNIZE;
-static bool _sw_initialized        = false;
-static bool _sw_changed            = false;
+// ─── State (ISR + alarm write, main code reads) ───
+static volatile DeviceMode _sw_stableMode = MODE_RECOGNIZE;
+static volatile bool _sw_changed          = false;
+static volatile uint32_t _sw_gen          = 0;   // bumped on every accepted flip
+static volatile uint32_t _sw_edgeUs       = 0;   // last raw edge
+static volatile alarm_id_t _sw_alarm      = 0;   // debounce alarm pending
+static bool _sw_initialized               = false;
+
+// ─── Alarm: pin quiet for DEBOUNCE_MS? take its position ───
+static int64_t _swOnSettle(alarm_id_t, void*) {
+  uint32_t quietUs = (uint32_t)micros() - _sw_edgeUs;
+  if (quietUs < DEBOUNCE_MS * 1000UL) {
+    return (int64_t)(DEBOUNCE_MS * 1000UL - quietUs);   // bounced since — wait out the rest
+  }
+  _sw_alarm = 0;
+  DeviceMode mode = (digitalRead(PIN_MODE_SWITCH) == LOW) ? MODE_REGISTER : MODE_RECOGNIZE;
+  if (mode != _sw_stableMode) {
+    _sw_stableMode = mode;
+    _sw_changed = true;
+    _sw_gen++;
+    idlePost(IDLE_EV_SWITCH);
+  }
+  return 0;
+}
+
+// ─── ISR — note the edge, arm the debounce alarm once ───
+static void _swOnEdge() {
+  _sw_edgeUs = (uint32_t)micros();
+  if (!_sw_alarm) {
+    alarm_id_t id = add_alarm_in_ms(DEBOUNCE_MS, _swOnSettle, nullptr, true);
+    _sw_alarm = id > 0 ? id : 0;
+  }
+}
 
 // ─── API ───
 
@@ -26,40 +74,25 @@ inline void switchInit() {
   pinMode(PIN_MODE_SWITCH, INPUT_PULLUP);
 
   // Read initial state immediately (no debounce needed at boot)
-  int raw = digitalRead(PIN_MODE_SWITCH);
-  _sw_stableMode   = (raw == LOW) ? MODE_REGISTER : MODE_RECOGNIZE;
-  _sw_lastReading  = raw;
-  _sw_lastChangeTime = millis();
-  _sw_initialized  = true;
-  _sw_changed      = false;
+  _sw_stableMode  = (digitalRead(PIN_MODE_SWITCH) == LOW) ? MODE_REGISTER : MODE_RECOGNIZE;
+  _sw_initialized = true;
+  _sw_changed     = false;
+  attachInterrupt(digitalPinToInterrupt(PIN_MODE_SWITCH), _swOnEdge, CHANGE);
 }
 
 inline DeviceMode switchRead() {
   if (!_sw_initialized) switchInit();
-
-  int reading = digitalRead(PIN_MODE_SWITCH);
-
-  // Reset debounce timer on any edge
-  if (reading != _sw_lastReading) {
-    _sw_lastChangeTime = millis();
-    _sw_lastReading = reading;
-  }
-
-  // Accept new state only after debounce settles
-  if ((millis() - _sw_lastChangeTime) > DEBOUNCE_MS) {
-    DeviceMode newMode = (reading == LOW) ? MODE_REGISTER : MODE_RECOGNIZE;
-    if (newMode != _sw_stableMode) {
-      _sw_stableMode = newMode;
-      _sw_changed = true;
-    }
-  }
-
   return _sw_stableMode;
 }
 
 inline bool switchChanged()    { return _sw_changed; }
 inline void switchAckChange()  { _sw_changed = false; }
 
+// ─── Cancelled by the next accepted flip ───
+inline CancelToken switchToken() {
+  return { &_sw_gen, _sw_gen };
+}
+
 inline const char* modeName(DeviceMode mode) {
   return (mode == MODE_REGISTER) ? "REGISTER" : "RECOGNIZE";
 }
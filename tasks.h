@@ -0,0 +1,129 @@
+// ============================================================
+// tasks.h — Cooperative background servicing for blocking flows
+//
+// Registration and recognition are written as straight-line
+// flows with waits between sensor steps. Instead of delay(),
+// they wait with taskDelay() / taskWaitUntil(), which keep
+// running the registered pollers (serial console, log
+// drain, ...) every TASK_POLL_INTERVAL_MS. Nothing is
+// starved while a flow is waiting.
+//
+// Pollers must be short and must NOT start flows themselves —
+// they only sample inputs and set flags that loop() acts on.
+//
+// Usage:
+//   taskAddPoller(fn)             — register once in setup
+//   taskPoll()                    — run all pollers now
+//   taskDelay(ms)                 — delay() that keeps polling
+//   taskWaitUntil(pred, ms)       — poll until pred() or timeout
+//   taskConsoleClaim/Release()    — flow owns Serial input
+//   taskCancelled(token)          — has the token's source moved on?
+//   taskPassStart()               — loop() woke: the gap clock restarts
+//   taskMaxGapMs()                — worst-case service latency (!STATS)
+// ============================================================
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+typedef void (*TaskPollFn)();
+typedef bool (*TaskPredFn)();
+
+// ─── Cancellation token ───
+// A generation taken when a flow starts. The source (an ISR) bumps
+// its counter to cancel every wait still holding the old value;
+// waits that take a token give up as soon as they see it.
+struct CancelToken {
+  const volatile uint32_t* gen;   // nullptr = never cancelled
+  uint32_t taken;
+};
+static const CancelToken TASK_NO_CANCEL = { nullptr, 0 };
+
+inline bool taskCancelled(const CancelToken &t) {
+  return t.gen && *t.gen != t.taken;
+}
+
+// ─── State ───
+static TaskPollFn _task_pollers[TASK_MAX_POLLERS];
+static uint8_t _task_pollerCount = 0;
+static bool _task_inPoll = false;        // re-entrancy guard
+static bool _task_consoleOwned = false;  // flow is reading Serial itself
+static unsigned long _task_lastPoll = 0;
+static unsigned long _task_maxGapMs = 0;
+
+// ─── Register a background poller ───
+inline bool taskAddPoller(TaskPollFn fn) {
+  if (_task_pollerCount >= TASK_MAX_POLLERS) return false;
+  _task_pollers[_task_pollerCount++] = fn;
+  return true;
+}
+
+// ─── Run all pollers once ───
+// Also tracks the longest gap between two polls — the worst-case
+// latency for a serial command or switch edge to be noticed.
+inline void taskPoll() {
+  if (_task_inPoll) return;
+  _task_inPoll = true;
+
+  unsigned long now = millis();
+  if (_task_lastPoll != 0 && (now - _task_lastPoll) > _task_maxGapMs) {
+    _task_maxGapMs = now - _task_lastPoll;
+  }
+  _task_lastPoll = now;
+
+  for (uint8_t i = 0; i < _task_pollerCount; i++) {
+    _task_pollers[i]();
+  }
+
+  _task_inPoll = false;
+}
+
+// ─── delay() replacement that keeps servicing pollers ───
+inline void taskDelay(unsigned long ms) {
+  unsigned long start = millis();
+  taskPoll();
+  while ((millis() - start) < ms) {
+    unsigned long left = ms - (millis() - start);
+    delay(left < TASK_POLL_INTERVAL_MS ? left : TASK_POLL_INTERVAL_MS);
+    taskPoll();
+  }
+}
+
+// ─── Poll until pred() is true or timeout expires ───
+// Returns true if pred() became true, false on timeout.
+inline bool taskWaitUntil(TaskPredFn pred, unsigned long timeoutMs) {
+  unsigned long start = millis();
+  while (true) {
+    taskPoll();
+    if (pred()) return true;
+    if ((millis() - start) >= timeoutMs) return false;
+    delay(TASK_POLL_INTERVAL_MS);
+  }
+}
+
+// ─── Console ownership ───
+// While a flow reads Serial directly (password entry), the console
+// poller must not consume its bytes.
+inline void taskConsoleClaim()   { _task_consoleOwned = true; }
+inline void taskConsoleRelease() { _task_consoleOwned = false; }
+inline bool taskConsoleOwned()   { return _task_consoleOwned; }
+
+// ─── Latency stats ───
+// Only gaps inside a loop() pass count: an idle core is woken by
+// the interrupt itself, so time asleep is not service latency.
+inline void taskPassStart() { _task_lastPoll = millis(); }
+
+inline unsigned long taskMaxGapMs() { return _task_maxGapMs; }
+inline void taskResetStats() {
+  _task_maxGapMs = 0;
+  _task_lastPoll = millis();
+}
+
+inline void taskPrintStats() {
+  char line[48];
+  snprintf(line, sizeof(line), "[STATS] max poll gap %lu ms", _task_maxGapMs);
+  Serial.println(line);
+}
+
+#endif // TASKS_H
@@ -0,0 +1,225 @@
+// ============================================================
+// tpl_backup.h — Encrypted template backups, restored at boot
+//
+// A replaced or factory-reset sensor module has lost its
+// templates while the journal still says which credential owns
+// which ID. Once an enrollment is committed its template is read
+// back from the sensor (getTemplate), sealed with the device keys
+// (crypto.h) and written to a backup sector after the journal:
+//
+//   [ magic | ver | id | cred | iv | tag ][ ciphertext (1008 B) ]
+//     ╰──────── AAD ─────────╯
+//
+// Boot validation hands every indexed ID the sensor lacks to
+// tplBackupRestore(): tag checked, decrypted, downloaded into the
+// same ID — one UART transfer instead of COLLECT_COUNT captures.
+// A backup from another board, altered in flash or made for
+// another credential is refused, and the finger stays missing.
+//
+// RAM: one static SENSOR_TEMPLATE_BYTES buffer, sealed / opened
+// in place and wiped after use. The sector is programmed a page
+// at a time, the page carrying the header last, so a torn write
+// never looks like a backup.
+//
+// A backup is dropped (header magic cleared, one page program)
+// before its ID's template is deleted, so a later finger in the
+// same ID is never swapped for an old one.
+//
+// Usage:
+//   tplBackupAvailable()  — FS area holds the backup sectors
+//   tplBackupSave(id)     — after the index commit; true = stored
+//   tplBackupRestore(id)  — boot: missing template → sensor
+//   tplBackupDrop(id)     — before deleting id's template
+//   tplBackupCount()      — slots holding a backup
+// ============================================================
+#ifndef TPL_BACKUP_H
+#define TPL_BACKUP_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "flash_region.h"
+#include "crypto.h"
+#include "cred_index.h"
+#include "sensor_service.h"
+
+#define TPL_BACKUP_MAGIC    0x4B425054UL   // "TPBK"
+#define TPL_BACKUP_VERSION  1
+#define TPL_BACKUP_AAD_LEN  8              // magic, version, id, credential, reserved
+
+struct TplBackupHdr {
+  uint32_t magic;       // TPL_BACKUP_MAGIC; 0 = dropped, 0xFFFFFFFF = erased
+  uint8_t  version;
+  uint8_t  id;          // sensor ID it restores into
+  uint8_t  credential;  // owner when it was taken
+  uint8_t  reserved;
+  uint8_t  iv[16];
+  uint8_t  tag[EEPROM_TAG_LEN];
+};
+
+#define TPL_BACKUP_BYTES  (sizeof(TplBackupHdr) + SENSOR_TEMPLATE_BYTES)
+#define TPL_BACKUP_PAGES  ((TPL_BACKUP_BYTES + FLASH_REGION_PAGE - 1) / FLASH_REGION_PAGE)
+
+static_assert(sizeof(TplBackupHdr) == 40, "TplBackupHdr must be packed");
+static_assert(SENSOR_TEMPLATE_BYTES % 16 == 0, "template must be whole AES blocks");
+static_assert(TPL_BACKUP_BYTES <= FLASH_REGION_SECTOR, "backup must fit one sector");
+static_assert(TPL_BACKUP_SLOTS >= 1, "TPL_BACKUP_SLOTS must be at least 1");
+
+enum TplRestore : uint8_t {
+  TPL_RESTORED,
+  TPL_NO_BACKUP,
+  TPL_REFUSED,        // tag, id or credential doesn't match
+  TPL_SENSOR_ERROR    // downLoadTemplate failed
+};
+
+// ─── State ───
+static uint8_t _tpl_buf[SENSOR_TEMPLATE_BYTES];   // template on its way through
+static uint8_t _tpl_slotId[TPL_BACKUP_SLOTS];     // sensor ID held, 0 = free
+static bool _tpl_scanned = false;
+
+static inline uint32_t _tplSlotOff(uint8_t slot) {
+  return FLASH_REGION_JOURNAL + (uint32_t)slot * FLASH_REGION_SECTOR;
+}
+
+// ─── Headers of every slot, once per boot ───
+static inline void _tplScan() {
+  if (_tpl_scanned) return;
+  for (uint8_t s = 0; s < TPL_BACKUP_SLOTS; s++) {
+    TplBackupHdr hdr;
+    flashRegionRead(_tplSlotOff(s), &hdr, sizeof(hdr));
+    bool held = hdr.magic == TPL_BACKUP_MAGIC && hdr.version == TPL_BACKUP_VERSION &&
+                hdr.id >= 1 && hdr.id <= SENSOR_CAPACITY;
+    _tpl_slotId[s] = held ? hdr.id : 0;
+  }
+  _tpl_scanned = true;
+}
+
+static inline int8_t _tplFind(uint8_t id) {
+  for (uint8_t s = 0; s < TPL_BACKUP_SLOTS; s++) {
+    if (_tpl_slotId[s] == id) return (int8_t)s;
+  }
+  return -1;
+}
+
+// ─── Slot for id: its own, else a free one, else one nobody owns ───
+static inline int8_t _tplPickSlot(uint8_t id) {
+  int8_t slot = _tplFind(id);
+  if (slot >= 0) return slot;
+  slot = _tplFind(0);
+  if (slot >= 0) return slot;
+  for (uint8_t s = 0; s < TPL_BACKUP_SLOTS; s++) {
+    if (!idBitsTest(credAssigned(), _tpl_slotId[s])) return (int8_t)s;
+  }
+  return -1;
+}
+
+// ─── Erase + program header || _tpl_buf, header page last ───
+static inline void _tplWrite(uint8_t slot, const TplBackupHdr &hdr) {
+  uint32_t off = _tplSlotOff(slot);
+  flashRegionErase(off);
+
+  uint8_t page[FLASH_REGION_PAGE];
+  for (uint8_t p = TPL_BACKUP_PAGES; p-- > 0; ) {
+    memset(page, 0xFF, sizeof(page));
+    for (uint16_t i = 0; i < FLASH_REGION_PAGE; i++) {
+      uint16_t at = (uint16_t)(p * FLASH_REGION_PAGE + i);
+      if (at < sizeof(hdr)) page[i] = ((const uint8_t*)&hdr)[at];
+      else if (at < TPL_BACKUP_BYTES) page[i] = _tpl_buf[at - sizeof(hdr)];
+    }
+    flashRegionProgram(off + (uint32_t)p * FLASH_REGION_PAGE, page);
+  }
+}
+
+// ============================================================
+// PUBLIC API
+// ============================================================
+
+inline bool tplBackupAvailable() {
+  return flashRegionSize() >= FLASH_REGION_BYTES;
+}
+
+// ─── Back up id's template under its current credential ───
+inline bool tplBackupSave(uint8_t id) {
+  uint8_t cred = credLookup(id);
+  if (!tplBackupAvailable() || cred == 0) return false;
+  _tplScan();
+  int8_t slot = _tplPickSlot(id);
+  if (slot < 0) return false;
+
+  if (sensorTemplateGet(id, _tpl_buf) != 0) {
+    cryptoWipe(_tpl_buf, sizeof(_tpl_buf));
+    return false;
+  }
+
+  TplBackupHdr hdr;
+  memset(&hdr, 0xFF, sizeof(hdr));
+  hdr.magic = TPL_BACKUP_MAGIC;
+  hdr.version = TPL_BACKUP_VERSION;
+  hdr.id = id;
+  hdr.credential = cred;
+  cryptoRandom(hdr.iv, sizeof(hdr.iv));
+  bool ok = cryptoSeal((const uint8_t*)&hdr, TPL_BACKUP_AAD_LEN, hdr.iv,
+                       _tpl_buf, _tpl_buf, SENSOR_TEMPLATE_BYTES, hdr.tag, EEPROM_TAG_LEN);
+  if (ok) {
+    sensorWaitIdle();   // flash program parks core1
+    _tplWrite((uint8_t)slot, hdr);
+    _tpl_slotId[slot] = id;
+
+    // Read back: the tag must hold over what landed in flash
+    TplBackupHdr back;
+    flashRegionRead(_tplSlotOff((uint8_t)slot), &back, sizeof(back));
+    flashRegionRead(_tplSlotOff((uint8_t)slot) + sizeof(back), _tpl_buf, SENSOR_TEMPLATE_BYTES);
+    ok = memcmp(&back, &hdr, sizeof(hdr)) == 0 &&
+         cryptoVerifyTag((const uint8_t*)&back, TPL_BACKUP_AAD_LEN, back.iv,
+                         _tpl_buf, SENSOR_TEMPLATE_BYTES, back.tag, EEPROM_TAG_LEN);
+  }
+  cryptoWipe(_tpl_buf, sizeof(_tpl_buf));
+  return ok;
+}
+
+// ─── Put id's backup back into the sensor (same ID) ───
+inline TplRestore tplBackupRestore(uint8_t id) {
+  if (!tplBackupAvailable()) return TPL_NO_BACKUP;
+  _tplScan();
+  int8_t slot = _tplFind(id);
+  if (slot < 0) return TPL_NO_BACKUP;
+
+  TplBackupHdr hdr;
+  flashRegionRead(_tplSlotOff((uint8_t)slot), &hdr, sizeof(hdr));
+  uint8_t cred = credLookup(id);
+  if (hdr.id != id || cred == 0 || hdr.credential != cred) return TPL_REFUSED;
+
+  flashRegionRead(_tplSlotOff((uint8_t)slot) + sizeof(hdr), _tpl_buf, SENSOR_TEMPLATE_BYTES);
+  if (!cryptoOpen((const uint8_t*)&hdr, TPL_BACKUP_AAD_LEN, hdr.iv, _tpl_buf, _tpl_buf,
+                  SENSOR_TEMPLATE_BYTES, hdr.tag, EEPROM_TAG_LEN)) {
+    cryptoWipe(_tpl_buf, sizeof(_tpl_buf));
+    return TPL_REFUSED;
+  }
+  uint8_t ret = sensorTemplatePut(id, _tpl_buf);
+  cryptoWipe(_tpl_buf, sizeof(_tpl_buf));
+  return ret == 0 ? TPL_RESTORED : TPL_SENSOR_ERROR;
+}
+
+// ─── Forget id's backup (no-op if it has none) ───
+inline void tplBackupDrop(uint8_t id) {
+  if (!tplBackupAvailable() || id == 0) return;
+  _tplScan();
+  int8_t slot = _tplFind(id);
+  if (slot < 0) return;
+
+  uint8_t page[FLASH_REGION_PAGE];
+  memset(page, 0xFF, sizeof(page));
+  memset(page, 0, sizeof(uint32_t));   // magic → 0; the sector is erased on reuse
+  sensorWaitIdle();
+  flashRegionProgram(_tplSlotOff((uint8_t)slot), page);
+  _tpl_slotId[slot] = 0;
+}
+
+inline uint8_t tplBackupCount() {
+  if (!tplBackupAvailable()) return 0;
+  _tplScan();
+  uint8_t n = 0;
+  for (uint8_t s = 0; s < TPL_BACKUP_SLOTS; s++) n += (_tpl_slotId[s] != 0);
+  return n;
+}
+
+#endif // TPL_BACKUP_H
@@ -1,13 +1,31 @@
 // ============================================================
 // validation.h — Boot integrity check + orphan cleanup
 //
-// Decision matrix (from PLAN.md):
-//   EEPROM valid + activeSlot fingerprint exists   → VALID (clean orphans)
-//   EEPROM invalid + no fingerprints               → VIRGIN
-//   EEPROM valid + activeSlot fingerprint missing   → CORRUPT (clear all)
-//   EEPROM invalid + fingerprint(s) exist           → CORRUPT (clear all)
+// Decision matrix, applied per credential (from PLAN.md, with the
+// two A/B slots generalized to N index entries):
+// Indexed fingers the sensor has lost (replaced or reset module) are
+// first restored from their encrypted backups (tpl_backup.h); only
+// what can't be restored counts as missing below.
 //
-// Slot check: uses getEnrolledIDList() to build a lookup of occupied slots.
+//   record valid + ≥1 of its fingers enrolled     → keep
+//   record valid + every finger missing           → drop credential
+//   record invalid (tag / missing)                → drop credential + its fingers
+//   indexed finger not enrolled                   → unassign that finger
+//   enrolled template not in the index            → orphan, delete
+//
+// While a legacy registration is waiting to be migrated
+// (credLegacyPending) its finger is on the sensor but in no index,
+// so the sensor checks are skipped that boot, as when the sensor
+// list can't be read.
+//
+// Overall result:
+//   any credential kept                           → VALID (cleanups logged)
+//   nothing kept, something had to be cleaned     → CORRUPT
+//   nothing kept, nothing enrolled                → VIRGIN
+//
+// The plan is computed from three bitsets (index, sensor occupancy,
+// per-credential fingers) before anything is touched, so it is a
+// handful of word operations whatever the number of fingers.
 // ============================================================
 #ifndef VALIDATION_H
 #define VALIDATION_H
@@ -16,7 +34,13 @@
 #include <DFRobot_ID809.h>
 #include "config.h"
 #include "eeprom_storage.h"
+#include "cred_index.h"
+#include "tpl_backup.h"
 #include "led_feedback.h"
+#include "sensor_service.h"
+#include "log_ring.h"
+#include "id_bits.h"
+#include "tasks.h"
 
 // ─── Result codes ───
 enum BootState {
@@ -25,141 +49,222 @@ enum BootState {
   BOOT_CORRUPT   // Inconsistent state, was cleaned up
 };
 
-// ─── Slot occupancy state (built once at validation time) ───
-static bool _val_slot1Occupied = false;
-static bool _val_slot2Occupied = false;
-
-// ─── Build slot occupancy map using getEnrolledIDList ───
-// More reliable than getStatusID which may have unexpected return values.
-static inline void _valBuildSlotMap(DFRobot_ID809 &fp) {
-  _val_slot1Occupied = false;
-  _val_slot2Occupied = false;
-
-  uint8_t count = fp.getEnrollCount();
-  if (count == 0) return;
-
-  // Allocate buffer for enrolled ID list (sensor supports up to 80)
-  uint8_t idList[80];
-  memset(idList, 0, sizeof(idList));
-
-  uint8_t ret = fp.getEnrolledIDList(idList);
-  if (ret != 0) {
-    // getEnrolledIDList failed — fall back to count-only check
-    Serial.println("[BOOT] Warning: getEnrolledIDList failed, using count only");
-    // If count > 0 but we can't get the list, assume worst case
-    // Mark both as potentially occupied to avoid false VIRGIN
-    _val_slot1Occupied = true;
-    _val_slot2Occupied = (count > 1);
+// ─── What boot validation will do ───
+struct ValPlan {
+  IdBits orphans;      // enrolled, not indexed → delete template
+  IdBits missing;      // indexed, not enrolled → unassign
+  IdBits doomed;       // fingers of dropped credentials → delete template
+  uint8_t keepMask;    // bit c-1: credential c is usable
+  uint8_t dropMask;    // bit c-1: credential c is removed
+};
+
+// ─── Pure planner ───
+// fingers[c-1] / inUse bit c-1 / recordOk bit c-1 describe the index;
+// enrolled is the sensor bitmap, trusted only when listed is true.
+static inline void _valPlan(const IdBits* fingers, const IdBits &assigned, uint8_t inUse,
+                            uint8_t recordOk, const IdBits &enrolled, bool listed, ValPlan &plan) {
+  idBitsClear(plan.orphans);
+  idBitsClear(plan.missing);
+  idBitsClear(plan.doomed);
+  plan.keepMask = 0;
+  plan.dropMask = 0;
+
+  if (listed) {
+    plan.orphans = idBitsAndNot(enrolled, assigned);
+    plan.missing = idBitsAndNot(assigned, enrolled);
+  }
+
+  for (uint8_t c = 0; c < CRED_MAX_CREDENTIALS; c++) {
+    uint8_t bit = (uint8_t)(1u << c);
+    bool used = inUse & bit;
+    IdBits live = idBitsAndNot(fingers[c], plan.missing);
+    if (!used && !idBitsAny(fingers[c])) continue;
+
+    if (used && (recordOk & bit) && idBitsAny(live)) {
+      plan.keepMask |= bit;
+    } else {
+      plan.dropMask |= bit;
+      for (uint8_t i = 0; i < ID_BITS_WORDS; i++) plan.doomed.w[i] |= live.w[i];
+    }
+  }
+}
+
+static inline BootState _valOutcome(const ValPlan &plan) {
+  if (plan.keepMask) return BOOT_VALID;
+  if (plan.dropMask || idBitsAny(plan.orphans) || idBitsAny(plan.missing)) return BOOT_CORRUPT;
+  return BOOT_VIRGIN;
+}
+
+static inline void _valPrintIds(const char* label, const IdBits &ids) {
+  logFlush();
+  Serial.print(label);
+  if (!idBitsAny(ids)) {
+    Serial.println(" none");
     return;
   }
+  for (uint8_t id = idBitsFirst(ids); id; id = idBitsNext(ids, id)) {
+    Serial.print(' ');
+    Serial.print(id);
+  }
+  Serial.println();
+}
 
-  // Scan the list for slots 1 and 2
-  for (uint8_t i = 0; i < count && i < 80; i++) {
-    if (idList[i] == 1) _val_slot1Occupied = true;
-    if (idList[i] == 2) _val_slot2Occupied = true;
+// ─── Delete templates (and their backups) for every id in ids ───
+static inline void _valDeleteTemplates(const IdBits &ids) {
+  for (uint8_t id = idBitsFirst(ids); id; id = idBitsNext(ids, id)) {
+    tplBackupDrop(id);
+    sensorDelete(id);
   }
 }
 
-// ─── Delete all fingerprints in our two slots ───
-static inline void _valClearAllSlots(DFRobot_ID809 &fp) {
-  fp.delFingerprint(1);
-  fp.delFingerprint(2);
+// ─── Indexed fingers the sensor lacks → back from their backups ───
+static inline void _valRestoreMissing() {
+  IdBits missing = idBitsAndNot(credAssigned(), sensorOccupancy());
+  if (!idBitsAny(missing)) return;
+
+  uint32_t t0 = millis();
+  uint8_t restored = 0;
+  for (uint8_t id = idBitsFirst(missing); id; id = idBitsNext(missing, id)) {
+    switch (tplBackupRestore(id)) {
+      case TPL_RESTORED:     restored++; break;
+      case TPL_REFUSED:      LOG("[WARNING] Backup for ID %u refused (tag / owner mismatch)", id); break;
+      case TPL_SENSOR_ERROR: LOG("[WARNING] Restoring ID %u failed (sensor)", id); break;
+      case TPL_NO_BACKUP:    break;
+    }
+  }
+  if (restored) LOG("[BOOT] Restored %u template(s) from backup in %u ms", restored, millis() - t0);
 }
 
 // ─── Main boot validation ───
-// Call after sensor + EEPROM are initialized, before entering main loop.
+// Call after sensor + credential index are initialized, before entering main loop.
 // Returns the boot state so the caller can decide behavior.
-inline BootState runBootValidation(DFRobot_ID809 &fp) {
-  Serial.println("[BOOT] Running integrity check...");
-  Serial.flush();
+inline BootState runBootValidation() {
+  LOG("[BOOT] Running integrity check...");
 
-  // Read EEPROM state
-  uint8_t activeSlot = 0;
-  char password[PASSWORD_MAX_LEN + 1];
-  uint8_t pwdLen = 0;
-  bool eepromValid = eepromReadRegistration(activeSlot, password, pwdLen);
-
-  // Clear password from stack immediately — we don't need it for validation
-  memset(password, 0, sizeof(password));
+  // Gather index + record state (tag checks only, nothing decrypted)
+  IdBits fingers[CRED_MAX_CREDENTIALS];
+  uint8_t inUse = 0, recordOk = 0;
+  for (uint8_t c = 1; c <= CRED_MAX_CREDENTIALS; c++) {
+    fingers[c - 1] = credFingers(c);
+    if (credInUse(c)) inUse |= (uint8_t)(1u << (c - 1));
+    if (credRecordValid(c)) recordOk |= (uint8_t)(1u << (c - 1));
+  }
 
-  // Build slot occupancy map from sensor
-  _valBuildSlotMap(fp);
+  // Sensor occupancy (cached bitmap from getEnrolledIDList)
+  bool listed = sensorOccupancyKnown();
+  if (credLegacyPending()) {
+    LOG("[BOOT] Warning: slot %u not migrated yet, sensor left as is", credLegacyPending());
+    listed = false;
+  }
+  if (listed) _valRestoreMissing();
+  uint8_t count = sensorCachedEnrollCount();
+  if (count > 0 && !listed && !credLegacyPending()) {
+    // getEnrolledIDList failed — trust the index, skip orphan/missing checks
+    LOG("[BOOT] Warning: getEnrolledIDList failed, using index only");
+  }
 
-  bool anyFingerprints = _val_slot1Occupied || _val_slot2Occupied;
+  ValPlan plan;
+  _valPlan(fingers, credAssigned(), inUse, recordOk, sensorOccupancy(), listed, plan);
 
   // Detailed debug output
-  Serial.print("[BOOT] EEPROM: ");
-  if (eepromValid) {
-    Serial.println("valid (slot " + String(activeSlot) + ")");
-  } else {
-    Serial.println("invalid");
-  }
-  Serial.flush();
-
-  Serial.print("[BOOT] Sensor: slot1=");
-  Serial.print(_val_slot1Occupied ? "occupied" : "empty");
-  Serial.print(" slot2=");
-  Serial.println(_val_slot2Occupied ? "occupied" : "empty");
-  Serial.flush();
-
-  // ── Case 1: EEPROM valid + active slot has fingerprint → VALID ──
-  bool activeSlotOccupied = (activeSlot == 1) ? _val_slot1Occupied : _val_slot2Occupied;
-
-  if (eepromValid && activeSlotOccupied) {
-    Serial.println("[BOOT] State: VALID");
-    Serial.flush();
-
-    // Clean up orphan in the OTHER slot (from interrupted registration)
-    uint8_t otherSlot = (activeSlot == 1) ? 2 : 1;
-    bool otherOccupied = (otherSlot == 1) ? _val_slot1Occupied : _val_slot2Occupied;
-    if (otherOccupied) {
-      fp.delFingerprint(otherSlot);
-      Serial.println("[BOOT] Cleaned orphan in slot " + String(otherSlot));
-    }
+  LOG("[BOOT] Sensor: %u template(s)", count);
+  credPrintIndex();
 
-    return BOOT_VALID;
-  }
+  BootState state = _valOutcome(plan);
+  bool cleanup = plan.dropMask || idBitsAny(plan.orphans) || idBitsAny(plan.missing);
 
-  // ── Case 2: EEPROM invalid + no fingerprints → VIRGIN ──
-  if (!eepromValid && !anyFingerprints) {
-    Serial.println("[BOOT] State: VIRGIN");
-    Serial.flush();
+  if (state == BOOT_VIRGIN) {
+    LOG("[BOOT] State: VIRGIN");
     return BOOT_VIRGIN;
   }
 
-  // ── Case 3: EEPROM valid + active slot fingerprint MISSING → CORRUPT ──
-  if (eepromValid && !activeSlotOccupied) {
-    Serial.println("[WARNING] Fingerprint missing for active slot — corrupt");
-    Serial.flush();
+  if (state == BOOT_CORRUPT) {
+    LOG("[WARNING] No usable credential left — corrupt");
     ledCorruptState();
+  }
 
-    eepromClearRegistration();
-    _valClearAllSlots(fp);
+  if (cleanup) {
+    if (idBitsAny(plan.orphans)) _valPrintIds("[BOOT] Deleting orphan template(s):", plan.orphans);
+    if (idBitsAny(plan.missing)) _valPrintIds("[WARNING] Indexed finger(s) missing on sensor:", plan.missing);
+    for (uint8_t c = 1; c <= CRED_MAX_CREDENTIALS; c++) {
+      if (plan.dropMask & (1u << (c - 1))) {
+        LOG("[WARNING] Dropping credential #%u%s", c,
+            credRecordValid(c) ? " (no fingers left)" : " (record invalid)");
+      }
+    }
 
-    Serial.println("[WARNING] Cleared EEPROM + all fingerprints");
-    Serial.flush();
-    delay(2000);
-    return BOOT_CORRUPT;
+    _valDeleteTemplates(plan.orphans);
+    _valDeleteTemplates(plan.doomed);
+    for (uint8_t id = idBitsFirst(plan.missing); id; id = idBitsNext(plan.missing, id)) {
+      tplBackupDrop(id);   // unassigned below; a refused backup must not linger
+    }
+    if (!credCommitPrune(plan.missing, plan.dropMask)) {
+      LOG("[ERROR] Credential index update failed");
+    }
   }
 
-  // ── Case 4: EEPROM invalid + fingerprint(s) exist → CORRUPT ──
-  if (!eepromValid && anyFingerprints) {
-    Serial.println("[WARNING] Orphan fingerprint(s) without password — corrupt");
-    Serial.flush();
-    ledCorruptState();
+  if (state == BOOT_CORRUPT) {
+    LOG("[WARNING] Cleared — register again");
+    return BOOT_CORRUPT;   // the red flash plays on while boot goes on
+  }
 
-    _valClearAllSlots(fp);
+  LOG("[BOOT] State: VALID");
+  return BOOT_VALID;
+}
 
-    Serial.println("[WARNING] Cleared orphan fingerprints");
-    Serial.flush();
-    delay(2000);
-    return BOOT_CORRUPT;
-  }
+// ============================================================
+// BENCHMARK — lookup + plan at 1 / 10 / 80 enrolled fingers
+// ============================================================
+// Synthetic index (ids 1..n round-robin over the credentials,
+// every finger enrolled); nothing touches flash or the sensor.
+inline void valBenchmark() {
+  static const uint8_t sizes[] = { 1, 10, SENSOR_CAPACITY };
+  const unsigned long cpu = F_CPU / 1000000UL;
+  const uint16_t passes = 1000;
 
-  // Shouldn't reach here, but treat as virgin
-  Serial.println("[WARNING] Unexpected state — treating as virgin");
-  Serial.flush();
-  return BOOT_VIRGIN;
+  for (uint8_t s = 0; s < sizeof(sizes); s++) {
+    uint8_t n = sizes[s];
+    CredIndexRecord idx;
+    _credEmpty(idx);
+    IdBits fingers[CRED_MAX_CREDENTIALS], assigned, enrolled;
+    idBitsClear(assigned);
+    for (uint8_t c = 0; c < CRED_MAX_CREDENTIALS; c++) idBitsClear(fingers[c]);
+    uint8_t inUse = 0;
+    for (uint8_t id = 1; id <= n; id++) {
+      uint8_t c = (uint8_t)((id - 1) % CRED_MAX_CREDENTIALS);
+      idx.owner[id - 1] = c + 1;
+      idx.bank[c] = CRED_BANK_A;
+      inUse |= (uint8_t)(1u << c);
+      idBitsSet(fingers[c], id);
+      idBitsSet(assigned, id);
+    }
+    enrolled = assigned;
+
+    // Lookup: every enrolled id, passes times
+    volatile uint8_t sink = 0;
+    unsigned long t0 = micros();
+    for (uint16_t p = 0; p < passes; p++) {
+      for (uint8_t id = 1; id <= n; id++) sink += _credLookupIn(idx, id);
+    }
+    unsigned long t1 = micros();
+
+    // Validation plan
+    ValPlan plan;
+    for (uint16_t p = 0; p < passes; p++) {
+      _valPlan(fingers, assigned, inUse, inUse, enrolled, true, plan);
+      sink += plan.keepMask;
+    }
+    unsigned long t2 = micros();
+    (void)sink;
+
+    Serial.print("[CRED] ");
+    Serial.print(n);
+    Serial.print(" finger(s): lookup ");
+    Serial.print((t1 - t0) * cpu / ((unsigned long)passes * n));
+    Serial.print(" cycles, plan ");
+    Serial.print((t2 - t1) * cpu / passes);
+    Serial.println(" cycles");
+  }
 }
 
 #endif // VALIDATION_H
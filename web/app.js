@@ -19,7 +19,15 @@ let isReconnecting = false;
 let reconnectAttempts = 0;
 let stabilityTimer = null;
 let passwordMode = false;   // true when firmware is prompting for password
-let incomingLineBuf = '';    // accumulates incoming chars to detect prompts
+let regPrompt = false;      // a registration prompt is waiting for input
+let protoActive = false;    // device answered HELLO — frames understood
+let deviceMode = '';        // from status / mode events
+let ctlSeq = 0;
+let logFormats = new Map();  // format ID → string (CTL_REQ_LOG_FMT), valid for one boot
+let logAsked = new Set();
+let logHeld = [];           // output waiting behind a record whose format is unknown
+let imageOn = false;        // device streams capture images (CTL_REQ_IMAGE)
+let image = null;           // frame being drawn
 
 // ── DOM refs ──
 const btnConnect = document.getElementById('btn-connect');
@@ -30,6 +38,209 @@ const serialInput = document.getElementById('serial-input');
 const inputBar = document.getElementById('input-bar');
 const statusDot = document.getElementById('status-dot');
 const statusText = document.getElementById('status-text');
+const btnImage = document.getElementById('btn-image');
+const imageShift = document.getElementById('image-shift');
+const imagePanel = document.getElementById('image-panel');
+const imageCanvas = document.getElementById('image-canvas');
+const imageInfo = document.getElementById('image-info');
+
+// ── Control protocol (ctl_proto.h) ──
+// Binary frames share the port with the console text:
+//   0x00  COBS( type | seq | body | crc16 big-endian )  0x00
+const CTL = {
+  REQ_HELLO: 0x01, REQ_PING: 0x02, REQ_STATUS: 0x03, REQ_STATS: 0x04,
+  REQ_STATS_RESET: 0x05, REQ_CONFIG: 0x06, REQ_REG_INPUT: 0x07, REQ_RESET: 0x08,
+  REQ_LOG_MODE: 0x09, REQ_LOG_FMT: 0x0A, REQ_PROVISION: 0x0B, REQ_IMAGE: 0x0C,
+  EVT_MODE: 0x40, EVT_REG: 0x41, EVT_AUTH: 0x42, EVT_LOG: 0x43,
+  EVT_IMAGE: 0x44, EVT_IMAGE_ROW: 0x45,
+  RSP: 0x80, RSP_NAK: 0xFF,
+};
+const REG_STEP = {
+  CHOOSE: 1, PLACE: 2, REMOVE: 3, CAPTURE_FAIL: 4, PASSWORD: 5, CONFIRM: 6,
+  EMPTY: 7, MISMATCH: 8, TIMEOUT: 9, DONE: 10, FAILED: 11,
+};
+const CTL_ERR_DISABLED = 4;
+const MODE_NAMES = ['REGISTER', 'RECOGNIZE'];
+const MAX_REG_INPUT = 32;   // PASSWORD_MAX_LEN
+
+// CRC-16/CCITT-FALSE
+function crc16(bytes, crc = 0xFFFF) {
+  for (const b of bytes) {
+    crc ^= b << 8;
+    for (let i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) & 0xFFFF : (crc << 1) & 0xFFFF;
+    }
+  }
+  return crc;
+}
+
+// type, seq, body → delimited wire frame
+function encodeFrame(type, seq, body = new Uint8Array(0)) {
+  const payload = new Uint8Array(body.length + 4);
+  payload[0] = type;
+  payload[1] = seq;
+  payload.set(body, 2);
+  const crc = crc16(payload.subarray(0, body.length + 2));
+  payload[body.length + 2] = crc >> 8;
+  payload[body.length + 3] = crc & 0xFF;
+
+  const out = [0];
+  let codeAt = out.length;
+  out.push(0);
+  let code = 1;
+  for (const b of payload) {
+    if (b !== 0) { out.push(b); code++; }
+    if (b === 0 || code === 0xFF) {
+      out[codeAt] = code;
+      codeAt = out.length;
+      out.push(0);
+      code = 1;
+    }
+  }
+  out[codeAt] = code;
+  out.push(0);
+  return new Uint8Array(out);
+}
+
+// COBS bytes (no delimiters) → { type, seq, body } or null
+function decodeFrame(cobs) {
+  const p = [];
+  for (let i = 0; i < cobs.length;) {
+    const code = cobs[i++];
+    if (code === 0 || i + code - 1 > cobs.length) return null;
+    for (let k = 1; k < code; k++) p.push(cobs[i++]);
+    if (code !== 0xFF && i < cobs.length) p.push(0);
+  }
+  if (p.length < 4 || crc16(p) !== 0) return null;   // CRC residue is 0
+  return { type: p[0], seq: p[1], body: Uint8Array.from(p.slice(2, -2)) };
+}
+
+// ── Deferred log records (log_ring.h) ──
+// CTL_EVT_LOG body: ms u32 LE, format ID, then per conversion
+// d/i/u/x/X → u32 LE, c → 1 byte, s → length byte + bytes.
+// Rendered with the same rules as the firmware's logFormat().
+function renderLog(fmt, body) {
+  let o = 5;
+  let out = '';
+  for (let i = 0; i < fmt.length; i++) {
+    const c = fmt[i];
+    if (c !== '%') { out += c; continue; }
+    if (fmt[i + 1] === '%') { out += '%'; i++; continue; }
+    let left = false, zero = false, width = 0;
+    for (i++; fmt[i] === '-' || fmt[i] === '0'; i++) {
+      if (fmt[i] === '-') left = true; else zero = true;
+    }
+    for (; fmt[i] >= '0' && fmt[i] <= '9'; i++) width = width * 10 + (fmt.charCodeAt(i) - 48);
+    while (fmt[i] === 'l' || fmt[i] === 'h') i++;
+    const conv = fmt[i];
+    if (conv === undefined) break;
+
+    let text, neg = false;
+    if (conv === 's') {
+      if (o >= body.length || o + 1 + body[o] > body.length) { out += '?'; continue; }
+      const n = body[o++];
+      text = new TextDecoder().decode(body.subarray(o, o + n));
+      o += n;
+      zero = false;
+    } else if (conv === 'c') {
+      if (o >= body.length) { out += '?'; continue; }
+      text = String.fromCharCode(body[o++]);
+      zero = false;
+    } else {
+      if (o + 4 > body.length) { out += '?'; continue; }
+      const v = (body[o] | (body[o + 1] << 8) | (body[o + 2] << 16) | (body[o + 3] << 24)) >>> 0;
+      o += 4;
+      if (conv === 'd' || conv === 'i') {
+        const sv = v | 0;
+        neg = sv < 0;
+        text = String(Math.abs(sv));
+      } else if (conv === 'u') {
+        text = String(v);
+      } else if (conv === 'x' || conv === 'X') {
+        text = conv === 'x' ? v.toString(16) : v.toString(16).toUpperCase();
+      } else {
+        out += '%' + conv;
+        continue;
+      }
+    }
+    const fill = Math.max(0, width - text.length - (neg ? 1 : 0));
+    if (!left && !zero) out += ' '.repeat(fill);
+    if (neg) out += '-';
+    if (!left && zero) out += '0'.repeat(fill);
+    out += text;
+    if (left) out += ' '.repeat(fill);
+  }
+  return out;
+}
+
+// ── Capture image rows (img_codec.h) ──
+// Differences to the left neighbour after px >> shift, as tokens:
+//   00nnnnnn literal, n+1 bytes follow   01nnnnnn n+1 zeros
+//   1nnnnnnn n+1 nibbles in -8..7, low nibble first
+// Writes gray pixels into rgba (4 bytes each); false if malformed.
+function decodeImageRow(src, w, shift, rgba) {
+  const mid = shift ? 1 << (shift - 1) : 0;
+  let v = 0, x = 0, i = 0;
+  const put = (d) => {
+    v = (v + d) & 0xFF;
+    const g = ((v << shift) | mid) & 0xFF;
+    rgba[x * 4] = rgba[x * 4 + 1] = rgba[x * 4 + 2] = g;
+    rgba[x * 4 + 3] = 255;
+    x++;
+  };
+  while (i < src.length) {
+    const t = src[i++];
+    let k = ((t & 0x80) ? t & 0x7F : t & 0x3F) + 1;
+    if (x + k > w) return false;
+    if (t & 0x80) {
+      if (i + ((k + 1) >> 1) > src.length) return false;
+      for (let j = 0; j < k; j++) {
+        const nib = (src[i + (j >> 1)] >> ((j & 1) * 4)) & 0x0F;
+        put(nib & 0x08 ? nib - 16 : nib);
+      }
+      i += (k + 1) >> 1;
+    } else if (t & 0x40) {
+      while (k--) put(0);
+    } else {
+      if (i + k > src.length) return false;
+      while (k--) put(src[i++]);
+    }
+  }
+  return x === w;
+}
+
+// Splits the incoming byte stream into console text and frames.
+// Same rule as the firmware: 0x00 opens a frame, the next closes
+// it, and "00 00" restarts (resync after a lost delimiter).
+class FrameDemux {
+  constructor(onText, onFrame) {
+    this.onText = onText;
+    this.onFrame = onFrame;
+    this.inFrame = false;
+    this.frame = [];
+  }
+
+  push(chunk) {
+    let textFrom = 0;
+    for (let i = 0; i < chunk.length; i++) {
+      const b = chunk[i];
+      if (!this.inFrame) {
+        if (b !== 0) continue;
+        if (i > textFrom) this.onText(chunk.subarray(textFrom, i));
+        this.inFrame = true;
+        this.frame = [];
+      } else if (b !== 0) {
+        this.frame.push(b);
+      } else if (this.frame.length > 0) {
+        const msg = decodeFrame(this.frame);
+        if (msg) this.onFrame(msg);
+        this.inFrame = false;
+        textFrom = i + 1;
+      }
+    }
+    if (!this.inFrame && textFrom < chunk.length) this.onText(chunk.subarray(textFrom));
+  }
+}
 
 // ── Mobile / browser detection ──
 const isMobile = /Android|iPhone|iPad|iPod|webOS|Opera Mini/i.test(navigator.userAgent);
@@ -124,11 +335,13 @@ term.writeln('');
 function setConnected(connected) {
   statusDot.classList.remove('connected', 'reconnecting');
   if (connected) statusDot.classList.add('connected');
-  statusText.textContent = connected ? 'Connected' : 'Disconnected';
+  if (!connected) { protoActive = false; deviceMode = ''; }
+  showStatusText(connected);
   btnConnect.textContent = connected ? 'Disconnect' : 'Connect';
   btnConnect.disabled = false;
   btnReset.disabled = !connected;
   btnSend.disabled = !connected;
+  btnImage.disabled = imageShift.disabled = !connected;
   serialInput.disabled = !connected;
   serialInput.placeholder = connected ? 'Type a command and press Enter...' : 'Not connected';
   if (connected) serialInput.focus();
@@ -146,6 +359,11 @@ function setReconnecting() {
   serialInput.placeholder = 'Reconnecting to device...';
 }
 
+function showStatusText(connected) {
+  if (!connected) { statusText.textContent = 'Disconnected'; return; }
+  statusText.textContent = deviceMode ? `Connected · ${deviceMode}` : 'Connected';
+}
+
 // ── Send text over serial ──
 async function serialSend(text) {
   if (writer) {
@@ -154,6 +372,13 @@ async function serialSend(text) {
   }
 }
 
+// ── Send a control request (seq 1..255; 0 is reserved for events) ──
+async function ctlSend(type, body) {
+  if (!writer) return;
+  ctlSeq = (ctlSeq % 255) + 1;
+  await writer.write(encodeFrame(type, ctlSeq, body));
+}
+
 // ── Connect (initial — requires user gesture for port picker) ──
 async function connect() {
   try {
@@ -186,6 +411,14 @@ async function openPort() {
     readLoopActive = true;
     readLoop();
 
+    // Ask for status and turn on device events; logs as binary records.
+    // Format IDs are handed out per boot, so the cache starts empty.
+    logFormats = new Map();
+    logAsked = new Set();
+    logHeld = [];
+    await ctlSend(CTL.REQ_HELLO);
+    await ctlSend(CTL.REQ_LOG_MODE, Uint8Array.of(1));
+
     // Listen for disconnect
     port.addEventListener('disconnect', onPortDisconnect);
 
@@ -212,6 +445,10 @@ async function openPort() {
 // ── Read loop ──
 async function readLoop() {
   const decoder = new TextDecoder();
+  const demux = new FrameDemux(
+    (bytes) => writeOutput(decoder.decode(bytes, { stream: true })),
+    handleDeviceMessage
+  );
   try {
     while (port && port.readable && readLoopActive) {
       reader = port.readable.getReader();
@@ -219,11 +456,7 @@ async function readLoop() {
         while (true) {
           const { value, done } = await reader.read();
           if (done) break;
-          if (value) {
-            const text = decoder.decode(value);
-            term.write(text);
-            checkForPasswordPrompt(text);
-          }
+          if (value) demux.push(value);
         }
       } finally {
         reader.releaseLock();
@@ -245,7 +478,7 @@ async function disconnect() {
   isReconnecting = false;
   reconnectAttempts = 0;
   setPasswordMode(false);
-  incomingLineBuf = '';
+  regPrompt = false;
   if (stabilityTimer) { clearTimeout(stabilityTimer); stabilityTimer = null; }
   await closePort();
   port = null;
@@ -353,12 +586,21 @@ btnClear.addEventListener('click', () => {
   term.clear();
 });
 
+// ── Capture images: on / off, quantization ──
+function requestImage(on) {
+  if (protoActive) ctlSend(CTL.REQ_IMAGE, Uint8Array.of(on ? 1 : 0, Number(imageShift.value)));
+}
+
+btnImage.addEventListener('click', () => requestImage(!imageOn));
+imageShift.addEventListener('change', () => { if (imageOn) requestImage(true); });
+
 btnReset.addEventListener('click', async () => {
   if (writer) {
     // Flag that we expect a disconnect and should auto-reconnect
     isReconnecting = true;
     reconnectAttempts = 0;
-    await serialSend('!RESET\n');
+    if (protoActive) await ctlSend(CTL.REQ_RESET);
+    else await serialSend('!RESET\n');
     term.writeln('');
     term.writeln('\x1b[33m── Reset command sent ──\x1b[0m');
   }
@@ -377,42 +619,157 @@ btnSend.addEventListener('click', () => {
 
 function sendInputValue() {
   const val = serialInput.value;
-  if (val.length === 0) return;
-  serialSend(val + '\n');
+  if (val.length === 0 && !regPrompt) return;
+  if (regPrompt && protoActive) {
+    // Answer the prompt as one frame — the device echoes only '*'
+    ctlSend(CTL.REQ_REG_INPUT, new TextEncoder().encode(val.slice(0, MAX_REG_INPUT)));
+  } else {
+    serialSend(val + '\n');
+  }
   serialInput.value = '';
   serialInput.focus();
 }
 
-// ── Password prompt detection ──
-// Watches incoming serial text for password prompt lines.
-// Toggles input field between password (masked) and text (plain).
-function checkForPasswordPrompt(text) {
-  // Accumulate into line buffer and check complete lines
-  for (const ch of text) {
-    if (ch === '\n' || ch === '\r') {
-      const line = incomingLineBuf.trim();
-      if (line.length > 0) {
-        if (line.includes('Enter password') || line.includes('Confirm password')) {
-          setPasswordMode(true);
-        } else if (line.includes('Mismatch') || line.includes('Empty password')) {
-          // Password error — flash but stay in password mode
-          flashInputError();
-        } else if (line.includes('Password entry timeout') || line.includes('Too many mismatches')) {
-          // Fatal password error — exit password mode with flash
-          flashInputError();
-          setPasswordMode(false);
-        } else if (passwordMode && (
-          line.includes('[REG]') || line.includes('[AUTH]') ||
-          line.includes('[BOOT]') || line.includes('[MODE]') ||
-          line.includes('[CMD]') || line.includes('[ERROR]')
-        )) {
-          // Any non-password tagged line ends password mode
-          setPasswordMode(false);
+// ── Terminal output, in device order ──
+// While a log record waits for its format, console text queues
+// behind it instead of overtaking it.
+function writeOutput(text) {
+  if (logHeld.length) logHeld.push({ text });
+  else term.write(text);
+}
+
+function releaseLogs() {
+  while (logHeld.length) {
+    const item = logHeld[0];
+    if (item.record) {
+      const id = item.record[4];
+      if (!logFormats.has(id)) {
+        if (!logAsked.has(id)) {
+          logAsked.add(id);
+          ctlSend(CTL.REQ_LOG_FMT, Uint8Array.of(id));
         }
+        return;
       }
-      incomingLineBuf = '';
+      term.write(renderLog(logFormats.get(id), item.record) + '\r\n');
+    } else {
+      term.write(item.text);
+    }
+    logHeld.shift();
+  }
+}
+
+// ── Device messages (responses + events) ──
+// Replaces scraping the console text for prompts: the firmware
+// announces every registration step as a CTL_EVT_REG event.
+function handleDeviceMessage(msg) {
+  const { type, body } = msg;
+
+  if (type === (CTL.REQ_HELLO | CTL.RSP) || type === (CTL.REQ_STATUS | CTL.RSP)) {
+    const first = !protoActive;
+    protoActive = true;
+    deviceMode = MODE_NAMES[body[1]] || '';
+    showStatusText(true);
+    if (first && imageOn) requestImage(true);   // a rebooted device starts with images off
+    return;
+  }
+
+  if (type === (CTL.REQ_IMAGE | CTL.RSP)) {
+    imageOn = body[0] === 1;
+    btnImage.classList.toggle('active', imageOn);
+    return;
+  }
+
+  if (type === CTL.RSP_NAK && body[0] === CTL.REQ_IMAGE) {
+    imageOn = false;
+    btnImage.classList.remove('active');
+    if (body[1] === CTL_ERR_DISABLED) {
+      btnImage.disabled = imageShift.disabled = true;
+      term.writeln('\x1b[33m── Image streaming compiled out (IMAGE_DIAG 0) ──\x1b[0m');
+    }
+    return;
+  }
+
+  if (type === CTL.EVT_IMAGE) {
+    if (body.length < 4) return;
+    const [frame, w, h, shift] = body;
+    imageCanvas.width = w;
+    imageCanvas.height = h;
+    const ctx = imageCanvas.getContext('2d');
+    image = { frame, w, h, shift, ctx, row: ctx.createImageData(w, 1), rows: 0, bad: 0, coded: 0, t0: performance.now() };
+    imagePanel.hidden = false;
+    imageInfo.textContent = `frame ${frame} · receiving…`;
+    return;
+  }
+
+  if (type === CTL.EVT_IMAGE_ROW) {
+    if (!image || body.length < 2 || body[0] !== image.frame || body[1] >= image.h) return;
+    if (decodeImageRow(body.subarray(2), image.w, image.shift, image.row.data)) {
+      image.ctx.putImageData(image.row, 0, body[1]);
     } else {
-      incomingLineBuf += ch;
+      image.bad++;
+    }
+    image.rows++;
+    image.coded += body.length - 2;
+    if (image.rows === image.h) {
+      const raw = image.w * image.h;
+      const ms = Math.round(performance.now() - image.t0);
+      imageInfo.textContent = `frame ${image.frame} · ${image.w}×${image.h} · ${256 >> image.shift} levels · ` +
+        `${image.coded} of ${raw} B (${(100 * image.coded / raw).toFixed(1)}%) · ${ms} ms` +
+        (image.bad ? ` · ${image.bad} bad row(s)` : '');
+    }
+    return;
+  }
+
+  if (type === CTL.EVT_LOG) {
+    if (body.length >= 5) {
+      logHeld.push({ record: body });
+      releaseLogs();
+    }
+    return;
+  }
+
+  if (type === (CTL.REQ_LOG_FMT | CTL.RSP)) {
+    if (body.length >= 1) logFormats.set(body[0], new TextDecoder().decode(body.subarray(1)));
+    releaseLogs();
+    return;
+  }
+
+  if (type === CTL.EVT_MODE) {
+    deviceMode = MODE_NAMES[body[0]] || '';
+    showStatusText(true);
+    regPrompt = false;
+    setPasswordMode(false);
+    return;
+  }
+
+  if (type === CTL.EVT_REG) {
+    switch (body[0]) {
+      case REG_STEP.CHOOSE:
+        regPrompt = true;
+        setPasswordMode(false);
+        break;
+      case REG_STEP.PASSWORD:
+      case REG_STEP.CONFIRM:
+        regPrompt = true;
+        setPasswordMode(true);
+        break;
+      case REG_STEP.EMPTY:
+      case REG_STEP.MISMATCH:
+        // Password error — flash but stay in password mode
+        flashInputError();
+        break;
+      case REG_STEP.TIMEOUT:
+      case REG_STEP.FAILED:
+        // Fatal — exit password mode with flash
+        flashInputError();
+        regPrompt = false;
+        setPasswordMode(false);
+        break;
+      default:
+        // Capture steps, done: nothing to type
+        regPrompt = false;
+        setPasswordMode(false);
+        break;
     }
   }
 }